@@ -78,11 +78,13 @@ SOURCES += \
     globals/aboutxfl3d.cpp \
     globals/main.cpp \
     globals/mainframe.cpp \
+    globals/offscreenrunner.cpp \
     globals/prefsdlg.cpp \
 
 HEADERS += \
     globals/aboutxfl3d.h \
     globals/mainframe.h \
+    globals/offscreenrunner.h \
     globals/prefsdlg.h
 
 
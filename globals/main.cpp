@@ -2,9 +2,15 @@
 #include <QApplication>
 #include <QSettings>
 #include <QFile>
+#include <QTextStream>
 
 #include <globals/mainframe.h>
+#include <globals/offscreenrunner.h>
 #include <xfl3d/views/gl3dview.h>
+#include <xfl3d/testgl/optim2dbench.h>
+#include <xfl3d/testgl/gl2dquat.h>
+#include <xfl3d/testgl/gl2drm.h>
+#include <xfl3d/testgl/quatraymarcher.h>
 
 
 
@@ -62,6 +68,146 @@ void setOGLDefaultFormat(int version)
 }
 
 
+/**
+ * Runs the optimization benchmark without the GUI.
+ * Usage: xfl3d -optimbench [settings.json] [-out results.json|results.csv]
+ */
+int runOptimBench(int argc, char *argv[])
+{
+    QCoreApplication a(argc, argv);
+
+    QString settingsfile, outfile;
+    for(int i=0; i<argc; i++)
+    {
+        QString strange = argv[i];
+        if(strange.compare("-optimbench", Qt::CaseSensitive)==0 && i<argc-1 && argv[i+1][0]!='-')
+            settingsfile = argv[i+1];
+        else if(strange.compare("-out", Qt::CaseSensitive)==0 && i<argc-1)
+            outfile = argv[i+1];
+    }
+
+    QTextStream out(stdout);
+    QString log;
+    Optim2dBench bench;
+    if(!settingsfile.isEmpty() && !bench.loadSettings(settingsfile, log))
+    {
+        out << log;
+        return 1;
+    }
+    bench.run(log);
+    if(!outfile.isEmpty()) bench.saveResults(outfile, log);
+    out << log;
+    return 0;
+}
+
+
+/**
+ * Ray-marches the 3d section of the quaternion Julia set on the CPU without the GUI,
+ * using the saved settings of the quaternion Julia and ray marching views.
+ * Usage: xfl3d -quatmarch [-size 3840x2160] [-out image.png] [-nobound]
+ */
+int runQuatMarch(int argc, char *argv[])
+{
+    QCoreApplication a(argc, argv);
+
+    int iw=1920, ih=1080;
+    bool bBounding = true;
+    QString outfile = "quatjulia.png";
+    for(int i=0; i<argc; i++)
+    {
+        QString strange = argv[i];
+        if(strange.compare("-size", Qt::CaseSensitive)==0 && i<argc-1)
+        {
+            QStringList dims = QString(argv[i+1]).split('x');
+            if(dims.size()==2)
+            {
+                iw = dims.at(0).toInt();
+                ih = dims.at(1).toInt();
+            }
+        }
+        else if(strange.compare("-out", Qt::CaseSensitive)==0 && i<argc-1)
+            outfile = argv[i+1];
+        else if(strange.compare("-nobound", Qt::CaseSensitive)==0)
+            bBounding = false;
+    }
+
+    QTextStream out(stdout);
+    if(iw<=0 || ih<=0)
+    {
+        out << "Invalid image size\n";
+        return 1;
+    }
+
+#if defined Q_OS_MAC
+    QSettings settings(QSettings::IniFormat,QSettings::UserScope,"Xfl3d", );
+#elif defined Q_OS_LINUX
+    QSettings settings(QSettings::NativeFormat,QSettings::UserScope,"Xfl3d");
+#else
+    QSettings settings(QSettings::IniFormat,QSettings::UserScope,"Xfl3d");
+#endif
+    if(QFile(settings.fileName()).exists())
+    {
+        gl2dQuat::loadSettings(settings);
+        gl2dRM::loadSettings(settings);
+    }
+
+    QuatRayMarcher marcher;
+    gl2dQuat::setRayMarcher(marcher);
+    marcher.setBoundingSphere(bBounding);
+    marcher.fitView(iw, ih);
+
+    QImage img = marcher.render(iw, ih);
+    if(img.isNull())
+    {
+        out << QString::asprintf("Could not allocate a %dx%d image\n", iw, ih);
+        return 1;
+    }
+    if(!img.save(outfile, "PNG"))
+    {
+        out << "Could not write the file "+outfile+"\n";
+        return 1;
+    }
+
+    out << QString::asprintf("%dx%d image in %.3f s: %.1f ms/Mpixel, %.1f steps/pixel\n",
+                             iw, ih, marcher.renderTime()/1000.0, marcher.msPerMegaPixel(), marcher.stepsPerPixel());
+    out << "Saved "+outfile+"\n";
+    return 0;
+}
+
+
+/**
+ * Runs a demo view for a number of frames without showing it, and prints the timings.
+ * On a Linux system without a display, the offscreen platform plugin is used unless another
+ * one is set, e.g. QT_QPA_PLATFORM=offscreen LIBGL_ALWAYS_SOFTWARE=1 for Mesa's llvmpipe.
+ * Usage: xfl3d -runview name [-frames 100] [-warmup 5] [-size 1280x720] [-seed 1]
+ *                            [-settings file.ini] [-out directory] [-every N] [-o 43]
+ */
+int runView(int argc, char *argv[])
+{
+#ifdef Q_OS_LINUX
+    if(qEnvironmentVariableIsEmpty("QT_QPA_PLATFORM") && qEnvironmentVariableIsEmpty("DISPLAY") && qEnvironmentVariableIsEmpty("WAYLAND_DISPLAY"))
+        qputenv("QT_QPA_PLATFORM", "offscreen");
+#endif
+
+    int version = -1;
+    for(int i=0; i<argc; i++)
+    {
+        if(QString(argv[i]).compare("-o", Qt::CaseSensitive)==0 && i<argc-1)
+            version = QString(argv[i+1]).toInt();
+    }
+    setOGLDefaultFormat(version);
+
+    QApplication a(argc, argv);
+
+    QTextStream out(stdout);
+    QString log;
+    OffscreenRunner runner;
+    bool bSuccess = runner.parseArguments(argc, argv, log) && runner.run(log);
+    out << log;
+    return bSuccess ? 0 : 1;
+}
+
+
 /**
  * The app's point of entry !
  */
@@ -87,6 +233,16 @@ int main(int argc, char *argv[])
     QCoreApplication::setAttribute(Qt::AA_ShareOpenGLContexts);
     QCoreApplication::setAttribute(Qt::AA_UseDesktopOpenGL);
 
+    for(int i=0; i<argc; i++)
+    {
+        if(QString(argv[i]).compare("-optimbench", Qt::CaseSensitive)==0)
+            return runOptimBench(argc, argv);
+        if(QString(argv[i]).compare("-quatmarch", Qt::CaseSensitive)==0)
+            return runQuatMarch(argc, argv);
+        if(QString(argv[i]).compare("-runview", Qt::CaseSensitive)==0)
+            return runView(argc, argv);
+    }
+
     int version = -1;
     for(int i=0; i<argc; i++)
     {
@@ -260,31 +260,38 @@ void MainFrame::loadSettings()
         }
         settings.endGroup();
 
-        DisplayOptions::loadSettings(settings);
-        GLLightDlg::loadSettings(settings);
-        OpenGlDlg::loadSettings(settings);
-        W3dPrefs::loadSettings(settings);
-        gl2dFractal::loadSettings(settings);
-        gl2dNewton::loadSettings(settings);
-        gl2dQuat::loadSettings(settings);
-        gl3dAttractors::loadSettings(settings);
-        gl3dBoids2::loadSettings(settings);
-        gl3dBoids::loadSettings(settings);
-        gl3dFlightView::loadSettings(settings);
-        gl3dFlowVtx::loadSettings(settings);
-        gl3dHydrogen::loadSettings(settings);
-        gl3dLorenz2::loadSettings(settings);
-        gl3dLorenz::loadSettings(settings);
-        gl3dOptim2d::loadSettings(settings);
-        gl3dSagittarius::loadSettings(settings);
-        gl3dShadow::loadSettings(settings);
-        gl3dSolarSys::loadSettings(settings);
-        gl3dSpace::loadSettings(settings);
-        gl3dView::loadSettings(settings);
+        loadViewSettings(settings);
     }
 }
 
 
+/** Loads the display options and the settings of all the views */
+void MainFrame::loadViewSettings(QSettings &settings)
+{
+    DisplayOptions::loadSettings(settings);
+    GLLightDlg::loadSettings(settings);
+    OpenGlDlg::loadSettings(settings);
+    W3dPrefs::loadSettings(settings);
+    gl2dFractal::loadSettings(settings);
+    gl2dNewton::loadSettings(settings);
+    gl2dQuat::loadSettings(settings);
+    gl3dAttractors::loadSettings(settings);
+    gl3dBoids2::loadSettings(settings);
+    gl3dBoids::loadSettings(settings);
+    gl3dFlightView::loadSettings(settings);
+    gl3dFlowVtx::loadSettings(settings);
+    gl3dHydrogen::loadSettings(settings);
+    gl3dLorenz2::loadSettings(settings);
+    gl3dLorenz::loadSettings(settings);
+    gl3dOptim2d::loadSettings(settings);
+    gl3dSagittarius::loadSettings(settings);
+    gl3dShadow::loadSettings(settings);
+    gl3dSolarSys::loadSettings(settings);
+    gl3dSpace::loadSettings(settings);
+    gl3dView::loadSettings(settings);
+}
+
+
 void MainFrame::saveSettings()
 {
 #if defined Q_OS_MAC
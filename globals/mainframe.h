@@ -2,6 +2,7 @@
 #pragma once
 
 #include <QMainWindow>
+#include <QSettings>
 
 class MainFrame : public QMainWindow
 {
@@ -11,6 +12,8 @@ class MainFrame : public QMainWindow
         MainFrame(QWidget *parent = nullptr);
         ~MainFrame();
 
+        static void setDefaultStaticFonts();
+        static void loadViewSettings(QSettings &settings);
 
     private:
         void createMenu();
@@ -18,7 +21,6 @@ class MainFrame : public QMainWindow
         void saveSettings();
 
         void setColorListFromFile();
-        void setDefaultStaticFonts();
 
         void closeEvent(QCloseEvent *pEvent) override;
 
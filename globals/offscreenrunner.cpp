@@ -0,0 +1,261 @@
+/****************************************************************************
+
+    Xfl3d application
+    Copyright (C) Andre Deperrois
+    License: GPL v3
+
+*****************************************************************************/
+
+#include <algorithm>
+
+#include <QCoreApplication>
+#include <QDir>
+#include <QElapsedTimer>
+#include <QFile>
+#include <QOpenGLContext>
+#include <QOpenGLFunctions>
+#include <QRandomGenerator>
+#include <QResizeEvent>
+#include <QSettings>
+#include <QShowEvent>
+#include <QTextStream>
+
+#include "offscreenrunner.h"
+#include <globals/mainframe.h>
+#include <xfl3d/views/frameprofiler.h>
+#include <xfl3d/testgl/gl3dtestglview.h>
+#include <xfl3d/testgl/gl2dfractal.h>
+#include <xfl3d/testgl/gl2dnewton.h>
+#include <xfl3d/testgl/gl2dquat.h>
+#include <xfl3d/testgl/gl3dattractors.h>
+#include <xfl3d/testgl/gl3dboids.h>
+#include <xfl3d/testgl/gl3dboids2.h>
+#include <xfl3d/testgl/gl3dflightview.h>
+#include <xfl3d/testgl/gl3dflowvtx.h>
+#include <xfl3d/testgl/gl3dhydrogen.h>
+#include <xfl3d/testgl/gl3dlorenz.h>
+#include <xfl3d/testgl/gl3dlorenz2.h>
+#include <xfl3d/testgl/gl3doptim2d.h>
+#include <xfl3d/testgl/gl3dsagittarius.h>
+#include <xfl3d/testgl/gl3dshadow.h>
+#include <xfl3d/testgl/gl3dsolarsys.h>
+#include <xfl3d/testgl/gl3dspace.h>
+
+
+OffscreenRunner::OffscreenRunner()
+{
+    m_ViewName = "testgl";
+    m_nFrames = 100;
+    m_nWarmUp = 5;
+    m_Size = QSize(1280, 720);
+    m_Seed = 1;
+    m_SaveEvery = 0;
+}
+
+
+QStringList OffscreenRunner::viewNames()
+{
+    return {"testgl", "fractal", "newton", "quat", "shadow", "flight", "hydrogen", "lorenz", "lorenzgpu",
+            "attractors", "solarsys", "sagittarius", "flow", "space", "optim2d", "boids", "boidsgpu"};
+}
+
+
+/**
+ * Creates the view, and returns the name of the slot which advances its simulation by one step,
+ * or nullptr if the view has no simulation or if the simulation is done when the view is painted.
+ */
+QOpenGLWidget *OffscreenRunner::makeView(QString const &name, char const *&stepslot) const
+{
+    stepslot = nullptr;
+    QString view = name.toLower();
+    if(view=="testgl")      return new gl3dTestGLView;
+    if(view=="fractal")     return new gl2dFractal;
+    if(view=="newton")      {stepslot = "onMoveRoots";   return new gl2dNewton;}
+    if(view=="quat")        return new gl2dQuat;
+    if(view=="shadow")      return new gl3dShadow;
+    if(view=="flight")      {stepslot = "moveIt";        return new gl3dFlightView;}
+    if(view=="hydrogen")    return new gl3dHydrogen;
+    if(view=="lorenz")      {stepslot = "moveIt";        return new gl3dLorenz;}
+    if(view=="lorenzgpu")   return new gl3dLorenz2;
+    if(view=="attractors")  {stepslot = "moveThem";      return new gl3dAttractors;}
+    if(view=="solarsys")    {stepslot = "onMovePlanets"; return new gl3dSolarSys;}
+    if(view=="sagittarius") {stepslot = "onMoveStars";   return new gl3dSagittarius;}
+    if(view=="flow")        {stepslot = "moveThem";      return new gl3dFlowVtx;}
+    if(view=="space")       return new gl3dSpace;
+    if(view=="optim2d")     {stepslot = "onIteration";   return new gl3dOptim2d;}
+    if(view=="boids")       {stepslot = "onMoveBoids";   return new gl3dBoids;}
+    if(view=="boidsgpu")    return new gl3dBoids2;
+    return nullptr;
+}
+
+
+/**
+ * Usage: xfl3d -runview name [-frames N] [-warmup N] [-size WxH] [-seed S]
+ *                            [-settings file.ini] [-out directory] [-every N]
+ */
+bool OffscreenRunner::parseArguments(int argc, char *argv[], QString &log)
+{
+    for(int i=0; i<argc; i++)
+    {
+        QString strange = argv[i];
+        bool bNext = i<argc-1;
+        if(strange.compare("-runview", Qt::CaseSensitive)==0 && bNext)
+            m_ViewName = argv[++i];
+        else if(strange.compare("-frames", Qt::CaseSensitive)==0 && bNext)
+            m_nFrames = QString(argv[++i]).toInt();
+        else if(strange.compare("-warmup", Qt::CaseSensitive)==0 && bNext)
+            m_nWarmUp = std::max(0, QString(argv[++i]).toInt());
+        else if(strange.compare("-seed", Qt::CaseSensitive)==0 && bNext)
+            m_Seed = QString(argv[++i]).toUInt();
+        else if(strange.compare("-settings", Qt::CaseSensitive)==0 && bNext)
+            m_SettingsFile = argv[++i];
+        else if(strange.compare("-out", Qt::CaseSensitive)==0 && bNext)
+            m_OutDir = argv[++i];
+        else if(strange.compare("-every", Qt::CaseSensitive)==0 && bNext)
+            m_SaveEvery = QString(argv[++i]).toInt();
+        else if(strange.compare("-size", Qt::CaseSensitive)==0 && bNext)
+        {
+            QStringList dims = QString(argv[++i]).split('x');
+            if(dims.size()==2) m_Size = QSize(dims.at(0).toInt(), dims.at(1).toInt());
+        }
+    }
+
+    if(!viewNames().contains(m_ViewName.toLower()))
+    {
+        log += "Unknown view "+m_ViewName+"; the views are: "+viewNames().join(", ")+"\n";
+        return false;
+    }
+    if(m_nFrames<=0 || m_Size.isEmpty())
+    {
+        log += "Invalid number of frames or image size\n";
+        return false;
+    }
+    if(!m_SettingsFile.isEmpty() && !QFile(m_SettingsFile).exists())
+    {
+        log += "The settings file "+m_SettingsFile+" does not exist\n";
+        return false;
+    }
+    if(!m_OutDir.isEmpty() && m_SaveEvery<=0) m_SaveEvery = m_nFrames; // by default, the first and the last frames are saved
+    return true;
+}
+
+
+bool OffscreenRunner::run(QString &log)
+{
+    MainFrame::setDefaultStaticFonts();
+
+    if(!m_SettingsFile.isEmpty())
+    {
+        QSettings settings(m_SettingsFile, QSettings::IniFormat);
+        MainFrame::loadViewSettings(settings);
+    }
+
+    if(!m_OutDir.isEmpty() && !QDir().mkpath(m_OutDir))
+    {
+        log += "Could not create the directory "+m_OutDir+"\n";
+        return false;
+    }
+
+    // the views draw their random initial states from the global generator
+    QRandomGenerator::global()->seed(m_Seed);
+
+    char const *stepslot = nullptr;
+    QOpenGLWidget *pView = makeView(m_ViewName, stepslot);
+    if(!pView) return false;
+
+    FrameProfiler::setEnabled(true);
+    FrameProfiler::setOverlay(false);
+
+    // the widget is never shown; the events are sent so that the view is initialized as if it were
+    pView->setAttribute(Qt::WA_DontShowOnScreen);
+    pView->resize(m_Size);
+    QShowEvent showevent;
+    QCoreApplication::sendEvent(pView, &showevent);
+    QResizeEvent resizeevent(m_Size, QSize());
+    QCoreApplication::sendEvent(pView, &resizeevent);
+
+    QImage img = pView->grabFramebuffer();
+    if(img.isNull() || !pView->context())
+    {
+        log += "Could not create the OpenGL context\n";
+        delete pView;
+        return false;
+    }
+
+    pView->makeCurrent();
+    QOpenGLFunctions *pFuncs = pView->context()->functions();
+    log += QString::asprintf("OpenGL %s - %s\n",
+                             reinterpret_cast<char const*>(pFuncs->glGetString(GL_VERSION)),
+                             reinterpret_cast<char const*>(pFuncs->glGetString(GL_RENDERER)));
+    pView->doneCurrent();
+
+    QVector<double> simtime, rendertime;
+    QElapsedTimer t;
+    QElapsedTimer total;
+    for(int iFrame=-m_nWarmUp; iFrame<m_nFrames; iFrame++)
+    {
+        if(iFrame==0) total.start();
+        t.start();
+        if(stepslot) QMetaObject::invokeMethod(pView, stepslot, Qt::DirectConnection);
+        qint64 tsim = t.nsecsElapsed();
+
+        // renders the frame and reads it back, which waits for the GPU to complete the frame
+        img = pView->grabFramebuffer();
+        qint64 tframe = t.nsecsElapsed();
+
+        if(iFrame<0) continue;
+
+        simtime.append(double(tsim)/1.e6);
+        rendertime.append(double(tframe-tsim)/1.e6);
+
+        if(!m_OutDir.isEmpty() && m_SaveEvery>0 && (iFrame%m_SaveEvery==0 || iFrame==m_nFrames-1))
+        {
+            QString filename = m_OutDir + QDir::separator() + m_ViewName + QString::asprintf("_%04d.png", iFrame);
+            if(!img.save(filename, "PNG")) log += "Could not write the file "+filename+"\n";
+        }
+    }
+    double totaltime = double(total.nsecsElapsed())/1.e6;
+
+    QVector<double> sorted = rendertime;
+    double p50 = FrameProfiler::percentile(sorted, 50.0);
+    double p95 = FrameProfiler::percentile(sorted, 95.0);
+    double p99 = FrameProfiler::percentile(sorted, 99.0);
+    double meansim = 0.0;
+    for(int i=0; i<simtime.size(); i++) meansim += simtime.at(i);
+    meansim /= double(simtime.size());
+
+    log += QString::asprintf("%s: %d frames %dx%d in %.3f s, %.1f frames/s\n",
+                             m_ViewName.toStdString().c_str(), m_nFrames, m_Size.width(), m_Size.height(),
+                             totaltime/1000.0, double(m_nFrames)/totaltime*1000.0);
+    log += QString::asprintf("  simulation: mean %.3f ms\n", meansim);
+    log += QString::asprintf("  render:     p50 %.3f ms  p95 %.3f ms  p99 %.3f ms\n", p50, p95, p99);
+
+    if(!m_OutDir.isEmpty())
+    {
+        QString filename = m_OutDir + QDir::separator() + m_ViewName + "_timing.csv";
+        QFile csvfile(filename);
+        if(csvfile.open(QIODevice::WriteOnly | QIODevice::Text))
+        {
+            QTextStream out(&csvfile);
+            out << "frame,simulation_ms,render_ms\n";
+            for(int i=0; i<rendertime.size(); i++)
+                out << QString::asprintf("%d,%.4f,%.4f\n", i, simtime.at(i), rendertime.at(i));
+            csvfile.close();
+        }
+        else log += "Could not write the file "+filename+"\n";
+
+        // the stage times recorded by the view's profiler
+        FrameProfiler const *pProfiler = nullptr;
+        if     (gl3dView const *pgl3dView = dynamic_cast<gl3dView const*>(pView)) pProfiler = &pgl3dView->profiler();
+        else if(gl2dView const *pgl2dView = dynamic_cast<gl2dView const*>(pView)) pProfiler = &pgl2dView->profiler();
+        if(pProfiler)
+        {
+            filename = m_OutDir + QDir::separator() + m_ViewName + "_frames.json";
+            if(!pProfiler->exportJSON(filename)) log += "Could not write the file "+filename+"\n";
+        }
+    }
+
+    delete pView;
+    return true;
+}
+
@@ -0,0 +1,54 @@
+/****************************************************************************
+
+    Xfl3d application
+    Copyright (C) Andre Deperrois
+    License: GPL v3
+
+*****************************************************************************/
+
+#pragma once
+
+#include <QSize>
+#include <QString>
+#include <QStringList>
+
+class QOpenGLWidget;
+
+
+/**
+ * @class OffscreenRunner
+ * Runs one of the demo views without showing it, for benchmarks and regression tests.
+ * The view is never shown: QOpenGLWidget then renders on its own offscreen surface into
+ * its frame buffer object, so that the runner works with any platform plugin which provides
+ * OpenGL, including the offscreen plugin with Mesa's llvmpipe driver.
+ * Each frame advances the view's simulation by one step, i.e. calls the slot which is connected
+ * to the view's animation timer, then renders the view and reads back the image.
+ * The event loop is never run, so the view's own timers never fire and the number of
+ * simulation steps is the same from one run to the next.
+ * The settings of the views are read from a settings file with the same format as the application's,
+ * and the global random generator is seeded with a fixed value before the view is created.
+ */
+class OffscreenRunner
+{
+    public:
+        OffscreenRunner();
+
+        bool parseArguments(int argc, char *argv[], QString &log);
+        bool run(QString &log);
+
+        static QStringList viewNames();
+
+    private:
+        QOpenGLWidget *makeView(QString const &name, const char *&stepslot) const;
+
+    private:
+        QString m_ViewName;
+        int m_nFrames;       /**< the number of timed frames */
+        int m_nWarmUp;       /**< the number of frames rendered before the timed frames */
+        QSize m_Size;        /**< the size of the frame buffer, in pixels */
+        quint32 m_Seed;
+        QString m_SettingsFile;
+        QString m_OutDir;    /**< the directory where the images and the timings are written; nothing is written if empty */
+        int m_SaveEvery;     /**< the interval between the saved frames; no image is saved if <=0 */
+};
+
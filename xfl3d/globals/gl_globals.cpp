@@ -1,4 +1,6 @@
 
+#include <algorithm>
+
 #include <QtConcurrent/QtConcurrent>
 #include <QVector3D>
 #include <QQuaternion>
@@ -6,6 +8,8 @@
 #include <xfl3d/controls/colourlegend.h>
 #include <xfl3d/controls/w3dprefs.h>
 #include <xfl3d/globals/gl_globals.h>
+#include <xfl3d/globals/quadcontourgrid.h>
+#include <xfl3d/globals/vertexwriter.h>
 #include <xflcore/xflcore.h>
 #include <xflgeom/geom_globals/geom_global.h>
 #include <xflgeom/geom3d/quaternion.h>
@@ -13,7 +17,6 @@
 
 
 double t_lmin(0), t_range(0);
-QVector<QVector<Segment3d>> t_futuresegs;
 
 
 #define GL_GPU_MEM_INFO_TOTAL_AVAILABLE_MEM_NVX 0x9048
@@ -146,7 +149,7 @@ void gl::makeArrows(const QVector<Vector3d> &point, const QVector<Vector3d> &arr
     //The three vectors defining the arrow on the panel
     QVector3D P, P1, P2;
 
-    QVector<float> ArrowVertexArray(point.size()*18);
+    VertexWriter ArrowVertexArray(vbo, point.size()*18);
     QVector3D N(0,0,1);// this is the vector used to define m_vboArrow
 
     int iv = 0;
@@ -191,10 +194,7 @@ void gl::makeArrows(const QVector<Vector3d> &point, const QVector<Vector3d> &arr
     }
     Q_ASSERT(iv==ArrowVertexArray.size());
 
-    vbo.create();
-    vbo.bind();
-    vbo.allocate(ArrowVertexArray.data(), ArrowVertexArray.size() * int(sizeof(GLfloat)));
-    vbo.release();
+    ArrowVertexArray.close();
 }
 
 
@@ -214,7 +214,7 @@ void gl::makeArrows(QVector<Vector2d> const &point, QVector<Vector2d> const &arr
     //The three vectors defining the arrow on the panel
     QVector3D P, P1, P2;
 
-    QVector<float> ArrowVertexArray(point.size()*18);
+    VertexWriter ArrowVertexArray(vbo, point.size()*18);
     QVector3D N(0,0,1);// this is the vector used to define m_vboArrow
 
     int iv = 0;
@@ -259,10 +259,7 @@ void gl::makeArrows(QVector<Vector2d> const &point, QVector<Vector2d> const &arr
     }
     Q_ASSERT(iv==ArrowVertexArray.size());
 
-    vbo.create();
-    vbo.bind();
-    vbo.allocate(ArrowVertexArray.data(), ArrowVertexArray.size() * int(sizeof(GLfloat)));
-    vbo.release();
+    ArrowVertexArray.close();
 }
 
 
@@ -276,7 +273,7 @@ void gl::makeLines(QVector<Vector3d> const &points, QOpenGLBuffer &vbo)
         return;
     }
 
-    QVector<float> LinesVertexArray(points.size()*3);
+    VertexWriter LinesVertexArray(vbo, points.size()*3);
 
     int iv = 0;
     for (int ipt=0; ipt<points.size(); )
@@ -291,10 +288,7 @@ void gl::makeLines(QVector<Vector3d> const &points, QOpenGLBuffer &vbo)
     }
     Q_ASSERT(iv==points.size()*3);
 
-    vbo.create();
-    vbo.bind();
-    vbo.allocate(LinesVertexArray.data(), LinesVertexArray.size() * int(sizeof(GLfloat)));
-    vbo.release();
+    LinesVertexArray.close();
 }
 
 
@@ -306,7 +300,7 @@ void gl::makeLineStrip(QVector<Vector3d> const &strip, QOpenGLBuffer &vbo)
         return;
     }
 
-    QVector<float> StripVertexArray(strip.size()*3);
+    VertexWriter StripVertexArray(vbo, strip.size()*3);
 
     int iv = 0;
     for (int ipt=0; ipt<strip.size(); ipt++)
@@ -317,10 +311,7 @@ void gl::makeLineStrip(QVector<Vector3d> const &strip, QOpenGLBuffer &vbo)
     }
     Q_ASSERT(iv==strip.size()*3);
 
-    vbo.create();
-    vbo.bind();
-    vbo.allocate(StripVertexArray.data(), StripVertexArray.size() * int(sizeof(GLfloat)));
-    vbo.release();
+    StripVertexArray.close();
 }
 
 
@@ -332,7 +323,7 @@ void gl::make2dLineStrip(const QVector<Vector2d> &strip, float zOffset, QOpenGLB
         return;
     }
 
-    QVector<float> StripVertexArray(strip.size()*3);
+    VertexWriter StripVertexArray(vbo, strip.size()*3);
 
     int iv = 0;
     for (int ipt=0; ipt<strip.size(); ipt++)
@@ -343,10 +334,7 @@ void gl::make2dLineStrip(const QVector<Vector2d> &strip, float zOffset, QOpenGLB
     }
     Q_ASSERT(iv==strip.size()*3);
 
-    vbo.create();
-    vbo.bind();
-    vbo.allocate(StripVertexArray.data(), StripVertexArray.size() * int(sizeof(GLfloat)));
-    vbo.release();
+    StripVertexArray.close();
 }
 
 
@@ -357,7 +345,7 @@ void gl::make2dLineStrip(const QVector<Vector2d> &strip, float zOffset, QOpenGLB
  */
 void gl::makeQuad(Node const&V0, Node const&V1, Node const&V2, Node const&V3, QOpenGLBuffer &vbo)
 {
-    QVector<GLfloat> QuadVertexArray(32, 0);
+    VertexWriter QuadVertexArray(vbo, 30);
 
     int iv = 0;
     QuadVertexArray[iv++] = V0.xf();
@@ -396,11 +384,7 @@ void gl::makeQuad(Node const&V0, Node const&V1, Node const&V2, Node const&V3, QO
     QuadVertexArray[iv++] = V0.normal().yf();
     QuadVertexArray[iv++] = V0.normal().zf();
 
-    vbo.destroy();
-    vbo.create();
-    vbo.bind();
-    vbo.allocate(QuadVertexArray.data(), 30 * sizeof(GLfloat));
-    vbo.release();
+    QuadVertexArray.close();
 }
 
 
@@ -410,7 +394,7 @@ void gl::makeSegments(QVector<Segment3d> const &segments, Vector3d const &pos, Q
     bufferSize *=2;    // 2 vertices for each segment
     bufferSize *=3;    // (3 coords) for each node
 
-    QVector<float> meshvertexarray(bufferSize);
+    VertexWriter meshvertexarray(vbo, bufferSize);
 
     int iv = 0;
     for(int it=0; it<segments.size(); it++)
@@ -426,11 +410,7 @@ void gl::makeSegments(QVector<Segment3d> const &segments, Vector3d const &pos, Q
 
     Q_ASSERT(meshvertexarray.size()==bufferSize);
 
-    vbo.destroy();
-    vbo.create();
-    vbo.bind();
-    vbo.allocate(meshvertexarray.data(), bufferSize * int(sizeof(GLfloat)));
-    vbo.release();
+    meshvertexarray.close();
 }
 
 
@@ -441,7 +421,7 @@ void gl::makeTriangles3Vtx(QVector<Triangle2d> const &triangles, float z, QOpenG
     bufferSize *= 3;    // 4 vertices for each triangle
     bufferSize *= 6;    // (3 coords+3 normal components) for each node
 
-    QVector<float> meshvertexarray(bufferSize);
+    VertexWriter meshvertexarray(vbo, bufferSize);
 
     Vector3d N(0,0,1);
 
@@ -474,11 +454,7 @@ void gl::makeTriangles3Vtx(QVector<Triangle2d> const &triangles, float z, QOpenG
 
     Q_ASSERT(iv==bufferSize);
 
-    if(vbo.isCreated()) vbo.destroy();
-    vbo.create();
-    vbo.bind();
-    vbo.allocate(meshvertexarray.data(), bufferSize * int(sizeof(GLfloat)));
-    vbo.release();
+    meshvertexarray.close();
 }
 
 
@@ -493,7 +469,7 @@ void gl::makeTrianglesOutline(QVector<Triangle2d> const &triangles, const Vector
 
     int buffersize = nPanel3*3*2*3;
 
-    QVector<float> nodeVertexArray(buffersize);
+    VertexWriter nodeVertexArray(vbo, buffersize);
 
     int iv = 0;
     for (int i3=0; i3<nPanel3; i3++)
@@ -514,11 +490,7 @@ void gl::makeTrianglesOutline(QVector<Triangle2d> const &triangles, const Vector
 
     Q_ASSERT(iv==buffersize);
 
-    vbo.destroy();
-    vbo.create();
-    vbo.bind();
-    vbo.allocate(nodeVertexArray.data(), nodeVertexArray.size() * int(sizeof(GLfloat)));
-    vbo.release();
+    nodeVertexArray.close();
 }
 
 
@@ -533,7 +505,7 @@ void gl::makeTriangles3Vtx(QVector<Triangle3d> const &triangles, bool bFlatNorma
     bufferSize *= 3;    // 3 vertices for each triangle
     bufferSize *= 6;    // (3 coords+3 normal components) for each node
 
-    QVector<float> meshvertexarray(bufferSize);
+    VertexWriter meshvertexarray(vbo, bufferSize);
 
     Vector3d N;
 
@@ -595,11 +567,7 @@ void gl::makeTriangles3Vtx(QVector<Triangle3d> const &triangles, bool bFlatNorma
 
     Q_ASSERT(iv==bufferSize);
 
-    if(vbo.isCreated()) vbo.destroy();
-    vbo.create();
-    vbo.bind();
-    vbo.allocate(meshvertexarray.data(), bufferSize * int(sizeof(GLfloat)));
-    vbo.release();
+    meshvertexarray.close();
 }
 
 
@@ -614,7 +582,7 @@ void gl::makeTrianglesOutline(QVector<Triangle3d> const &triangles, const Vector
 
     int buffersize = nPanel3*3*2*3;
 
-    QVector<float> nodeVertexArray(buffersize);
+    VertexWriter nodeVertexArray(vbo, buffersize);
 
     int iv = 0;
     for (int i3=0; i3<nPanel3; i3++)
@@ -635,11 +603,7 @@ void gl::makeTrianglesOutline(QVector<Triangle3d> const &triangles, const Vector
 
     Q_ASSERT(iv==buffersize);
 
-    vbo.destroy();
-    vbo.create();
-    vbo.bind();
-    vbo.allocate(nodeVertexArray.data(), nodeVertexArray.size() * int(sizeof(GLfloat)));
-    vbo.release();
+    nodeVertexArray.close();
 }
 
 
@@ -654,7 +618,7 @@ void gl::makeTriangulation3Vtx(Triangulation const & triangulation, Vector3d con
     bufferSize *= 3;    // 3 vertices for each triangle
     bufferSize *= 6;    // (3 coords+3 normal components) for each node
 
-    QVector<float> meshvertexarray(bufferSize);
+    VertexWriter meshvertexarray(vbo, bufferSize);
 
     Vector3d N;
     int inode=0;
@@ -698,11 +662,224 @@ void gl::makeTriangulation3Vtx(Triangulation const & triangulation, Vector3d con
 
     Q_ASSERT(iv==bufferSize);
 
-    if(vbo.isCreated()) vbo.destroy();
-    vbo.create();
-    vbo.bind();
-    vbo.allocate(meshvertexarray.data(), bufferSize * int(sizeof(GLfloat)));
-    vbo.release();
+    meshvertexarray.close();
+}
+
+
+/**
+ * Writes the vertex and index buffers of an indexed mesh, splitting the merged vertices at the creases;
+ * see makeTriangulationIndexed().
+ * @param vertexid the index of the merged vertex at each triangle corner
+ * @param facenormal returns the unit normal of a triangle
+ * @param position returns the position of a triangle corner
+ */
+template<class FaceNormal, class CornerPosition>
+static void makeCreasedMesh(int nVertices, QVector<int> const &vertexid, FaceNormal facenormal, CornerPosition position,
+                            Vector3d const &pos, double creaseangle, QOpenGLBuffer &vbo, QOpenGLBuffer &ibo)
+{
+    int nCorners = vertexid.size();
+
+    // list the corners at each merged vertex
+    QVector<int> offset(nVertices+1, 0);
+    for(int ic=0; ic<nCorners; ic++) offset[vertexid.at(ic)+1]++;
+    for(int iv=0; iv<nVertices; iv++) offset[iv+1] += offset.at(iv);
+    QVector<int> vertexcorners(nCorners);
+    QVector<int> fill = offset;
+    for(int ic=0; ic<nCorners; ic++) vertexcorners[fill[vertexid.at(ic)]++] = ic;
+
+    // at each merged vertex, group the corners whose face normals are within the crease angle of the group's first face
+    double cosCrease = cos(std::min(std::max(creaseangle, 0.0), 180.0)*PI/180.0);
+    QVector<GLuint> indices(nCorners);
+    QVector<int> source;          // a corner of each output vertex, to get its position
+    QVector<Vector3d> normal;     // the sum of the face normals of each output vertex
+    QVector<Vector3d> seed;       // the first face normal of each output vertex
+    source.reserve(nVertices);
+    normal.reserve(nVertices);
+    seed.reserve(nVertices);
+    for(int iv=0; iv<nVertices; iv++)
+    {
+        int first = source.size();
+        for(int k=offset.at(iv); k<offset.at(iv+1); k++)
+        {
+            int ic = vertexcorners.at(k);
+            Vector3d N = facenormal(ic/3);
+            int igroup = -1;
+            for(int ig=first; ig<source.size(); ig++)
+            {
+                if(seed.at(ig).dot(N)>=cosCrease-1.e-6)
+                {
+                    igroup = ig;
+                    break;
+                }
+            }
+            if(igroup<0)
+            {
+                igroup = source.size();
+                source.append(ic);
+                normal.append(Vector3d(0.0,0.0,0.0));
+                seed.append(N);
+            }
+            normal[igroup] += N;
+            indices[ic] = GLuint(igroup);
+        }
+    }
+
+    int bufferSize = source.size() * 6;  // (3 coords+3 normal components) for each vertex
+    VertexWriter meshvertexarray(vbo, bufferSize);
+    for(int i=0; i<source.size(); i++)
+    {
+        Vector3d V = position(source.at(i));
+        Vector3d N = normal.at(i);
+        if(N.norm()<LENGTHPRECISION) N = seed.at(i); // the faces cancel each other
+        N.normalize();
+        meshvertexarray.put(V.xf()+pos.xf(), V.yf()+pos.yf(), V.zf()+pos.zf());
+        meshvertexarray.put(N);
+    }
+    Q_ASSERT(meshvertexarray.count()==bufferSize);
+    meshvertexarray.close();
+
+    if(!ibo.isCreated()) ibo.create();
+    ibo.bind();
+    ibo.allocate(indices.constData(), nCorners * int(sizeof(GLuint)));
+    ibo.release();
+}
+
+
+/**
+ * Makes an indexed mesh of the triangulation: the vertices shared by adjacent triangles are written once
+ * in the vbo, and the ibo receives three GLuint indices per triangle. The ibo must have been constructed
+ * with the type QOpenGLBuffer::IndexBuffer.
+ *
+ * The triangle vertices are merged using the triangulation's node indices if the nodes have been made,
+ * otherwise using the identical positions of the vertices.
+ * At each merged vertex, the triangles whose normals differ by less than the crease angle share
+ * one vertex with a smooth normal, i.e. the average of their normals. A vertex is split only where
+ * the angle between two faces exceeds the crease angle; a crease angle of 0 results in flat shading,
+ * and a crease angle of 180 or more results in a fully smooth mesh.
+ *
+ * The vertex layout is the same as in makeTriangulation3Vtx, i.e. (3 coords+3 normal components).
+ * @param creaseangle the crease angle in degrees.
+ */
+void gl::makeTriangulationIndexed(Triangulation const &triangulation, Vector3d const &pos, double creaseangle,
+                                  QOpenGLBuffer &vbo, QOpenGLBuffer &ibo)
+{
+    int nt = triangulation.nTriangles();
+    int nCorners = nt*3;
+    if(nt==0)
+    {
+        vbo.destroy();
+        ibo.destroy();
+        return;
+    }
+
+    // make the index of the merged vertex at each triangle corner
+    QVector<int> vertexid(nCorners, -1);
+    int nVertices = 0;
+    bool bNodes = triangulation.nNodes()>0;
+    for(int ic=0; ic<nCorners && bNodes; ic++)
+    {
+        int in = triangulation.triangleAt(ic/3).nodeIndex(ic%3);
+        if(in<0 || in>=triangulation.nNodes()) bNodes = false;
+        else vertexid[ic] = in;
+    }
+    if(bNodes)
+    {
+        nVertices = triangulation.nNodes();
+    }
+    else
+    {
+        // sort the corners by position and merge the identical ones
+        QVector<int> corner(nCorners);
+        for(int ic=0; ic<nCorners; ic++) corner[ic] = ic;
+        auto less = [&triangulation](int ic0, int ic1)
+        {
+            Node const &V0 = triangulation.triangleAt(ic0/3).vertexAt(ic0%3);
+            Node const &V1 = triangulation.triangleAt(ic1/3).vertexAt(ic1%3);
+            if(V0.x!=V1.x) return V0.x<V1.x;
+            if(V0.y!=V1.y) return V0.y<V1.y;
+            return V0.z<V1.z;
+        };
+        std::sort(corner.begin(), corner.end(), less);
+        for(int i=0; i<nCorners; i++)
+        {
+            if(i>0 && less(corner.at(i-1), corner.at(i))) nVertices++;
+            vertexid[corner.at(i)] = nVertices;
+        }
+        nVertices++;
+    }
+
+    makeCreasedMesh(nVertices, vertexid,
+                    [&triangulation](int it) {return triangulation.triangleAt(it).normal();},
+                    [&triangulation](int ic) {return Vector3d(triangulation.triangleAt(ic/3).vertexAt(ic%3));},
+                    pos, creaseangle, vbo, ibo);
+}
+
+
+/**
+ * Makes an indexed mesh of the TriMesh, with the same vertex layout and crease splitting as makeTriangulationIndexed().
+ * The ibo must have been constructed with the type QOpenGLBuffer::IndexBuffer.
+ * @param creaseangle the crease angle in degrees.
+ */
+void gl::makeTriMeshIndexed(TriMesh const &mesh, Vector3d const &pos, double creaseangle, QOpenGLBuffer &vbo, QOpenGLBuffer &ibo)
+{
+    if(mesh.isEmpty())
+    {
+        vbo.destroy();
+        ibo.destroy();
+        return;
+    }
+
+    if(mesh.hasFaceNormals())
+    {
+        QVector<float> const &fn = mesh.faceNormals();
+        makeCreasedMesh(mesh.vertexCount(), mesh.indexes(),
+                        [&fn](int it) {return Vector3d(double(fn.at(3*it)), double(fn.at(3*it+1)), double(fn.at(3*it+2)));},
+                        [&mesh](int ic) {return mesh.vertex(mesh.indexes().at(ic));},
+                        pos, creaseangle, vbo, ibo);
+    }
+    else
+    {
+        makeCreasedMesh(mesh.vertexCount(), mesh.indexes(),
+                        [&mesh](int it) {return mesh.faceNormal(it);},
+                        [&mesh](int ic) {return mesh.vertex(mesh.indexes().at(ic));},
+                        pos, creaseangle, vbo, ibo);
+    }
+}
+
+
+/**
+ * Makes the outline of the TriMesh as pairs of vertices of 3 components.
+ * If the mesh has been connected, each edge is written once; otherwise each triangle writes its three edges.
+ */
+void gl::makeTriMeshOutline(TriMesh const &mesh, Vector3d const &pos, QOpenGLBuffer &vbo)
+{
+    bool bConnected = mesh.hasConnections();
+    int nEdges = 0;
+    for(int it=0; it<mesh.triangleCount(); it++)
+    {
+        for(int iEdge=0; iEdge<3; iEdge++)
+        {
+            int in = bConnected ? mesh.neighbour(it, iEdge) : -1;
+            if(in<0 || it<in) nEdges++;
+        }
+    }
+
+    VertexWriter outlinearray(vbo, nEdges*2*3);
+    for(int it=0; it<mesh.triangleCount(); it++)
+    {
+        for(int iEdge=0; iEdge<3; iEdge++)
+        {
+            int in = bConnected ? mesh.neighbour(it, iEdge) : -1;
+            if(in>=0 && in<it) continue;
+            // the edge iEdge is opposite to the vertex iEdge
+            Vector3d V0 = mesh.vertex(mesh.vertexIndex(it, (iEdge+1)%3));
+            Vector3d V1 = mesh.vertex(mesh.vertexIndex(it, (iEdge+2)%3));
+            outlinearray.put(V0.xf()+pos.xf(), V0.yf()+pos.yf(), V0.zf()+pos.zf());
+            outlinearray.put(V1.xf()+pos.xf(), V1.yf()+pos.yf(), V1.zf()+pos.zf());
+        }
+    }
+    Q_ASSERT(outlinearray.count()==nEdges*2*3);
+    outlinearray.close();
 }
 
 
@@ -715,7 +892,7 @@ void gl::makeTriangleNormals(QVector<Triangle3d> const &trianglelist, float coef
     //      x2 nodes per normal
     //        x6 = 3 components
     int nodeVertexSize = trianglelist.count() * 2 * 3;
-    QVector<float>nodeVertexArray(nodeVertexSize, 0);
+    VertexWriter nodeVertexArray(vbo, nodeVertexSize);
 
     int iv=0;
 
@@ -733,11 +910,7 @@ void gl::makeTriangleNormals(QVector<Triangle3d> const &trianglelist, float coef
 
     Q_ASSERT(iv==nodeVertexSize);
 
-    vbo.destroy();
-    vbo.create();
-    vbo.bind();
-    vbo.allocate(nodeVertexArray.data(), nodeVertexSize * int(sizeof(GLfloat)));
-    vbo.release();
+    nodeVertexArray.close();
 }
 
 
@@ -751,7 +924,7 @@ void gl::makeTriangleNodeNormals(QVector<Triangle3d> const &trianglelist, float
     //      x2 nodes per normal
     //        x3 = 3 components
     int nodeVertexSize = trianglelist.count() * 3 * 2 * 3;
-    QVector<float>nodeVertexArray(nodeVertexSize, 0);
+    VertexWriter nodeVertexArray(vbo, nodeVertexSize);
 
     int iv=0;
 
@@ -773,11 +946,7 @@ void gl::makeTriangleNodeNormals(QVector<Triangle3d> const &trianglelist, float
 
     Q_ASSERT(iv==nodeVertexSize);
 
-    vbo.destroy();
-    vbo.create();
-    vbo.bind();
-    vbo.allocate(nodeVertexArray.data(), nodeVertexSize * int(sizeof(GLfloat)));
-    vbo.release();
+    nodeVertexArray.close();
 }
 
 
@@ -789,7 +958,7 @@ void gl::makeNodeNormals(QVector<Node> const &nodelist, Vector3d const &pos, flo
     //        x6 = 3 vertex components
 
     int nodeVertexSize = nodelist.count()* 2 * 3;
-    QVector<float>nodeVertexArray(nodeVertexSize, 0);
+    VertexWriter nodeVertexArray(vbo, nodeVertexSize);
 
     int iv=0;
 
@@ -806,18 +975,14 @@ void gl::makeNodeNormals(QVector<Node> const &nodelist, Vector3d const &pos, flo
 
     Q_ASSERT(iv==nodeVertexSize);
 
-    vbo.destroy();
-    vbo.create();
-    vbo.bind();
-    vbo.allocate(nodeVertexArray.data(), nodeVertexSize * int(sizeof(GLfloat)));
-    vbo.release();
+    nodeVertexArray.close();
 }
 
 
 /** makes a unit arrow point in direction D*/
 void gl::makeArrow(Vector3d const &start, Vector3d const &end, QOpenGLBuffer &vbo)
 {
-    QVector<GLfloat> ArrowVertexArray(18);
+    VertexWriter ArrowVertexArray(vbo, 18);
 
     Vector3d Arrow = end-start;
     double amplitude = Arrow.norm();
@@ -873,11 +1038,7 @@ void gl::makeArrow(Vector3d const &start, Vector3d const &end, QOpenGLBuffer &vb
     ArrowVertexArray[iv++] = O.yf()+P.yf()+P2.yf();
     ArrowVertexArray[iv++] = O.zf()+P.zf()+P2.zf();
 
-    vbo.destroy();
-    vbo.create();
-    vbo.bind();
-    vbo.allocate(ArrowVertexArray.constData(), 18 * sizeof(GLfloat));
-    vbo.release();
+    ArrowVertexArray.close();
 }
 
 
@@ -1173,14 +1334,22 @@ void gl::makeNodeForces(QVector<Node> const &nodes, QVector<double> const &CpNod
     //      x2 vertices per line
     //        x6 = 3 vertex components + 3 color components
 
-    int forceVertexSize = nNodes * 3 * 2 * 6;
-    QVector<float> forceVertexArray(forceVertexSize);
+    // the arrows stop at the first node without a value, so the buffer is sized to the nodes before it
+    int nForces = 0;
+    while(nForces<nNodes && nodes.at(nForces).index()<CpNodes.size()) nForces++;
+    if(nForces==0)
+    {
+        vbo.destroy();
+        return;
+    }
+
+    int forceVertexSize = nForces * 3 * 2 * 6;
+    VertexWriter forceVertexArray(vbo, forceVertexSize);
     QColor clr;
     int iv=0;
-    for (int p=0; p<nNodes; p++)
+    for (int p=0; p<nForces; p++)
     {
         Node const &node = nodes.at(p);
-        if(node.index()>=CpNodes.size()) break;
 
         float force = qDyn * float(CpNodes[node.index()]);
         float tau = (force-rmin)/range;
@@ -1290,13 +1459,9 @@ void gl::makeNodeForces(QVector<Node> const &nodes, QVector<double> const &CpNod
         }
     }
 
-//    Q_ASSERT(iv==forceVertexSize);
+    Q_ASSERT(iv==forceVertexSize);
 
-    vbo.destroy();
-    vbo.create();
-    vbo.bind();
-    vbo.allocate(forceVertexArray.data(), forceVertexSize * int(sizeof(GLfloat)));
-    vbo.release();
+    forceVertexArray.close();
 }
 
 
@@ -1309,7 +1474,7 @@ void gl::makeCircle(double radius, Vector3d const &O, QOpenGLBuffer &vbo)
     arcbuffersize *= 2; // two vertices per segment
     arcbuffersize *= 3; // three components per vertex
 
-    QVector<GLfloat> ArcVertexArray(arcbuffersize, 0);
+    VertexWriter ArcVertexArray(vbo, arcbuffersize);
 
 
     int iv = 0;
@@ -1328,11 +1493,7 @@ void gl::makeCircle(double radius, Vector3d const &O, QOpenGLBuffer &vbo)
 
     Q_ASSERT(iv==arcbuffersize);
 
-    vbo.destroy();
-    vbo.create();
-    vbo.bind();
-    vbo.allocate(ArcVertexArray.data(), arcbuffersize * sizeof(GLfloat));
-    vbo.release();
+    ArcVertexArray.close();
 }
 
 
@@ -1370,7 +1531,7 @@ void gl::makeDisk(double radius, Vector3d const &O, QOpenGLBuffer &vbo)
 
     // NPOINTS-1 triangles
 
-    QVector<GLfloat> ArcVertexArray(arcbuffersize, 0);
+    VertexWriter ArcVertexArray(vbo, arcbuffersize);
 
     int iv = 0;
     //set the fixed central vertex
@@ -1393,11 +1554,7 @@ void gl::makeDisk(double radius, Vector3d const &O, QOpenGLBuffer &vbo)
 
     Q_ASSERT(iv==arcbuffersize);
 
-    vbo.destroy();
-    vbo.create();
-    vbo.bind();
-    vbo.allocate(ArcVertexArray.data(), arcbuffersize * sizeof(GLfloat));
-    vbo.release();
+    ArcVertexArray.close();
 }
 
 
@@ -1412,7 +1569,7 @@ void gl::makeEllipseLineStrip(double a, double e, Vector3d const &O, QOpenGLBuff
 
     // NPOINTS-1 triangles
 
-    QVector<GLfloat> ArcVertexArray(arcbuffersize, 0);
+    VertexWriter ArcVertexArray(vbo, arcbuffersize);
 
     Vector3d C(O.x+a*e, O.y, 0.0);
     double b = a * sqrt(1.0-e*e);
@@ -1430,11 +1587,7 @@ void gl::makeEllipseLineStrip(double a, double e, Vector3d const &O, QOpenGLBuff
 
     Q_ASSERT(iv==arcbuffersize);
 
-    vbo.destroy();
-    vbo.create();
-    vbo.bind();
-    vbo.allocate(ArcVertexArray.data(), arcbuffersize * sizeof(GLfloat));
-    vbo.release();
+    ArcVertexArray.close();
 }
 
 
@@ -1450,7 +1603,7 @@ void gl::makeEllipseFan(double a, double e, Vector3d const &O, QOpenGLBuffer &vb
 
     // NPOINTS-1 triangles
 
-    QVector<GLfloat> ArcVertexArray(arcbuffersize, 0);
+    VertexWriter ArcVertexArray(vbo, arcbuffersize);
 
     Vector3d C(O.x+a*e, O.y, 0.0);
     double b = a * sqrt(1.0-e*e);
@@ -1478,11 +1631,7 @@ void gl::makeEllipseFan(double a, double e, Vector3d const &O, QOpenGLBuffer &vb
 
     Q_ASSERT(iv==arcbuffersize);
 
-    vbo.destroy();
-    vbo.create();
-    vbo.bind();
-    vbo.allocate(ArcVertexArray.data(), arcbuffersize * sizeof(GLfloat));
-    vbo.release();
+    ArcVertexArray.close();
 }
 
 
@@ -1609,7 +1758,7 @@ void gl::makeCube(Vector3d const &pt, double dx, double dy, double dz,
     // 3 vertices/triangle
     // (3 position + 3 normal) components/vertex
     int buffersize = 12 *3 * 6;
-    QVector<GLfloat> CubeVertexArray(buffersize, 0);
+    VertexWriter CubeVertexArray(vboFaces, buffersize);
 
     // 8 vertices
     Vector3d T000 = {pt.x-dx/2, pt.y-dy/2, pt.z-dz/2};
@@ -1876,14 +2025,10 @@ void gl::makeCube(Vector3d const &pt, double dx, double dy, double dz,
 
     Q_ASSERT(iv==buffersize);
 
-    vboFaces.destroy();
-    vboFaces.create();
-    vboFaces.bind();
-    vboFaces.allocate(CubeVertexArray.data(), buffersize* int(sizeof(GLfloat)));
-    vboFaces.release();
+    CubeVertexArray.close();
 
     buffersize = 12 * 2 *3; //12 edges x2 vertices x3 components
-    QVector<float> EdgeVertexArray(buffersize);
+    VertexWriter EdgeVertexArray(vboEdges, buffersize);
     iv=0;
 
     //bottom face
@@ -1981,11 +2126,7 @@ void gl::makeCube(Vector3d const &pt, double dx, double dy, double dz,
 
     Q_ASSERT(iv==buffersize);
 
-    vboEdges.destroy();
-    vboEdges.create();
-    vboEdges.bind();
-    vboEdges.allocate(EdgeVertexArray.data(), buffersize* int(sizeof(GLfloat)));
-    vboEdges.release();
+    EdgeVertexArray.close();
 }
 
 
@@ -2003,7 +2144,7 @@ void gl::makeTriangle(Vector3d *V, QOpenGLBuffer &vbo)
 
 void gl::makeTriangle(Vector2d const &V0, Vector2d const &V1, Vector2d const &V2, QOpenGLBuffer &vbo)
 {
-    QVector<GLfloat> TriangleVertexArray(12);
+    VertexWriter TriangleVertexArray(vbo, 12);
 
     int iv = 0;
 
@@ -2024,17 +2165,13 @@ void gl::makeTriangle(Vector2d const &V0, Vector2d const &V1, Vector2d const &V2
     TriangleVertexArray[iv++] = V0.yf();
     TriangleVertexArray[iv++] = 0.0f;
 
-    vbo.destroy();
-    vbo.create();
-    vbo.bind();
-    vbo.allocate(TriangleVertexArray.data(), 12 * sizeof(GLfloat));
-    vbo.release();
+    TriangleVertexArray.close();
 }
 
 
 void gl::makeTriangle(Vector3d const &V0, Vector3d const &V1, Vector3d const &V2, QOpenGLBuffer &vbo)
 {
-    QVector<GLfloat> TriangleVertexArray(12);
+    VertexWriter TriangleVertexArray(vbo, 12);
 
     int iv = 0;
 
@@ -2055,11 +2192,7 @@ void gl::makeTriangle(Vector3d const &V0, Vector3d const &V1, Vector3d const &V2
     TriangleVertexArray[iv++] = V0.yf();
     TriangleVertexArray[iv++] = V0.zf();
 
-    vbo.destroy();
-    vbo.create();
-    vbo.bind();
-    vbo.allocate(TriangleVertexArray.data(), 12 * sizeof(GLfloat));
-    vbo.release();
+    TriangleVertexArray.close();
 }
 
 
@@ -2097,7 +2230,7 @@ void gl::makeQuadColorMap(QOpenGLBuffer &vbo, int nrows, int ncols,
     //        x6 = 3 vertex components + 3 color components
 
     int nodeVertexSize = (nrows-1)*(ncols-1) * 2 * 3 * 6;
-    QVector<float> nodeVertexArray(nodeVertexSize);
+    VertexWriter nodeVertexArray(vbo, nodeVertexSize);
 
     if(bMultiThreaded)
     {
@@ -2118,11 +2251,7 @@ void gl::makeQuadColorMap(QOpenGLBuffer &vbo, int nrows, int ncols,
         }
     }
 
-    vbo.destroy();
-    vbo.create();
-    vbo.bind();
-    vbo.allocate(nodeVertexArray.data(), nodeVertexSize * int(sizeof(GLfloat)));
-    vbo.release();
+    nodeVertexArray.close();
 }
 
 
@@ -2173,8 +2302,12 @@ void gl::makeQuadColorMapRow(int r, int ncols, QVector<Vector3d> const&nodes, QV
 }
 
 
-/** Implementation of the marching square algorithm.
- *  Use instead the triangle method if possible to increase the accuracy*/
+/**
+ * Implementation of the marching square algorithm.
+ * The segments of all the contour levels are made in a single traversal of the grid's min/max quadtree,
+ * so that the cells and the regions which cross no level are skipped.
+ * The segments are counted first, then written directly to the buffer.
+ * Use instead the triangle method if possible to increase the accuracy*/
 void gl::makeQuadContoursOnGrid(QOpenGLBuffer &vbo, int nrows, int ncols,
                                            QVector<Vector3d> const&node, QVector<double> const &value,
                                            bool bMultithreaded)
@@ -2202,128 +2335,61 @@ void gl::makeQuadContoursOnGrid(QOpenGLBuffer &vbo, int nrows, int ncols,
     QVector<float> contour(nContours);
     for(int ic=0; ic<nContours; ic++) contour[ic] = lmin + float(ic)/float(nContours-1)*range;
 
-    QVector<Segment3d> segs;
+    QuadContourGrid grid(nrows, ncols, node, value);
+    grid.setLevels(contour);
 
-    t_futuresegs.resize(nContours);
+    int nTasks = grid.taskCount();
+    int nThreads = bMultithreaded ? std::max(1, std::min(QThread::idealThreadCount(), nTasks)) : 1;
 
-    if(bMultithreaded)
+    // count the segments of each task, to get the offset of its segments in the buffer
+    QVector<int> offset(nTasks+1, 0);
+    auto countTasks = [&grid, &offset, nTasks, nThreads](int iThread)
     {
-        QFutureSynchronizer<void> futureSync;
-        for(int ic=0; ic<nContours; ic++)
-        {
-            t_futuresegs[ic].clear();
-            t_futuresegs[ic].reserve((nrows-1)*(ncols-1)*4);
+        for(int it=iThread; it<nTasks; it+=nThreads) offset[it+1] = grid.countSegments(it);
+    };
 
-            futureSync.addFuture(QtConcurrent::run(&gl::makeQuadContour,
-                                                   contour.at(ic), nrows, node, value,
-                                                   ic));
-        }
-        futureSync.waitForFinished();
-        for(int iseg=0; iseg<t_futuresegs.size(); iseg++)
-            segs.append(t_futuresegs.at(iseg));
-    }
-    else
+    if(nThreads>1)
     {
-        for(int ic=0; ic<nContours; ic++)
-        {
-            t_futuresegs[ic].clear();
-            t_futuresegs[ic].reserve((nrows-1)*(ncols-1)*4);
-            gl::makeQuadContour(contour.at(ic), nrows, node, value, ic);
-            segs.append(t_futuresegs[ic]);
-        }
+        QFutureSynchronizer<void> futureSync;
+        for(int iThread=0; iThread<nThreads; iThread++)
+            futureSync.addFuture(QtConcurrent::run(countTasks, iThread));
+        futureSync.waitForFinished();
     }
+    else countTasks(0);
+
+    for(int it=0; it<nTasks; it++) offset[it+1] += offset.at(it);
 
     // vertex array size
     // nsegs
     // x 2 vertices
     // x 3 components
-    int nodeVertexSize = segs.size() * 2 * 3;
-    QVector<float> nodeVertexArray(nodeVertexSize);
+    int nodeVertexSize = offset.at(nTasks) * 2 * 3;
+    VertexWriter nodeVertexArray(vbo, nodeVertexSize);
+    float *pData = nodeVertexArray.data();
 
-    int iv=0;
-    for(int is=0; is<segs.size(); is++)
+    auto writeTasks = [&grid, &offset, nTasks, nThreads, pData](int iThread)
     {
-        Node const & n0 = segs.at(is).vertexAt(0);
-        Node const & n1 = segs.at(is).vertexAt(1);
-        nodeVertexArray[iv++] = n0.xf();
-        nodeVertexArray[iv++] = n0.yf();
-        nodeVertexArray[iv++] = n0.zf();
-        nodeVertexArray[iv++] = n1.xf();
-        nodeVertexArray[iv++] = n1.yf();
-        nodeVertexArray[iv++] = n1.zf();
-    }
-
-    Q_ASSERT(iv==nodeVertexSize);
-
-    vbo.destroy();
-    vbo.create();
-    vbo.bind();
-    vbo.allocate(nodeVertexArray.data(), nodeVertexSize * int(sizeof(GLfloat)));
-    vbo.release();
-}
-
-
-void gl::makeQuadContour(double threshold, int nrows,
-                                        QVector<Vector3d> const&node, QVector<double> const &value,
-                                        int ic)
-{
-    QVector<Segment3d> &contoursegs = t_futuresegs[ic];
-
-    int idx[] = {0,0,0,0};
-    int ncols = node.size()/nrows;
-    double tau = 0.0;
-    int ik[] = {-1, -1, -1, -1, -1, -1, -1, -1};
-    Vector3d I[2]; // crossover points on edge
-
-    int i0=0, i1=0, i2=0, i3=0;
-    int key=0, k=1;
+        for(int it=iThread; it<nTasks; it+=nThreads)
+        {
+            int nSegs = grid.writeSegments(it, pData+offset.at(it)*6);
+            Q_ASSERT(nSegs==offset.at(it+1)-offset.at(it));
+            Q_UNUSED(nSegs)
+        }
+    };
 
-    for(int r=0; r<nrows-1; r++)
+    if(nodeVertexSize>0)
     {
-        for(int c=0; c<ncols-1; c++)
+        if(nThreads>1)
         {
-            // for each cell
-            idx[0] =  r   *ncols+c;
-            idx[1] =  r   *ncols+c+1;
-            idx[2] = (r+1)*ncols+c+1;
-            idx[3] = (r+1)*ncols+c;
-
-            // check for crossover of contour value
-            // use base 2 key as table index
-            key = 0;
-            k=1;
-            for(int i=0; i<4; i++)
-            {
-                if(value[idx[i%4]]-threshold<0) // true if there is a crossover
-                {
-                    key += k;
-                }
-                k *= 2;
-            }
-
-            gl::lookUpQuadKey(key, ik);
-
-            for(int jk=0; jk<2; jk++)
-            {
-                i0 = ik[4*jk+0];
-                i1 = ik[4*jk+1];
-                i2 = ik[4*jk+2];
-                i3 = ik[4*jk+3];
-                if(i0>=0 && i1>=0 && i2>=0 && i3>=0)
-                {
-                    tau = (threshold - value[idx[i0]]) /(value[idx[i1]]-value[idx[i0]]);
-                    I[0].x = node[idx[i0]].x*(1-tau) + node[idx[i1]].x*tau;
-                    I[0].y = node[idx[i0]].y*(1-tau) + node[idx[i1]].y*tau;
-                    I[0].z = node[idx[i0]].z*(1-tau) + node[idx[i1]].z*tau;
-                    tau = (threshold - value[idx[i2]]) /(value[idx[i3]]-value[idx[i2]]);
-                    I[1].x = node[idx[i2]].x*(1-tau) + node[idx[i3]].x*tau;
-                    I[1].y = node[idx[i2]].y*(1-tau) + node[idx[i3]].y*tau;
-                    I[1].z = node[idx[i2]].z*(1-tau) + node[idx[i3]].z*tau;
-                    contoursegs.push_back({I[0], I[1]});
-                }
-            }
+            QFutureSynchronizer<void> futureSync;
+            for(int iThread=0; iThread<nThreads; iThread++)
+                futureSync.addFuture(QtConcurrent::run(writeTasks, iThread));
+            futureSync.waitForFinished();
         }
+        else writeTasks(0);
     }
+
+    nodeVertexArray.close();
 }
 
 
@@ -2344,7 +2410,7 @@ void gl::makeQuadTex(double xside, double yside, QOpenGLBuffer &vbo)
     bufferSize *= 3;    // 4 vertices for each triangle
     bufferSize *= 8;    // (3 coords+3 normal components+2UVcomponents) for each node
 
-    QVector<float> meshvertexarray(bufferSize);
+    VertexWriter meshvertexarray(vbo, bufferSize);
 
     Vector3d N;
     bool bFlatNormals = true;
@@ -2380,11 +2446,7 @@ void gl::makeQuadTex(double xside, double yside, QOpenGLBuffer &vbo)
 
     Q_ASSERT(iv==bufferSize);
 
-    vbo.destroy();
-    vbo.create();
-    vbo.bind();
-    vbo.allocate(meshvertexarray.data(), bufferSize * int(sizeof(GLfloat)));
-    vbo.release();
+    meshvertexarray.close();
 }
 
 
@@ -2395,7 +2457,7 @@ void gl::makeSegments2d(QVector<Segment2d> const &segments, Vector2d const &pos,
     bufferSize *=2;    // 2 vertices for each segment
     bufferSize *=3;    // (3 coords) for each node
 
-    QVector<float> meshvertexarray(bufferSize);
+    VertexWriter meshvertexarray(vbo, bufferSize);
 
     int iv = 0;
     for(int it=0; it<segments.size(); it++)
@@ -2411,11 +2473,7 @@ void gl::makeSegments2d(QVector<Segment2d> const &segments, Vector2d const &pos,
 
     Q_ASSERT(meshvertexarray.size()==bufferSize);
 
-    vbo.destroy();
-    vbo.create();
-    vbo.bind();
-    vbo.allocate(meshvertexarray.data(), bufferSize * int(sizeof(GLfloat)));
-    vbo.release();
+    meshvertexarray.close();
 }
 
 
@@ -2439,7 +2497,7 @@ void gl::makeColourMap2d(QVector<Triangle2d> const &panel3, float height,
     //        x6 = 3 vertex components + 3 color components
 
     int nodeVertexSize = nPanel3* 3 * 6;
-    QVector<float> nodeVertexArray(nodeVertexSize, 0.0f);
+    VertexWriter nodeVertexArray(vbo, nodeVertexSize);
     QColor clr;
     int iv=0;
     for (int p=0; p<nPanel3; p++)
@@ -2478,17 +2536,13 @@ void gl::makeColourMap2d(QVector<Triangle2d> const &panel3, float height,
 
     Q_ASSERT(iv==nodeVertexSize);
 
-    vbo.destroy();
-    vbo.create();
-    vbo.bind();
-    vbo.allocate(nodeVertexArray.data(), nodeVertexSize * int(sizeof(GLfloat)));
-    vbo.release();
+    nodeVertexArray.close();
 }
 
 
 void gl::makeQuad2d(QRectF const &rect, QOpenGLBuffer &vbo)
 {
-    QVector<GLfloat> QuadVertexArray(12, 0);
+    VertexWriter QuadVertexArray(vbo, 12);
 
     int iv = 0;
     QuadVertexArray[iv++] = 0.0f;
@@ -2511,9 +2565,5 @@ void gl::makeQuad2d(QRectF const &rect, QOpenGLBuffer &vbo)
 
     Q_ASSERT(iv==QuadVertexArray.size());
 
-    vbo.destroy();
-    vbo.create();
-    vbo.bind();
-    vbo.allocate(QuadVertexArray.data(), int(QuadVertexArray.size()) * sizeof(GLfloat));
-    vbo.release();
+    QuadVertexArray.close();
 }
@@ -16,6 +16,7 @@
 #include <xflgeom/geom3d/quad3d.h>
 #include <xflgeom/geom3d/segment3d.h>
 #include <xflgeom/geom3d/triangulation.h>
+#include <xflgeom/geom3d/trimesh.h>
 #include <xflgeom/geom3d/vector3d.h>
 
 
@@ -52,6 +53,9 @@ namespace gl
     void makeTriangles3Vtx(const QVector<Triangle3d> &triangles, bool bFlatNormals, QOpenGLBuffer &vbo);
     void makeTrianglesOutline(QVector<Triangle3d> const &triangles, const Vector3d &position, QOpenGLBuffer &vbo);
     void makeTriangulation3Vtx(const Triangulation &triangulation, const Vector3d &pos, QOpenGLBuffer &vbo, bool bFlatNormals);
+    void makeTriangulationIndexed(const Triangulation &triangulation, const Vector3d &pos, double creaseangle, QOpenGLBuffer &vbo, QOpenGLBuffer &ibo);
+    void makeTriMeshIndexed(TriMesh const &mesh, Vector3d const &pos, double creaseangle, QOpenGLBuffer &vbo, QOpenGLBuffer &ibo);
+    void makeTriMeshOutline(TriMesh const &mesh, Vector3d const &pos, QOpenGLBuffer &vbo);
     void makeTriangleNormals(const QVector<Triangle3d> &trianglelist, float coef, QOpenGLBuffer &vbo);
     void makeTriangleNodeNormals(const QVector<Triangle3d> &trianglelist, float coef, QOpenGLBuffer &vbo);
     void makeNodeNormals(const QVector<Node> &nodelist, const Vector3d &pos, float coef, QOpenGLBuffer &vbo);
@@ -76,11 +80,6 @@ namespace gl
     void makeQuadContoursOnGrid(QOpenGLBuffer &vbo, int nrows, int ncols, QVector<Vector3d> const&nodes, QVector<double> const &values, bool bMultithreaded);
 
 
-    void makeQuadContour(double threshold, int nrows,
-                         QVector<Vector3d> const&node, QVector<double> const &value,
-                         int ic);
-
-
     void makeCpSection(QVector<Node> const&pts, QVector<double> const&Cp, double coef, QVector<Node> &cpsections);
 
     void lookUpQuadKey(int key, int *i);
@@ -96,6 +95,5 @@ namespace gl
 
 /* external temp variables for multithreading  */
 extern double t_lmin, t_range;
-extern QVector<QVector<Segment3d>> t_futuresegs;
 
 
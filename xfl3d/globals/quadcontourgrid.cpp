@@ -0,0 +1,223 @@
+/****************************************************************************
+
+    Xfl3d application
+    Copyright (C) Andre Deperrois
+    License: GPL v3
+
+*****************************************************************************/
+
+#include <algorithm>
+
+#include "quadcontourgrid.h"
+#include <xfl3d/globals/gl_globals.h>
+
+
+QuadContourGrid::QuadContourGrid(int nrows, int ncols, QVector<Vector3d> const &node, QVector<double> const &value)
+    : m_nRows(nrows), m_nCols(ncols), m_Node(node), m_Value(value)
+{
+    makeQuadTree();
+}
+
+
+/** Sets the contour levels; the levels are sorted if necessary */
+void QuadContourGrid::setLevels(QVector<float> const &levels)
+{
+    m_Level.resize(levels.size());
+    for(int i=0; i<levels.size(); i++) m_Level[i] = double(levels.at(i));
+    std::sort(m_Level.begin(), m_Level.end());
+}
+
+
+/** Builds the min/max quadtree bottom-up, from the cells to a single block */
+void QuadContourGrid::makeQuadTree()
+{
+    m_nr.clear();
+    m_nc.clear();
+    m_Min.clear();
+    m_Max.clear();
+
+    int nr = m_nRows-1;
+    int nc = m_nCols-1;
+    if(nr<=0 || nc<=0) return;
+
+    QVector<double> mins(nr*nc), maxs(nr*nc);
+    for(int r=0; r<nr; r++)
+    {
+        for(int c=0; c<nc; c++)
+        {
+            double v0 = m_Value.at( r   *m_nCols+c);
+            double v1 = m_Value.at( r   *m_nCols+c+1);
+            double v2 = m_Value.at((r+1)*m_nCols+c+1);
+            double v3 = m_Value.at((r+1)*m_nCols+c);
+            mins[r*nc+c] = std::min(std::min(v0, v1), std::min(v2, v3));
+            maxs[r*nc+c] = std::max(std::max(v0, v1), std::max(v2, v3));
+        }
+    }
+    m_nr.append(nr);
+    m_nc.append(nc);
+    m_Min.append(mins);
+    m_Max.append(maxs);
+
+    while(nr>1 || nc>1)
+    {
+        int nr1 = (nr+1)/2;
+        int nc1 = (nc+1)/2;
+        QVector<double> const &cmin = m_Min.last();
+        QVector<double> const &cmax = m_Max.last();
+        mins.resize(nr1*nc1);
+        maxs.resize(nr1*nc1);
+        for(int i=0; i<nr1; i++)
+        {
+            for(int j=0; j<nc1; j++)
+            {
+                double bmin =  1.e300;
+                double bmax = -1.e300;
+                for(int ci=2*i; ci<std::min(2*i+2, nr); ci++)
+                {
+                    for(int cj=2*j; cj<std::min(2*j+2, nc); cj++)
+                    {
+                        bmin = std::min(bmin, cmin.at(ci*nc+cj));
+                        bmax = std::max(bmax, cmax.at(ci*nc+cj));
+                    }
+                }
+                mins[i*nc1+j] = bmin;
+                maxs[i*nc1+j] = bmax;
+            }
+        }
+        nr = nr1;
+        nc = nc1;
+        m_nr.append(nr);
+        m_nc.append(nc);
+        m_Min.append(mins);
+        m_Max.append(maxs);
+    }
+}
+
+
+/** The level of the quadtree at which the blocks are processed as separate tasks */
+int QuadContourGrid::taskLevel() const
+{
+    for(int level=m_Min.size()-1; level>0; level--)
+    {
+        if(m_nr.at(level)*m_nc.at(level)>=64) return level;
+    }
+    return 0;
+}
+
+
+int QuadContourGrid::taskCount() const
+{
+    if(m_Min.isEmpty()) return 0;
+    int level = taskLevel();
+    return m_nr.at(level)*m_nc.at(level);
+}
+
+
+/** Returns the number of segments in the block of the task, without making them */
+int QuadContourGrid::countSegments(int iTask) const
+{
+    int level = taskLevel();
+    return traverse(level, iTask/m_nc.at(level), iTask%m_nc.at(level), 0, m_Level.size(), nullptr);
+}
+
+
+/**
+ * Writes the segments of the block of the task as pairs of vertices of 3 components,
+ * and returns the number of segments written, which is the same as the value returned by countSegments().
+ */
+int QuadContourGrid::writeSegments(int iTask, float *pData) const
+{
+    int level = taskLevel();
+    return traverse(level, iTask/m_nc.at(level), iTask%m_nc.at(level), 0, m_Level.size(), pData);
+}
+
+
+/** Returns the index of the first level in the range [ia, ib[ which is greater than v, or ib if none */
+int QuadContourGrid::firstAbove(double v, int ia, int ib) const
+{
+    return int(std::upper_bound(m_Level.constBegin()+ia, m_Level.constBegin()+ib, v) - m_Level.constBegin());
+}
+
+
+/**
+ * Makes the segments of the levels [ia, ib[ in the block (i,j) of the quadtree's level.
+ * If pData is null, the segments are only counted.
+ */
+int QuadContourGrid::traverse(int level, int i, int j, int ia, int ib, float *pData) const
+{
+    int nc = m_nc.at(level);
+    // the levels t crossed by the block are such that min < t <= max
+    ia = firstAbove(m_Min.at(level).at(i*nc+j), ia, ib);
+    ib = firstAbove(m_Max.at(level).at(i*nc+j), ia, ib);
+    if(ia>=ib) return 0;
+
+    if(level==0) return makeCellSegments(i, j, ia, ib, pData);
+
+    int nSegs = 0;
+    for(int ci=2*i; ci<std::min(2*i+2, m_nr.at(level-1)); ci++)
+    {
+        for(int cj=2*j; cj<std::min(2*j+2, m_nc.at(level-1)); cj++)
+        {
+            nSegs += traverse(level-1, ci, cj, ia, ib, pData ? pData+nSegs*6 : nullptr);
+        }
+    }
+    return nSegs;
+}
+
+
+int QuadContourGrid::makeCellSegments(int r, int c, int ia, int ib, float *pData) const
+{
+    int idx[4];
+    idx[0] =  r   *m_nCols+c;
+    idx[1] =  r   *m_nCols+c+1;
+    idx[2] = (r+1)*m_nCols+c+1;
+    idx[3] = (r+1)*m_nCols+c;
+
+    int ik[] = {-1, -1, -1, -1, -1, -1, -1, -1};
+    int nSegs = 0;
+    for(int il=ia; il<ib; il++)
+    {
+        double threshold = m_Level.at(il);
+
+        // use base 2 key as table index
+        int key = 0;
+        int k = 1;
+        for(int i=0; i<4; i++)
+        {
+            if(m_Value.at(idx[i])-threshold<0) key += k;
+            k *= 2;
+        }
+
+        gl::lookUpQuadKey(key, ik);
+
+        for(int jk=0; jk<2; jk++)
+        {
+            int i0 = ik[4*jk+0];
+            int i1 = ik[4*jk+1];
+            int i2 = ik[4*jk+2];
+            int i3 = ik[4*jk+3];
+            if(i0<0 || i1<0 || i2<0 || i3<0) continue;
+
+            if(pData)
+            {
+                float *pSeg = pData + nSegs*6;
+                double tau = (threshold - m_Value.at(idx[i0])) /(m_Value.at(idx[i1])-m_Value.at(idx[i0]));
+                Vector3d const &N0 = m_Node.at(idx[i0]);
+                Vector3d const &N1 = m_Node.at(idx[i1]);
+                pSeg[0] = float(N0.x*(1-tau) + N1.x*tau);
+                pSeg[1] = float(N0.y*(1-tau) + N1.y*tau);
+                pSeg[2] = float(N0.z*(1-tau) + N1.z*tau);
+
+                tau = (threshold - m_Value.at(idx[i2])) /(m_Value.at(idx[i3])-m_Value.at(idx[i2]));
+                Vector3d const &N2 = m_Node.at(idx[i2]);
+                Vector3d const &N3 = m_Node.at(idx[i3]);
+                pSeg[3] = float(N2.x*(1-tau) + N3.x*tau);
+                pSeg[4] = float(N2.y*(1-tau) + N3.y*tau);
+                pSeg[5] = float(N2.z*(1-tau) + N3.z*tau);
+            }
+            nSegs++;
+        }
+    }
+    return nSegs;
+}
+
@@ -0,0 +1,58 @@
+/****************************************************************************
+
+    Xfl3d application
+    Copyright (C) Andre Deperrois
+    License: GPL v3
+
+*****************************************************************************/
+
+#pragma once
+
+#include <QVector>
+
+#include <xflgeom/geom3d/vector3d.h>
+
+
+/**
+ * @class QuadContourGrid
+ * Makes the contour lines of a structured grid of nrows x ncols nodes for all the contour levels in one pass.
+ *
+ * A cell crosses the level t if and only if min < t <= max, where min and max are the smallest and largest
+ * of the values at the cell's four corners. The min and max values of the cells are stored in a quadtree,
+ * each level of which holds the min and max of 2x2 blocks of the level below. The quadtree is traversed
+ * from the top down, narrowing at each block the range of sorted levels which the block crosses, and the
+ * blocks which cross no level are skipped entirely. At the cells, the segments of all the levels in the
+ * remaining range are made at once with the marching squares lookup table.
+ *
+ * The quadtree's blocks at level taskLevel() are independent, so that they can be processed in parallel:
+ * the segments of each block are counted first, then written to their offset in the output buffer.
+ */
+class QuadContourGrid
+{
+    public:
+        QuadContourGrid(int nrows, int ncols, QVector<Vector3d> const &node, QVector<double> const &value);
+
+        void setLevels(QVector<float> const &levels);
+
+        int taskCount() const;
+        int countSegments(int iTask) const;
+        int writeSegments(int iTask, float *pData) const;
+
+    private:
+        void makeQuadTree();
+        int traverse(int level, int i, int j, int ia, int ib, float *pData) const;
+        int makeCellSegments(int r, int c, int ia, int ib, float *pData) const;
+        int taskLevel() const;
+        int firstAbove(double v, int ia, int ib) const;
+
+    private:
+        int m_nRows, m_nCols;                 /**< the number of grid nodes in each direction */
+        QVector<Vector3d> const &m_Node;
+        QVector<double> const &m_Value;
+        QVector<double> m_Level;              /**< the contour levels, sorted in ascending order */
+
+        QVector<int> m_nr, m_nc;              /**< the number of blocks in each direction at each level of the quadtree */
+        QVector<QVector<double>> m_Min;       /**< the minimum value of each block at each level; level 0 is the cells */
+        QVector<QVector<double>> m_Max;       /**< the maximum value of each block at each level */
+};
+
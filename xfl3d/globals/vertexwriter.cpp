@@ -0,0 +1,72 @@
+/****************************************************************************
+
+    Xfl3d application
+    Copyright (C) Andre Deperrois
+    License: GPL v3
+
+*****************************************************************************/
+
+#include <algorithm>
+
+#include "vertexwriter.h"
+
+
+/**
+ * Prepares the buffer to receive nFloats values. The buffer is created if necessary; otherwise
+ * the buffer object is re-used and its previous storage is orphaned.
+ */
+VertexWriter::VertexWriter(QOpenGLBuffer &vbo, int nFloats) : m_vbo(vbo)
+{
+    m_nFloats = std::max(nFloats, 0);
+    m_pData = m_pCur = nullptr;
+    m_bMapped = false;
+    m_bClosed = false;
+
+    if(m_vbo.isCreated()) m_vbo.setUsagePattern(QOpenGLBuffer::DynamicDraw); // the buffer is being rebuilt, so it will likely be rebuilt again
+    else                  m_vbo.create();
+
+    int nBytes = m_nFloats * int(sizeof(float));
+    m_vbo.bind();
+    {
+        m_vbo.allocate(nBytes); // orphans the previous storage
+        if(nBytes>0)
+        {
+            m_pData = static_cast<float*>(m_vbo.mapRange(0, nBytes, QOpenGLBuffer::RangeWrite | QOpenGLBuffer::RangeInvalidateBuffer));
+            m_bMapped = (m_pData!=nullptr);
+        }
+    }
+    m_vbo.release();
+
+    if(!m_bMapped && m_nFloats>0)
+    {
+        m_Fallback.resize(m_nFloats);
+        m_pData = m_Fallback.data();
+    }
+    m_pCur = m_pData;
+}
+
+
+VertexWriter::~VertexWriter()
+{
+    close();
+}
+
+
+/**
+ * Makes the data available for drawing. The buffer is bound again before it is unmapped,
+ * so that other buffers may be bound while the writer is open.
+ */
+void VertexWriter::close()
+{
+    if(m_bClosed) return;
+    m_bClosed = true;
+    if(m_nFloats<=0) return;
+
+    m_vbo.bind();
+    {
+        if(m_bMapped) m_vbo.unmap();
+        else          m_vbo.write(0, m_pData, m_nFloats*int(sizeof(float)));
+    }
+    m_vbo.release();
+}
+
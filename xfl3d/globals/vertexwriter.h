@@ -0,0 +1,70 @@
+/****************************************************************************
+
+    Xfl3d application
+    Copyright (C) Andre Deperrois
+    License: GPL v3
+
+*****************************************************************************/
+
+#pragma once
+
+#include <QColor>
+#include <QOpenGLBuffer>
+#include <QVector>
+
+#include <xflgeom/geom2d/vector2d.h>
+#include <xflgeom/geom3d/vector3d.h>
+
+
+/**
+ * @class VertexWriter
+ * Writes the vertex data of a buffer directly in the memory of the OpenGL buffer object.
+ *
+ * The buffer object is created once and kept: each rebuild orphans the previous storage and maps
+ * the new one with GL_MAP_INVALIDATE_BUFFER_BIT, so that the driver does not need to wait until the GPU
+ * is done with the previous frame's vertices, and no intermediate array is allocated on the heap.
+ * A buffer which is rebuilt is switched to the DynamicDraw usage pattern.
+ *
+ * The writer is used like the float arrays it replaces: the builder writes the values with operator[]
+ * or appends them with the put methods, then calls close(), which unmaps the buffer.
+ * The storage is exactly the size requested, so that QOpenGLBuffer::size() remains the size of the vertex data.
+ * The mapped memory must only be written, never read.
+ * If the buffer cannot be mapped, the data is written to an array in memory and uploaded by close().
+ *
+ * The context must be current during the lifetime of the writer.
+ */
+class VertexWriter
+{
+    public:
+        VertexWriter(QOpenGLBuffer &vbo, int nFloats);
+        ~VertexWriter();
+
+        float &operator[](int i) {Q_ASSERT(i>=0 && i<m_nFloats); return m_pData[i];}
+
+        int size() const {return m_nFloats;}
+        int count() const {return int(m_pCur-m_pData);} /**< the number of floats appended with the put methods */
+        float *data() {return m_pData;}
+        bool isMapped() const {return m_bMapped;}
+
+        void put(float f) {Q_ASSERT(count()<m_nFloats); *m_pCur++ = f;}
+        void put(float x, float y) {put(x); put(y);}
+        void put(float x, float y, float z) {put(x); put(y); put(z);}
+        void put(float x, float y, float z, float w) {put(x); put(y); put(z); put(w);}
+        void put(Vector3d const &v) {put(v.xf(), v.yf(), v.zf());}
+        void put(Vector3d const &v, float w) {put(v.xf(), v.yf(), v.zf(), w);}
+        void put(Vector2d const &v, float z) {put(v.xf(), v.yf(), z);}
+        void putRGB(QColor const &clr) {put(float(clr.redF()), float(clr.greenF()), float(clr.blueF()));}
+        void putRGBA(QColor const &clr) {put(float(clr.redF()), float(clr.greenF()), float(clr.blueF()), float(clr.alphaF()));}
+
+        void close();
+
+    private:
+        QOpenGLBuffer &m_vbo;
+        int m_nFloats;
+        float *m_pData;
+        float *m_pCur;
+        bool m_bMapped;
+        bool m_bClosed;
+        QVector<float> m_Fallback; /**< used only if the buffer cannot be mapped */
+};
+
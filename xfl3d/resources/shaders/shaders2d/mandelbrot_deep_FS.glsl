@@ -0,0 +1,103 @@
+#version 430
+
+// Deep zoom of the Mandelbrot set by perturbation of a reference orbit
+// computed in high precision on the CPU; see PerturbationOrbit
+
+uniform float tau;
+
+uniform int maxiters;
+uniform float maxlength;
+
+uniform int skip;      // the number of iterations skipped by the series approximation
+uniform int reflength; // the number of points in the reference orbit
+uniform vec2 viewport;
+
+layout(std430, binding=0) buffer RefOrbit
+{
+    dvec2 header[4];   // the series coefficients A, B, C, and (deltamax, pixelsize)
+    dvec2 orbit[];
+};
+
+layout(location = 0) out vec4 FragmentColor;
+
+
+
+float glGetRed(float tau)
+{
+    if     (tau>5.0f/6.0f) return 1.0f;
+    else if(tau>4.0f/6.0f) return (6.0f*(tau-4.0f/6.0f));
+    else if(tau>2.0f/6.0f) return 0.0f;
+    else if(tau>1.0f/6.0f) return 1.0f - (6.0f*(tau-1.0f/6.0f));
+    else                   return 1.0f;
+}
+
+float glGetGreen(float tau)
+{
+    if      (tau<2.0f/6.0f) return 0.0f;
+    else if (tau<3.0f/6.0f) return 6.0f*(tau-2.0f/6.0f);
+    else if (tau<5.0f/6.0f) return 1.0f;
+    else if (tau<6.0f/6.0f) return 1.0f - (6.0f*(tau-5.0f/6.0f));
+    else                    return 0.0f;
+}
+
+float glGetBlue(float tau)
+{
+    if      (tau<0.0f)      return 0.0f;
+    else if (tau<1.0f/6.0f) return 6.0f * tau;
+    else if (tau<3.0f/6.0f) return 1.0f;
+    else if (tau<4.0f/6.0f) return 1.0f - (6.0f*(tau-3.0f/6.0f));
+    else                    return 0.0f;
+}
+
+
+
+dvec2 cmul(dvec2 a, dvec2 b)
+{
+    return dvec2(a.x*b.x-a.y*b.y, a.x*b.y+a.y*b.x);
+}
+
+
+void main(void)
+{
+    double deltamax  = header[3].x;
+    double pixelsize = header[3].y;
+
+    dvec2 dc = dvec2(gl_FragCoord.xy - 0.5*viewport) * pixelsize;
+
+    // series approximation
+    dvec2 dz = dvec2(0,0);
+    if(skip>0)
+    {
+        dvec2 u  = dc/deltamax;
+        dvec2 u2 = cmul(u, u);
+        dz = cmul(header[0], u) + cmul(header[1], u2) + cmul(header[2], cmul(u2, u));
+    }
+
+    double maxlength2 = double(maxlength)*double(maxlength);
+
+    int m = skip;
+    int iter = skip;
+    while(iter<maxiters)
+    {
+        dz = cmul(2.0*orbit[m]+dz, dz) + dc;
+        m++;
+        iter++;
+
+        dvec2 z = orbit[m] + dz;
+        double r2 = dot(z, z);
+        if(r2>=maxlength2) break;
+
+        if(r2<dot(dz, dz) || m>=reflength-1)
+        {
+            // rebase on the start of the reference orbit
+            dz = z;
+            m = 0;
+        }
+    }
+
+    if(iter >= maxiters) FragmentColor = vec4(0,0,0,1);
+    else
+    {
+        FragmentColor = min(32.0, float(iter))/32.0 * vec4(glGetRed(tau), glGetGreen(tau), glGetBlue(tau), 1.0);
+    }
+}
@@ -16,10 +16,14 @@ in vec4 vertexColor;
 
 in vec3  vertexOffset; // used if instanced
 
+in mat4  instanceMatrix; // used if Instanced==2; occupies 4 consecutive locations
+in float instanceRadius;
+in vec4  instanceColor;
+
 uniform mat4 pvmMatrix;
 uniform mat4 vmMatrix;
 uniform mat4 LightViewMatrix;
-uniform int Instanced = 0;
+uniform int Instanced = 0; // 0: none, 1: offset and uniform scale, 2: per-instance model matrix, radius and colour
 uniform float uScale;  // used if instanced
 
 // Output data; will be interpolated for each fragment.
@@ -42,6 +46,11 @@ void main()
         vertexpos.w = vertexPosition_modelSpace.w;
         vertexpos += vec4(vertexOffset, 0.0);    // then translate
     }
+    else if(Instanced==2)
+    {
+        // scale first, then move the vertex with the instance's model matrix
+        vertexpos = instanceMatrix * vec4(vertexPosition_modelSpace.xyz*instanceRadius, 1.0);
+    }
 
     // Output position of the vertex, in clip space : MVP * position
     gl_Position =  pvmMatrix * vertexpos;
@@ -51,10 +60,12 @@ void main()
     Position_viewSpace = vsPos.xyz;
     // Normal to the vertex, in camera space
     // Only correct if ModelMatrix does not scale the model! Use its inverse transpose if not.
-    Normal_viewSpace = vec3(vmMatrix * vec4(vertexNormal_modelSpace,0));
+    if(Instanced==2) Normal_viewSpace = vec3(vmMatrix * instanceMatrix * vec4(vertexNormal_modelSpace,0));
+    else             Normal_viewSpace = vec3(vmMatrix * vec4(vertexNormal_modelSpace,0));
 
     // the vertex color, optional
-    VSColor = vertexColor;
+    if(Instanced==2) VSColor = instanceColor;
+    else             VSColor = vertexColor;
 
     // in case there is a texture
     UV = vertexUV;
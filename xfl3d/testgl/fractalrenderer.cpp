@@ -0,0 +1,298 @@
+/****************************************************************************
+
+    Xfl3d application
+    Copyright (C) Andre Deperrois
+    License: GPL v3
+
+*****************************************************************************/
+
+#include <cmath>
+
+#include <QElapsedTimer>
+#include <QFutureSynchronizer>
+#include <QtConcurrent/QtConcurrent>
+
+#if defined(__AVX__)
+#include <immintrin.h>
+#endif
+
+#include "fractalrenderer.h"
+#include "perturbationorbit.h"
+
+#include <xflcore/xflcore.h>
+
+
+FractalRenderer::FractalRenderer()
+{
+    m_bJulia = false;
+    m_SeedX = -0.35099;
+    m_SeedY = -0.605502;
+    m_MaxIter = 128;
+    m_MaxLength = 10.0;
+    m_Tau = 1.0f;
+
+    m_xc = m_yc = 0.0;
+    m_PixelSize = 1.0/512.0;
+    m_TileSize = 64;
+
+    m_pOrbit = nullptr;
+
+    m_RenderTime = 0.0;
+    m_nPixels = 0;
+}
+
+
+bool FractalRenderer::hasAVX()
+{
+#if defined(__AVX__)
+    return true;
+#else
+    return false;
+#endif
+}
+
+
+/** Same colours as julia_FS.glsl: black inside the set, and a brightness proportional to the iterations outside */
+void FractalRenderer::makePalette()
+{
+    float r = xfl::getRed(m_Tau);
+    float g = xfl::getGreen(m_Tau);
+    float b = xfl::getBlue(m_Tau);
+
+    m_Palette.resize(3*(m_MaxIter+1));
+    for(int iter=0; iter<=m_MaxIter; iter++)
+    {
+        float f = (iter==m_MaxIter) ? 0.0f : std::min(32.0f, float(iter))/32.0f;
+        m_Palette[3*iter  ] = uchar(std::round(f*r*255.0f));
+        m_Palette[3*iter+1] = uchar(std::round(f*g*255.0f));
+        m_Palette[3*iter+2] = uchar(std::round(f*b*255.0f));
+    }
+}
+
+
+/**
+ * Renders the image with the current settings.
+ * The image is centered on the view's center, and the y-axis points upwards as in the OpenGL view.
+ */
+QImage FractalRenderer::render(int width, int height)
+{
+    QElapsedTimer t;
+    t.start();
+
+    QImage img(width, height, QImage::Format_RGB888);
+    if(img.isNull()) return img; // allocation failure
+
+    makePalette();
+
+    QVector<QRect> tiles;
+    for(int y0=0; y0<height; y0+=m_TileSize)
+    {
+        for(int x0=0; x0<width; x0+=m_TileSize)
+        {
+            tiles.append(QRect(x0, y0, std::min(m_TileSize, width-x0), std::min(m_TileSize, height-y0)));
+        }
+    }
+
+    uchar *pBits = img.bits();
+    int bytesperline = int(img.bytesPerLine());
+    std::atomic<int> next(0);
+
+    int nThreads = xfl::isMultiThreaded() ? std::max(1, xfl::maxThreadCount()) : 1;
+    nThreads = std::min(nThreads, int(tiles.size()));
+
+    if(nThreads<=1)
+    {
+        renderTiles(pBits, bytesperline, width, height, &tiles, &next);
+    }
+    else
+    {
+        QFutureSynchronizer<void> futureSync;
+        for(int it=0; it<nThreads; it++)
+        {
+#if (QT_VERSION < QT_VERSION_CHECK(6, 0, 0))
+            futureSync.addFuture(QtConcurrent::run(this, &FractalRenderer::renderTiles, pBits, bytesperline, width, height, &tiles, &next));
+#else
+            futureSync.addFuture(QtConcurrent::run(&FractalRenderer::renderTiles, this, pBits, bytesperline, width, height, &tiles, &next));
+#endif
+        }
+        futureSync.waitForFinished();
+    }
+
+    m_RenderTime = double(t.nsecsElapsed())/1.e6;
+    m_nPixels = qint64(width)*qint64(height);
+
+    return img;
+}
+
+
+/** Worker loop: takes the next available tile until all have been rendered */
+void FractalRenderer::renderTiles(uchar *pBits, int bytesperline, int width, int height, QVector<QRect> const *pTiles, std::atomic<int> *pNext) const
+{
+    int itile = pNext->fetch_add(1);
+    while(itile<pTiles->size())
+    {
+        renderTile(pBits, bytesperline, width, height, pTiles->at(itile));
+        itile = pNext->fetch_add(1);
+    }
+}
+
+
+void FractalRenderer::renderTile(uchar *pBits, int bytesperline, int width, int height, QRect const &tile) const
+{
+    if(m_pOrbit && !m_pOrbit->isEmpty())
+    {
+        renderPerturbedTile(pBits, bytesperline, width, height, tile);
+        return;
+    }
+
+    double px[NLANES], py[NLANES];
+    int iters[NLANES];
+
+    double x0 = m_xc - 0.5*double(width-1) *m_PixelSize;
+    double y0 = m_yc + 0.5*double(height-1)*m_PixelSize;
+
+    for(int j=tile.top(); j<=tile.bottom(); j++)
+    {
+        uchar *pLine = pBits + qint64(j)*bytesperline;
+        double y = y0 - double(j)*m_PixelSize;
+        for(int i=tile.left(); i<=tile.right(); i+=NLANES)
+        {
+            int nl = std::min(NLANES, tile.right()+1-i);
+            for(int l=0; l<NLANES; l++)
+            {
+                // pad the last group with the last pixel
+                px[l] = x0 + double(i+std::min(l, nl-1))*m_PixelSize;
+                py[l] = y;
+            }
+
+            iterateLanes(px, py, iters);
+
+            for(int l=0; l<nl; l++)
+            {
+                uchar const *pColour = m_Palette.constData() + 3*iters[l];
+                uchar *pPixel = pLine + 3*(i+l);
+                pPixel[0] = pColour[0];
+                pPixel[1] = pColour[1];
+                pPixel[2] = pColour[2];
+            }
+        }
+    }
+}
+
+
+/** The pixel offsets are relative to the image's center, which is the orbit's reference point */
+void FractalRenderer::renderPerturbedTile(uchar *pBits, int bytesperline, int width, int height, QRect const &tile) const
+{
+    double dx0 = -0.5*double(width-1) *m_PixelSize;
+    double dy0 =  0.5*double(height-1)*m_PixelSize;
+
+    for(int j=tile.top(); j<=tile.bottom(); j++)
+    {
+        uchar *pLine = pBits + qint64(j)*bytesperline;
+        double dcy = dy0 - double(j)*m_PixelSize;
+        for(int i=tile.left(); i<=tile.right(); i++)
+        {
+            double dcx = dx0 + double(i)*m_PixelSize;
+            int iter = std::min(m_pOrbit->iterate(dcx, dcy), m_MaxIter);
+            uchar const *pColour = m_Palette.constData() + 3*iter;
+            uchar *pPixel = pLine + 3*i;
+            pPixel[0] = pColour[0];
+            pPixel[1] = pColour[1];
+            pPixel[2] = pColour[2];
+        }
+    }
+}
+
+
+/**
+ * Iterates z=z²+c for NLANES pixels at a time.
+ * Lanes which have escaped are masked out and keep their count; the group stops when all lanes have escaped.
+ * The count is the same as in julia_FS.glsl, i.e. the escape iteration, or maxiters if the point did not escape.
+ */
+void FractalRenderer::iterateLanes(double const *px, double const *py, int *iters) const
+{
+    double const maxlength2 = m_MaxLength*m_MaxLength;
+
+#if defined(__AVX__)
+    int const NREG = NLANES/4;
+    __m256d zx[NREG], zy[NREG], cx[NREG], cy[NREG], count[NREG], mask[NREG];
+    __m256d const one = _mm256_set1_pd(1.0);
+    __m256d const two = _mm256_set1_pd(2.0);
+    __m256d const l2  = _mm256_set1_pd(maxlength2);
+    for(int k=0; k<NREG; k++)
+    {
+        __m256d x = _mm256_loadu_pd(px+4*k);
+        __m256d y = _mm256_loadu_pd(py+4*k);
+        if(m_bJulia)
+        {
+            zx[k] = x;    zy[k] = y;
+            cx[k] = _mm256_set1_pd(m_SeedX);
+            cy[k] = _mm256_set1_pd(m_SeedY);
+        }
+        else
+        {
+            zx[k] = zy[k] = _mm256_setzero_pd();
+            cx[k] = x;    cy[k] = y;
+        }
+        count[k] = _mm256_setzero_pd();
+        mask[k] = _mm256_cmp_pd(one, one, _CMP_EQ_OQ); // all lanes active
+    }
+
+    for(int it=0; it<m_MaxIter; it++)
+    {
+        int active = 0;
+        for(int k=0; k<NREG; k++)
+        {
+            __m256d nx = _mm256_add_pd(_mm256_sub_pd(_mm256_mul_pd(zx[k], zx[k]), _mm256_mul_pd(zy[k], zy[k])), cx[k]);
+            __m256d ny = _mm256_add_pd(_mm256_mul_pd(two, _mm256_mul_pd(zx[k], zy[k])), cy[k]);
+            zx[k] = _mm256_blendv_pd(zx[k], nx, mask[k]);
+            zy[k] = _mm256_blendv_pd(zy[k], ny, mask[k]);
+            count[k] = _mm256_add_pd(count[k], _mm256_and_pd(mask[k], one));
+            __m256d r2 = _mm256_add_pd(_mm256_mul_pd(nx, nx), _mm256_mul_pd(ny, ny));
+            mask[k] = _mm256_and_pd(mask[k], _mm256_cmp_pd(r2, l2, _CMP_LT_OQ));
+            active |= _mm256_movemask_pd(mask[k]);
+        }
+        if(!active) break;
+    }
+
+    double c[NLANES];
+    for(int k=0; k<NREG; k++) _mm256_storeu_pd(c+4*k, count[k]);
+    for(int l=0; l<NLANES; l++) iters[l] = int(c[l]);
+#else
+    // portable version, written so that the compiler can vectorize the inner loop
+    double zx[NLANES], zy[NLANES], cx[NLANES], cy[NLANES];
+    int active[NLANES];
+    for(int l=0; l<NLANES; l++)
+    {
+        if(m_bJulia)
+        {
+            zx[l] = px[l];    zy[l] = py[l];
+            cx[l] = m_SeedX;  cy[l] = m_SeedY;
+        }
+        else
+        {
+            zx[l] = zy[l] = 0.0;
+            cx[l] = px[l];    cy[l] = py[l];
+        }
+        iters[l] = 0;
+        active[l] = 1;
+    }
+
+    for(int it=0; it<m_MaxIter; it++)
+    {
+        int nactive = 0;
+        for(int l=0; l<NLANES; l++)
+        {
+            double nx = zx[l]*zx[l] - zy[l]*zy[l] + cx[l];
+            double ny = 2.0*zx[l]*zy[l] + cy[l];
+            zx[l] = active[l] ? nx : zx[l];
+            zy[l] = active[l] ? ny : zy[l];
+            iters[l] += active[l];
+            active[l] &= (nx*nx+ny*ny<maxlength2) ? 1 : 0;
+            nactive += active[l];
+        }
+        if(nactive==0) break;
+    }
+#endif
+}
+
@@ -0,0 +1,83 @@
+/****************************************************************************
+
+    Xfl3d application
+    Copyright (C) Andre Deperrois
+    License: GPL v3
+
+*****************************************************************************/
+
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+
+#include <QImage>
+#include <QRect>
+#include <QVector>
+
+class PerturbationOrbit;
+
+/**
+ * @class FractalRenderer
+ * CPU renderer for the Mandelbrot and Julia sets.
+ * Uses the same iteration and colouring as julia_FS.glsl, in double precision.
+ * Pixels are iterated in groups of NLANES with early-escape masking,
+ * and the image is split into tiles which are shared dynamically between threads.
+ * Does not require an OpenGL context, so that images of arbitrary size can be exported.
+ * Deep zooms of the Mandelbrot set are rendered by perturbation of a high precision reference orbit
+ * centered on the view; these pixels are iterated one at a time, since each has its own reference index.
+ */
+class FractalRenderer
+{
+    public:
+        static int const NLANES = 8;   /**< the number of pixels iterated together */
+
+    public:
+        FractalRenderer();
+
+        void setJulia(bool bJulia) {m_bJulia=bJulia;}
+        void setSeed(double x, double y) {m_SeedX=x; m_SeedY=y;}
+        void setMaxIter(int maxiter) {m_MaxIter=std::max(1, maxiter);}
+        void setMaxLength(double maxlength) {m_MaxLength=maxlength;}
+        void setHue(float tau) {m_Tau=tau;}
+        void setTileSize(int size) {m_TileSize=std::max(NLANES, size);}
+
+        /** Sets the world coordinates of the image's center, and the world size of one pixel */
+        void setView(double xc, double yc, double pixelsize) {m_xc=xc; m_yc=yc; m_PixelSize=pixelsize;}
+
+        /** Renders the Mandelbrot set by perturbation of the orbit; the orbit's reference is the image's center */
+        void setPerturbationOrbit(PerturbationOrbit const *pOrbit) {m_pOrbit=pOrbit;}
+
+        QImage render(int width, int height);
+
+        double renderTime() const {return m_RenderTime;}
+        double pixelRate() const {return m_RenderTime>0.0 ? double(m_nPixels)/m_RenderTime*1000.0 : 0.0;}
+
+        static bool hasAVX();
+
+    private:
+        void makePalette();
+        void renderTiles(uchar *pBits, int bytesperline, int width, int height, QVector<QRect> const *pTiles, std::atomic<int> *pNext) const;
+        void renderTile(uchar *pBits, int bytesperline, int width, int height, QRect const &tile) const;
+        void iterateLanes(double const *px, double const *py, int *iters) const;
+        void renderPerturbedTile(uchar *pBits, int bytesperline, int width, int height, QRect const &tile) const;
+
+    private:
+        bool m_bJulia;
+        double m_SeedX, m_SeedY;
+        int m_MaxIter;
+        double m_MaxLength;
+        float m_Tau;
+
+        double m_xc, m_yc;
+        double m_PixelSize;
+        int m_TileSize;
+
+        PerturbationOrbit const *m_pOrbit;
+
+        QVector<uchar> m_Palette; /**< the rgb colour for each iteration count */
+
+        double m_RenderTime; /**< the wall time of the last render, in ms */
+        qint64 m_nPixels;
+};
+
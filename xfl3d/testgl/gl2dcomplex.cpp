@@ -18,6 +18,7 @@
 #include <xflcore/displayoptions.h>
 #include <xflcore/trace.h>
 #include <xfl3d/views/gl3dview.h> // for the static variables
+#include <xfl3d/views/shaderregistry.h>
 #include <xflmath/mathelem.h>
 #include <xflwidgets/customwts/intedit.h>
 #include <xflwidgets/customwts/floatedit.h>
@@ -27,7 +28,8 @@
 
 QByteArray gl2dComplex::s_Geometry;
 
-gl2dComplex::gl2dComplex(QWidget *pParent) : gl2dView(pParent)
+gl2dComplex::gl2dComplex(QWidget *pParent) : gl2dView(pParent),
+    m_shadComplex(ShaderRegistry::program("complex"))
 {
     setWindowTitle("Complex analysis");
     setMouseTracking(false);
@@ -107,24 +109,8 @@ void gl2dComplex::hideEvent(QHideEvent *pEvent)
 
 void gl2dComplex::initializeGL()
 {
-    QString strange, vsrc, fsrc;
-    vsrc = ":/shaders/shaders2d/fractal_VS.glsl";
-    m_shadComplex.addShaderFromSourceFile(QOpenGLShader::Vertex, vsrc);
-    if(m_shadComplex.log().length())
-    {
-        strange = QString::asprintf("%s", QString("Frac. vertex shader log:"+m_shadComplex.log()).toStdString().c_str());
-        trace(strange);
-    }
-
-    fsrc = ":/shaders/shaders2d/complex_FS.glsl";
-    m_shadComplex.addShaderFromSourceFile(QOpenGLShader::Fragment, fsrc);
-    if(m_shadComplex.log().length())
-    {
-        strange = QString::asprintf("%s", QString("Complex fragment shader log:"+m_shadComplex.log()).toStdString().c_str());
-        trace(strange);
-    }
-
-    m_shadComplex.link();
+    ShaderRegistry::build(m_shadComplex, "Complex", {{QOpenGLShader::Vertex,   ":/shaders/shaders2d/fractal_VS.glsl"},
+                                                     {QOpenGLShader::Fragment, ":/shaders/shaders2d/complex_FS.glsl"}});
     m_shadComplex.bind();
     {
         m_locViewTrans  = m_shadComplex.uniformLocation("ViewTrans");
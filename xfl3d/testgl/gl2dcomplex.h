@@ -53,7 +53,7 @@ class gl2dComplex : public gl2dView
         PlainTextOutput *m_ppto;
         QLabel *m_plabScale;
 
-        QOpenGLShaderProgram m_shadComplex;
+        QOpenGLShaderProgram &m_shadComplex;
         // shader uniforms
         int m_locZeta;
         static QByteArray s_Geometry;
@@ -6,17 +6,26 @@
 
 *****************************************************************************/
 
+#include <cmath>
+
 #include <QApplication>
+#include <QDataStream>
 #include <QFormLayout>
 #include <QLabel>
+#include <QOpenGLExtraFunctions>
+#include <QOpenGLPaintDevice>
+#include <QPainter>
 #include <QPushButton>
+#include <QWheelEvent>
 
 #include "gl2dfractal.h"
+#include "fractalrenderer.h"
 
 #include <xflcore/xflcore.h>
 #include <xflcore/displayoptions.h>
 #include <xflcore/trace.h>
 #include <xfl3d/views/gl3dview.h> // for the static variables
+#include <xfl3d/views/shaderregistry.h>
 #include <xflwidgets/customwts/intedit.h>
 #include <xflwidgets/customwts/floatedit.h>
 #include <xflwidgets/wt_globals.h>
@@ -25,10 +34,17 @@ int gl2dFractal::s_Hue(1000);
 int gl2dFractal::s_MaxIter(128);
 float gl2dFractal::s_MaxLength(10.0f);
 QVector2D gl2dFractal::s_Seed(-0.35099f, -0.605502f);
+bool gl2dFractal::s_bCpuImage(false);
+bool gl2dFractal::s_bDeepZoom(false);
+BigReal gl2dFractal::s_DeepX(-0.5);
+BigReal gl2dFractal::s_DeepY(0.0);
+double gl2dFractal::s_DeepPixelSize(0.0);
 
 
 
-gl2dFractal::gl2dFractal(QWidget *pParent) : gl2dView(pParent)
+gl2dFractal::gl2dFractal(QWidget *pParent) : gl2dView(pParent),
+    m_shadFrac(ShaderRegistry::program("julia")),
+    m_shadDeep(ShaderRegistry::program("mandelbrot_deep"))
 {
     setWindowTitle("Fractals");
 //    setMouseTracking(true);
@@ -36,6 +52,8 @@ gl2dFractal::gl2dFractal(QWidget *pParent) : gl2dView(pParent)
     m_fScale = 0.5f;
 
     m_bAxes = false;
+    m_bProgressive = true;
+    m_bTileCache = true;
 
     m_nRoots = 1;
     m_iHoveredRoot = m_iSelectedRoot = -1;
@@ -44,6 +62,13 @@ gl2dFractal::gl2dFractal(QWidget *pParent) : gl2dView(pParent)
     m_locJulia = m_locParam = -1;
     m_locIters = m_locLength = m_locHue = -1;
 
+    m_locDeepIters = m_locDeepHue = m_locDeepLength = -1;
+    m_locDeepSkip = m_locDeepRefLength = m_locDeepViewport = -1;
+    m_bDeepShader = false;
+    m_bResetOrbit = m_bResetDeepImage = true;
+    m_bResetOrbitBuffer = true;
+    m_OrbitPixelSize = 0.0;
+
 
     m_pCmdFrame = new QFrame(this);
     {
@@ -82,6 +107,13 @@ gl2dFractal::gl2dFractal(QWidget *pParent) : gl2dView(pParent)
                 pParamLayout->addRow("Max. length:",     m_pdeMaxLength);
             }
 
+            m_pchDeepZoom = new QCheckBox("Deep zoom");
+            m_pchDeepZoom->setToolTip("<p>Renders the Mandelbrot set by perturbation of a high precision reference orbit "
+                                      "centered on the view, to allow zooms down to 1e-100. "
+                                      "Increase the max. number of iterations as the zoom gets deeper.</p>");
+            m_pchDeepZoom->setChecked(s_bDeepZoom);
+            connect(m_pchDeepZoom, SIGNAL(clicked()), SLOT(onDeepZoom()));
+
             m_pchShowSeed = new QCheckBox("Show seed");
             connect(m_pchShowSeed, SIGNAL(clicked()), SLOT(onMode()));
             m_pchShowSeed->setToolTip("Use the mouse to drag the seed and update the corresponding Julia set");
@@ -96,7 +128,7 @@ gl2dFractal::gl2dFractal(QWidget *pParent) : gl2dView(pParent)
                 m_pslTau->setTickInterval(50);
                 m_pslTau->setTickPosition(QSlider::TicksBelow);
                 m_pslTau->setValue(s_Hue);
-                connect(m_pslTau, SIGNAL(sliderMoved(int)), SLOT(update()));
+                connect(m_pslTau, SIGNAL(sliderMoved(int)), SLOT(onProgressiveUpdate()));
 
                 pHueLayout->addWidget(plabHue,         1, 1);
                 pHueLayout->addWidget(m_pslTau,        1, 2);
@@ -120,6 +152,14 @@ gl2dFractal::gl2dFractal(QWidget *pParent) : gl2dView(pParent)
                 pWidthLayout->addStretch();
             }
 
+            m_pchCpuImage = new QCheckBox("Render the image on the CPU");
+            m_pchCpuImage->setToolTip("<p>Computes the saved image in double precision on the CPU instead of the GPU. "
+                                      "Images larger than the maximum OpenGL framebuffer size can be exported.</p>");
+            m_pchCpuImage->setChecked(s_bCpuImage);
+
+            m_plabCpuInfo = new QLabel();
+            m_plabCpuInfo->setFont(DisplayOptions::textFont());
+
             QLabel *pRefLink = new QLabel;
             pRefLink->setText("Inspired by <a href=https://youtu.be/LqbZpur38nw>3Blue1Brown's YouTube video</a>");
             pRefLink->setOpenExternalLinks(true);
@@ -129,11 +169,14 @@ gl2dFractal::gl2dFractal(QWidget *pParent) : gl2dView(pParent)
             pFrameLayout->addWidget(pLabTitle);
             pFrameLayout->addLayout(pModeLayout);
             pFrameLayout->addLayout(pParamLayout);
+            pFrameLayout->addWidget(m_pchDeepZoom);
             pFrameLayout->addWidget(m_pchShowSeed);
             pFrameLayout->addLayout(pHueLayout);
             pFrameLayout->addWidget(m_plabScale);
             pFrameLayout->addWidget(m_ppbSaveImg);
             pFrameLayout->addLayout(pWidthLayout);
+            pFrameLayout->addWidget(m_pchCpuImage);
+            pFrameLayout->addWidget(m_plabCpuInfo);
             pFrameLayout->addWidget(pRefLink);
         }
 
@@ -155,6 +198,11 @@ void gl2dFractal::loadSettings(QSettings &settings)
         s_MaxLength  = settings.value("MaxLength",  s_MaxLength).toFloat();
         s_Seed.setX(settings.value("SeedX",        s_Seed.x()).toFloat());
         s_Seed.setY(settings.value("SeedY",        s_Seed.y()).toFloat());
+        s_bCpuImage  = settings.value("CpuImage",   s_bCpuImage).toBool();
+        s_bDeepZoom  = settings.value("DeepZoom",   s_bDeepZoom).toBool();
+        s_DeepX.fromString(settings.value("DeepX",  s_DeepX.toString()).toString());
+        s_DeepY.fromString(settings.value("DeepY",  s_DeepY.toString()).toString());
+        s_DeepPixelSize = settings.value("DeepPixelSize", s_DeepPixelSize).toDouble();
     }
     settings.endGroup();
 }
@@ -169,6 +217,11 @@ void gl2dFractal::saveSettings(QSettings &settings)
         settings.setValue("MaxLength",  s_MaxLength);
         settings.setValue("SeedX",      s_Seed.x());
         settings.setValue("SeedY",      s_Seed.y());
+        settings.setValue("CpuImage",   s_bCpuImage);
+        settings.setValue("DeepZoom",   s_bDeepZoom);
+        settings.setValue("DeepX",      s_DeepX.toString());
+        settings.setValue("DeepY",      s_DeepY.toString());
+        settings.setValue("DeepPixelSize", s_DeepPixelSize);
     }
     settings.endGroup();
 }
@@ -177,30 +230,78 @@ void gl2dFractal::saveSettings(QSettings &settings)
 void gl2dFractal::onMode()
 {
     m_bResetRoots = true;
+    m_bResetOrbit = true;
     update();
 }
 
 
-void gl2dFractal::initializeGL()
+/**
+ * Switches between the single precision shader view and the deep zoom view.
+ * The deep zoom view starts from the current view, and the standard view resumes
+ * from the deep zoom view's position as far as the float scale allows.
+ */
+void gl2dFractal::onDeepZoom()
 {
-    QString strange, vsrc, fsrc;
-    vsrc = ":/shaders/shaders2d/fractal_VS.glsl";
-    m_shadFrac.addShaderFromSourceFile(QOpenGLShader::Vertex, vsrc);
-    if(m_shadFrac.log().length())
-    {
-        strange = QString::asprintf("%s", QString("Frac vertex shader log:"+m_shadFrac.log()).toStdString().c_str());
-        trace(strange);
-    }
+    s_bDeepZoom = m_pchDeepZoom->isChecked();
+    if(s_bDeepZoom) setDeepZoomFromView();
+    else            setViewFromDeepZoom();
+    m_bResetOrbit = true;
+    update();
+}
+
+
+void gl2dFractal::setDeepZoomFromView()
+{
+    double w = m_rectView.width();
+    s_DeepX = BigReal(-m_ptOffset.x()/double(width())*w);
+    s_DeepY = BigReal( m_ptOffset.y()/double(width())*w);
+    s_DeepPixelSize = w/double(m_fScale)/double(width());
+}
 
-    fsrc = ":/shaders/shaders2d/julia_FS.glsl";
-    m_shadFrac.addShaderFromSourceFile(QOpenGLShader::Fragment, fsrc);
-    if(m_shadFrac.log().length())
+
+void gl2dFractal::setViewFromDeepZoom()
+{
+    if(s_DeepPixelSize<=0.0 || width()<=0) return;
+    double w = m_rectView.width();
+    double scale = w/s_DeepPixelSize/double(width());
+    m_fScale = float(std::min(scale, 1.e30));
+    m_ptOffset.setX(-s_DeepX.toDouble()*double(width())/w);
+    m_ptOffset.setY( s_DeepY.toDouble()*double(width())/w);
+}
+
+
+/**
+ * Returns the world position of the screen point. In deep zoom mode, the position is computed in double precision
+ * from the high precision center and the pixel size, since the view's float scale is meaningless at these depths.
+ */
+void gl2dFractal::screenToFractal(QPoint const &point, double &x, double &y) const
+{
+    if(isDeepZoom() && s_DeepPixelSize>0.0)
     {
-        strange = QString::asprintf("%s", QString("Frac fragment shader log:"+m_shadFrac.log()).toStdString().c_str());
-        trace(strange);
+        x = s_DeepX.toDouble() + (double(point.x()) - double(width())/2.0)  * s_DeepPixelSize;
+        y = s_DeepY.toDouble() - (double(point.y()) - double(height())/2.0) * s_DeepPixelSize;
+        return;
     }
+    QVector2D pt;
+    screenToWorld(point, pt);
+    x = double(pt.x());
+    y = double(pt.y());
+}
 
-    m_shadFrac.link();
+
+/** The distance in world units within which the mouse picks the seed */
+double gl2dFractal::seedTolerance() const
+{
+    if(isDeepZoom() && s_DeepPixelSize>0.0)
+        return 0.025*double(width())/m_rectView.width()*s_DeepPixelSize;
+    return 0.025/double(m_fScale);
+}
+
+
+void gl2dFractal::initializeGL()
+{
+    ShaderRegistry::build(m_shadFrac, "Frac", {{QOpenGLShader::Vertex,   ":/shaders/shaders2d/fractal_VS.glsl"},
+                                               {QOpenGLShader::Fragment, ":/shaders/shaders2d/julia_FS.glsl"}});
     m_shadFrac.bind();
     {
         m_attrVertexPosition = m_shadFrac.attributeLocation("VertexPosition");
@@ -216,19 +317,159 @@ void gl2dFractal::initializeGL()
     }
     m_shadFrac.release();
 
+    // the deep zoom shader requires double precision and shader storage buffers
+    m_bDeepShader = false;
+    if(context()->format().version()>=qMakePair(4,3))
+    {
+        m_bDeepShader = ShaderRegistry::build(m_shadDeep, "Deep zoom", {{QOpenGLShader::Vertex,   ":/shaders/shaders2d/fractal_VS.glsl"},
+                                                                        {QOpenGLShader::Fragment, ":/shaders/shaders2d/mandelbrot_deep_FS.glsl"}});
+        if(m_bDeepShader)
+        {
+            m_shadDeep.bind();
+            {
+                m_locDeepIters     = m_shadDeep.uniformLocation("maxiters");
+                m_locDeepLength    = m_shadDeep.uniformLocation("maxlength");
+                m_locDeepHue       = m_shadDeep.uniformLocation("tau");
+                m_locDeepSkip      = m_shadDeep.uniformLocation("skip");
+                m_locDeepRefLength = m_shadDeep.uniformLocation("reflength");
+                m_locDeepViewport  = m_shadDeep.uniformLocation("viewport");
+            }
+            m_shadDeep.release();
+        }
+    }
+
     gl2dView::initializeGL();
 }
 
 
-void gl2dFractal::glRenderView()
+/**
+ * Renders the deep zoom view, with the shader if available and with the CPU renderer otherwise.
+ * The reference orbit is recomputed only when the view's center or the iteration settings change.
+ */
+void gl2dFractal::renderDeepZoom()
 {
-    QOpenGLVertexArrayObject::Binder vaoBinder(&m_vao);
+    s_MaxIter   = m_pieMaxIter->value();
+    s_MaxLength = m_pdeMaxLength->value();
+    if(s_Hue!=m_pslTau->value()) m_bResetDeepImage = true;
+    s_Hue = m_pslTau->value();
+
+    if(s_DeepPixelSize<=0.0) setDeepZoomFromView(); // first use
+
+    bool bNewOrbit = false;
+    if(m_bResetOrbit)
+    {
+        m_Orbit.compute(s_DeepX, s_DeepY, s_MaxIter, s_MaxLength);
+        m_bResetOrbit = false;
+        m_bResetDeepImage = true;
+        bNewOrbit = true;
+    }
+
+    GLint viewport[4]{0,0,0,0};
+    glGetIntegerv(GL_VIEWPORT, viewport);
+    double vw = viewport[2];
+    double vh = viewport[3];
+    // the viewport is in device pixels
+    double pixelsize = s_DeepPixelSize * double(width())/vw;
+    double deltamax = 0.5*pixelsize*sqrt(vw*vw+vh*vh);
+    if(bNewOrbit || deltamax!=m_Orbit.deltaMax() || pixelsize!=m_OrbitPixelSize)
+    {
+        m_Orbit.computeSeries(deltamax);
+        m_OrbitPixelSize = pixelsize;
+        m_bResetOrbitBuffer = true;
+    }
+
+    if(m_bDeepShader)
+    {
+        if(m_bResetOrbitBuffer || !m_ssboOrbit.isCreated())
+        {
+            QVector<double> buffer(8);
+            double const *coef = m_Orbit.seriesCoefs();
+            for(int i=0; i<6; i++) buffer[i] = coef[i];
+            buffer[6] = m_Orbit.deltaMax();
+            buffer[7] = pixelsize;
+            buffer.append(m_Orbit.orbit());
+
+            if(!m_ssboOrbit.isCreated()) m_ssboOrbit.create();
+            m_ssboOrbit.bind();
+            m_ssboOrbit.allocate(buffer.data(), int(buffer.size()*sizeof(double)));
+            m_ssboOrbit.release();
+            m_bResetOrbitBuffer = false;
+        }
+
+        if(m_shadDeep.bind())
+        {
+            int stride = 2;
+            m_shadDeep.setUniformValue(m_locDeepIters,     s_MaxIter);
+            m_shadDeep.setUniformValue(m_locDeepLength,    s_MaxLength);
+            m_shadDeep.setUniformValue(m_locDeepHue,       float(s_Hue)/1000.0f);
+            m_shadDeep.setUniformValue(m_locDeepSkip,      m_Orbit.skip());
+            m_shadDeep.setUniformValue(m_locDeepRefLength, m_Orbit.length());
+            m_shadDeep.setUniformValue(m_locDeepViewport,  QVector2D(float(vw), float(vh)));
+            m_shadDeep.setUniformValue(m_locViewTrans,     QVector2D(0.0f, 0.0f));
+            m_shadDeep.setUniformValue(m_locViewScale,     1.0f);
+            m_shadDeep.setUniformValue(m_locViewRatio,     float(width())/float(height()));
+
+            QOpenGLContext::currentContext()->extraFunctions()->glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 0, m_ssboOrbit.bufferId());
+
+            m_vboQuad.bind();
+            {
+                int attrPos = m_shadDeep.attributeLocation("VertexPosition");
+                m_shadDeep.enableAttributeArray(attrPos);
+                m_shadDeep.setAttributeBuffer(attrPos, GL_FLOAT, 0, stride, stride*sizeof(GLfloat));
+
+                glPolygonMode(GL_FRONT_AND_BACK, GL_FILL);
+                glDisable(GL_CULL_FACE);
+
+                int nvtx = m_vboQuad.size()/stride/int(sizeof(float));
+                glDrawArrays(GL_TRIANGLE_STRIP, 0, nvtx);
+
+                m_shadDeep.disableAttributeArray(attrPos);
+            }
+            m_vboQuad.release();
+            m_shadDeep.release();
+        }
+    }
+    else if(m_bResetDeepImage || m_imgDeep.width()!=int(vw) || m_imgDeep.height()!=int(vh))
+    {
+        FractalRenderer renderer;
+        renderer.setMaxIter(s_MaxIter);
+        renderer.setMaxLength(s_MaxLength);
+        renderer.setHue(float(s_Hue)/1000.0f);
+        renderer.setView(0.0, 0.0, pixelsize);
+        renderer.setPerturbationOrbit(&m_Orbit);
+        m_imgDeep = renderer.render(int(vw), int(vh));
+        m_bResetDeepImage = false;
+    }
+}
+
+
+void gl2dFractal::paintOverlay()
+{
+    if(isDeepZoom() && !m_bDeepShader && !m_imgDeep.isNull())
+    {
+        QOpenGLPaintDevice device(size() * devicePixelRatio());
+        QPainter painter(&device);
+        painter.drawImage(QRect(0, 0, device.width(), device.height()), m_imgDeep);
+    }
+    gl2dView::paintOverlay();
+}
 
-//    glClearColor(0.0f, 1.0f, 0.0f, 1.0f);
-//    glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
-//    glDisable(GL_BLEND);
-    glEnable(GL_DEPTH_TEST);
 
+/** The values which define the image, used to identify the cached tiles */
+QByteArray gl2dFractal::tileParameters() const
+{
+    QByteArray params;
+    QDataStream ds(&params, QIODevice::WriteOnly);
+    ds << m_prbJulia->isChecked() << s_Seed << m_pieMaxIter->value() << m_pdeMaxLength->value() << m_pslTau->value();
+    // the deep zoom images are not tiled, but the key also identifies the finished progressive image
+    if(isDeepZoom()) ds << s_DeepX.toString() << s_DeepY.toString() << s_DeepPixelSize << m_bDeepShader;
+    return params;
+}
+
+
+/** Renders the fractal only; the VAO is bound by the caller */
+void gl2dFractal::glRenderImage()
+{
     double w = m_rectView.width();
     QVector2D off(-m_ptOffset.x()/width()*w, m_ptOffset.y()/width()*w);
 
@@ -267,6 +508,34 @@ void gl2dFractal::glRenderView()
         m_vboQuad.release();
         m_shadFrac.release();
     }
+}
+
+
+void gl2dFractal::glRenderView()
+{
+    QOpenGLVertexArrayObject::Binder vaoBinder(&m_vao);
+
+//    glClearColor(0.0f, 1.0f, 0.0f, 1.0f);
+//    glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+//    glDisable(GL_BLEND);
+    glEnable(GL_DEPTH_TEST);
+
+    if(isDeepZoom())
+    {
+        renderDeepZoom();
+        m_plabScale->setText(QString::asprintf("Scale = %g", m_rectView.width()/s_DeepPixelSize/double(width())));
+        if (!m_bInitialized)
+        {
+            m_bInitialized = true;
+            emit ready2d();
+        }
+        return;
+    }
+
+    double w = m_rectView.width();
+    QVector2D off(-m_ptOffset.x()/width()*w, m_ptOffset.y()/width()*w);
+
+    if(!m_bImageFromTiles) glRenderImage();
 
     if(m_pchShowSeed->isChecked())
     {
@@ -386,13 +655,13 @@ void gl2dFractal::glRenderView()
 
 void gl2dFractal::mousePressEvent(QMouseEvent *pEvent)
 {
-    QVector2D pt;
-    screenToWorld(pEvent->pos(), pt);
+    double x=0, y=0;
+    screenToFractal(pEvent->pos(), x, y);
 
     int nroots = 1;
     for(int i=0; i<nroots; i++)
     {
-        if(pt.distanceToPoint(s_Seed)<0.025/m_fScale)
+        if(std::hypot(x-double(s_Seed.x()), y-double(s_Seed.y()))<seedTolerance())
         {
 //            m_Timer.stop();
 //            m_pchAnimateRoots->setChecked(false);
@@ -407,24 +676,24 @@ void gl2dFractal::mousePressEvent(QMouseEvent *pEvent)
 
 void gl2dFractal::mouseMoveEvent(QMouseEvent *pEvent)
 {
-    QVector2D pt;
-    screenToWorld(pEvent->pos(), pt);
+    double x=0, y=0;
+    screenToFractal(pEvent->pos(), x, y);
 
     if(m_iSelectedRoot>=0)
     {
-        s_Seed = pt;
+        s_Seed = QVector2D(float(x), float(y));
         m_amp0 = sqrt(s_Seed.x()*s_Seed.x()+s_Seed.y()*s_Seed.y());
         m_phi0 = atan2f(s_Seed.y(), s_Seed.x());
 //        m_Time = 0;
         m_bResetRoots = true;
-        update();
+        onProgressiveUpdate();
         return;
     }
     else
     {
         for(int i=0; i<m_nRoots; i++)
         {
-            if(pt.distanceToPoint(s_Seed)<0.025/m_fScale)
+            if(std::hypot(x-double(s_Seed.x()), y-double(s_Seed.y()))<seedTolerance())
             {
                 m_iHoveredRoot = 0;
                 m_bResetRoots = true;
@@ -436,10 +705,42 @@ void gl2dFractal::mouseMoveEvent(QMouseEvent *pEvent)
         m_bResetRoots = true;
         update();
     }
+
+    if(isDeepZoom() && (pEvent->buttons() & Qt::LeftButton))
+    {
+        // translate the view in high precision
+        QPoint delta = pEvent->pos() - m_LastPoint;
+        s_DeepX -= BigReal(double(delta.x())*s_DeepPixelSize);
+        s_DeepY += BigReal(double(delta.y())*s_DeepPixelSize);
+        m_LastPoint = pEvent->pos();
+        m_bResetOrbit = true;
+        onProgressiveUpdate();
+        return;
+    }
+
     gl2dView::mouseMoveEvent(pEvent);
 }
 
 
+/** In deep zoom mode, the view is scaled about its center, as in gl2dView, without the dynamic animation */
+void gl2dFractal::wheelEvent(QWheelEvent *pEvent)
+{
+    if(!isDeepZoom())
+    {
+        gl2dView::wheelEvent(pEvent);
+        return;
+    }
+
+    double zoomfactor(1.0);
+    if(pEvent->angleDelta().y()>0) zoomfactor = 1.0/(1.0+DisplayOptions::scaleFactor());
+    else                           zoomfactor = 1.0+DisplayOptions::scaleFactor();
+    s_DeepPixelSize /= zoomfactor;
+    m_bResetDeepImage = true;
+    onProgressiveUpdate();
+    pEvent->accept();
+}
+
+
 void gl2dFractal::mouseReleaseEvent(QMouseEvent *pEvent)
 {
     m_iSelectedRoot = -1;
@@ -467,7 +768,69 @@ void gl2dFractal::onSaveImage()
     if(m_prbJulia->isChecked())
         description += QString::asprintf("Seed = x=%.3f, y=%.3f", s_Seed.x(), s_Seed.y());
 
-    saveImage(filename, description);
+    s_bCpuImage = m_pchCpuImage->isChecked();
+    if(s_bCpuImage || isDeepZoom()) saveCpuImage(filename, description);
+    else            saveImage(filename, description);
+}
+
+
+/**
+ * Renders the image on the CPU with the same framing as gl2dView::saveImage,
+ * i.e. the view is scaled to the image's size and cropped to the image's aspect ratio.
+ */
+void gl2dFractal::saveCpuImage(QString const &filename, QString const &description)
+{
+    QString FileName = imageFileName(filename);
+    if(FileName.isEmpty()) return;
+
+    int iw = m_pieWidth->value();
+    int ih = m_pieHeight->value();
+    if(iw<=0 || ih<=0) return;
+
+    // same viewport ratio as in the OpenGL image
+    float wtratio = float(width())/float(height());
+    float imgratio = float(iw)/float(ih);
+    double w = iw;
+    if(wtratio>imgratio) w = double(width()) * double(ih)/double(height());
+
+    double span = m_rectView.width();
+    double xc = -m_ptOffset.x()/double(width())*span;
+    double yc =  m_ptOffset.y()/double(width())*span;
+    double pixelsize = 2.0/double(m_fScale)/w;
+
+    PerturbationOrbit orbit;
+    if(isDeepZoom())
+    {
+        xc = yc = 0.0; // the reference orbit is centered on the view
+        pixelsize = s_DeepPixelSize*double(width())/w;
+        orbit.compute(s_DeepX, s_DeepY, m_pieMaxIter->value(), m_pdeMaxLength->value());
+        orbit.computeSeries(0.5*pixelsize*sqrt(double(iw)*double(iw)+double(ih)*double(ih)));
+    }
+
+    FractalRenderer renderer;
+    renderer.setJulia(m_prbJulia->isChecked());
+    renderer.setSeed(s_Seed.x(), s_Seed.y());
+    renderer.setMaxIter(m_pieMaxIter->value());
+    renderer.setMaxLength(m_pdeMaxLength->value());
+    renderer.setHue(float(m_pslTau->value())/1000.0f);
+    renderer.setView(xc, yc, pixelsize);
+    if(isDeepZoom()) renderer.setPerturbationOrbit(&orbit);
+
+    QApplication::setOverrideCursor(Qt::WaitCursor);
+    QImage img = renderer.render(iw, ih);
+    QApplication::restoreOverrideCursor();
+
+    if(img.isNull())
+    {
+        m_plabCpuInfo->setText(QString::asprintf("Could not allocate a %dx%d image", iw, ih));
+        return;
+    }
+
+    img.setText(QString("Description"), description);
+    img.save(FileName, "PNG");
+
+    m_plabCpuInfo->setText(QString::asprintf("CPU render: %dx%d in %.3f s, %.2f Mpixels/s",
+                                             iw, ih, renderer.renderTime()/1000.0, renderer.pixelRate()/1.e6));
 }
 
 
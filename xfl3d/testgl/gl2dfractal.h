@@ -8,6 +8,7 @@
 
 #pragma once
 
+#include <QImage>
 #include <QOpenGLShaderProgram>
 #include <QRadioButton>
 #include <QCheckBox>
@@ -15,6 +16,8 @@
 #include <QSettings>
 
 #include <xfl3d/views/gl2dview.h>
+#include <xfl3d/testgl/perturbationorbit.h>
+#include <xflmath/bigreal.h>
 
 #include <QLabel>
 
@@ -32,32 +35,51 @@ class gl2dFractal : public gl2dView
 
         void initializeGL() override;
         void glRenderView() override;
+        void glRenderImage() override;
+        bool useTileCache() const override {return m_bTileCache && !isDeepZoom() && m_iSelectedRoot<0;}
+        QByteArray tileParameters() const override;
         void glMake2dObjects() override {}
 
         void mousePressEvent(QMouseEvent *pEvent) override;
         void mouseMoveEvent(QMouseEvent *pEvent) override;
         void mouseReleaseEvent(QMouseEvent *pEvent) override;
+        void wheelEvent(QWheelEvent *pEvent) override;
+
+        void paintOverlay() override;
 
         static void loadSettings(QSettings &settings);
         static void saveSettings(QSettings &settings);
 
     private slots:
         void onMode();
+        void onDeepZoom();
         void onSaveImage() override;
 
     private:
+        void saveCpuImage(QString const &filename, QString const &description);
+
+        bool isDeepZoom() const {return m_pchDeepZoom->isChecked() && m_prbMandelbrot->isChecked();}
+        void renderDeepZoom();
+        void setDeepZoomFromView();
+        void setViewFromDeepZoom();
+        void screenToFractal(QPoint const &point, double &x, double &y) const;
+        double seedTolerance() const;
+
         QRadioButton *m_prbMandelbrot, *m_prbJulia;
         IntEdit *m_pieMaxIter;
         FloatEdit *m_pdeMaxLength;
         QLabel *m_plabScale;
         QCheckBox *m_pchShowSeed;
+        QCheckBox *m_pchCpuImage;
+        QCheckBox *m_pchDeepZoom;
+        QLabel *m_plabCpuInfo;
         QSlider *m_pslTau;
 
 
         QOpenGLBuffer m_vboRoots;
         QOpenGLBuffer m_vboSegs;
 
-        QOpenGLShaderProgram m_shadFrac;
+        QOpenGLShaderProgram &m_shadFrac;
         // shader uniforms
         int m_locJulia;
         int m_locParam;
@@ -65,6 +87,24 @@ class gl2dFractal : public gl2dView
         int m_locHue;
         int m_locLength;
 
+        QOpenGLShaderProgram &m_shadDeep;
+        // deep zoom shader uniforms
+        int m_locDeepIters;
+        int m_locDeepHue;
+        int m_locDeepLength;
+        int m_locDeepSkip;
+        int m_locDeepRefLength;
+        int m_locDeepViewport;
+        bool m_bDeepShader;    /**< true if the context supports the deep zoom shader, i.e. OpenGL 4.3 */
+        QOpenGLBuffer m_ssboOrbit;
+
+        PerturbationOrbit m_Orbit;
+        bool m_bResetOrbit;
+        bool m_bResetOrbitBuffer;  /**< true if the orbit or its series have changed since they were uploaded to m_ssboOrbit */
+        double m_OrbitPixelSize;   /**< the pixel size for which the series has been computed */
+        bool m_bResetDeepImage;
+        QImage m_imgDeep;      /**< the CPU image displayed if the deep zoom shader is not available */
+
         bool m_bResetRoots;
         int m_iHoveredRoot;
         int m_iSelectedRoot;
@@ -74,4 +114,9 @@ class gl2dFractal : public gl2dView
         static int s_MaxIter;
         static float s_MaxLength;
         static QVector2D s_Seed;
+        static bool s_bCpuImage;
+
+        static bool s_bDeepZoom;
+        static BigReal s_DeepX, s_DeepY;  /**< the high precision center of the deep zoom view */
+        static double s_DeepPixelSize;    /**< the world size of a pixel in the deep zoom view */
 };
@@ -7,6 +7,7 @@
 *****************************************************************************/
 
 #include <QApplication>
+#include <QDataStream>
 #include <QRandomGenerator>
 #include <QGridLayout>
 #include <QFormLayout>
@@ -19,6 +20,7 @@
 #include <xflcore/displayoptions.h>
 #include <xflcore/trace.h>
 #include <xfl3d/views/gl3dview.h> // for the static variables
+#include <xfl3d/views/shaderregistry.h>
 #include <xflwidgets/customwts/intedit.h>
 #include <xflwidgets/customwts/floatedit.h>
 #include <xflwidgets/wt_globals.h>
@@ -29,7 +31,8 @@ float gl2dNewton::s_Tolerance = 1.e-6f;
 QColor gl2dNewton::s_Colors[5] = {QColor(77,27,21), QColor(75,111,117), QColor(11,47,77), QColor(77,77,77), QColor(131,120,107)};
 
 
-gl2dNewton::gl2dNewton(QWidget *pParent) : gl2dView(pParent)
+gl2dNewton::gl2dNewton(QWidget *pParent) : gl2dView(pParent),
+    m_shadNewton(ShaderRegistry::program("newton"))
 {
     setWindowTitle("Newton fractal");
 //    setMouseTracking(true);
@@ -37,6 +40,8 @@ gl2dNewton::gl2dNewton(QWidget *pParent) : gl2dView(pParent)
     m_rectView = QRectF(-1.0, -1.0, 2.0, 2.0);
 
     m_bAxes = false;
+    m_bProgressive = true;
+    m_bTileCache = true;
 
     m_bResetRoots = true;
 
@@ -167,24 +172,8 @@ void gl2dNewton::initializeGL()
 {
     gl2dView::initializeGL();
 
-    QString strange, vsrc, gsrc, fsrc;
-    vsrc = ":/shaders/shaders2d/fractal_VS.glsl";
-    m_shadNewton.addShaderFromSourceFile(QOpenGLShader::Vertex, vsrc);
-    if(m_shadNewton.log().length())
-    {
-        strange = QString::asprintf("%s", QString("Newton vertex shader log:"+m_shadNewton.log()).toStdString().c_str());
-        trace(strange);
-    }
-
-    fsrc = ":/shaders/shaders2d/newton_FS.glsl";
-    m_shadNewton.addShaderFromSourceFile(QOpenGLShader::Fragment, fsrc);
-    if(m_shadNewton.log().length())
-    {
-        strange = QString::asprintf("%s", QString("Newton fragment shader log:"+m_shadNewton.log()).toStdString().c_str());
-        trace(strange);
-    }
-
-    m_shadNewton.link();
+    ShaderRegistry::build(m_shadNewton, "Newton", {{QOpenGLShader::Vertex,   ":/shaders/shaders2d/fractal_VS.glsl"},
+                                                   {QOpenGLShader::Fragment, ":/shaders/shaders2d/newton_FS.glsl"}});
 
     m_shadNewton.bind();
     {
@@ -247,10 +236,9 @@ void gl2dNewton::initializeGL()
 }
 
 
-void gl2dNewton::glRenderView()
+/** Renders the fractal only; the VAO is bound by the caller */
+void gl2dNewton::glRenderImage()
 {
-    QOpenGLVertexArrayObject::Binder vaoBinder(&m_vao);
-
     float w_ = float(width());
     float h_ = float(height());
     float ratio = w_/h_;
@@ -293,6 +281,26 @@ void gl2dNewton::glRenderView()
         m_vboQuad.release();
     }
     m_shadNewton.release();
+}
+
+
+/** The values which define the image, used to identify the cached tiles */
+QByteArray gl2dNewton::tileParameters() const
+{
+    QByteArray params;
+    QDataStream ds(&params, QIODevice::WriteOnly);
+    int nroots = m_prb3roots->isChecked() ? 3 : 5;
+    ds << m_pieMaxIter->value() << m_pfeTolerance->value() << nroots;
+    for(int i=0; i<nroots; i++) ds << m_Root[i] << s_Colors[i];
+    return params;
+}
+
+
+void gl2dNewton::glRenderView()
+{
+    QOpenGLVertexArrayObject::Binder vaoBinder(&m_vao);
+
+    if(!m_bImageFromTiles) glRenderImage();
 
     if(m_pchShowRoots->isChecked())
     {
@@ -442,7 +450,7 @@ void gl2dNewton::mouseMoveEvent(QMouseEvent *pEvent)
         }
         m_Time = 0;
         m_bResetRoots = true;
-        update();
+        onProgressiveUpdate();
         return;
     }
     else
@@ -501,7 +509,7 @@ void gl2dNewton::onMoveRoots()
     m_Time++;
 
     m_bResetRoots = true;
-    update();
+    onProgressiveUpdate();
 }
 
 
@@ -36,6 +36,9 @@ class gl2dNewton : public gl2dView
         QPointF defaultOffset() override {return QPointF(0.0f,0.0f);}
         void initializeGL() override;
         void glRenderView() override;
+        void glRenderImage() override;
+        bool useTileCache() const override {return m_bTileCache && !m_Timer.isActive() && m_iSelectedRoot<0;}
+        QByteArray tileParameters() const override;
         void mousePressEvent(QMouseEvent *pEvent) override;
         void mouseMoveEvent(QMouseEvent *pEvent) override;
         void mouseReleaseEvent(QMouseEvent *pEvent) override;
@@ -47,7 +50,7 @@ class gl2dNewton : public gl2dView
         void onSaveImage() override;
 
     private:
-        QOpenGLShaderProgram m_shadNewton;
+        QOpenGLShaderProgram &m_shadNewton;
         // shader uniforms
         int m_locIters;
         int m_locTolerance;
@@ -13,11 +13,14 @@
 #include <QGroupBox>
 
 #include "gl2dquat.h"
+#include "gl2drm.h"
+#include "quatraymarcher.h"
 
 #include <xflcore/xflcore.h>
 #include <xflcore/displayoptions.h>
 #include <xflcore/trace.h>
 #include <xfl3d/views/gl3dview.h> // for the static variables
+#include <xfl3d/views/shaderregistry.h>
 #include <xflwidgets/customwts/intedit.h>
 #include <xflwidgets/customwts/floatedit.h>
 #include <xflwidgets/wt_globals.h>
@@ -28,8 +31,10 @@ int gl2dQuat::s_iSlice(0);
 float gl2dQuat::s_MaxLength(10.0f);
 QVector2D gl2dQuat::s_Slicer(0.0f, 0.0f);
 QVector4D gl2dQuat::s_Seed(0.0f, 0.0f, 0.0f, 0.0f);
+bool gl2dQuat::s_bRayMarch(false);
 
-gl2dQuat::gl2dQuat(QWidget *pParent) : gl2dView(pParent)
+gl2dQuat::gl2dQuat(QWidget *pParent) : gl2dView(pParent),
+    m_shadQuat(ShaderRegistry::program("quat"))
 {
     setWindowTitle("Quat Julia");
     setMouseTracking(false);
@@ -37,6 +42,7 @@ gl2dQuat::gl2dQuat(QWidget *pParent) : gl2dView(pParent)
     m_fScale = 0.5f;
 
     m_bAxes = false;
+    m_bProgressive = true;
 
     m_locJulia = m_locSeed = m_locSlicer = m_locSlice = -1;
     m_locIters = m_locLength = -1;
@@ -75,7 +81,7 @@ gl2dQuat::gl2dQuat(QWidget *pParent) : gl2dView(pParent)
                         m_pslSeed[i]->setTickInterval(50);
                         m_pslSeed[i]->setTickPosition(QSlider::TicksBelow);
                         m_pslSeed[i]->setValue(int((s_Seed[i]+1.0)*500.0f));
-                        connect(m_pslSeed[i], SIGNAL(sliderMoved(int)), SLOT(update()));
+                        connect(m_pslSeed[i], SIGNAL(sliderMoved(int)), SLOT(onProgressiveUpdate()));
                         pParamsLayout->addWidget(m_pslSeed[i], i+1, 2);
                     }
 
@@ -87,8 +93,8 @@ gl2dQuat::gl2dQuat(QWidget *pParent) : gl2dView(pParent)
                     m_pfeMaxLength = new FloatEdit(s_MaxLength);
                     m_pfeMaxLength->setToolTip("<P>The escape amplitude of z.</p>");
 
-                    connect(m_pieMaxIter,   SIGNAL(intChanged(int)),     this, SLOT(update()));
-                    connect(m_pfeMaxLength, SIGNAL(floatChanged(float)), this, SLOT(update()));
+                    connect(m_pieMaxIter,   SIGNAL(intChanged(int)),     this, SLOT(onProgressiveUpdate()));
+                    connect(m_pfeMaxLength, SIGNAL(floatChanged(float)), this, SLOT(onProgressiveUpdate()));
 
                     pParamsLayout->addWidget(plabMaxIter,    6, 1);
                     pParamsLayout->addWidget(m_pieMaxIter,   6, 2);
@@ -131,7 +137,7 @@ gl2dQuat::gl2dQuat(QWidget *pParent) : gl2dView(pParent)
                         m_pslSlice[i] ->setTickInterval(50);
                         m_pslSlice[i] ->setTickPosition(QSlider::TicksBelow);
                         m_pslSlice[i] ->setValue(int((s_Slicer[i]+1.0)*500.0f));
-                        connect(m_pslSlice[i] , SIGNAL(sliderMoved(int)), SLOT(update()));
+                        connect(m_pslSlice[i] , SIGNAL(sliderMoved(int)), SLOT(onProgressiveUpdate()));
                         pSliceLayout->addWidget(m_plabSlice[i],  i+5, 1);
                         pSliceLayout->addWidget(m_pslSlice[i],   i+5, 2,1,2);
                     }
@@ -156,7 +162,7 @@ gl2dQuat::gl2dQuat(QWidget *pParent) : gl2dView(pParent)
                         m_pslTau->setTickInterval(50);
                         m_pslTau->setTickPosition(QSlider::TicksBelow);
                         m_pslTau->setValue(s_Hue);
-                        connect(m_pslTau, SIGNAL(sliderMoved(int)), SLOT(update()));
+                        connect(m_pslTau, SIGNAL(sliderMoved(int)), SLOT(onProgressiveUpdate()));
 
                         pDisplayLayout->addWidget(plabHue,         7, 1);
                         pDisplayLayout->addWidget(m_pslTau,        7, 2);
@@ -176,6 +182,19 @@ gl2dQuat::gl2dQuat(QWidget *pParent) : gl2dView(pParent)
                         pImageLayout->addWidget(plabPixel,    1, 5);
 
                         pImageLayout->addWidget(m_ppbSaveImg, 2, 1, 1, 5);
+
+                        m_pchRayMarch = new QCheckBox("Ray-march a 3d section on the CPU");
+                        m_pchRayMarch->setToolTip("<p>Saves the 3d section of the Julia set ray-marched on the CPU, "
+                                                  "in place of the 2d slice rendered by the GPU. "
+                                                  "The third axis is the component set by the first slicer, "
+                                                  "and the camera is the one of the ray marching view.</p>");
+                        m_pchRayMarch->setChecked(s_bRayMarch);
+
+                        m_plabRayMarchInfo = new QLabel();
+                        m_plabRayMarchInfo->setFont(DisplayOptions::textFont());
+
+                        pImageLayout->addWidget(m_pchRayMarch,      3, 1, 1, 5);
+                        pImageLayout->addWidget(m_plabRayMarchInfo, 4, 1, 1, 5);
                     }
                     pOutputLayout->addLayout(pDisplayLayout);
                     pOutputLayout->addLayout(pImageLayout);
@@ -218,6 +237,7 @@ void gl2dQuat::loadSettings(QSettings &settings)
         s_MaxIter    = settings.value("MaxIters",   s_MaxIter).toInt();
         s_MaxLength  = settings.value("MaxLength",  s_MaxLength).toFloat();
         s_Seed       = settings.value("Seed",       s_Seed).value<QVector4D>();
+        s_bRayMarch  = settings.value("RayMarch",   s_bRayMarch).toBool();
     }
     settings.endGroup();
 }
@@ -233,6 +253,7 @@ void gl2dQuat::saveSettings(QSettings &settings)
         settings.setValue("MaxIters",   s_MaxIter);
         settings.setValue("MaxLength",  s_MaxLength);
         settings.setValue("Seed",       s_Seed);
+        settings.setValue("RayMarch",   s_bRayMarch);
     }
     settings.endGroup();
 }
@@ -240,24 +261,8 @@ void gl2dQuat::saveSettings(QSettings &settings)
 
 void gl2dQuat::initializeGL()
 {
-    QString strange, vsrc, fsrc;
-    vsrc = ":/shaders/shaders2d/fractal_VS.glsl";
-    m_shadQuat.addShaderFromSourceFile(QOpenGLShader::Vertex, vsrc);
-    if(m_shadQuat.log().length())
-    {
-        strange = QString::asprintf("%s", QString("Frac. vertex shader log:"+m_shadQuat.log()).toStdString().c_str());
-        trace(strange);
-    }
-
-    fsrc = ":/shaders/shaders2d/quat_FS.glsl";
-    m_shadQuat.addShaderFromSourceFile(QOpenGLShader::Fragment, fsrc);
-    if(m_shadQuat.log().length())
-    {
-        strange = QString::asprintf("%s", QString("Quat. fragment shader log:"+m_shadQuat.log()).toStdString().c_str());
-        trace(strange);
-    }
-
-    m_shadQuat.link();
+    ShaderRegistry::build(m_shadQuat, "Quat.", {{QOpenGLShader::Vertex,   ":/shaders/shaders2d/fractal_VS.glsl"},
+                                                {QOpenGLShader::Fragment, ":/shaders/shaders2d/quat_FS.glsl"}});
     m_shadQuat.bind();
     {
         m_attrVertexPosition = m_shadQuat.attributeLocation("VertexPosition");
@@ -429,7 +434,7 @@ void gl2dQuat::onSlice()
     }
     m_plabSlice[0]->setText(str0);
     m_plabSlice[1]->setText(str1);
-    update();
+    onProgressiveUpdate();
 }
 
 
@@ -462,7 +467,57 @@ void gl2dQuat::onSaveImage()
         case 6:
             break;
     }
-    saveImage(filename, description);
+
+    s_bRayMarch = m_pchRayMarch->isChecked();
+    if(s_bRayMarch) saveRayMarchedImage(filename, description);
+    else            saveImage(filename, description);
+}
+
+
+/** Sets the parameters of the CPU ray-marcher from the current settings of this view and of the ray marching view */
+void gl2dQuat::setRayMarcher(QuatRayMarcher &marcher)
+{
+    marcher.setSeed(s_Seed.x(), s_Seed.y(), s_Seed.z(), s_Seed.w());
+    marcher.setSlice(s_iSlice, s_Slicer.x(), s_Slicer.y());
+    marcher.setMaxIter(s_MaxIter);
+    marcher.setMaxLength(s_MaxLength);
+    marcher.setHue(float(s_Hue)/1000.0f);
+
+    QVector3D const &eye   = gl2dRM::eyePosition();
+    QVector3D const &light = gl2dRM::lightPosition();
+    marcher.setEye(eye.x(), eye.y(), eye.z());
+    marcher.setLight(light.x(), light.y(), light.z());
+}
+
+
+void gl2dQuat::saveRayMarchedImage(QString const &filename, QString const &description)
+{
+    QString FileName = imageFileName(filename);
+    if(FileName.isEmpty()) return;
+
+    int iw = m_pieWidth->value();
+    int ih = m_pieHeight->value();
+    if(iw<=0 || ih<=0) return;
+
+    QuatRayMarcher marcher;
+    setRayMarcher(marcher);
+    marcher.fitView(iw, ih);
+
+    QApplication::setOverrideCursor(Qt::WaitCursor);
+    QImage img = marcher.render(iw, ih);
+    QApplication::restoreOverrideCursor();
+
+    if(img.isNull())
+    {
+        m_plabRayMarchInfo->setText(QString::asprintf("Could not allocate a %dx%d image", iw, ih));
+        return;
+    }
+
+    img.setText(QString("Description"), description);
+    img.save(FileName, "PNG");
+
+    m_plabRayMarchInfo->setText(QString::asprintf("Ray-marched %dx%d in %.3f s, %.1f ms/Mpixel, %.1f steps/pixel",
+                                                  iw, ih, marcher.renderTime()/1000.0, marcher.msPerMegaPixel(), marcher.stepsPerPixel()));
 }
 
 
@@ -21,6 +21,7 @@
 
 class IntEdit;
 class FloatEdit;
+class QuatRayMarcher;
 
 class gl2dQuat : public gl2dView
 {
@@ -38,11 +39,15 @@ class gl2dQuat : public gl2dView
         static void loadSettings(QSettings &settings);
         static void saveSettings(QSettings &settings);
 
+        static void setRayMarcher(QuatRayMarcher &marcher);
+
     private slots:
         void onSlice();
         void onSaveImage() override;
 
     private:
+        void saveRayMarchedImage(QString const &filename, QString const &description);
+
         IntEdit *m_pieMaxIter;
         FloatEdit *m_pfeMaxLength;
         QLabel *m_plabScale;
@@ -54,7 +59,10 @@ class gl2dQuat : public gl2dView
 
         QRadioButton *m_prbSlice[6];
 
-        QOpenGLShaderProgram m_shadQuat;
+        QCheckBox *m_pchRayMarch;
+        QLabel *m_plabRayMarchInfo;
+
+        QOpenGLShaderProgram &m_shadQuat;
         // shader uniforms
         int m_locJulia;
         int m_locSeed;
@@ -72,4 +80,5 @@ class gl2dQuat : public gl2dView
         static float s_MaxLength;
         static QVector4D s_Seed;
         static QVector2D s_Slicer;
+        static bool s_bRayMarch;
 };
@@ -17,6 +17,7 @@
 #include <xflcore/trace.h>
 #include <xfl3d/globals/gl_globals.h>
 #include <xfl3d/views/gl3dview.h> // for the static variables
+#include <xfl3d/views/shaderregistry.h>
 #include <xflwidgets/customwts/intedit.h>
 #include <xflwidgets/customwts/exponentialslider.h>
 #include <xflwidgets/wt_globals.h>
@@ -27,7 +28,8 @@ QVector3D gl2dRM::s_LightPos(2.5f,2.5f,5.0f);
 QVector3D gl2dRM::s_EyePos(0.0f,0.0f,-10.0f);
 
 
-gl2dRM::gl2dRM(QWidget *pParent) : gl2dView(pParent)
+gl2dRM::gl2dRM(QWidget *pParent) : gl2dView(pParent),
+    m_shadRM(ShaderRegistry::program("raymarching"))
 {
     setWindowTitle("Ray marching");
     setFocusPolicy(Qt::WheelFocus);
@@ -194,24 +196,8 @@ void gl2dRM::onParamChanged()
 
 void gl2dRM::initializeGL()
 {
-    QString strange, vsrc, fsrc;
-    vsrc = ":/shaders/raymarching/raymarching_VS.glsl";
-    m_shadRM.addShaderFromSourceFile(QOpenGLShader::Vertex, vsrc);
-    if(m_shadRM.log().length())
-    {
-        strange = QString::asprintf("%s", QString("raymarching vertex shader log:"+m_shadRM.log()).toStdString().c_str());
-        trace(strange);
-    }
-
-    fsrc = ":/shaders/raymarching/raymarching_FS.glsl";
-    m_shadRM.addShaderFromSourceFile(QOpenGLShader::Fragment, fsrc);
-    if(m_shadRM.log().length())
-    {
-        strange = QString::asprintf("%s", QString("raymarching fragment shader log:"+m_shadRM.log()).toStdString().c_str());
-        trace(strange);
-    }
-
-    m_shadRM.link();
+    ShaderRegistry::build(m_shadRM, "raymarching", {{QOpenGLShader::Vertex,   ":/shaders/raymarching/raymarching_VS.glsl"},
+                                                    {QOpenGLShader::Fragment, ":/shaders/raymarching/raymarching_FS.glsl"}});
     m_shadRM.bind();
     {
         m_attrXY       = m_shadRM.attributeLocation("vertexXY");
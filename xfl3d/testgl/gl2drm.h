@@ -30,11 +30,14 @@ class gl2dRM : public gl2dView
         static void loadSettings(QSettings &settings);
         static void saveSettings(QSettings &settings);
 
+        static QVector3D const &eyePosition() {return s_EyePos;}
+        static QVector3D const &lightPosition() {return s_LightPos;}
+
     private slots:
         void onParamChanged();
 
     private:
-        QOpenGLShaderProgram m_shadRM;
+        QOpenGLShaderProgram &m_shadRM;
 
         // shader uniforms
         int m_locViewTrans;
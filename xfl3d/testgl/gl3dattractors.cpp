@@ -13,6 +13,7 @@
 #include "gl3dattractors.h"
 #include <xfl3d/controls/w3dprefs.h>
 #include <xfl3d/globals/gl_globals.h>
+#include <xfl3d/globals/vertexwriter.h>
 #include <xflcore/displayoptions.h>
 #include <xflcore/xflcore.h>
 #include <xflwidgets/customwts/intedit.h>
@@ -235,7 +236,7 @@ void gl3dAttractors::glMake3dObjects()
         int buffersize =  s_NTrace
                          *(s_TailSize-1)  // NSegments
                          *2*(4+4);     // 2 vertices * (4 coordinates+ 4 color components)
-        QVector<float> buffer(buffersize);
+        VertexWriter buffer(m_vboTrace, buffersize);
 
         int ip0(0), ip1(0);
 
@@ -290,32 +291,23 @@ void gl3dAttractors::glMake3dObjects()
         }
 
         Q_ASSERT(iv==buffersize);
-
-        if(m_vboTrace.isCreated()) m_vboTrace.destroy();
-        m_vboTrace.create();
-        m_vboTrace.bind();
-        m_vboTrace.allocate(buffer.data(), buffersize * int(sizeof(GLfloat)));
-        m_vboTrace.release();
+        buffer.close();
 
         // leading points
         buffersize =  s_NTrace * 4;
-        buffer.resize(buffersize);
+        VertexWriter points(m_vboPoints, buffersize);
         iv = 0;
         for(int i=0; i<m_Trace.size(); i++)
         {
             QVector<double> const &velocity = m_Velocity.at(i);
-            buffer[iv++] = m_Trace.at(i).at(m_iLead).xf();
-            buffer[iv++] = m_Trace.at(i).at(m_iLead).yf();
-            buffer[iv++] = m_Trace.at(i).at(m_iLead).zf();
+            points[iv++] = m_Trace.at(i).at(m_iLead).xf();
+            points[iv++] = m_Trace.at(i).at(m_iLead).yf();
+            points[iv++] = m_Trace.at(i).at(m_iLead).zf();
 
-            if(s_bDynColor)      buffer[iv++] = velocity.at(m_iLead)/m_MaxVelocity;
-            else                 buffer[iv++] = -1.0f;
+            if(s_bDynColor)      points[iv++] = velocity.at(m_iLead)/m_MaxVelocity;
+            else                 points[iv++] = -1.0f;
         }
-        if(m_vboPoints.isCreated()) m_vboPoints.destroy();
-        m_vboPoints.create();
-        m_vboPoints.bind();
-        m_vboPoints.allocate(buffer.data(), buffersize * int(sizeof(GLfloat)));
-        m_vboPoints.release();
+        points.close();
 
         m_bResetAttractor = false;
     }
@@ -19,6 +19,7 @@
 #include "gl3dboids.h"
 
 #include <xfl3d/globals/gl_globals.h>
+#include <xfl3d/globals/vertexwriter.h>
 #include <xfl3d/controls/w3dprefs.h>
 #include <xflwidgets/customwts/floatedit.h>
 #include <xflwidgets/customwts/intedit.h>
@@ -228,7 +229,7 @@ void gl3dBoids::glMake3dObjects()
     }
     if(m_bResetInstances)
     {
-        QVector<float>PositionArray(m_Boids.size() *3);//3 vertices for each galaxy
+        VertexWriter PositionArray(m_vboInstPositions, m_Boids.size() *3);//3 vertices for each galaxy
         int iv=0;
         for(int i=0; i<m_Boids.size(); i++)
         {
@@ -237,13 +238,7 @@ void gl3dBoids::glMake3dObjects()
             PositionArray[iv++] = m_Boids.at(i).m_Position.zf();
         }
 
-        if(m_vboInstPositions.isCreated()) m_vboInstPositions.destroy();
-        m_vboInstPositions.create();
-        m_vboInstPositions.bind();
-        {
-            m_vboInstPositions.allocate(PositionArray.data(), int(PositionArray.size()) * sizeof(GLfloat));
-        }
-        m_vboInstPositions.release();
+        PositionArray.close();
 
         m_bResetInstances = false;
     }
@@ -23,6 +23,7 @@
 #include <xflcore/trace.h>
 #include <xfl3d/globals/gl_globals.h>
 #include <xfl3d/controls/w3dprefs.h>
+#include <xfl3d/views/shaderregistry.h>
 #include <xflwidgets/customwts/floatedit.h>
 #include <xflwidgets/customwts/intedit.h>
 #include <xflwidgets/wt_globals.h>
@@ -36,7 +37,8 @@ float gl3dBoids2::s_Predator   = 1.0f;
 float gl3dBoids2::s_Ratio      = 0.15f;
 
 
-gl3dBoids2::gl3dBoids2(QWidget *pParent) : gl3dTestGLView(pParent)
+gl3dBoids2::gl3dBoids2(QWidget *pParent) : gl3dTestGLView(pParent),
+    m_shadBoids(ShaderRegistry::program("boids2_compute"))
 {
     setWindowTitle("Boids (GPU)");
 
@@ -344,20 +346,7 @@ void gl3dBoids2::initializeGL()
 {
     gl3dTestGLView::initializeGL();
 #ifndef Q_OS_MAC
-    QString csrc, strange;
-
-    csrc = ":/shaders/boids2/boids2_CS.glsl";
-    m_shadBoids.addShaderFromSourceFile(QOpenGLShader::Compute, csrc);
-    if(m_shadBoids.log().length())
-    {
-        strange = QString::asprintf("%s", QString("Compute shader log:"+m_shadBoids.log()).toStdString().c_str());
-        trace(strange);
-    }
-
-    if(!m_shadBoids.link())
-    {
-        trace("Compute shader is not linked");
-    }
+    ShaderRegistry::build(m_shadBoids, "Boids compute", {{QOpenGLShader::Compute, ":/shaders/boids2/boids2_CS.glsl"}});
     m_shadBoids.bind();
     {
         m_locCube        = m_shadBoids.uniformLocation("cube");
@@ -47,7 +47,7 @@ class gl3dBoids2 : public gl3dTestGLView
         void onSwarmReset();
 
     private:
-        QOpenGLShaderProgram m_shadBoids;
+        QOpenGLShaderProgram &m_shadBoids;
 
         int m_locCube;
         int m_locWidth;
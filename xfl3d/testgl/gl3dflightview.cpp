@@ -17,6 +17,7 @@
 #include <xfl3d/controls/w3dprefs.h>
 #include <xfl3d/controls/gllightdlg.h>
 #include <xfl3d/globals/gl_globals.h>
+#include <xfl3d/globals/vertexwriter.h>
 #include <xflgeom/geom_globals/geom_global.h>
 #include <xflcore/displayoptions.h>
 #include <xflcore/stlreaderdlg.h>
@@ -92,7 +93,8 @@ gl3dFlightView::gl3dFlightView(QWidget *pParent) : gl3dTestGLView(pParent)
     }
 
     StlReaderDlg dlg(this);
-    dlg.importTrianglesFromStlFile(":/textfiles/stl_mesh.stl", 0.001, m_Triangles);
+    dlg.importMeshFromStlFile(":/textfiles/stl_mesh.stl", 0.001, m_StlMesh);
+    m_StlLod.setMesh(m_StlMesh, 2000);
 
     setReferenceLength(SIDE);
     reset3dScale();
@@ -265,7 +267,7 @@ void gl3dFlightView::glMake3dObjects()
     {
         int buffersize = (s_MaxPts-1)  // NSegments
                          *2*(4+4);     // 2 vertices * (4 coordinates+ 4 color components)
-        QVector<float> buffer(buffersize);
+        VertexWriter buffer(m_vboTrace, buffersize);
 
         int ip0(0), ip1(0);
 
@@ -297,22 +299,17 @@ void gl3dFlightView::glMake3dObjects()
         }
 
         Q_ASSERT(iv==buffersize);
-
-        if(m_vboTrace.isCreated()) m_vboTrace.destroy();
-        m_vboTrace.create();
-        m_vboTrace.bind();
-        m_vboTrace.allocate(buffer.data(), buffersize * int(sizeof(GLfloat)));
-
-        m_vboTrace.release();
+        buffer.close();
 
         m_bResetTrace = false;
     }
 
 
+    if(m_StlLod.updateLevels()) m_bResetObject = true; // the decimated levels are ready
+
     if(m_bResetObject)
     {
-        gl::makeTriangles3Vtx(m_Triangles, true, m_vboStlTriangulation);
-        gl::makeTrianglesOutline(m_Triangles, Vector3d(), m_vboStlOutline);
+        m_StlLod.makeBuffers(Vector3d(), 30.0); // smooth the faces less than 30 degrees apart
 
         gl::makeQuadTex(SIDE, SIDE, m_vboBackgroundQuad);
 
@@ -331,6 +328,29 @@ void gl3dFlightView::glMake3dObjects()
 }
 
 
+/**
+ * Picks the STL model. Its triangles are defined in the plane's frame, so the ray is moved to this frame
+ * rather than refitting the hierarchy each time the plane moves.
+ */
+bool gl3dFlightView::intersectTheObject(Vector3d const &AA, Vector3d const &BB, Vector3d &I)
+{
+    bool bInvertible = false;
+    QMatrix4x4 matInv = m_matPlane.inverted(&bInvertible);
+    if(!bInvertible) return false;
+
+    QVector3D A = matInv.map(QVector3D(AA.xf(), AA.yf(), AA.zf()));
+    QVector3D B = matInv.map(QVector3D(BB.xf(), BB.yf(), BB.zf()));
+    Vector3d IPlane, N;
+    if(!m_StlMesh.intersect(Vector3d(double(A.x()), double(A.y()), double(A.z())),
+                            Vector3d(double(B.x()), double(B.y()), double(B.z())), IPlane, N))
+        return false;
+
+    QVector3D IWorld = m_matPlane.map(QVector3D(IPlane.xf(), IPlane.yf(), IPlane.zf()));
+    I.set(double(IWorld.x()), double(IWorld.y()), double(IWorld.z()));
+    return true;
+}
+
+
 void gl3dFlightView::glRenderView()
 {
     updateLightMatrix();
@@ -366,7 +386,7 @@ void gl3dFlightView::glRenderView()
         m_shadLine.setUniformValue(m_locLine.m_pvmMatrix, m_matProj*m_matView*m_matModel*m_matPlane);
     }
     m_shadLine.release();
-    paintSegments(m_vboStlOutline, W3dPrefs::s_OutlineStyle);
+    paintSegments(m_StlLod.vboOutline(meshLodLevel(m_StlLod, m_matPlane)), W3dPrefs::s_OutlineStyle);
 
     if (!m_bInitialized)
     {
@@ -390,7 +410,8 @@ void gl3dFlightView::renderToShadowMap()
 
     QMatrix4x4 identity;
     paintTrianglesToDepthMap(m_vboBackgroundQuad,   identity, 8);
-    paintTrianglesToDepthMap(m_vboStlTriangulation, m_matPlane, 6);
+    int iLevel = meshLodLevel(m_StlLod, m_matPlane);
+    paintTrianglesToDepthMap(m_StlLod.vbo(iLevel), m_matPlane, 6, &m_StlLod.ibo(iLevel));
 //    paintTrianglesToDepthMap(m_vboCube, identity, 6);
 
     glBindFramebuffer(GL_FRAMEBUFFER, 0);
@@ -434,5 +455,6 @@ void gl3dFlightView::renderToScreen()
     }
     m_shadSurf.release();
 //    paintTriangles3VtxShadow(m_vboCube, Qt::cyan,  false, true, identity, 6);
-    paintTriangles3VtxShadow(m_vboStlTriangulation, Qt::darkCyan, false, s_Light.m_bIsLightOn, m_matPlane, 6);
+    int iLevel = meshLodLevel(m_StlLod, m_matPlane);
+    paintTriangles3VtxShadow(m_StlLod.vbo(iLevel), Qt::darkCyan, false, s_Light.m_bIsLightOn, m_matPlane, 6, &m_StlLod.ibo(iLevel));
 }
@@ -14,6 +14,7 @@
 #include <xfl3d/testgl/gl3dtestglview.h>
 #include <xflgeom/geom3d/vector3d.h>
 #include <xflgeom/geom3d/triangle3d.h>
+#include <xflgeom/geom3d/trimesh.h>
 
 class PlaneSTL;
 class Triangle3d;
@@ -34,6 +35,7 @@ class gl3dFlightView : public gl3dTestGLView
 
     private:
         void glMake3dObjects() override;
+        bool intersectTheObject(Vector3d const &AA, Vector3d const &BB, Vector3d &I) override;
         void keyPressEvent(QKeyEvent *pEvent) override;
 
         void restartTimer();
@@ -55,13 +57,12 @@ class gl3dFlightView : public gl3dTestGLView
         bool m_bResetObject;
         bool m_bResetTrace;
 
-        QVector<Triangle3d> m_Triangles;
+        TriMesh m_StlMesh;
 
         QOpenGLBuffer m_vboBackgroundQuad;
 
 
-        QOpenGLBuffer m_vboStlTriangulation;
-        QOpenGLBuffer m_vboStlOutline;
+        MeshLod m_StlLod;
 
         QTimer m_Timer;
 
@@ -26,6 +26,7 @@
 #include <xflcore/trace.h>
 #include <xfl3d/globals/gl_globals.h>
 #include <xfl3d/controls/w3dprefs.h>
+#include <xfl3d/views/shaderregistry.h>
 
 #define GROUP_SIZE 64
 #define REFLENGTH 1.0f
@@ -35,7 +36,8 @@ float gl3dFlowVtx::s_dt(0.001f);
 float gl3dFlowVtx::s_VInf(10.0f);
 float gl3dFlowVtx::s_Gamma(1.0f);
 
-gl3dFlowVtx::gl3dFlowVtx(QWidget *pParent) : gl3dTestGLView(pParent)
+gl3dFlowVtx::gl3dFlowVtx(QWidget *pParent) : gl3dTestGLView(pParent),
+    m_shadCompute(ShaderRegistry::program("flowvtx_compute"))
 {
     setWindowTitle("Flow");
 
@@ -253,20 +255,7 @@ void gl3dFlowVtx::onRestart()
 void gl3dFlowVtx::initializeGL()
 {
     gl3dTestGLView::initializeGL();
-    QString csrc, strange;
-
-    csrc = ":/shaders/flow/flowVtx_CS.glsl";
-    m_shadCompute.addShaderFromSourceFile(QOpenGLShader::Compute, csrc);
-    if(m_shadCompute.log().length())
-    {
-        strange = QString::asprintf("%s", QString("Compute shader log:"+m_shadCompute.log()).toStdString().c_str());
-        trace(strange);
-    }
-
-    if(!m_shadCompute.link())
-    {
-        trace("Compute shader is not linked");
-    }
+    ShaderRegistry::build(m_shadCompute, "Flow compute", {{QOpenGLShader::Compute, ":/shaders/flow/flowVtx_CS.glsl"}});
     m_shadCompute.bind();
     {
         m_locGamma     = m_shadCompute.uniformLocation("gamma");
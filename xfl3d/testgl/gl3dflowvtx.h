@@ -57,7 +57,7 @@ class gl3dFlowVtx : public gl3dTestGLView
         QTimer m_Timer;
         int m_Period;
 
-        QOpenGLShaderProgram m_shadCompute;
+        QOpenGLShaderProgram &m_shadCompute;
         QOpenGLBuffer m_vboBoids, m_vboTraces;
         QOpenGLBuffer m_vboVortices;
         QOpenGLBuffer m_ssboVortices;
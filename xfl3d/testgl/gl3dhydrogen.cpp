@@ -16,6 +16,7 @@
 
 #include <xfl3d/controls/w3dprefs.h>
 #include <xfl3d/globals/gl_globals.h>
+#include <xfl3d/globals/vertexwriter.h>
 #include <xflcore/displayoptions.h>
 #include <xflcore/xflcore.h>
 #include <xflmath/mathelem.h>
@@ -334,7 +335,7 @@ void gl3dHydrogen::glMake3dObjects()
         float state(0);
         int stride = 8;
         int buffersize = m_Pts.size()*stride;
-        QVector<float> pts(buffersize);
+        VertexWriter pts(m_vboObservations, buffersize);
         int iv =0;
         for(int i=0; i<m_Pts.size(); i++)
         {
@@ -351,12 +352,7 @@ void gl3dHydrogen::glMake3dObjects()
         }
 
         Q_ASSERT(iv==buffersize);
-
-        if(m_vboObservations.isCreated()) m_vboObservations.destroy();
-        m_vboObservations.create();
-        m_vboObservations.bind();
-        m_vboObservations.allocate(pts.data(), buffersize * int(sizeof(GLfloat)));
-        m_vboObservations.release();
+        pts.close();
 
         m_bResetPositions = false;
     }
@@ -12,6 +12,7 @@
 #include "gl3dlorenz.h"
 
 #include <xfl3d/controls/w3dprefs.h>
+#include <xfl3d/globals/vertexwriter.h>
 #include <xflcore/trace.h>
 #include <xflcore/displayoptions.h>
 #include <xflcore/xflcore.h>
@@ -313,7 +314,7 @@ void gl3dLorenz::glMake3dObjects()
     {
         int buffersize = (s_MaxPts-1)  // NSegments
                          *2*(4+4);     // 2 vertices * (3 coordinates+ 4 color components)
-        QVector<float> buffer(buffersize);
+        VertexWriter buffer(m_vboTrace, buffersize);
 
         int ip0(0), ip1(0);
 
@@ -345,13 +346,7 @@ void gl3dLorenz::glMake3dObjects()
         }
 
         Q_ASSERT(iv==buffersize);
-
-        if(m_vboTrace.isCreated()) m_vboTrace.destroy();
-        m_vboTrace.create();
-        m_vboTrace.bind();
-        m_vboTrace.allocate(buffer.data(), buffersize * int(sizeof(GLfloat)));
-
-        m_vboTrace.release();
+        buffer.close();
 
         m_bResetAttractor = false;
     }
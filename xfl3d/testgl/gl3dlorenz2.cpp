@@ -18,6 +18,7 @@
 #include "gl3dlorenz2.h"
 #include <xfl3d/globals/gl_globals.h>
 #include <xfl3d/controls/w3dprefs.h>
+#include <xfl3d/views/shaderregistry.h>
 #include <xflcore/displayoptions.h>
 #include <xflcore/trace.h>
 #include <xflcore/xflcore.h>
@@ -39,7 +40,8 @@ double gl3dLorenz2::s_dt(0.002);
 
 float gl3dLorenz2::s_Size = 5.0f;
 
-gl3dLorenz2::gl3dLorenz2(QWidget *pParent) : gl3dTestGLView(pParent)
+gl3dLorenz2::gl3dLorenz2(QWidget *pParent) : gl3dTestGLView(pParent),
+    m_shadLorenz2(ShaderRegistry::program("lorenz2_compute"))
 {
     setWindowTitle("Lorenz - GPU");
 
@@ -218,20 +220,7 @@ void gl3dLorenz2::initializeGL()
     gl3dTestGLView::initializeGL();
 
 #ifndef Q_OS_MAC
-    QString csrc, strange;
-
-    csrc = ":/shaders/lorenz2/lorenz2_CS.glsl";
-    m_shadLorenz2.addShaderFromSourceFile(QOpenGLShader::Compute, csrc);
-    if(m_shadLorenz2.log().length())
-    {
-        strange = QString::asprintf("%s", QString("Compute shader log:"+m_shadLorenz2.log()).toStdString().c_str());
-        trace(strange);
-    }
-
-    if(!m_shadLorenz2.link())
-    {
-        trace("Compute shader is not linked");
-    }
+    ShaderRegistry::build(m_shadLorenz2, "Lorenz compute", {{QOpenGLShader::Compute, ":/shaders/lorenz2/lorenz2_CS.glsl"}});
     m_shadLorenz2.bind();
     {
         m_locRadius = m_shadLorenz2.uniformLocation("radius");
@@ -46,7 +46,7 @@ class gl3dLorenz2 : public gl3dTestGLView
 
     private:
         QOpenGLVertexArrayObject m_vao; /** generic vao required for the core profile >3.x*/
-        QOpenGLShaderProgram m_shadLorenz2;
+        QOpenGLShaderProgram &m_shadLorenz2;
 
         // CS uniforms
         int m_locRadius, m_locDt;
@@ -14,6 +14,7 @@
 #include "gl3dsagittarius.h"
 #include <xfl3d/controls/w3dprefs.h>
 #include <xfl3d/globals/gl_globals.h>
+#include <xfl3d/globals/vertexwriter.h>
 #include <xflcore/displayoptions.h>
 #include <xflcore/xflcore.h>
 #include <xflgraph/containers/graphwt.h>
@@ -501,7 +502,7 @@ void gl3dSagittarius::glMake3dObjects()
 
             int buffersize =  (s_TailSize-1)  // NSegments
                              *2*(4+4);     // 2 vertices * (4 coordinates+ 4 color components)
-            QVector<float> buffer(buffersize);
+            VertexWriter buffer(m_vboTrace[is], buffersize);
 
             QVector<Vector3d> const &trace = m_Trace.at(is);
             int ip0(0), ip1(0);
@@ -531,30 +532,20 @@ void gl3dSagittarius::glMake3dObjects()
                 buffer[iv++] = double(trace.size()-j)/double(trace.size()-1);
             }
             Q_ASSERT(iv==buffersize);
-
-            if(m_vboTrace[is].isCreated()) m_vboTrace[is].destroy();
-            m_vboTrace[is].create();
-            m_vboTrace[is].bind();
-            m_vboTrace[is].allocate(buffer.data(), buffersize * int(sizeof(GLfloat)));
-            m_vboTrace[is].release();
+            buffer.close();
         }
 
         for(int is=0; is<m_Star.size(); is++)
         {
             int nPts = 1;
             int buffersize = nPts*4;
-            QVector<float> pts(buffersize);
+            VertexWriter pts(m_vboStar[is], buffersize);
             int iv = 0;
             pts[iv++] = 0.0f;
             pts[iv++] = 0.0f;
             pts[iv++] = 0.0f;
             pts[iv++] = m_Star[is].m_Tau;
-
-            if(m_vboStar[is].isCreated()) m_vboStar[is].destroy();
-            m_vboStar[is].create();
-            m_vboStar[is].bind();
-            m_vboStar[is].allocate(pts.data(), buffersize * int(sizeof(GLfloat)));
-            m_vboStar[is].release();
+            pts.close();
         }
 
         m_bResetTrail = false;
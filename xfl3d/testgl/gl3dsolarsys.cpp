@@ -6,6 +6,8 @@
 
 *****************************************************************************/
 
+#include <cstring>
+
 #include <QFormLayout>
 #include <QGuiApplication>
 #include <QCheckBox>
@@ -15,6 +17,7 @@
 #include <xflwidgets/customwts/floatedit.h>
 #include <xflwidgets/wt_globals.h>
 #include <xfl3d/globals/gl_globals.h>
+#include <xfl3d/globals/vertexwriter.h>
 #include <xfl3d/controls/w3dprefs.h>
 #include <xflcore/displayoptions.h>
 
@@ -170,6 +173,7 @@ void gl3dSolarSys::initializeGL()
 void gl3dSolarSys::glRenderView()
 {
     QOpenGLVertexArrayObject::Binder vaoBinder(&m_vao);
+    m_matModel.setToIdentity();
     QMatrix4x4 vmMat(m_matView*m_matModel);
     QMatrix4x4 pvmMat(m_matProj*vmMat);
 
@@ -186,78 +190,51 @@ void gl3dSolarSys::glRenderView()
     }
     m_shadSurf.release();
 
-    Vector3d pos;
+    // the orbits and the bodies are drawn in the sun's frame, whatever the number of bodies
+    paintColorSegments(m_vboOrbits, 1.0f, Line::SOLID);
 
+    makeInstances();
+    paintSphereInstances(m_vboInstMatrices, m_vboInstRadii, m_vboInstColors, true);
+
+    Vector3d pos;
     for(int i=0; i<m_Planet.size(); i++)
     {
         Planet const &planet = m_Planet.at(i);
+        pos = planet.position()/SCALEFACTOR; // million km
+        pos.z += planet.m_Radius/SCALEFACTOR*s_PlanetSize*1.1;
+        QVector3D label = planet.orbitMat().map(QVector3D(pos.xf(), pos.yf(), pos.zf()));
+        glRenderText(label.x(), label.y(), label.z(), planet.m_Name, planet.m_Color);
+    }
 
-        m_matModel = planet.orbitMat();
+    {
+        //paint Saturn's disk
+        Planet const &Saturn = m_Planet.at(5);
+        m_matModel = Saturn.orbitMat();
+        m_matModel.translate(Saturn.m_var[0]/SCALEFACTOR, Saturn.m_var[1]/SCALEFACTOR, Saturn.m_var[2]/SCALEFACTOR);
+        m_matModel.rotate(-27.0f, sqrtf(2)/2.0f, sqrtf(2)/2.0f,0.0f);
+        m_matModel.scale(s_PlanetSize);
 
         vmMat = m_matView*m_matModel;
         pvmMat = m_matProj*vmMat;
 
         m_shadSurf.bind();
         {
-            m_shadSurf.setUniformValue(m_locSurf.m_vmMatrix, vmMat);
+            m_shadSurf.setUniformValue(m_locSurf.m_vmMatrix,  vmMat);
             m_shadSurf.setUniformValue(m_locSurf.m_pvmMatrix, pvmMat);
         }
         m_shadSurf.release();
-        m_shadLine.bind();
-        {
-            m_shadLine.setUniformValue(m_locLine.m_vmMatrix, vmMat);
-            m_shadLine.setUniformValue(m_locLine.m_pvmMatrix, pvmMat);
-        }
-        m_shadLine.release();
 
-        pos = planet.position()/SCALEFACTOR; // million km
-        paintLineStrip(m_vboCircle[i], planet.m_Color, 1.0f, Line::SOLID);
-        paintSphere(pos, planet.m_Radius/SCALEFACTOR*s_PlanetSize, planet.m_Color, true);
-        glRenderText(pos.x, pos.y, pos.z+planet.m_Radius/SCALEFACTOR*s_PlanetSize*1.1,
-                     planet.m_Name, planet.m_Color);
-
-        if(i==5)
-        {
-            //paint Saturn's disk
-            Planet const &Saturn = m_Planet.at(5);
-//            QMatrix4x4 scale, rotate, translate;
-            m_matModel.translate(Saturn.m_var[0]/SCALEFACTOR, Saturn.m_var[1]/SCALEFACTOR, Saturn.m_var[2]/SCALEFACTOR);
-            m_matModel.rotate(-27.0f, sqrtf(2)/2.0f, sqrtf(2)/2.0f,0.0f);
-            m_matModel.scale(s_PlanetSize);
-//            m_pvmMatrix = m_pvmMatrix*translate*rotate*scale;
-
-            vmMat = m_matView*m_matModel;
-            pvmMat = m_matProj*vmMat;
-
-            m_shadSurf.bind();
-            {
-                m_shadSurf.setUniformValue(m_locSurf.m_vmMatrix,  vmMat);
-                m_shadSurf.setUniformValue(m_locSurf.m_pvmMatrix, pvmMat);
-            }
-            m_shadSurf.release();
-
-            QColor clr = Saturn.m_Color;
-            clr.setAlpha(175);
-            paintTriangleFan(m_vboSaturnDisk, clr, true, false);
-
-            m_matModel.setToIdentity();
-            vmMat = m_matView*m_matModel;
-            pvmMat = m_matProj*vmMat;
-            m_shadSurf.bind();
-            {
-                m_shadSurf.setUniformValue(m_locSurf.m_vmMatrix,  vmMat);
-                m_shadSurf.setUniformValue(m_locSurf.m_pvmMatrix, pvmMat);
-            }
-            m_shadSurf.release();
-        }
+        QColor clr = Saturn.m_Color;
+        clr.setAlpha(175);
+        paintTriangleFan(m_vboSaturnDisk, clr, true, false);
     }
 
     if(m_bHalley)
     {
         m_matModel = m_Halley.orbitMat();
 
-        QMatrix4x4 vmMat(m_matView*m_matModel);
-        QMatrix4x4 pvmMat(m_matProj*vmMat);
+        vmMat = m_matView*m_matModel;
+        pvmMat = m_matProj*vmMat;
 
         m_shadSurf.bind();
         {
@@ -271,7 +248,6 @@ void gl3dSolarSys::glRenderView()
         paintTriangleFan(m_vboHalleyEllipse, clr, false, false);
 
         pos = m_Halley.position()/SCALEFACTOR; // million km
-        paintSphere(pos, 0.005/m_glScalef, m_Halley.m_Color, true);
         glRenderText(pos.x, pos.y, pos.z*s_PlanetSize*1.1, m_Halley.m_Name, m_Halley.m_Color);
     }
 
@@ -279,8 +255,8 @@ void gl3dSolarSys::glRenderView()
     {
         m_matModel = m_Ceres.orbitMat();
 
-        QMatrix4x4 vmMat(m_matView*m_matModel);
-        QMatrix4x4 pvmMat(m_matProj*vmMat);
+        vmMat = m_matView*m_matModel;
+        pvmMat = m_matProj*vmMat;
 
         m_shadLine.bind();
         {
@@ -292,7 +268,6 @@ void gl3dSolarSys::glRenderView()
         paintLineStrip(m_vboCeresEllipse, m_Ceres.m_Color, 0.3f, Line::SOLID);
 
         pos = m_Ceres.position()/SCALEFACTOR; // million km
-        paintSphere(pos, m_Ceres.m_Radius/SCALEFACTOR*s_PlanetSize, m_Ceres.m_Color, true);
         glRenderText(pos.x, pos.y, pos.z*s_PlanetSize*1.1, m_Ceres.m_Name, m_Ceres.m_Color);
     }
 
@@ -301,6 +276,13 @@ void gl3dSolarSys::glRenderView()
     vmMat = m_matView*m_matModel;
     pvmMat = m_matProj*vmMat;
 
+    m_shadSurf.bind();
+    {
+        m_shadSurf.setUniformValue(m_locSurf.m_vmMatrix,  vmMat);
+        m_shadSurf.setUniformValue(m_locSurf.m_pvmMatrix, pvmMat);
+    }
+    m_shadSurf.release();
+
     float radius = float(1.3927e9/SCALEFACTOR);
 
     m_shadPoint.bind();
@@ -324,16 +306,8 @@ void gl3dSolarSys::glMake3dObjects()
 {
     if(m_bResetPlanets)
     {
-        for(int i=0; i<m_vboCircle.size(); i++)
-        {
-            if(m_vboCircle[i].isCreated()) m_vboCircle[i].destroy();
-        }
-        m_vboCircle.resize(m_Planet.size());
-        for(int i=0; i<m_Planet.size(); i++)
-        {
-            Planet const &planet = m_Planet.at(i);
-            gl::makeEllipseLineStrip(planet.m_a/SCALEFACTOR, planet.m_e, Vector3d(), m_vboCircle[i]);
-        }
+        makeOrbits();
+
         gl::makeDisk(270.0e6/2.0/SCALEFACTOR, Vector3d(), m_vboSaturnDisk); // 270 000 km diameter
 
         // make Ceres's ellipse
@@ -348,6 +322,97 @@ void gl3dSolarSys::glMake3dObjects()
 }
 
 
+/**
+ * Builds the orbits of all the planets in a single buffer of coloured segments.
+ * The orbits are transformed to the sun's frame here, once, so that they can be drawn in one call.
+ */
+void gl3dSolarSys::makeOrbits()
+{
+    int const NPTS = 300;
+    int buffersize = m_Planet.size() * (NPTS-1) * 2 * 6; // 2 vertices x (3 coords + 3 colour components) per segment
+    VertexWriter OrbitVertexArray(m_vboOrbits, buffersize);
+
+    int iv = 0;
+    for(int ip=0; ip<m_Planet.size(); ip++)
+    {
+        Planet const &planet = m_Planet.at(ip);
+        QMatrix4x4 orbit = planet.orbitMat();
+
+        double a = planet.m_a/SCALEFACTOR;
+        double b = a * sqrt(1.0-planet.m_e*planet.m_e);
+        double xc = a*planet.m_e;
+
+        QVector3D prev;
+        for(int i=0; i<NPTS; i++)
+        {
+            double t = double(i)/double(NPTS-1);
+            QVector3D pt = orbit.map(QVector3D(float(xc+a*cos(2.0*PI*t)), float(b*sin(2.0*PI*t)), 0.0f));
+            if(i>0)
+            {
+                for(QVector3D const &v : {prev, pt})
+                {
+                    OrbitVertexArray[iv++] = v.x();
+                    OrbitVertexArray[iv++] = v.y();
+                    OrbitVertexArray[iv++] = v.z();
+                    OrbitVertexArray[iv++] = planet.m_Color.redF();
+                    OrbitVertexArray[iv++] = planet.m_Color.greenF();
+                    OrbitVertexArray[iv++] = planet.m_Color.blueF();
+                }
+            }
+            prev = pt;
+        }
+    }
+    Q_ASSERT(iv==buffersize);
+    OrbitVertexArray.close();
+}
+
+
+/** Fills the per-instance buffers with the current model matrix, radius and colour of each body */
+void gl3dSolarSys::makeInstances()
+{
+    QVector<Planet const*> bodies;
+    QVector<float> radii;
+    for(int i=0; i<m_Planet.size(); i++)
+    {
+        bodies.append(&m_Planet.at(i));
+        radii.append(float(m_Planet.at(i).m_Radius/SCALEFACTOR*s_PlanetSize));
+    }
+    if(m_bHalley)
+    {
+        bodies.append(&m_Halley);
+        radii.append(float(0.005/m_glScalef));
+    }
+    if(m_bCeres)
+    {
+        bodies.append(&m_Ceres);
+        radii.append(float(m_Ceres.m_Radius/SCALEFACTOR*s_PlanetSize));
+    }
+
+    VertexWriter matrices(m_vboInstMatrices, bodies.size()*16);
+    VertexWriter colors(m_vboInstColors, bodies.size()*4);
+    VertexWriter radiusarray(m_vboInstRadii, radii.size());
+    for(int i=0; i<bodies.size(); i++)
+    {
+        Planet const *pBody = bodies.at(i);
+        Vector3d pos = pBody->position()/SCALEFACTOR; // million km
+        QMatrix4x4 mat = pBody->orbitMat();
+        mat.translate(pos.xf(), pos.yf(), pos.zf());
+        memcpy(matrices.data()+16*i, mat.constData(), 16*sizeof(GLfloat));
+
+        colors[4*i+0] = pBody->m_Color.redF();
+        colors[4*i+1] = pBody->m_Color.greenF();
+        colors[4*i+2] = pBody->m_Color.blueF();
+        colors[4*i+3] = pBody->m_Color.alphaF();
+
+        radiusarray[i] = radii.at(i);
+    }
+
+    matrices.close();
+    colors.close();
+    radiusarray.close();
+}
+
+
 void gl3dSolarSys::onRestart()
 {
     s_dt = m_pdeDt->value();
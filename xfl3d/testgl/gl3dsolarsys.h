@@ -49,6 +49,8 @@ class gl3dSolarSys : public gl3dTestGLView
 
 
         void makePlanets();
+        void makeOrbits();
+        void makeInstances();
 
 
     private:
@@ -71,7 +73,10 @@ class gl3dSolarSys : public gl3dTestGLView
         QLabel *m_plabDate;
         QLabel *m_plabHalley;
 
-        QVector<QOpenGLBuffer> m_vboCircle;
+        QOpenGLBuffer m_vboOrbits;        /**< the orbits of all planets, as coloured segments in the sun's frame */
+        QOpenGLBuffer m_vboInstMatrices;  /**< the per-instance model matrices of the bodies */
+        QOpenGLBuffer m_vboInstRadii;     /**< the per-instance display radii of the bodies */
+        QOpenGLBuffer m_vboInstColors;    /**< the per-instance colours of the bodies */
         QOpenGLBuffer m_vboSaturnDisk;
         QOpenGLBuffer m_vboCeresEllipse;
         QOpenGLBuffer m_vboHalleyEllipse;
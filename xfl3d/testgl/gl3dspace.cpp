@@ -11,6 +11,7 @@
 #include "gl3dspace.h"
 
 #include <xfl3d/globals/gl_globals.h>
+#include <xfl3d/globals/vertexwriter.h>
 #include <xfl3d/controls/w3dprefs.h>
 #include <xflwidgets/customwts/intedit.h>
 #include <xflwidgets/customwts/floatedit.h>
@@ -120,8 +121,8 @@ void gl3dSpace::glMake3dObjects()
             arcbuffersize *= 2; // two arcs Ra and Da
             arcbuffersize *= 2; // two vertices per segment
             arcbuffersize *= 3; // three components per vertex
-            QVector<GLfloat> ArcVertexArray(arcbuffersize, 0);
-            QVector<GLfloat> RadiusVertexArray(3*2*3, 0);
+            VertexWriter ArcVertexArray(m_vboArcSegments, arcbuffersize);
+            VertexWriter RadiusVertexArray(m_vboRadius, 3*2*3);
 
 
             Star const &galaxy = m_Galaxies.at(m_iSelIndex);
@@ -193,17 +194,8 @@ void gl3dSpace::glMake3dObjects()
 
             Q_ASSERT(iv==arcbuffersize);
 
-            m_vboArcSegments.destroy();
-            m_vboArcSegments.create();
-            m_vboArcSegments.bind();
-            m_vboArcSegments.allocate(ArcVertexArray.data(), arcbuffersize * sizeof(GLfloat));
-            m_vboArcSegments.release();
-
-            m_vboRadius.destroy();
-            m_vboRadius.create();
-            m_vboRadius.bind();
-            m_vboRadius.allocate(RadiusVertexArray.data(), 18 * sizeof(GLfloat));
-            m_vboRadius.release();
+            ArcVertexArray.close();
+            RadiusVertexArray.close();
         }
         m_bResetArcs = false;
     }
@@ -215,22 +207,10 @@ void gl3dSpace::glMake3dObjects()
 
         int nobj = std::min(s_NObjects, int(m_Galaxies.size()));
 
-        QVector<float>PositionArray(nobj *3);//3 vertices for each galaxy
-        int iv=0;
+        // the instance buffers are made from the galaxies in the view frustum each time the view changes
+        m_Culler.setInstanceCount(nobj);
         for(int i=0; i<nobj; i++)
-        {
-            PositionArray[iv++] = m_Galaxies.at(i).m_Position.xf();
-            PositionArray[iv++] = m_Galaxies.at(i).m_Position.yf();
-            PositionArray[iv++] = m_Galaxies.at(i).m_Position.zf();
-        }
-
-        if(m_vboInstPositions.isCreated()) m_vboInstPositions.destroy();
-        m_vboInstPositions.create();
-        m_vboInstPositions.bind();
-        {
-            m_vboInstPositions.allocate(PositionArray.data(), int(PositionArray.size() * sizeof(GLfloat)));
-        }
-        m_vboInstPositions.release();
+            m_Culler.setPosition(i, m_Galaxies.at(i).m_Position);
 
         m_bResetInstances = false;
     }
@@ -252,7 +232,7 @@ void gl3dSpace::glRenderView()
     }
     m_shadSurf.release();
 
-    paintSphereInstances(m_vboInstPositions, float(s_SphereRadius)/m_glScalef/5000.0f, Qt::lightGray, false, true);
+    paintSphereInstances(m_Culler, float(s_SphereRadius)/m_glScalef/5000.0f, Qt::lightGray, false, true);
 
     if(m_iCloseIndex>=0 && m_iCloseIndex<m_Galaxies.size() && m_iCloseIndex!=m_iSelIndex)
     {
@@ -387,6 +367,10 @@ void gl3dSpace::makeGalaxies()
     m_Galaxies.squeeze();
     m_plwGalaxies->sortItems();
 
+    QVector<Vector3d> positions(m_Galaxies.size());
+    for(int i=0; i<m_Galaxies.size(); i++) positions[i] = m_Galaxies.at(i).m_Position;
+    m_GalaxyTree.build(positions);
+
     m_iSelIndex = 0;
     for(int iGal=0; iGal<m_plwGalaxies->count(); iGal++)
     {
@@ -437,41 +421,12 @@ void gl3dSpace::mouseMoveEvent(QMouseEvent *pEvent)
 
     if(!m_DynTimer.isActive())
     {
-        QPoint point = pEvent->pos();
-        Vector3d AA, BB;
-
-        screenToWorld(point, -1.0, AA);
-        screenToWorld(point,  1.0, BB);
-
-        QVector4D v4d;
-
-        double dist =0.0;
-        double dmax = 100.;
-        float zmax = +1.e10;
-
         double radius = double(s_SphereRadius)/2500.0/m_glScalef;
 
         s_NObjects = std::min(s_NObjects, int(m_Galaxies.size()));
 
-        m_iCloseIndex = -1;
-        for(int in=0; in<s_NObjects; in++)
-        {
-            Star const &node = m_Galaxies.at(in);
-
-            dist = distanceToLine3d(AA, BB, node.m_Position);
-            // first screening: set a max distance
-            if(dist<5.0*radius && dist<dmax)
-            {
-                worldToScreen(node.m_Position, v4d);
-                // second screening: keep the node closest to the viewer
-                if(v4d.z()<zmax)
-                {
-                    dmax = dist;
-                    zmax = v4d.z();
-                    m_iCloseIndex = in;
-                }
-            }
-        }
+        // the galaxy closest to the viewer within the pick distance of the line of sight
+        m_iCloseIndex = pickPoint(m_GalaxyTree, pEvent->pos(), 5.0*radius, s_NObjects);
         update();
     }
 }
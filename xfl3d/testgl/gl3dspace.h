@@ -12,6 +12,7 @@
 
 
 #include <xfl3d/testgl/gl3dtestglview.h>
+#include <xflgeom/geom3d/pointkdtree.h>
 #include <xflgeom/geom3d/vector3d.h>
 #include "spaceobject.h"
 
@@ -56,12 +57,13 @@ class gl3dSpace : public gl3dTestGLView
     private:
 //        QOpenGLVertexArrayObject m_vaoSpace;
         QOpenGLBuffer m_vboTetra, m_vboTetraEdges;
-        QOpenGLBuffer m_vboInstPositions;
+        InstanceCuller m_Culler;
 
         QOpenGLBuffer m_vboArcSegments;
         QOpenGLBuffer m_vboRadius;
 
         QVector<Star> m_Galaxies;
+        PointKdTree m_GalaxyTree;  /**< the galaxy positions, to pick the galaxy under the mouse */
 
         IntEdit *m_pieNGalaxies;
         QListWidget *m_plwGalaxies;
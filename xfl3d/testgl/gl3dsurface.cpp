@@ -14,6 +14,7 @@
 
 #include <xfl3d/controls/colourlegend.h>
 #include <xfl3d/globals/gl_globals.h>
+#include <xfl3d/globals/vertexwriter.h>
 #include <xfl3d/controls/w3dprefs.h>
 
 
@@ -97,7 +98,7 @@ void gl3dSurface::glMakeSurface()
     // x (3 vtx + 3 normal)/vertex
     int bufferSize = (m_Size_x-1)*(m_Size_y-1)* 2 * 3 * 6;
 
-    QVector<float>surfvertexarray(bufferSize);
+    VertexWriter surfvertexarray(m_vboSurface, bufferSize);
 
     float zmin= 1.0e10f;
     float zmax=-1.0e10f;
@@ -186,19 +187,13 @@ void gl3dSurface::glMakeSurface()
     }
 
     Q_ASSERT(iv==bufferSize);
-
-
-    if(m_vboSurface.isCreated()) m_vboSurface.destroy();
-    m_vboSurface.create();
-    m_vboSurface.bind();
-    m_vboSurface.allocate(surfvertexarray.data(), bufferSize * int(sizeof(GLfloat)));
-    m_vboSurface.release();
+    surfvertexarray.close();
 
     //Make the grid
     int nsegs = m_Size_x * (m_Size_y-1) + m_Size_y * (m_Size_x-1);
     bufferSize = nsegs * 2 * 3; // 3 vertex components
 
-    QVector<float>gridvertexarray(bufferSize);
+    VertexWriter gridvertexarray(m_vboGrid, bufferSize);
     iv=0;
     for (int i=0; i<m_Size_x; i++)
     {
@@ -236,13 +231,7 @@ void gl3dSurface::glMakeSurface()
         }
     }
     Q_ASSERT(iv==bufferSize);
-
-    if(m_vboGrid.isCreated()) m_vboGrid.destroy();
-    m_vboGrid.create();
-    m_vboGrid.bind();
-    m_vboGrid.allocate(gridvertexarray.data(), bufferSize * int(sizeof(GLfloat)));
-    m_vboGrid.release();
-
+    gridvertexarray.close();
 }
 
 
@@ -342,7 +331,14 @@ double gl3dSurface::function(double x, double y) const
     if(m_bDoubleDipSurface)
         return x * exp(-(x*x/m_HalfSide + y*y/m_HalfSide))*m_HalfSide/2.0;
     else
-        return 1.0/ sqrt((0.5+x*x + y*y)/5.0) * (sin(c0*(0.5*x+y)+3.517) + cos((y+x-c1)*c2-1.57)*sin((y-2.0*x-c1)*c2));
+        return randomFunction(x, y, c0, c1, c2);
+}
+
+
+/** The random test surface, also used by the headless optimizer benchmark */
+double gl3dSurface::randomFunction(double x, double y, double a0, double a1, double a2)
+{
+    return 1.0/ sqrt((0.5+x*x + y*y)/5.0) * (sin(a0*(0.5*x+y)+3.517) + cos((y+x-a1)*a2-1.57)*sin((y-2.0*x-a1)*a2));
 }
 
 
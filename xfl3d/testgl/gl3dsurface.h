@@ -28,6 +28,9 @@ class gl3dSurface : public gl3dTestGLView
         double error(const Vector2d &pos, bool bMinimum) const;
         double function(double x, double y) const;
 
+    public:
+        static double randomFunction(double x, double y, double a0, double a1, double a2);
+
     protected:
         bool m_bGrid, m_bContour;
         double m_HalfSide;
@@ -819,6 +819,7 @@ void gl3dTexture::glRenderView()
         m_shadSurf.disableAttributeArray(m_locSurf.m_attrNormal);
         m_shadSurf.disableAttributeArray(m_locSurf.m_attrUV);
         m_shadSurf.setUniformValue(m_locSurf.m_TwoSided, 0); // leave things as they were
+        m_shadSurf.setUniformValue(m_locSurf.m_HasTexture, 0); // the program is shared with the other views
         glEnable(GL_CULL_FACE);
     }
     m_shadSurf.release();
@@ -0,0 +1,695 @@
+/****************************************************************************
+
+    Xfl3d application
+    Copyright (C) Andre Deperrois
+    License: GPL v3
+
+*****************************************************************************/
+
+#include <QElapsedTimer>
+#include <QFile>
+#include <QFileInfo>
+#include <QJsonArray>
+#include <QJsonDocument>
+#include <QTextStream>
+
+#include "optim2dbench.h"
+#include <xfl3d/testgl/gl3dsurface.h>
+#include <xflmath/constants.h>
+
+
+Optim2dBench::Optim2dBench() : m_Rng(1), m_NormalEngine(1)
+{
+    m_Cases.append(BenchCase());
+    m_Algorithms = {PSO, GA, SIMPLEX};
+    m_Functions  = {RASTRIGIN, ROSENBROCK, ACKLEY, RANDOMSURFACE};
+
+    m_pCase = &m_Cases.first();
+    m_Function = RASTRIGIN;
+    m_HalfSide = 5.0;
+    m_ValMin = m_ValMax = 0.0;
+    m_nEvals = 0;
+    m_EvalsToTarget = -1;
+    m_BestError = LARGEVALUE;
+}
+
+
+QString Optim2dBench::algorithmName(enumAlgorithm algo)
+{
+    switch(algo)
+    {
+        case PSO:     return "PSO";
+        case GA:      return "GA";
+        case SIMPLEX: return "Simplex";
+    }
+    return QString();
+}
+
+
+QString Optim2dBench::functionName(enumFunction func)
+{
+    switch(func)
+    {
+        case RASTRIGIN:     return "Rastrigin";
+        case ROSENBROCK:    return "Rosenbrock";
+        case ACKLEY:        return "Ackley";
+        case RANDOMSURFACE: return "Random";
+    }
+    return QString();
+}
+
+
+/** The half-width of the square search domain, centered on the origin */
+double Optim2dBench::halfSide(enumFunction func)
+{
+    switch(func)
+    {
+        case RASTRIGIN:     return 5.12;
+        case ROSENBROCK:    return 2.048;
+        case ACKLEY:        return 5.0;
+        case RANDOMSURFACE: return 5.0;
+    }
+    return 5.0;
+}
+
+
+double Optim2dBench::testFunction(enumFunction func, double x, double y, BenchCase const &bc)
+{
+    switch(func)
+    {
+        case RASTRIGIN:
+            return 20.0 + x*x - 10.0*cos(2.0*PI*x) + y*y - 10.0*cos(2.0*PI*y);
+        case ROSENBROCK:
+            return (1.0-x)*(1.0-x) + 100.0*(y-x*x)*(y-x*x);
+        case ACKLEY:
+            return -20.0*exp(-0.2*sqrt(0.5*(x*x+y*y))) - exp(0.5*(cos(2.0*PI*x)+cos(2.0*PI*y))) + exp(1.0) + 20.0;
+        case RANDOMSURFACE:
+            return gl3dSurface::randomFunction(x, y, bc.m_c0, bc.m_c1, bc.m_c2);
+    }
+    return 0.0;
+}
+
+
+/**
+ * Reads the benchmark settings from a JSON file.
+ * The top level object holds the default settings and the lists of algorithms and functions;
+ * the optional "cases" array holds objects which override the defaults, one case per object.
+ */
+bool Optim2dBench::loadSettings(QString const &pathname, QString &log)
+{
+    QFile jsonfile(pathname);
+    if(!jsonfile.open(QIODevice::ReadOnly))
+    {
+        log += "Could not open the settings file "+pathname+"\n";
+        return false;
+    }
+
+    QJsonParseError error;
+    QJsonDocument doc = QJsonDocument::fromJson(jsonfile.readAll(), &error);
+    jsonfile.close();
+    if(doc.isNull() || !doc.isObject())
+    {
+        log += "Error parsing the settings file: " + error.errorString() + "\n";
+        return false;
+    }
+
+    QJsonObject root = doc.object();
+
+    auto readCase = [](QJsonObject const &obj, BenchCase &bc)
+    {
+        bc.m_Name            = obj.value("name").toString(bc.m_Name);
+        bc.m_Seed            = quint32(obj.value("seed").toDouble(bc.m_Seed));
+        bc.m_Repeats         = obj.value("repeats").toInt(bc.m_Repeats);
+        bc.m_MaxIter         = obj.value("maxiter").toInt(bc.m_MaxIter);
+        bc.m_PopSize         = obj.value("popsize").toInt(bc.m_PopSize);
+        bc.m_MaxError        = obj.value("maxerror").toDouble(bc.m_MaxError);
+        bc.m_InertiaWeight   = obj.value("inertiaweight").toDouble(bc.m_InertiaWeight);
+        bc.m_CognitiveWeight = obj.value("cognitiveweight").toDouble(bc.m_CognitiveWeight);
+        bc.m_SocialWeight    = obj.value("socialweight").toDouble(bc.m_SocialWeight);
+        bc.m_ProbRegenerate  = obj.value("probregenerate").toDouble(bc.m_ProbRegenerate);
+        bc.m_ProbXOver       = obj.value("probxover").toDouble(bc.m_ProbXOver);
+        bc.m_ProbMutation    = obj.value("probmutation").toDouble(bc.m_ProbMutation);
+        bc.m_SigmaMutation   = obj.value("sigmamutation").toDouble(bc.m_SigmaMutation);
+        bc.m_c0              = obj.value("c0").toDouble(bc.m_c0);
+        bc.m_c1              = obj.value("c1").toDouble(bc.m_c1);
+        bc.m_c2              = obj.value("c2").toDouble(bc.m_c2);
+
+        bc.m_Repeats = std::max(1, bc.m_Repeats);
+        bc.m_PopSize = std::max(2, bc.m_PopSize);
+    };
+
+    BenchCase defaultcase;
+    readCase(root, defaultcase);
+
+    m_Cases.clear();
+    QJsonArray cases = root.value("cases").toArray();
+    for(int i=0; i<cases.size(); i++)
+    {
+        BenchCase bc = defaultcase;
+        bc.m_Name = QString::asprintf("case_%d", i);
+        readCase(cases.at(i).toObject(), bc);
+        m_Cases.append(bc);
+    }
+    if(m_Cases.isEmpty()) m_Cases.append(defaultcase);
+
+    if(root.contains("algorithms"))
+    {
+        m_Algorithms.clear();
+        QJsonArray algos = root.value("algorithms").toArray();
+        for(int i=0; i<algos.size(); i++)
+        {
+            QString name = algos.at(i).toString();
+            if     (name.compare("PSO",     Qt::CaseInsensitive)==0) m_Algorithms.append(PSO);
+            else if(name.compare("GA",      Qt::CaseInsensitive)==0) m_Algorithms.append(GA);
+            else if(name.compare("Simplex", Qt::CaseInsensitive)==0) m_Algorithms.append(SIMPLEX);
+            else log += "Unknown algorithm "+name+"\n";
+        }
+    }
+
+    if(root.contains("functions"))
+    {
+        m_Functions.clear();
+        QJsonArray funcs = root.value("functions").toArray();
+        for(int i=0; i<funcs.size(); i++)
+        {
+            QString name = funcs.at(i).toString();
+            if     (name.compare("Rastrigin",  Qt::CaseInsensitive)==0) m_Functions.append(RASTRIGIN);
+            else if(name.compare("Rosenbrock", Qt::CaseInsensitive)==0) m_Functions.append(ROSENBROCK);
+            else if(name.compare("Ackley",     Qt::CaseInsensitive)==0) m_Functions.append(ACKLEY);
+            else if(name.compare("Random",     Qt::CaseInsensitive)==0) m_Functions.append(RANDOMSURFACE);
+            else log += "Unknown function "+name+"\n";
+        }
+    }
+
+    log += QString::asprintf("Loaded %d case(s), %d algorithm(s), %d function(s)\n",
+                             int(m_Cases.size()), int(m_Algorithms.size()), int(m_Functions.size()));
+    return true;
+}
+
+
+/**
+ * Sets the search domain and the reference min and max values of the function.
+ * The max value is only used by the GA's fitness; the min value is the analytical minimum
+ * of the standard functions, and is sampled on a fine grid for the random surface.
+ */
+void Optim2dBench::initFunction(enumFunction func, BenchCase const &bc)
+{
+    m_Function = func;
+    m_HalfSide = halfSide(func);
+
+    int const NGRID = 401;
+    m_ValMin =  LARGEVALUE;
+    m_ValMax = -LARGEVALUE;
+    for(int i=0; i<NGRID; i++)
+    {
+        double x = -m_HalfSide + 2.0*m_HalfSide*double(i)/double(NGRID-1);
+        for(int j=0; j<NGRID; j++)
+        {
+            double y = -m_HalfSide + 2.0*m_HalfSide*double(j)/double(NGRID-1);
+            double z = testFunction(func, x, y, bc);
+            m_ValMin = std::min(m_ValMin, z);
+            m_ValMax = std::max(m_ValMax, z);
+        }
+    }
+
+    if(func!=RANDOMSURFACE) m_ValMin = 0.0;
+}
+
+
+/** Evaluates the function and records the evaluation count when the target is first reached */
+double Optim2dBench::evaluate(double x, double y)
+{
+    m_nEvals++;
+    double z = testFunction(m_Function, x, y, *m_pCase);
+    double err = (z-m_ValMin)*(z-m_ValMin);
+    m_BestError = std::min(m_BestError, err);
+    if(m_EvalsToTarget<0 && err<m_pCase->m_MaxError) m_EvalsToTarget = m_nEvals;
+    return z;
+}
+
+
+void Optim2dBench::run(QString &log)
+{
+    m_Results.clear();
+
+    QElapsedTimer t;
+    for(int ic=0; ic<m_Cases.size(); ic++)
+    {
+        m_pCase = &m_Cases.at(ic);
+        for(int ifunc=0; ifunc<m_Functions.size(); ifunc++)
+        {
+            initFunction(m_Functions.at(ifunc), *m_pCase);
+            for(int ia=0; ia<m_Algorithms.size(); ia++)
+            {
+                enumAlgorithm algo = m_Algorithms.at(ia);
+                for(int irep=0; irep<m_pCase->m_Repeats; irep++)
+                {
+                    RunResult result;
+                    result.m_iCase = ic;
+                    result.m_Algo = algo;
+                    result.m_Function = m_Function;
+                    result.m_Seed = m_pCase->m_Seed + quint32(irep);
+
+                    m_Rng.seed(result.m_Seed);
+                    m_NormalEngine.seed(result.m_Seed);
+                    m_nEvals = 0;
+                    m_EvalsToTarget = -1;
+                    m_BestError = LARGEVALUE;
+
+                    t.start();
+                    switch(algo)
+                    {
+                        case PSO:     result.m_nIter = runPSO();     break;
+                        case GA:      result.m_nIter = runGA();      break;
+                        case SIMPLEX: result.m_nIter = runSimplex(); break;
+                    }
+                    result.m_WallTime = double(t.nsecsElapsed())/1.e6;
+
+                    result.m_bSuccess      = m_EvalsToTarget>=0;
+                    result.m_EvalsToTarget = m_EvalsToTarget;
+                    result.m_nEvals        = m_nEvals;
+                    result.m_BestError     = m_BestError;
+                    m_Results.append(result);
+                }
+
+                int nRuns=0, nSuccess=0;
+                double meanEvals=0, medianEvals=0, meanTime=0, evalRate=0;
+                summarize(ic, algo, m_Function, nRuns, nSuccess, meanEvals, medianEvals, meanTime, evalRate);
+                log += QString::asprintf("%-12s %-8s %-11s success=%3d/%-3d  evals-to-target: mean=%9.1f median=%9.1f  time=%9.3f ms  %11.0f evals/s\n",
+                                         m_pCase->m_Name.toStdString().c_str(),
+                                         algorithmName(algo).toStdString().c_str(),
+                                         functionName(m_Function).toStdString().c_str(),
+                                         nSuccess, nRuns, meanEvals, medianEvals, meanTime, evalRate);
+            }
+        }
+    }
+}
+
+
+/** Same update rules as gl3dOptim2d::onMakeSwarm and gl3dOptim2d::moveSwarm */
+int Optim2dBench::runPSO()
+{
+    BenchCase const &bc = *m_pCase;
+    int const n = bc.m_PopSize;
+
+    QVector<Vector2d> pos(n), vel(n), bestpos(n);
+    QVector<double> besterror(n);
+    Vector2d globalbest;
+    double error = LARGEVALUE;
+
+    for(int i=0; i<n; i++)
+    {
+        pos[i].x = uniform(m_HalfSide);
+        pos[i].y = uniform(m_HalfSide);
+        vel[i].x = uniform(m_HalfSide/2.0);
+        vel[i].y = uniform(m_HalfSide/2.0);
+        bestpos[i] = pos[i];
+        besterror[i] = evaluate(pos[i].x, pos[i].y) - m_ValMin;
+        if(besterror.at(i)<error)
+        {
+            error = besterror.at(i);
+            globalbest = pos.at(i);
+        }
+    }
+
+    int iter = 0;
+    while(!isDone(iter))
+    {
+        error = LARGEVALUE;
+        for(int i=0; i<n; i++)
+        {
+            for(int j=0; j<2; j++)
+            {
+                double r1 = m_Rng.bounded(1.0);
+                double r2 = m_Rng.bounded(1.0);
+                double v = bc.m_InertiaWeight * vel[i][j] +
+                           bc.m_CognitiveWeight * r1 * (bestpos[i][j]  - pos[i][j]) +
+                           bc.m_SocialWeight    * r2 * (globalbest[j] - pos[i][j]);
+                double newpos = pos[i][j] + v;
+                if(newpos<-m_HalfSide || newpos>m_HalfSide) v = -v;
+                vel[i][j] = v;
+                double p = pos[i][j] + v;
+                bound(p);
+                pos[i][j] = p;
+            }
+
+            double newerror = evaluate(pos[i].x, pos[i].y) - m_ValMin;
+            if(newerror<besterror.at(i))
+            {
+                bestpos[i] = pos.at(i);
+                besterror[i] = newerror;
+            }
+
+            if(m_Rng.bounded(1.0)<bc.m_ProbRegenerate)
+            {
+                pos[i].x = uniform(m_HalfSide);
+                pos[i].y = uniform(m_HalfSide);
+                newerror = evaluate(pos[i].x, pos[i].y) - m_ValMin;
+                bestpos[i] = pos.at(i);
+                besterror[i] = newerror;
+            }
+
+            if(newerror<error)
+            {
+                globalbest = pos.at(i);
+                error = newerror;
+            }
+        }
+        iter++;
+    }
+    return iter;
+}
+
+
+/**
+ * Same operators as gl3dOptim2d::makeNewGen: roulette selection, BLX-alpha crossover and gaussian mutation.
+ * Each individual is evaluated once per generation, after mutation.
+ */
+int Optim2dBench::runGA()
+{
+    BenchCase const &bc = *m_pCase;
+    int const n = bc.m_PopSize;
+    double const alpha = 0.5;
+
+    QVector<Vector2d> pop(n);
+    QVector<double> fit(n), cumul(n);
+    std::normal_distribution<double> distribution(0.0, bc.m_SigmaMutation);
+
+    for(int i=0; i<n; i++)
+    {
+        pop[i].x = uniform(m_HalfSide);
+        pop[i].y = uniform(m_HalfSide);
+        fit[i] = m_ValMax - evaluate(pop[i].x, pop[i].y);
+    }
+
+    int iter = 0;
+    while(!isDone(iter))
+    {
+        // roulette selection
+        cumul[0] = fit.at(0);
+        for(int i=1; i<n; i++) cumul[i] = cumul.at(i-1) + fit.at(i);
+
+        QVector<Vector2d> selected(n);
+        for(int i=0; i<n; i++)
+        {
+            double p = cumul.last()>0.0 ? m_Rng.bounded(cumul.last()) : 0.0;
+            int j=0;
+            while(j<n-1 && p>cumul.at(j)) j++;
+            selected[i] = pop.at(j);
+        }
+
+        // BLX-alpha crossover
+        pop.clear();
+        while(selected.size()>=2)
+        {
+            Vector2d parent0 = selected.takeAt(m_Rng.bounded(int(selected.size())));
+            Vector2d parent1 = selected.takeAt(m_Rng.bounded(int(selected.size())));
+            if(m_Rng.bounded(1.0)<bc.m_ProbXOver)
+            {
+                for(int ic=0; ic<2; ic++)
+                {
+                    Vector2d child;
+                    for(int j=0; j<2; j++)
+                    {
+                        double frac = -alpha + m_Rng.bounded(1.0+alpha);
+                        double gene = frac*parent0[j] + (1.0-frac)*parent1[j];
+                        bound(gene);
+                        child[j] = gene;
+                    }
+                    pop.append(child);
+                }
+            }
+            else
+            {
+                pop.append(parent0);
+                pop.append(parent1);
+            }
+        }
+        pop.append(selected); // the remaining single parent if odd population
+
+        // gaussian mutation and evaluation
+        for(int i=0; i<n; i++)
+        {
+            for(int j=0; j<2; j++)
+            {
+                if(m_Rng.bounded(1.0)<bc.m_ProbMutation)
+                {
+                    double gene = pop[i][j] + distribution(m_NormalEngine);
+                    bound(gene);
+                    pop[i][j] = gene;
+                }
+            }
+            fit[i] = m_ValMax - evaluate(pop[i].x, pop[i].y);
+        }
+        iter++;
+    }
+    return iter;
+}
+
+
+/** Same Nelder-Mead rules as gl3dOptim2d::moveSimplex; function values are cached at the vertices */
+int Optim2dBench::runSimplex()
+{
+    double const alpha=1.0, beta=0.5, gamma=2.0, delta=0.5;
+
+    Vector2d S[3];
+    double f[3]{0,0,0};
+    for(int i=0; i<3; i++)
+    {
+        S[i].x = uniform(m_HalfSide);
+        S[i].y = uniform(m_HalfSide);
+        f[i] = evaluate(S[i].x, S[i].y);
+    }
+
+    int iter = 0;
+    while(!isDone(iter))
+    {
+        iter++;
+
+        // re-order the vertices in crescending function values
+        if(f[0]>f[1]) {std::swap(S[0], S[1]); std::swap(f[0], f[1]);}
+        if(f[1]>f[2]) {std::swap(S[1], S[2]); std::swap(f[1], f[2]);}
+        if(f[0]>f[1]) {std::swap(S[0], S[1]); std::swap(f[0], f[1]);}
+
+        // center of the best side
+        Vector2d C((S[0].x+S[1].x)/2.0, (S[0].y+S[1].y)/2.0);
+
+        // reflect
+        double xr = C.x + alpha*(C.x-S[2].x);    bound(xr);
+        double yr = C.y + alpha*(C.y-S[2].y);    bound(yr);
+        double fr = evaluate(xr, yr);
+        if(f[0]<=fr && fr<f[1])
+        {
+            S[2].x = xr;  S[2].y = yr;  f[2] = fr;
+            continue;
+        }
+
+        // expand
+        if(fr<f[0])
+        {
+            double xe = C.x + gamma*(xr-C.x);    bound(xe);
+            double ye = C.y + gamma*(yr-C.y);    bound(ye);
+            double fe = evaluate(xe, ye);
+            if(fe<fr) {S[2].x = xe;  S[2].y = ye;  f[2] = fe;}
+            else      {S[2].x = xr;  S[2].y = yr;  f[2] = fr;}
+            continue;
+        }
+
+        // contract
+        if(fr<f[2])
+        {
+            //outside
+            double xc = C.x + beta*(xr-C.x);    bound(xc);
+            double yc = C.y + beta*(yr-C.y);    bound(yc);
+            double fc = evaluate(xc, yc);
+            if(fc<=fr)
+            {
+                S[2].x = xc;  S[2].y = yc;  f[2] = fc;
+                continue;
+            }
+        }
+        else
+        {
+            //inside
+            double xc = C.x + beta*(S[2].x-C.x);    bound(xc);
+            double yc = C.y + beta*(S[2].y-C.y);    bound(yc);
+            double fc = evaluate(xc, yc);
+            if(fc<f[2])
+            {
+                S[2].x = xc;  S[2].y = yc;  f[2] = fc;
+                continue;
+            }
+        }
+
+        // shrink
+        for(int i=1; i<3; i++)
+        {
+            S[i].x = S[0].x + (S[i].x-S[0].x)*delta;
+            S[i].y = S[0].y + (S[i].y-S[0].y)*delta;
+            f[i] = evaluate(S[i].x, S[i].y);
+        }
+    }
+    return iter;
+}
+
+
+void Optim2dBench::summarize(int iCase, enumAlgorithm algo, enumFunction func, int &nRuns, int &nSuccess,
+                             double &meanEvals, double &medianEvals, double &meanTime, double &evalRate) const
+{
+    nRuns = nSuccess = 0;
+    meanEvals = medianEvals = meanTime = evalRate = 0.0;
+
+    QVector<int> evals;
+    double totaltime = 0.0;
+    double totalevals = 0.0;
+    for(RunResult const &result : m_Results)
+    {
+        if(result.m_iCase!=iCase || result.m_Algo!=algo || result.m_Function!=func) continue;
+        nRuns++;
+        totaltime  += result.m_WallTime;
+        totalevals += result.m_nEvals;
+        if(result.m_bSuccess)
+        {
+            nSuccess++;
+            evals.append(result.m_EvalsToTarget);
+            meanEvals += result.m_EvalsToTarget;
+        }
+    }
+
+    if(nRuns>0)   meanTime = totaltime/double(nRuns);
+    if(totaltime>0.0) evalRate = totalevals/totaltime*1000.0;
+    if(nSuccess>0)
+    {
+        meanEvals /= double(nSuccess);
+        std::sort(evals.begin(), evals.end());
+        int mid = nSuccess/2;
+        medianEvals = (nSuccess%2==1) ? evals.at(mid) : (evals.at(mid-1)+evals.at(mid))/2.0;
+    }
+}
+
+
+QJsonObject Optim2dBench::jsonResults() const
+{
+    QJsonObject root;
+
+    QJsonArray cases;
+    for(BenchCase const &bc : m_Cases)
+    {
+        QJsonObject obj;
+        obj["name"]            = bc.m_Name;
+        obj["seed"]            = double(bc.m_Seed);
+        obj["repeats"]         = bc.m_Repeats;
+        obj["maxiter"]         = bc.m_MaxIter;
+        obj["popsize"]         = bc.m_PopSize;
+        obj["maxerror"]        = bc.m_MaxError;
+        obj["inertiaweight"]   = bc.m_InertiaWeight;
+        obj["cognitiveweight"] = bc.m_CognitiveWeight;
+        obj["socialweight"]    = bc.m_SocialWeight;
+        obj["probregenerate"]  = bc.m_ProbRegenerate;
+        obj["probxover"]       = bc.m_ProbXOver;
+        obj["probmutation"]    = bc.m_ProbMutation;
+        obj["sigmamutation"]   = bc.m_SigmaMutation;
+        obj["c0"]              = bc.m_c0;
+        obj["c1"]              = bc.m_c1;
+        obj["c2"]              = bc.m_c2;
+        cases.append(obj);
+    }
+    root["cases"] = cases;
+
+    QJsonArray runs;
+    for(RunResult const &result : m_Results)
+    {
+        QJsonObject obj;
+        obj["case"]          = m_Cases.at(result.m_iCase).m_Name;
+        obj["algorithm"]     = algorithmName(result.m_Algo);
+        obj["function"]      = functionName(result.m_Function);
+        obj["seed"]          = double(result.m_Seed);
+        obj["success"]       = result.m_bSuccess;
+        obj["evalstotarget"] = result.m_EvalsToTarget;
+        obj["evals"]         = result.m_nEvals;
+        obj["iterations"]    = result.m_nIter;
+        obj["besterror"]     = result.m_BestError;
+        obj["walltime_ms"]   = result.m_WallTime;
+        runs.append(obj);
+    }
+    root["runs"] = runs;
+
+    QJsonArray summary;
+    for(int ic=0; ic<m_Cases.size(); ic++)
+    {
+        for(enumFunction func : m_Functions)
+        {
+            for(enumAlgorithm algo : m_Algorithms)
+            {
+                int nRuns=0, nSuccess=0;
+                double meanEvals=0, medianEvals=0, meanTime=0, evalRate=0;
+                summarize(ic, algo, func, nRuns, nSuccess, meanEvals, medianEvals, meanTime, evalRate);
+                QJsonObject obj;
+                obj["case"]                = m_Cases.at(ic).m_Name;
+                obj["algorithm"]           = algorithmName(algo);
+                obj["function"]            = functionName(func);
+                obj["runs"]                = nRuns;
+                obj["successes"]           = nSuccess;
+                obj["successrate"]         = nRuns>0 ? double(nSuccess)/double(nRuns) : 0.0;
+                obj["evalstotarget_mean"]  = meanEvals;
+                obj["evalstotarget_median"]= medianEvals;
+                obj["walltime_ms_mean"]    = meanTime;
+                obj["evals_per_s"]         = evalRate;
+                summary.append(obj);
+            }
+        }
+    }
+    root["summary"] = summary;
+
+    return root;
+}
+
+
+QString Optim2dBench::csvSummary() const
+{
+    QString csv = "case,algorithm,function,runs,successes,successrate,evalstotarget_mean,evalstotarget_median,walltime_ms_mean,evals_per_s\n";
+    for(int ic=0; ic<m_Cases.size(); ic++)
+    {
+        for(enumFunction func : m_Functions)
+        {
+            for(enumAlgorithm algo : m_Algorithms)
+            {
+                int nRuns=0, nSuccess=0;
+                double meanEvals=0, medianEvals=0, meanTime=0, evalRate=0;
+                summarize(ic, algo, func, nRuns, nSuccess, meanEvals, medianEvals, meanTime, evalRate);
+                csv += m_Cases.at(ic).m_Name + "," + algorithmName(algo) + "," + functionName(func);
+                csv += QString::asprintf(",%d,%d,%g,%g,%g,%g,%g\n",
+                                         nRuns, nSuccess, nRuns>0 ? double(nSuccess)/double(nRuns) : 0.0,
+                                         meanEvals, medianEvals, meanTime, evalRate);
+            }
+        }
+    }
+    return csv;
+}
+
+
+/** Writes the results in CSV format if the file's suffix is .csv, and in JSON format otherwise */
+bool Optim2dBench::saveResults(QString const &pathname, QString &log) const
+{
+    QFile outfile(pathname);
+    if(!outfile.open(QIODevice::WriteOnly | QIODevice::Text))
+    {
+        log += "Could not open the output file "+pathname+"\n";
+        return false;
+    }
+
+    if(QFileInfo(pathname).suffix().compare("csv", Qt::CaseInsensitive)==0)
+    {
+        QTextStream out(&outfile);
+        out << csvSummary();
+    }
+    else
+    {
+        outfile.write(QJsonDocument(jsonResults()).toJson(QJsonDocument::Indented));
+    }
+    outfile.close();
+
+    log += "Results written to "+pathname+"\n";
+    return true;
+}
+
@@ -0,0 +1,122 @@
+/****************************************************************************
+
+    Xfl3d application
+    Copyright (C) Andre Deperrois
+    License: GPL v3
+
+*****************************************************************************/
+
+#pragma once
+
+#include <algorithm>
+#include <random>
+
+#include <QString>
+#include <QVector>
+#include <QJsonObject>
+#include <QRandomGenerator>
+
+#include <xflgeom/geom2d/vector2d.h>
+
+
+/**
+ * @class Optim2dBench
+ * Headless benchmark of the PSO, GA and Simplex algorithms demonstrated in gl3dOptim2d.
+ * Each algorithm is run repeatedly with fixed seeds on a set of standard test functions
+ * and the evaluations-to-target, wall time, evaluation rate and success rate are reported.
+ * The update rules are the same as those of the interactive view, without the rendering.
+ */
+class Optim2dBench
+{
+    public:
+        enum enumAlgorithm {PSO, GA, SIMPLEX};
+        enum enumFunction {RASTRIGIN, ROSENBROCK, ACKLEY, RANDOMSURFACE};
+
+        /** A set of algorithm settings; several cases may be compared in a single benchmark */
+        struct BenchCase
+        {
+            QString m_Name{"default"};
+            quint32 m_Seed{1};
+            int m_Repeats{10};
+            int m_MaxIter{1000};
+            int m_PopSize{29};
+            double m_MaxError{1.e-4};
+
+            //PSO specific
+            double m_InertiaWeight{0.3};
+            double m_CognitiveWeight{0.7};
+            double m_SocialWeight{0.7};
+            double m_ProbRegenerate{0.05};
+
+            //GA specific
+            double m_ProbXOver{0.5};
+            double m_ProbMutation{0.15};
+            double m_SigmaMutation{0.5};
+
+            // random surface coefficients
+            double m_c0{0.29}, m_c1{0.22}, m_c2{-0.43};
+        };
+
+        struct RunResult
+        {
+            int m_iCase{0};
+            enumAlgorithm m_Algo{PSO};
+            enumFunction m_Function{RASTRIGIN};
+            quint32 m_Seed{0};
+            bool m_bSuccess{false};
+            int m_EvalsToTarget{-1};   /**< the number of function evaluations when the error first dropped below the target, or -1 */
+            int m_nEvals{0};           /**< the total number of function evaluations */
+            int m_nIter{0};
+            double m_BestError{0};
+            double m_WallTime{0};      /**< the wall time in ms */
+        };
+
+    public:
+        Optim2dBench();
+
+        bool loadSettings(QString const &pathname, QString &log);
+        void run(QString &log);
+        bool saveResults(QString const &pathname, QString &log) const;
+
+        QJsonObject jsonResults() const;
+        QString csvSummary() const;
+
+        static QString algorithmName(enumAlgorithm algo);
+        static QString functionName(enumFunction func);
+        static double testFunction(enumFunction func, double x, double y, BenchCase const &bc);
+        static double halfSide(enumFunction func);
+
+    private:
+        void initFunction(enumFunction func, BenchCase const &bc);
+        double evaluate(double x, double y);
+        bool isDone(int iter) const {return m_EvalsToTarget>=0 || iter>=m_pCase->m_MaxIter;}
+        double uniform(double amp) {return m_Rng.bounded(2.0*amp)-amp;}
+        void bound(double &val) const {val = std::min(m_HalfSide, val); val = std::max(-m_HalfSide, val);}
+
+        int runPSO();
+        int runGA();
+        int runSimplex();
+
+        void summarize(int iCase, enumAlgorithm algo, enumFunction func, int &nRuns, int &nSuccess,
+                       double &meanEvals, double &medianEvals, double &meanTime, double &evalRate) const;
+
+    private:
+        QVector<BenchCase> m_Cases;
+        QVector<enumAlgorithm> m_Algorithms;
+        QVector<enumFunction> m_Functions;
+
+        QVector<RunResult> m_Results;
+
+        // current run
+        BenchCase const *m_pCase;
+        enumFunction m_Function;
+        double m_HalfSide;
+        double m_ValMin, m_ValMax;
+        int m_nEvals;
+        int m_EvalsToTarget;
+        double m_BestError;
+
+        QRandomGenerator m_Rng;
+        std::mt19937 m_NormalEngine;
+};
+
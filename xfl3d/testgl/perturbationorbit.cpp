@@ -0,0 +1,164 @@
+/****************************************************************************
+
+    Xfl3d application
+    Copyright (C) Andre Deperrois
+    License: GPL v3
+
+*****************************************************************************/
+
+#include <algorithm>
+#include <cmath>
+
+#include "perturbationorbit.h"
+
+
+PerturbationOrbit::PerturbationOrbit()
+{
+    m_MaxIter = 0;
+    m_MaxLength = 10.0;
+    m_Skip = 0;
+    m_DeltaMax = 0.0;
+    for(int i=0; i<6; i++) m_Coef[i] = 0.0;
+}
+
+
+/**
+ * Computes the reference orbit Z(n+1)=Z(n)²+C, starting from Z(0)=0,
+ * until the orbit escapes or the max number of iterations is reached.
+ */
+void PerturbationOrbit::compute(BigReal const &cx, BigReal const &cy, int maxiter, double maxlength)
+{
+    m_MaxIter = maxiter;
+    m_MaxLength = maxlength;
+
+    // pixels are rebased when the reference escapes, so the reference can bail out early;
+    // this also keeps the values within the range of the BigReal's integer part
+    double const refbailout = std::min(maxlength, 1.e4);
+    double const refbailout2 = refbailout*refbailout;
+
+    m_Orbit.clear();
+    m_Orbit.reserve(2*(maxiter+1));
+
+    BigReal x, y;
+    m_Orbit.append(0.0);
+    m_Orbit.append(0.0);
+    for(int n=0; n<maxiter; n++)
+    {
+        BigReal xy = x*y;
+        BigReal xn = x*x - y*y + cx;
+        y = xy + xy + cy;
+        x = xn;
+
+        double zx = x.toDouble();
+        double zy = y.toDouble();
+        m_Orbit.append(zx);
+        m_Orbit.append(zy);
+        if(zx*zx+zy*zy>=refbailout2) break;
+    }
+
+    m_Skip = 0;
+    for(int i=0; i<6; i++) m_Coef[i] = 0.0;
+}
+
+
+/**
+ * Computes the coefficients of the series dz(n) = A(n).dc + B(n).dc² + C(n).dc³
+ *     A(n+1) = 2.Z(n).A(n) + 1
+ *     B(n+1) = 2.Z(n).B(n) + A(n)²
+ *     C(n+1) = 2.Z(n).C(n) + 2.A(n).B(n)
+ * The coefficients are scaled by powers of deltamax to remain within the range of doubles.
+ * The series is used as long as the third order term is negligible compared to the first order term
+ * for all the pixels of the image, i.e. for |dc|<=deltamax.
+ */
+void PerturbationOrbit::computeSeries(double deltamax)
+{
+    double const tolerance = 1.e-6;
+
+    m_DeltaMax = deltamax;
+    m_Skip = 0;
+    for(int i=0; i<6; i++) m_Coef[i] = 0.0;
+    if(deltamax<=0.0 || isEmpty()) return;
+
+    double ax=0, ay=0, bx=0, by=0, cx=0, cy=0;
+    int nmax = std::min(length()-2, m_MaxIter-1);
+    for(int n=0; n<nmax; n++)
+    {
+        double zx = 2.0*m_Orbit.at(2*n);
+        double zy = 2.0*m_Orbit.at(2*n+1);
+
+        double nax = zx*ax - zy*ay + deltamax;
+        double nay = zx*ay + zy*ax;
+        double nbx = zx*bx - zy*by + ax*ax - ay*ay;
+        double nby = zx*by + zy*bx + 2.0*ax*ay;
+        double ncx = zx*cx - zy*cy + 2.0*(ax*bx - ay*by);
+        double ncy = zx*cy + zy*cx + 2.0*(ax*by + ay*bx);
+
+        double a = sqrt(nax*nax+nay*nay);
+        double c = sqrt(ncx*ncx+ncy*ncy);
+        if(!std::isfinite(a) || !std::isfinite(c) || c>tolerance*a) break;
+
+        ax = nax;  ay = nay;
+        bx = nbx;  by = nby;
+        cx = ncx;  cy = ncy;
+        m_Skip = n+1;
+    }
+
+    m_Coef[0] = ax;  m_Coef[1] = ay;
+    m_Coef[2] = bx;  m_Coef[3] = by;
+    m_Coef[4] = cx;  m_Coef[5] = cy;
+}
+
+
+/**
+ * Returns the escape iteration of the pixel c=C+dc, or maxiter if the pixel did not escape.
+ * The count is the same as in julia_FS.glsl.
+ */
+int PerturbationOrbit::iterate(double dcx, double dcy) const
+{
+    double const maxlength2 = m_MaxLength*m_MaxLength;
+    double const *Z = m_Orbit.constData();
+    int const nref = length();
+
+    double dzx=0, dzy=0;
+    if(m_Skip>0)
+    {
+        double ux = dcx/m_DeltaMax;
+        double uy = dcy/m_DeltaMax;
+        double u2x = ux*ux - uy*uy;
+        double u2y = 2.0*ux*uy;
+        double u3x = u2x*ux - u2y*uy;
+        double u3y = u2x*uy + u2y*ux;
+        dzx = m_Coef[0]*ux  - m_Coef[1]*uy  + m_Coef[2]*u2x - m_Coef[3]*u2y + m_Coef[4]*u3x - m_Coef[5]*u3y;
+        dzy = m_Coef[0]*uy  + m_Coef[1]*ux  + m_Coef[2]*u2y + m_Coef[3]*u2x + m_Coef[4]*u3y + m_Coef[5]*u3x;
+    }
+
+    int m = m_Skip;
+    int iter = m_Skip;
+    while(iter<m_MaxIter)
+    {
+        // dz = (2Z+dz).dz + dc
+        double tx = 2.0*Z[2*m]   + dzx;
+        double ty = 2.0*Z[2*m+1] + dzy;
+        double nx = tx*dzx - ty*dzy + dcx;
+        double ny = tx*dzy + ty*dzx + dcy;
+        dzx = nx;
+        dzy = ny;
+        m++;
+        iter++;
+
+        double zx = Z[2*m]   + dzx;
+        double zy = Z[2*m+1] + dzy;
+        double r2 = zx*zx + zy*zy;
+        if(r2>=maxlength2) break;
+
+        if(r2<dzx*dzx+dzy*dzy || m>=nref-1)
+        {
+            // rebase on the start of the reference orbit
+            dzx = zx;
+            dzy = zy;
+            m = 0;
+        }
+    }
+    return iter;
+}
+
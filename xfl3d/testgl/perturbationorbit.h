@@ -0,0 +1,53 @@
+/****************************************************************************
+
+    Xfl3d application
+    Copyright (C) Andre Deperrois
+    License: GPL v3
+
+*****************************************************************************/
+
+#pragma once
+
+#include <QVector>
+
+#include <xflmath/bigreal.h>
+
+
+/**
+ * @class PerturbationOrbit
+ * The high precision reference orbit used to render deep zooms of the Mandelbrot set.
+ * The reference point C is the view's center, computed with BigReal numbers; each pixel
+ * at c=C+dc then only iterates its difference dz with the reference orbit, in double precision:
+ *     dz(n+1) = 2.Z(n).dz(n) + dz(n)² + dc
+ * A third order series approximation of dz in powers of dc skips the first iterations,
+ * and the pixel's orbit is rebased on the start of the reference orbit when |Z+dz|<|dz|
+ * or when the reference orbit has escaped, which avoids the glitches due to the loss of precision.
+ */
+class PerturbationOrbit
+{
+    public:
+        PerturbationOrbit();
+
+        void compute(BigReal const &cx, BigReal const &cy, int maxiter, double maxlength);
+        void computeSeries(double deltamax);
+
+        int iterate(double dcx, double dcy) const;
+
+        bool isEmpty() const {return m_Orbit.size()<4;}
+        int length() const {return int(m_Orbit.size()/2);}
+        QVector<double> const &orbit() const {return m_Orbit;}
+
+        int skip() const {return m_Skip;}
+        double deltaMax() const {return m_DeltaMax;}
+        double const *seriesCoefs() const {return m_Coef;}
+
+    private:
+        QVector<double> m_Orbit; /**< the interleaved (x,y) values of the reference orbit Z(n) */
+        int m_MaxIter;
+        double m_MaxLength;
+
+        int m_Skip;            /**< the number of iterations skipped by the series approximation */
+        double m_DeltaMax;     /**< the largest |dc| in the image */
+        double m_Coef[6];      /**< the complex coefficients A, B, C of the series, scaled by deltamax, deltamax², deltamax³ */
+};
+
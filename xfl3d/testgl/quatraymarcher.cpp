@@ -0,0 +1,409 @@
+/****************************************************************************
+
+    Xfl3d application
+    Copyright (C) Andre Deperrois
+    License: GPL v3
+
+*****************************************************************************/
+
+#include <cmath>
+
+#include <QElapsedTimer>
+#include <QFutureSynchronizer>
+#include <QtConcurrent/QtConcurrent>
+
+#include "quatraymarcher.h"
+
+#include <xflcore/xflcore.h>
+
+
+QuatRayMarcher::QuatRayMarcher()
+{
+    setSeed(0.0, 0.0, 0.0, 0.0);
+    setSlice(0, 0.0, 0.0);
+    m_MaxIter = 128;
+    m_MaxLength = 10.0;
+    m_Tau = 1.0f;
+
+    setEye(0.0, 0.0, -5.0);
+    setLight(2.5, 2.5, -2.5);
+    m_uc = m_vc = 0.0;
+    m_PixelSize = 1.0/1024.0;
+
+    m_MaxSteps = 256;
+    m_Omega = 1.6;
+    m_bBoundingSphere = true;
+    m_MaxDistance = 100.0;
+    m_TileSize = 32;
+
+    m_RenderTime = 0.0;
+    m_nPixels = 0;
+    m_nSteps = 0;
+}
+
+
+/**
+ * Sets the slice with the same index as in quat_FS.glsl.
+ * The components are stored in the order x, y, z, w, with w the real part of the quaternion.
+ * The theta-phi slice has no 3d equivalent, and is replaced by the x-y slice.
+ */
+void QuatRayMarcher::setSlice(int iSlice, double slicer0, double slicer1)
+{
+    // the quaternion components of the 3d point's x, y and z, and of the fixed value
+    int const comps[6][4] = {{2,3,0,1},   // x-y
+                             {1,3,0,2},   // x-z
+                             {0,3,1,2},   // y-z
+                             {1,2,0,3},   // x-w
+                             {0,2,1,3},   // y-w
+                             {0,1,2,3}};  // z-w
+    m_iSlice = (iSlice>=0 && iSlice<6) ? iSlice : 0;
+    for(int k=0; k<4; k++) m_iComp[k] = comps[m_iSlice][k];
+    m_Slicer[0] = slicer0;
+    m_Slicer[1] = slicer1;
+}
+
+
+/**
+ * The 4d Julia set is inside the ball of radius 1/2+sqrt(1/4+|c|), since the points outside escape.
+ * @return the radius of the ball's 3d section, or a negative value if the section is empty.
+ */
+double QuatRayMarcher::boundingRadius() const
+{
+    double c = sqrt(m_Seed[0]*m_Seed[0] + m_Seed[1]*m_Seed[1] + m_Seed[2]*m_Seed[2] + m_Seed[3]*m_Seed[3]);
+    double R = 0.5 + sqrt(0.25+c);
+    double r2 = R*R - m_Slicer[1]*m_Slicer[1];
+    return r2>0.0 ? sqrt(r2) : -1.0;
+}
+
+
+/** Centers the view on the origin and sets the pixel size so that the bounding sphere fills the image */
+void QuatRayMarcher::fitView(int width, int height)
+{
+    double r = boundingRadius();
+    double d = sqrt(m_Eye[0]*m_Eye[0] + m_Eye[1]*m_Eye[1] + m_Eye[2]*m_Eye[2]);
+    if(r<=0.0 || d<=r || m_Eye[2]>=0.0 || width<=0 || height<=0) return; // the origin is not in front of the eye
+
+    m_uc = m_Eye[0]/m_Eye[2];
+    m_vc = m_Eye[1]/m_Eye[2];
+    double halfextent = r*d/(sqrt(d*d-r*r)*(-m_Eye[2]));
+    m_PixelSize = 2.0*1.1*halfextent/double(std::min(width, height));
+}
+
+
+/**
+ * Renders the image with the current settings.
+ * The y-axis of the view points upwards as in the OpenGL views.
+ */
+QImage QuatRayMarcher::render(int width, int height)
+{
+    QElapsedTimer t;
+    t.start();
+
+    QImage img(width, height, QImage::Format_RGB888);
+    if(img.isNull()) return img; // allocation failure
+
+    QVector<QRect> tiles;
+    for(int y0=0; y0<height; y0+=m_TileSize)
+    {
+        for(int x0=0; x0<width; x0+=m_TileSize)
+        {
+            tiles.append(QRect(x0, y0, std::min(m_TileSize, width-x0), std::min(m_TileSize, height-y0)));
+        }
+    }
+
+    uchar *pBits = img.bits();
+    int bytesperline = int(img.bytesPerLine());
+    std::atomic<int> next(0);
+    m_nSteps = 0;
+
+    int nThreads = xfl::isMultiThreaded() ? std::max(1, xfl::maxThreadCount()) : 1;
+    nThreads = std::min(nThreads, int(tiles.size()));
+
+    if(nThreads<=1)
+    {
+        renderTiles(pBits, bytesperline, width, height, &tiles, &next);
+    }
+    else
+    {
+        QFutureSynchronizer<void> futureSync;
+        for(int it=0; it<nThreads; it++)
+        {
+#if (QT_VERSION < QT_VERSION_CHECK(6, 0, 0))
+            futureSync.addFuture(QtConcurrent::run(this, &QuatRayMarcher::renderTiles, pBits, bytesperline, width, height, &tiles, &next));
+#else
+            futureSync.addFuture(QtConcurrent::run(&QuatRayMarcher::renderTiles, this, pBits, bytesperline, width, height, &tiles, &next));
+#endif
+        }
+        futureSync.waitForFinished();
+    }
+
+    m_RenderTime = double(t.nsecsElapsed())/1.e6;
+    m_nPixels = qint64(width)*qint64(height);
+
+    return img;
+}
+
+
+/** Worker loop: takes the next available tile until all have been rendered */
+void QuatRayMarcher::renderTiles(uchar *pBits, int bytesperline, int width, int height, QVector<QRect> const *pTiles, std::atomic<int> *pNext)
+{
+    qint64 nsteps = 0;
+    int itile = pNext->fetch_add(1);
+    while(itile<pTiles->size())
+    {
+        renderTile(pBits, bytesperline, width, height, pTiles->at(itile), nsteps);
+        itile = pNext->fetch_add(1);
+    }
+    m_nSteps += nsteps;
+}
+
+
+void QuatRayMarcher::renderTile(uchar *pBits, int bytesperline, int width, int height, QRect const &tile, qint64 &nsteps) const
+{
+    double dx[NLANES], dy[NLANES], dz[NLANES];
+    double t[NLANES];
+    int steps[NLANES];
+    bool bHit[NLANES];
+    double px[NLANES], py[NLANES], pz[NLANES];
+    int active[NLANES];
+    double grad[6][NLANES];
+
+    double const red   = double(xfl::getRed(m_Tau));
+    double const green = double(xfl::getGreen(m_Tau));
+    double const blue  = double(xfl::getBlue(m_Tau));
+    double const background = 0.05;
+
+    double u0 = m_uc - 0.5*double(width-1) *m_PixelSize;
+    double v0 = m_vc + 0.5*double(height-1)*m_PixelSize;
+
+    for(int j=tile.top(); j<=tile.bottom(); j++)
+    {
+        uchar *pLine = pBits + qint64(j)*bytesperline;
+        double v = v0 - double(j)*m_PixelSize;
+        for(int i=tile.left(); i<=tile.right(); i+=NLANES)
+        {
+            int nl = std::min(NLANES, tile.right()+1-i);
+            for(int l=0; l<NLANES; l++)
+            {
+                // pad the last packet with the last pixel
+                double u = u0 + double(i+std::min(l, nl-1))*m_PixelSize;
+                double norm = sqrt(u*u + v*v + 1.0);
+                dx[l] = u/norm;
+                dy[l] = v/norm;
+                dz[l] = 1.0/norm;
+            }
+
+            marchLanes(dx, dy, dz, t, steps, bHit);
+
+            // normals from the central differences of the distance estimator, for the rays which hit the surface
+            int nhit = 0;
+            for(int l=0; l<NLANES; l++)
+            {
+                active[l] = (bHit[l] && l<nl) ? 1 : 0;
+                nhit += active[l];
+            }
+            if(nhit>0)
+            {
+                for(int k=0; k<6; k++)
+                {
+                    for(int l=0; l<NLANES; l++)
+                    {
+                        double h = std::max(0.5*m_PixelSize*t[l], 1.e-7);
+                        double s = (k%2==0) ? h : -h;
+                        px[l] = m_Eye[0] + t[l]*dx[l] + (k/2==0 ? s : 0.0);
+                        py[l] = m_Eye[1] + t[l]*dy[l] + (k/2==1 ? s : 0.0);
+                        pz[l] = m_Eye[2] + t[l]*dz[l] + (k/2==2 ? s : 0.0);
+                    }
+                    distanceLanes(px, py, pz, active, grad[k]);
+                }
+            }
+
+            for(int l=0; l<nl; l++)
+            {
+                nsteps += steps[l];
+                double r=background, g=background, b=background;
+                if(bHit[l])
+                {
+                    double nx = grad[0][l]-grad[1][l];
+                    double ny = grad[2][l]-grad[3][l];
+                    double nz = grad[4][l]-grad[5][l];
+                    double nn = sqrt(nx*nx + ny*ny + nz*nz);
+
+                    double x = m_Eye[0] + t[l]*dx[l];
+                    double y = m_Eye[1] + t[l]*dy[l];
+                    double z = m_Eye[2] + t[l]*dz[l];
+                    double lx = m_Light[0]-x, ly = m_Light[1]-y, lz = m_Light[2]-z;
+                    double ll = sqrt(lx*lx + ly*ly + lz*lz);
+
+                    double diffuse = 0.0;
+                    if(nn>0.0 && ll>0.0) diffuse = std::max(0.0, (nx*lx + ny*ly + nz*lz)/nn/ll);
+
+                    // darken the creases, where the rays need many steps to converge
+                    double occlusion = 1.0 - 0.5*double(steps[l])/double(m_MaxSteps);
+                    double f = (0.15 + 0.85*diffuse) * occlusion;
+                    r = f*red;
+                    g = f*green;
+                    b = f*blue;
+                }
+                uchar *pPixel = pLine + 3*(i+l);
+                pPixel[0] = uchar(std::round(std::min(1.0, r)*255.0));
+                pPixel[1] = uchar(std::round(std::min(1.0, g)*255.0));
+                pPixel[2] = uchar(std::round(std::min(1.0, b)*255.0));
+            }
+        }
+    }
+}
+
+
+/**
+ * Sphere traces NLANES rays from the eye position.
+ * The steps are over-relaxed by the factor omega; if the unbounding sphere at the new point does not
+ * overlap the previous one, the step may have crossed the surface, so the ray reverts to the plain step
+ * and continues without relaxation.
+ * The surface is hit when the distance is less than the half-width of the pixel's cone.
+ * @param dx, dy, dz the normalized directions of the rays
+ * @param t the distance to the surface along each ray, if the ray hits the surface
+ */
+void QuatRayMarcher::marchLanes(double const *dx, double const *dy, double const *dz, double *t, int *steps, bool *bHit) const
+{
+    double tmax[NLANES], omega[NLANES], prevr[NLANES], step[NLANES];
+    double px[NLANES], py[NLANES], pz[NLANES], dist[NLANES];
+    int active[NLANES];
+
+    double const rb = boundingRadius();
+    for(int l=0; l<NLANES; l++)
+    {
+        steps[l] = 0;
+        bHit[l] = false;
+        omega[l] = m_Omega;
+        prevr[l] = 0.0;
+        step[l] = 0.0;
+        active[l] = 1;
+        t[l] = 0.0;
+        tmax[l] = m_MaxDistance;
+
+        if(m_bBoundingSphere)
+        {
+            // early out if the ray misses the bounding sphere; otherwise march only inside the sphere
+            double b = m_Eye[0]*dx[l] + m_Eye[1]*dy[l] + m_Eye[2]*dz[l];
+            double c = m_Eye[0]*m_Eye[0] + m_Eye[1]*m_Eye[1] + m_Eye[2]*m_Eye[2] - rb*rb;
+            double disc = b*b - c;
+            if(rb<=0.0 || disc<0.0 || -b+sqrt(disc)<0.0)
+            {
+                active[l] = 0;
+                continue;
+            }
+            t[l]    = std::max(0.0, -b-sqrt(disc));
+            tmax[l] = -b+sqrt(disc);
+        }
+    }
+
+    for(int is=0; is<m_MaxSteps; is++)
+    {
+        int nactive = 0;
+        for(int l=0; l<NLANES; l++)
+        {
+            px[l] = m_Eye[0] + t[l]*dx[l];
+            py[l] = m_Eye[1] + t[l]*dy[l];
+            pz[l] = m_Eye[2] + t[l]*dz[l];
+            nactive += active[l];
+        }
+        if(nactive==0) break;
+
+        distanceLanes(px, py, pz, active, dist);
+
+        for(int l=0; l<NLANES; l++)
+        {
+            if(!active[l]) continue;
+            steps[l]++;
+
+            double r = dist[l];
+            if(omega[l]>1.0 && r+prevr[l]<step[l])
+            {
+                // revert to the plain step from the previous point
+                t[l] += prevr[l]-step[l];
+                step[l] = prevr[l];
+                omega[l] = 1.0;
+                continue;
+            }
+
+            if(r<std::max(0.5*m_PixelSize*t[l], 1.e-7))
+            {
+                bHit[l] = true;
+                active[l] = 0;
+                continue;
+            }
+
+            step[l] = omega[l]*r;
+            prevr[l] = r;
+            t[l] += step[l];
+            if(t[l]>tmax[l]) active[l] = 0;
+        }
+    }
+}
+
+
+/**
+ * Evaluates the distance estimator at NLANES points.
+ * The iterations of the lanes which have escaped are masked out; the group stops when all lanes have escaped.
+ * The distance is 0 for the points which do not escape, i.e. the points inside the set,
+ * and is not evaluated for the inactive lanes.
+ */
+void QuatRayMarcher::distanceLanes(double const *px, double const *py, double const *pz, int const *active, double *dist) const
+{
+    double const maxlength2 = m_MaxLength*m_MaxLength;
+
+    double q[4][NLANES];
+    double md[NLANES], r2[NLANES];
+    int running[NLANES];
+
+    for(int l=0; l<NLANES; l++)
+    {
+        q[m_iComp[0]][l] = px[l];
+        q[m_iComp[1]][l] = py[l];
+        q[m_iComp[2]][l] = pz[l];
+        q[m_iComp[3]][l] = m_Slicer[1];
+        md[l] = 1.0;
+        r2[l] = 0.0;
+        running[l] = active[l];
+    }
+
+    double const cx = m_Seed[0], cy = m_Seed[1], cz = m_Seed[2], cw = m_Seed[3];
+    double *qx = q[0], *qy = q[1], *qz = q[2], *qw = q[3];
+    for(int it=0; it<m_MaxIter; it++)
+    {
+        int nrunning = 0;
+        for(int l=0; l<NLANES; l++)
+        {
+            // q² + c, with w the real part
+            double nw = qw[l]*qw[l] - qx[l]*qx[l] - qy[l]*qy[l] - qz[l]*qz[l] + cw;
+            double nx = 2.0*qw[l]*qx[l] + cx;
+            double ny = 2.0*qw[l]*qy[l] + cy;
+            double nz = 2.0*qw[l]*qz[l] + cz;
+            double q2 = qw[l]*qw[l] + qx[l]*qx[l] + qy[l]*qy[l] + qz[l]*qz[l];
+            double nmd = 2.0*sqrt(q2)*md[l];
+            double n2 = nw*nw + nx*nx + ny*ny + nz*nz;
+
+            qw[l] = running[l] ? nw  : qw[l];
+            qx[l] = running[l] ? nx  : qx[l];
+            qy[l] = running[l] ? ny  : qy[l];
+            qz[l] = running[l] ? nz  : qz[l];
+            md[l] = running[l] ? nmd : md[l];
+            r2[l] = running[l] ? n2  : r2[l];
+            running[l] &= (n2<maxlength2) ? 1 : 0;
+            nrunning += running[l];
+        }
+        if(nrunning==0) break;
+    }
+
+    for(int l=0; l<NLANES; l++)
+    {
+        dist[l] = 0.0;
+        if(active[l] && r2[l]>=maxlength2 && md[l]>0.0)
+        {
+            double r = sqrt(r2[l]);
+            dist[l] = 0.5*r*log(r)/md[l];
+        }
+    }
+}
+
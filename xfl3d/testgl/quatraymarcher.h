@@ -0,0 +1,99 @@
+/****************************************************************************
+
+    Xfl3d application
+    Copyright (C) Andre Deperrois
+    License: GPL v3
+
+*****************************************************************************/
+
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+
+#include <QImage>
+#include <QRect>
+#include <QVector>
+
+
+/**
+ * @class QuatRayMarcher
+ * CPU ray-marcher for the 3d sections of the quaternion Julia sets q(n+1) = q(n)² + c.
+ * The 3d section uses the same slices as gl2dQuat and quat_FS.glsl: the x and y coordinates
+ * of the 3d point are the two components of the 2d slice, the z coordinate is the component set
+ * by the first slicer value, and the last component is fixed at the second slicer value.
+ * The camera follows the convention of gl2dRM and raymarching_FS.glsl, i.e. the eye looks
+ * towards +z and the ray through the view coordinates (u,v) has the direction (u,v,1).
+ *
+ * The surface is found by sphere tracing the distance estimator
+ *     d = 0.5.|q|.log|q|/|q'|   with q'(n+1) = 2.q(n).q'(n)
+ * with over-relaxed steps which fall back to plain steps when two successive
+ * unbounding spheres do not overlap. Rays are marched in packets of NLANES with
+ * masking of the finished rays, and the image is split into tiles shared between threads.
+ * Does not require an OpenGL context.
+ */
+class QuatRayMarcher
+{
+    public:
+        static int const NLANES = 8;   /**< the number of rays marched together */
+
+    public:
+        QuatRayMarcher();
+
+        void setSeed(double x, double y, double z, double w) {m_Seed[0]=x; m_Seed[1]=y; m_Seed[2]=z; m_Seed[3]=w;}
+        void setSlice(int iSlice, double slicer0, double slicer1);
+        void setMaxIter(int maxiter) {m_MaxIter=std::max(1, maxiter);}
+        void setMaxLength(double maxlength) {m_MaxLength=std::max(2.0, maxlength);}
+        void setHue(float tau) {m_Tau=tau;}
+
+        void setEye(double x, double y, double z) {m_Eye[0]=x; m_Eye[1]=y; m_Eye[2]=z;}
+        void setLight(double x, double y, double z) {m_Light[0]=x; m_Light[1]=y; m_Light[2]=z;}
+
+        /** Sets the view coordinates (u,v) of the image's center, and the size of one pixel in view coordinates */
+        void setView(double uc, double vc, double pixelsize) {m_uc=uc; m_vc=vc; m_PixelSize=pixelsize;}
+        void fitView(int width, int height);
+
+        void setMaxSteps(int maxsteps) {m_MaxSteps=std::max(1, maxsteps);}
+        void setRelaxation(double omega) {m_Omega=std::max(1.0, std::min(omega, 2.0));}
+        void setBoundingSphere(bool bBounding) {m_bBoundingSphere=bBounding;}
+        void setTileSize(int size) {m_TileSize=std::max(NLANES, size);}
+
+        QImage render(int width, int height);
+
+        double boundingRadius() const;
+
+        double renderTime() const {return m_RenderTime;}
+        double msPerMegaPixel() const {return m_nPixels>0 ? m_RenderTime/(double(m_nPixels)/1.e6) : 0.0;}
+        double stepsPerPixel() const {return m_nPixels>0 ? double(m_nSteps)/double(m_nPixels) : 0.0;}
+
+    private:
+        void renderTiles(uchar *pBits, int bytesperline, int width, int height, QVector<QRect> const *pTiles, std::atomic<int> *pNext);
+        void renderTile(uchar *pBits, int bytesperline, int width, int height, QRect const &tile, qint64 &nsteps) const;
+        void marchLanes(double const *dx, double const *dy, double const *dz, double *t, int *steps, bool *bHit) const;
+        void distanceLanes(double const *px, double const *py, double const *pz, int const *active, double *dist) const;
+
+    private:
+        double m_Seed[4];
+        int m_iSlice;
+        double m_Slicer[2];
+        int m_iComp[4];        /**< the quaternion components of the 3d point's x, y, z coordinates and of the fixed value */
+        int m_MaxIter;
+        double m_MaxLength;
+        float m_Tau;
+
+        double m_Eye[3];
+        double m_Light[3];
+        double m_uc, m_vc;
+        double m_PixelSize;
+
+        int m_MaxSteps;
+        double m_Omega;        /**< the over-relaxation factor of the steps */
+        bool m_bBoundingSphere;
+        double m_MaxDistance;  /**< the max. length of the rays if the bounding sphere is not used */
+        int m_TileSize;
+
+        double m_RenderTime;   /**< the wall time of the last render, in ms */
+        qint64 m_nPixels;
+        std::atomic<qint64> m_nSteps;
+};
+
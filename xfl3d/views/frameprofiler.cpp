@@ -0,0 +1,478 @@
+/****************************************************************************
+
+    Xfl3d application
+    Copyright (C) Andre Deperrois
+    License: GPL v3
+
+*****************************************************************************/
+
+#include <cmath>
+
+#include <QFile>
+#include <QFontMetrics>
+#include <QJsonArray>
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <QOpenGLContext>
+#include <QOpenGLTimerQuery>
+#include <QPainter>
+#include <QTextStream>
+
+#include "frameprofiler.h"
+#include <xflcore/displayoptions.h>
+
+
+bool FrameProfiler::s_bEnabled(false);
+bool FrameProfiler::s_bOverlay(true);
+int FrameProfiler::s_Capacity(600);
+int FrameProfiler::s_nQuerySets(4);
+double FrameProfiler::s_IdleGap(250.0);
+
+static char const *stageName[] = {"makeobjects", "render", "overlay"};
+
+
+double FrameProfiler::Frame::gpuTime() const
+{
+    if(m_Gpu[0]<0.0 || m_Gpu[1]<0.0 || m_Gpu[2]<0.0) return -1.0;
+    return m_Gpu[0]+m_Gpu[1]+m_Gpu[2];
+}
+
+
+FrameProfiler::FrameProfiler()
+{
+    m_nFrames = 0;
+    m_NextId = 0;
+    m_StageStart = 0;
+    m_LastFrameStart = -1.0;
+    m_bInFrame = false;
+
+    m_iQuerySet = -1;
+    m_bGpuQueries = false;
+    m_bQueriesMade = false;
+
+    m_TargetInterval = 1000.0/60.0;
+
+    m_Clock.start();
+}
+
+
+/**
+ * The owning view releases the queries in cleanupGL() with its context current, when the context is about to be
+ * destroyed and in its destructor. Any query left over is released here only if a context is current.
+ */
+FrameProfiler::~FrameProfiler()
+{
+    if(QOpenGLContext::currentContext()) cleanupGL();
+}
+
+
+void FrameProfiler::cleanupGL()
+{
+    for(int i=0; i<m_Queries.size(); i++)
+    {
+        for(int is=0; is<NSTAGES; is++)
+        {
+            if(m_Queries[i].m_pQuery[is])
+            {
+                m_Queries[i].m_pQuery[is]->destroy();
+                delete m_Queries[i].m_pQuery[is];
+                m_Queries[i].m_pQuery[is] = nullptr;
+            }
+        }
+    }
+    m_Queries.clear();
+    m_bQueriesMade = false;
+    m_bGpuQueries = false;
+}
+
+
+void FrameProfiler::clear()
+{
+    m_nFrames = 0;
+    m_LastFrameStart = -1.0;
+    for(int i=0; i<m_Queries.size(); i++) m_Queries[i].m_FrameId = -1;
+}
+
+
+/** Creates the GPU queries; the timer queries are not available with OpenGL ES and with some drivers */
+void FrameProfiler::makeQueries()
+{
+    m_bQueriesMade = true;
+    m_bGpuQueries = false;
+    if(!QOpenGLContext::currentContext()) return;
+
+    m_Queries.resize(s_nQuerySets);
+    for(int i=0; i<m_Queries.size(); i++)
+    {
+        for(int is=0; is<NSTAGES; is++)
+        {
+            QOpenGLTimerQuery *pQuery = new QOpenGLTimerQuery;
+            if(!pQuery->create())
+            {
+                delete pQuery;
+                cleanupGL();
+                m_bQueriesMade = true;
+                return;
+            }
+            m_Queries[i].m_pQuery[is] = pQuery;
+        }
+    }
+    m_bGpuQueries = true;
+}
+
+
+/**
+ * Reads back the results of the query sets issued for the previous frames.
+ * @param bWait if true, waits for the results; otherwise only the sets for which all the results are available are read.
+ */
+void FrameProfiler::readQueries(bool bWait)
+{
+    for(int i=0; i<m_Queries.size(); i++)
+    {
+        QuerySet &qs = m_Queries[i];
+        if(qs.m_FrameId<0) continue;
+
+        bool bAvailable = true;
+        if(!bWait)
+        {
+            for(int is=0; is<NSTAGES; is++)
+            {
+                if(qs.m_bIssued[is] && !qs.m_pQuery[is]->isResultAvailable())
+                {
+                    bAvailable = false;
+                    break;
+                }
+            }
+        }
+        if(!bAvailable) continue;
+
+        Frame *pFrame = findFrame(qs.m_FrameId);
+        for(int is=0; is<NSTAGES; is++)
+        {
+            if(!qs.m_bIssued[is]) continue;
+            double ns = double(qs.m_pQuery[is]->waitForResult());
+            if(pFrame) pFrame->m_Gpu[is] = ns/1.e6;
+        }
+        qs.m_FrameId = -1;
+    }
+}
+
+
+/** @return a pointer to the recorded frame with this id, or nullptr if it was overwritten or never recorded */
+FrameProfiler::Frame *FrameProfiler::findFrame(qint64 id)
+{
+    if(m_Frames.isEmpty() || id<0 || id>=m_NextId) return nullptr;
+    Frame &frame = m_Frames[int(id%m_Frames.size())];
+    if(frame.m_Id!=id) return nullptr;
+    return &frame;
+}
+
+
+void FrameProfiler::beginFrame()
+{
+    if(!s_bEnabled) return;
+
+    if(m_Frames.size()!=s_Capacity)
+    {
+        m_Frames.resize(s_Capacity);
+        for(int i=0; i<m_Frames.size(); i++) m_Frames[i].m_Id = -1;
+        m_nFrames = 0;
+    }
+
+    if(!m_bQueriesMade) makeQueries();
+
+    m_iQuerySet = -1;
+    if(m_bGpuQueries)
+    {
+        readQueries(false);
+        for(int i=0; i<m_Queries.size(); i++)
+        {
+            if(m_Queries[i].m_FrameId<0)
+            {
+                m_iQuerySet = i;
+                break;
+            }
+        }
+        // if all the sets are still in flight, the GPU time of this frame is not measured
+        if(m_iQuerySet>=0)
+        {
+            QuerySet &qs = m_Queries[m_iQuerySet];
+            qs.m_FrameId = m_NextId;
+            for(int is=0; is<NSTAGES; is++) qs.m_bIssued[is] = false;
+        }
+    }
+
+    double now = double(m_Clock.nsecsElapsed())/1.e6;
+    m_Current.m_Id = m_NextId;
+    m_Current.m_Time = now;
+    m_Current.m_Interval = m_LastFrameStart>=0.0 ? now-m_LastFrameStart : -1.0;
+    for(int is=0; is<NSTAGES; is++)
+    {
+        m_Current.m_Cpu[is] = 0.0;
+        m_Current.m_Gpu[is] = -1.0;
+    }
+    m_LastFrameStart = now;
+    m_bInFrame = true;
+}
+
+
+void FrameProfiler::endFrame()
+{
+    if(!m_bInFrame) return;
+    m_bInFrame = false;
+
+    m_Frames[int(m_NextId%m_Frames.size())] = m_Current;
+    m_NextId++;
+    m_nFrames++;
+}
+
+
+void FrameProfiler::beginStage(enumStage stage)
+{
+    if(!m_bInFrame) return;
+    if(m_iQuerySet>=0)
+    {
+        m_Queries[m_iQuerySet].m_pQuery[stage]->begin();
+        m_Queries[m_iQuerySet].m_bIssued[stage] = true;
+    }
+    m_StageStart = m_Clock.nsecsElapsed();
+}
+
+
+void FrameProfiler::endStage(enumStage stage)
+{
+    if(!m_bInFrame) return;
+    m_Current.m_Cpu[stage] += double(m_Clock.nsecsElapsed()-m_StageStart)/1.e6;
+    if(m_iQuerySet>=0) m_Queries[m_iQuerySet].m_pQuery[stage]->end();
+}
+
+
+int FrameProfiler::frameCount() const
+{
+    return int(std::min(m_nFrames, qint64(m_Frames.size())));
+}
+
+
+/** @return the i-th recorded frame, from the oldest to the most recent */
+FrameProfiler::Frame const &FrameProfiler::frame(int i) const
+{
+    qint64 id = m_NextId - frameCount() + i;
+    return m_Frames.at(int(id%m_Frames.size()));
+}
+
+
+/** Returns the p-th percentile of the values, using the nearest rank; the values are sorted in place */
+double FrameProfiler::percentile(QVector<double> &values, double p)
+{
+    if(values.isEmpty()) return 0.0;
+    std::sort(values.begin(), values.end());
+    int rank = int(std::ceil(p/100.0*double(values.size())))-1;
+    rank = std::max(0, std::min(rank, int(values.size())-1));
+    return values.at(rank);
+}
+
+
+FrameProfiler::Statistics FrameProfiler::statistics() const
+{
+    Statistics stats;
+    int n = frameCount();
+    stats.m_nFrames = n;
+    if(n==0) return stats;
+
+    QVector<double> cpu, gpu, interval;
+    double cpustage[NSTAGES]{0,0,0}, gpustage[NSTAGES]{0,0,0};
+    int ngpu = 0;
+    for(int i=0; i<n; i++)
+    {
+        Frame const &fr = frame(i);
+        cpu.append(fr.cpuTime());
+        for(int is=0; is<NSTAGES; is++) cpustage[is] += fr.m_Cpu[is];
+
+        if(fr.gpuTime()>=0.0)
+        {
+            gpu.append(fr.gpuTime());
+            for(int is=0; is<NSTAGES; is++) gpustage[is] += fr.m_Gpu[is];
+            ngpu++;
+        }
+
+        // the frames painted on demand after an idle period are not part of the frame pacing
+        if(fr.m_Interval>0.0 && fr.m_Interval<std::max(s_IdleGap, 4.0*m_TargetInterval))
+        {
+            interval.append(fr.m_Interval);
+            if(m_TargetInterval>0.0)
+            {
+                int nlate = int(std::floor(fr.m_Interval/m_TargetInterval + 0.5)) - 1;
+                if(nlate>0) stats.m_nDropped += nlate;
+            }
+        }
+    }
+
+    for(int is=0; is<NSTAGES; is++) stats.m_CpuStage[is] = cpustage[is]/double(n);
+    stats.m_CpuP50 = percentile(cpu, 50.0);
+    stats.m_CpuP95 = percentile(cpu, 95.0);
+    stats.m_CpuP99 = percentile(cpu, 99.0);
+
+    if(ngpu>0)
+    {
+        for(int is=0; is<NSTAGES; is++) stats.m_GpuStage[is] = gpustage[is]/double(ngpu);
+        stats.m_GpuP50 = percentile(gpu, 50.0);
+        stats.m_GpuP95 = percentile(gpu, 95.0);
+        stats.m_GpuP99 = percentile(gpu, 99.0);
+    }
+
+    if(interval.size())
+    {
+        stats.m_IntervalP50 = percentile(interval, 50.0);
+        stats.m_IntervalP95 = percentile(interval, 95.0);
+        stats.m_IntervalP99 = percentile(interval, 99.0);
+    }
+
+    return stats;
+}
+
+
+QString FrameProfiler::summary() const
+{
+    Statistics stats = statistics();
+    QString strange, summary;
+
+    strange = QString::asprintf("Frames:   %d   target interval %.1f ms   dropped %d\n", stats.m_nFrames, m_TargetInterval, stats.m_nDropped);
+    summary += strange;
+    strange = QString::asprintf("Interval: p50=%6.2f  p95=%6.2f  p99=%6.2f ms\n", stats.m_IntervalP50, stats.m_IntervalP95, stats.m_IntervalP99);
+    summary += strange;
+    strange = QString::asprintf("CPU:      p50=%6.2f  p95=%6.2f  p99=%6.2f ms\n", stats.m_CpuP50, stats.m_CpuP95, stats.m_CpuP99);
+    summary += strange;
+    if(stats.m_GpuP50>=0.0)
+        strange = QString::asprintf("GPU:      p50=%6.2f  p95=%6.2f  p99=%6.2f ms\n", stats.m_GpuP50, stats.m_GpuP95, stats.m_GpuP99);
+    else
+        strange = "GPU:      timer queries not available\n";
+    summary += strange;
+
+    for(int is=0; is<NSTAGES; is++)
+    {
+        if(stats.m_GpuStage[is]>=0.0)
+            strange = QString::asprintf("  %-12s cpu %6.2f  gpu %6.2f ms", stageName[is], stats.m_CpuStage[is], stats.m_GpuStage[is]);
+        else
+            strange = QString::asprintf("  %-12s cpu %6.2f ms", stageName[is], stats.m_CpuStage[is]);
+        summary += strange;
+        if(is<NSTAGES-1) summary += "\n";
+    }
+    return summary;
+}
+
+
+/** Paints the summary in a box with its top left corner at (x,y), in device pixels */
+void FrameProfiler::paintOverlay(QPainter &painter, int x, int y) const
+{
+    QStringList lines = summary().split("\n");
+
+    painter.save();
+    {
+        QFont font(DisplayOptions::textFont());
+        font.setStyleHint(QFont::Monospace);
+        font.setFamily("Monospace");
+        painter.setFont(font);
+        QFontMetrics fm(font);
+
+        int w = 0;
+        for(int i=0; i<lines.size(); i++) w = std::max(w, fm.horizontalAdvance(lines.at(i)));
+        int h = fm.height();
+        int margin = h/2;
+
+        QColor back = DisplayOptions::backgroundColor();
+        back.setAlpha(175);
+        painter.setPen(Qt::NoPen);
+        painter.setBrush(back);
+        painter.drawRect(x, y, w+2*margin, lines.size()*h+2*margin);
+
+        painter.setPen(DisplayOptions::textColor());
+        for(int i=0; i<lines.size(); i++)
+            painter.drawText(x+margin, y+margin+i*h+fm.ascent(), lines.at(i));
+    }
+    painter.restore();
+}
+
+
+bool FrameProfiler::exportCSV(QString const &pathname) const
+{
+    QFile csvfile(pathname);
+    if (!csvfile.open(QIODevice::WriteOnly | QIODevice::Text)) return false;
+
+    QTextStream out(&csvfile);
+    out << "frame,time_ms,interval_ms";
+    for(int is=0; is<NSTAGES; is++) out << ",cpu_" << stageName[is] << "_ms";
+    out << ",cpu_total_ms";
+    for(int is=0; is<NSTAGES; is++) out << ",gpu_" << stageName[is] << "_ms";
+    out << ",gpu_total_ms\n";
+
+    // the unavailable values are left empty
+    auto field = [](double value) {return value>=0.0 ? QString::asprintf("%.4f", value) : QString();};
+
+    for(int i=0; i<frameCount(); i++)
+    {
+        Frame const &fr = frame(i);
+        out << fr.m_Id << "," << QString::asprintf("%.4f", fr.m_Time) << "," << field(fr.m_Interval);
+        for(int is=0; is<NSTAGES; is++) out << "," << field(fr.m_Cpu[is]);
+        out << "," << field(fr.cpuTime());
+        for(int is=0; is<NSTAGES; is++) out << "," << field(fr.m_Gpu[is]);
+        out << "," << field(fr.gpuTime()) << "\n";
+    }
+
+    csvfile.close();
+    return true;
+}
+
+
+bool FrameProfiler::exportJSON(QString const &pathname) const
+{
+    QFile jsonfile(pathname);
+    if (!jsonfile.open(QIODevice::WriteOnly | QIODevice::Text)) return false;
+
+    Statistics stats = statistics();
+
+    QJsonObject jsonstats;
+    jsonstats["frames"]          = stats.m_nFrames;
+    jsonstats["dropped"]         = stats.m_nDropped;
+    jsonstats["cpu_p50_ms"]      = stats.m_CpuP50;
+    jsonstats["cpu_p95_ms"]      = stats.m_CpuP95;
+    jsonstats["cpu_p99_ms"]      = stats.m_CpuP99;
+    jsonstats["interval_p50_ms"] = stats.m_IntervalP50;
+    jsonstats["interval_p95_ms"] = stats.m_IntervalP95;
+    jsonstats["interval_p99_ms"] = stats.m_IntervalP99;
+    if(stats.m_GpuP50>=0.0)
+    {
+        jsonstats["gpu_p50_ms"] = stats.m_GpuP50;
+        jsonstats["gpu_p95_ms"] = stats.m_GpuP95;
+        jsonstats["gpu_p99_ms"] = stats.m_GpuP99;
+    }
+
+    QJsonArray frames;
+    for(int i=0; i<frameCount(); i++)
+    {
+        Frame const &fr = frame(i);
+        QJsonObject jsonframe;
+        jsonframe["frame"]   = double(fr.m_Id);
+        jsonframe["time_ms"] = fr.m_Time;
+        if(fr.m_Interval>=0.0) jsonframe["interval_ms"] = fr.m_Interval;
+
+        QJsonObject cpu, gpu;
+        for(int is=0; is<NSTAGES; is++)
+        {
+            cpu[stageName[is]] = fr.m_Cpu[is];
+            if(fr.m_Gpu[is]>=0.0) gpu[stageName[is]] = fr.m_Gpu[is];
+        }
+        jsonframe["cpu_ms"] = cpu;
+        if(!gpu.isEmpty()) jsonframe["gpu_ms"] = gpu;
+        frames.append(jsonframe);
+    }
+
+    QJsonObject root;
+    root["target_interval_ms"] = m_TargetInterval;
+    root["statistics"] = jsonstats;
+    root["frames"] = frames;
+
+    jsonfile.write(QJsonDocument(root).toJson());
+    jsonfile.close();
+    return true;
+}
+
@@ -0,0 +1,134 @@
+/****************************************************************************
+
+    Xfl3d application
+    Copyright (C) Andre Deperrois
+    License: GPL v3
+
+*****************************************************************************/
+
+
+#pragma once
+
+#include <algorithm>
+
+#include <QElapsedTimer>
+#include <QString>
+#include <QVector>
+
+class QOpenGLTimerQuery;
+class QPainter;
+
+
+/**
+ * @class FrameProfiler
+ * Records the duration of the stages of the frames painted by a view.
+ * The CPU time of each stage is measured with a wall clock; the GPU time is measured
+ * with GL_TIME_ELAPSED queries if the context supports them. The GPU results are read
+ * back a few frames later so that the queries never stall the pipeline.
+ * The last frames are kept in a ring buffer, from which the frame pacing statistics
+ * are computed: the frames are expected at the interval of the view's animation timer,
+ * and a frame which comes later than expected counts as one or more dropped frames.
+ * The methods which use the GPU queries must be called with the view's context current.
+ */
+class FrameProfiler
+{
+    public:
+        enum enumStage {MAKEOBJECTS, RENDER, OVERLAY};
+        static int const NSTAGES = 3;
+
+        struct Frame
+        {
+            qint64 m_Id;               /**< the frame's number since the profiler was created */
+            double m_Time;             /**< the time at which the frame started, in ms since the profiler was created */
+            double m_Interval;         /**< the time since the previous frame started, in ms; negative if there was no previous frame */
+            double m_Cpu[NSTAGES];     /**< the CPU time of each stage, in ms */
+            double m_Gpu[NSTAGES];     /**< the GPU time of each stage, in ms; negative if not available */
+
+            double cpuTime() const {return m_Cpu[0]+m_Cpu[1]+m_Cpu[2];}
+            double gpuTime() const;
+        };
+
+        struct Statistics
+        {
+            int m_nFrames{0};
+            double m_CpuP50{0}, m_CpuP95{0}, m_CpuP99{0};         /**< the percentiles of the CPU frame time, in ms */
+            double m_GpuP50{-1}, m_GpuP95{-1}, m_GpuP99{-1};      /**< the percentiles of the GPU frame time, in ms; negative if not available */
+            double m_IntervalP50{0}, m_IntervalP95{0}, m_IntervalP99{0}; /**< the percentiles of the interval between frames, in ms */
+            double m_CpuStage[NSTAGES]{0,0,0};                    /**< the mean CPU time of each stage, in ms */
+            double m_GpuStage[NSTAGES]{-1,-1,-1};                 /**< the mean GPU time of each stage, in ms */
+            int m_nDropped{0};                                    /**< the number of frames missed against the target interval */
+        };
+
+    public:
+        FrameProfiler();
+        ~FrameProfiler();
+
+        void beginFrame();
+        void endFrame();
+        void beginStage(enumStage stage);
+        void endStage(enumStage stage);
+
+        void cleanupGL();
+
+        void setTargetInterval(double ms) {m_TargetInterval=ms;}
+        double targetInterval() const {return m_TargetInterval;}
+
+        void clear();
+        int frameCount() const;
+        Frame const &frame(int i) const;
+
+        Statistics statistics() const;
+        QString summary() const;
+        void paintOverlay(QPainter &painter, int x, int y) const;
+
+        bool exportCSV(QString const &pathname) const;
+        bool exportJSON(QString const &pathname) const;
+
+        static bool isEnabled() {return s_bEnabled;}
+        static void setEnabled(bool bEnabled) {s_bEnabled=bEnabled;}
+        static bool bOverlay() {return s_bOverlay;}
+        static void setOverlay(bool bOverlay) {s_bOverlay=bOverlay;}
+        static void setCapacity(int nFrames) {s_Capacity=std::max(nFrames, 16);}
+        static int capacity() {return s_Capacity;}
+
+        static double percentile(QVector<double> &values, double p);
+
+    private:
+        void makeQueries();
+        void readQueries(bool bWait);
+        Frame *findFrame(qint64 id);
+
+    private:
+        /** a set of GPU queries, one per stage, issued for one frame */
+        struct QuerySet
+        {
+            QOpenGLTimerQuery *m_pQuery[NSTAGES]{nullptr, nullptr, nullptr};
+            qint64 m_FrameId{-1};    /**< the frame for which the queries were issued, or -1 if the set is free */
+            bool m_bIssued[NSTAGES]{false, false, false};
+        };
+
+        QVector<Frame> m_Frames;     /**< the ring buffer */
+        Frame m_Current;             /**< the frame being recorded, copied to the ring buffer when it ends */
+        qint64 m_nFrames;            /**< the number of frames recorded since the last clear */
+        qint64 m_NextId;
+
+        QElapsedTimer m_Clock;
+        qint64 m_StageStart;         /**< the start of the current stage, in ns */
+        double m_LastFrameStart;     /**< in ms, negative if no frame was recorded */
+        bool m_bInFrame;
+
+        QVector<QuerySet> m_Queries;
+        int m_iQuerySet;             /**< the query set used for the current frame, or -1 */
+        bool m_bGpuQueries;          /**< true if the context supports the timer queries */
+        bool m_bQueriesMade;
+
+        double m_TargetInterval;     /**< the expected time between two frames, in ms */
+
+        static bool s_bEnabled;
+        static bool s_bOverlay;
+        static int s_Capacity;       /**< the size of the ring buffer, in frames */
+        static int s_nQuerySets;     /**< the number of frames which can be in flight on the GPU */
+        static double s_IdleGap;     /**< the interval above which two frames are not part of the same animation, in ms */
+};
+
+
@@ -8,7 +8,11 @@
 
 #define _MATH_DEFINES_DEFINED
 
+#include <algorithm>
+#include <cmath>
+
 #include <QApplication>
+#include <QDataStream>
 #include <QFileDialog>
 #include <QKeyEvent>
 #include <QMatrix4x4>
@@ -23,6 +27,7 @@
 
 #include <xfl3d/globals/gl_globals.h>
 #include <xfl3d/controls/w3dprefs.h>
+#include <xfl3d/views/shaderregistry.h>
 #include <xflcore/displayoptions.h>
 #include <xflcore/trace.h>
 #include <xflcore/xflcore.h>
@@ -34,9 +39,16 @@
 
 
 QSize gl2dView::s_ImageSize(1920, 1080);
+int gl2dView::s_CoarseLevel(3);
+int gl2dView::s_nBands(4);
+int gl2dView::s_TilesPerFrame(8);
 
 
-gl2dView::gl2dView(QWidget *pParent) : QOpenGLWidget(pParent)
+gl2dView::gl2dView(QWidget *pParent) : QOpenGLWidget(pParent),
+    m_shadPoint(ShaderRegistry::program("point")),
+    m_shadPoint2(ShaderRegistry::program("point2")),
+    m_shadLine(ShaderRegistry::program("line")),
+    m_shadSurf(ShaderRegistry::program("surface"))
 {
     setFocusPolicy(Qt::WheelFocus);
     setCursor(Qt::CrossCursor);
@@ -82,11 +94,330 @@ gl2dView::gl2dView(QWidget *pParent) : QOpenGLWidget(pParent)
     ANIMATIONFRAMES = 30;
     m_iTimerInc = 0;
     m_glScaleIncrement = 0.0;
+
+    m_bProgressive = false;
+    m_iProgressiveLevel = -1;
+    m_iProgressiveBand = 0;
+    m_pfboCoarse = m_pfboFull = nullptr;
+    m_RefineTimer.setSingleShot(true);
+    m_RefineTimer.setInterval(0); // i.e. when the event queue is empty
+    connect(&m_RefineTimer, SIGNAL(timeout()), SLOT(onRefineRender()));
+
+    m_bTileCache = false;
+    m_bImageFromTiles = false;
+    m_bTilesPending = false;
 }
 
 
 gl2dView::~gl2dView()
 {    
+    makeCurrent();
+    delete m_pfboCoarse;
+    delete m_pfboFull;
+    if(m_TextureBlitter.isCreated()) m_TextureBlitter.destroy();
+    m_TileCache.clear();
+    m_Profiler.cleanupGL();
+    doneCurrent();
+}
+
+
+/** Releases the profiler's queries before the context is destroyed, e.g. when the widget is reparented */
+void gl2dView::onCleanupGL()
+{
+    makeCurrent();
+    m_Profiler.cleanupGL();
+    doneCurrent();
+}
+
+
+/**
+ * Restarts the progressive rendering sequence from the coarsest level.
+ * Called on each interaction, which cancels the pending refinement passes at once.
+ */
+void gl2dView::startProgressiveRender()
+{
+    if(!m_bProgressive) return;
+    m_RefineTimer.stop();
+    m_iProgressiveLevel = s_CoarseLevel;
+    m_iProgressiveBand = 0;
+    m_FullImageKey.clear();
+}
+
+
+void gl2dView::onProgressiveUpdate()
+{
+    startProgressiveRender();
+    update();
+}
+
+
+void gl2dView::onRefineRender()
+{
+    if(m_iProgressiveLevel>=0 || m_bTilesPending) update();
+}
+
+
+/**
+ * Renders one step of the progressive sequence:
+ *   - levels>0: the full view at 1/2^level resolution, upscaled into the full size buffer
+ *   - level 0: one horizontal band of the full resolution image, over the previous preview
+ * Each step costs at most a fraction of the full resolution frame,
+ * so that the latency of the next interaction remains bounded.
+ */
+void gl2dView::paintProgressive()
+{
+    QSize fullsize = makeFullBuffer();
+
+    if(m_iProgressiveLevel>0)
+    {
+        int f = 1<<m_iProgressiveLevel;
+        QSize coarsesize(std::max(1, fullsize.width()/f), std::max(1, fullsize.height()/f));
+        if(!m_pfboCoarse || m_pfboCoarse->size()!=coarsesize)
+        {
+            delete m_pfboCoarse;
+            m_pfboCoarse = new QOpenGLFramebufferObject(coarsesize, QOpenGLFramebufferObject::CombinedDepthStencil);
+        }
+
+        m_pfboCoarse->bind();
+        {
+            glViewport(0, 0, coarsesize.width(), coarsesize.height());
+            glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+            glRenderView();
+        }
+        m_pfboCoarse->release();
+
+        QOpenGLFramebufferObject::blitFramebuffer(m_pfboFull,   QRect(QPoint(0,0), fullsize),
+                                                  m_pfboCoarse, QRect(QPoint(0,0), coarsesize),
+                                                  GL_COLOR_BUFFER_BIT, GL_NEAREST);
+        m_iProgressiveLevel--;
+        m_iProgressiveBand = 0;
+    }
+    else
+    {
+        // bands are rendered from the top of the view
+        int bandheight = (fullsize.height()+s_nBands-1)/s_nBands;
+        int top = fullsize.height() - (m_iProgressiveBand+1)*bandheight;
+
+        m_pfboFull->bind();
+        {
+            glViewport(0, 0, fullsize.width(), fullsize.height());
+            glEnable(GL_SCISSOR_TEST);
+            glScissor(0, std::max(0, top), fullsize.width(), bandheight);
+            glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+            glRenderView();
+            glDisable(GL_SCISSOR_TEST);
+        }
+        m_pfboFull->release();
+
+        m_iProgressiveBand++;
+        if(m_iProgressiveBand>=s_nBands)
+        {
+            m_iProgressiveLevel = -1; // done
+            m_FullImageKey = fullImageKey();
+        }
+    }
+
+    paintFullImage();
+
+    if(m_iProgressiveLevel>=0) m_RefineTimer.start();
+}
+
+
+/** Makes the full size buffer if it does not exist or if the view has been resized, and returns its size */
+QSize gl2dView::makeFullBuffer()
+{
+    QSize fullsize(width()*devicePixelRatio(), height()*devicePixelRatio());
+    if(!m_pfboFull || m_pfboFull->size()!=fullsize)
+    {
+        delete m_pfboFull;
+        m_pfboFull = new QOpenGLFramebufferObject(fullsize, QOpenGLFramebufferObject::CombinedDepthStencil);
+    }
+    return fullsize;
+}
+
+
+/**
+ * Renders the full resolution image at once in the full size buffer,
+ * when the image is changed outside of an interaction, e.g. by an animation.
+ */
+void gl2dView::renderFullImage()
+{
+    QSize fullsize = makeFullBuffer();
+    m_pfboFull->bind();
+    {
+        glViewport(0, 0, fullsize.width(), fullsize.height());
+        glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+        glRenderView();
+    }
+    m_pfboFull->release();
+    m_FullImageKey = fullImageKey();
+}
+
+
+/** Displays the full size buffer */
+void gl2dView::paintFullImage()
+{
+    glViewport(0, 0, m_pfboFull->width(), m_pfboFull->height());
+    glDisable(GL_DEPTH_TEST);
+    glDisable(GL_BLEND);
+    if(!m_TextureBlitter.isCreated()) m_TextureBlitter.create();
+    m_TextureBlitter.bind();
+    m_TextureBlitter.blit(m_pfboFull->texture(), QMatrix4x4(), QOpenGLTextureBlitter::OriginBottomLeft);
+    m_TextureBlitter.release();
+}
+
+
+/**
+ * The values which identify the image held by the full size buffer once the refinement is finished:
+ * the image parameters, the view's position and scale, and the buffer's size.
+ * The finished image is displayed again as long as the key is unchanged.
+ */
+QByteArray gl2dView::fullImageKey() const
+{
+    QByteArray key;
+    QDataStream ds(&key, QIODevice::WriteOnly);
+    ds << tileParameters() << m_ptOffset << m_fScale << width() << height() << devicePixelRatio();
+    return key;
+}
+
+
+/**
+ * Composites the view from the tiles of the cache.
+ * The tiles are aligned on a grid anchored at the world origin, so that after a translation
+ * only the tiles in the newly exposed strips need to be rendered.
+ * The tiles are rendered at the zoom level whose pixel size is the power of 2 just below the view's,
+ * and are scaled to the view's pixel size when displayed.
+ * The missing tiles are rendered over the successive frames, at most s_TilesPerFrame per frame;
+ * in the meantime, the tile rendered at a lower zoom level which covers them is displayed as a placeholder.
+ * If there is none, a placeholder is rendered s_CoarseLevel levels lower, at a fraction of the cost.
+ */
+void gl2dView::paintTiles()
+{
+    int const T = TileCache::tileSize();
+    int const wd = int(width()*devicePixelRatio());
+    int const hd = int(height()*devicePixelRatio());
+    double const w = m_rectView.width();
+
+    // the world size of a device pixel, and the world position of the view's bottom left corner
+    double const ps = w/(double(m_fScale)*double(wd));
+    double const x0 = -m_ptOffset.x()/width()*w - 0.5*double(wd)*ps;
+    double const y0 =  m_ptOffset.y()/width()*w - 0.5*double(hd)*ps;
+
+    TileCache::TileKey key;
+    key.Level = TileCache::level(ps);
+    key.Params = tileParameters();
+
+    double const ts = double(T)*TileCache::pixelSize(key.Level);
+    int const imin = int(floor(x0/ts));
+    int const jmin = int(floor(y0/ts));
+    int const imax = int(floor((x0+double(wd)*ps)/ts));
+    int const jmax = int(floor((y0+double(hd)*ps)/ts));
+
+    m_TileCache.newFrame();
+
+    QVector<TileCache::TileKey> visible, placeholders;
+    int nrendered = 0;
+    m_bTilesPending = false;
+
+    QPointF offset = m_ptOffset;
+    float scale = m_fScale;
+    QOpenGLVertexArrayObject::Binder vaoBinder(&m_vao);
+
+    for(int j=jmin; j<=jmax; j++)
+    {
+        for(int i=imin; i<=imax; i++)
+        {
+            key.i = i;
+            key.j = j;
+            if(!m_TileCache.tile(key))
+            {
+                if(nrendered>=s_TilesPerFrame)
+                {
+                    TileCache::TileKey placeholder;
+                    if(!m_TileCache.coarserTile(key, placeholder))
+                    {
+                        placeholder = TileCache::coarserKey(key, s_CoarseLevel);
+                        renderTile(placeholder);
+                    }
+                    if(!placeholders.contains(placeholder)) placeholders.append(placeholder);
+                    m_bTilesPending = true;
+                    continue;
+                }
+                renderTile(key);
+                nrendered++;
+            }
+            visible.append(key);
+        }
+    }
+    m_ptOffset = offset;
+    m_fScale = scale;
+
+    // draw the placeholders first, from the lowest zoom level, then the tiles at the current zoom level
+    std::sort(placeholders.begin(), placeholders.end(),
+              [](TileCache::TileKey const &a, TileCache::TileKey const &b) {return a.Level>b.Level;});
+    placeholders.append(visible);
+
+    QRect viewport(0, 0, wd, hd);
+    glViewport(0, 0, wd, hd);
+    glDisable(GL_DEPTH_TEST);
+    glDisable(GL_BLEND);
+    if(!m_TextureBlitter.isCreated()) m_TextureBlitter.create();
+    m_TextureBlitter.bind();
+    for(int it=0; it<placeholders.size(); it++)
+    {
+        TileCache::TileKey const &tk = placeholders.at(it);
+        QOpenGLFramebufferObject *pfbo = m_TileCache.tile(tk);
+        if(!pfbo) continue;
+
+        // the tile's edges are snapped to the device pixels, so that the adjacent tiles
+        // share their edges and are not resampled at a fractional offset
+        double tts = double(T)*TileCache::pixelSize(tk.Level);
+        double left   = std::round((double(tk.i)  *tts-x0)/ps);
+        double right  = std::round((double(tk.i+1)*tts-x0)/ps);
+        double bottom = std::round((double(tk.j)  *tts-y0)/ps);
+        double top    = std::round((double(tk.j+1)*tts-y0)/ps);
+        QRectF target(left, double(hd)-top, right-left, top-bottom); // the blitter's target y axis points down
+        m_TextureBlitter.blit(pfbo->texture(), QOpenGLTextureBlitter::targetTransform(target, viewport),
+                              QOpenGLTextureBlitter::OriginBottomLeft);
+    }
+    m_TextureBlitter.release();
+
+    m_TileCache.trim();
+
+    // the progressive sequence is finished when all the tiles are at the current zoom level
+    if(m_bTilesPending) m_RefineTimer.start();
+    else                m_iProgressiveLevel = -1;
+}
+
+
+/**
+ * Renders the tile in a viewport of the view's size, positioned and scaled so that
+ * the tile's bottom left corner is at the origin of the frame buffer, and the tile's
+ * pixels have the world size of its zoom level.
+ * The view's offset and scale are modified and must be restored by the caller.
+ */
+void gl2dView::renderTile(TileCache::TileKey const &key)
+{
+    int const T = TileCache::tileSize();
+    int const wd = int(width()*devicePixelRatio());
+    int const hd = int(height()*devicePixelRatio());
+    double const w = m_rectView.width();
+    double const tps = TileCache::pixelSize(key.Level);
+
+    double xc = (double(key.i)*T + 0.5*double(wd))*tps;
+    double yc = (double(key.j)*T + 0.5*double(hd))*tps;
+    m_ptOffset = QPointF(-xc*width()/w, yc*width()/w);
+    m_fScale = float(w/(tps*double(wd)));
+
+    QOpenGLFramebufferObject *pfbo = new QOpenGLFramebufferObject(T, T);
+    pfbo->bind();
+    {
+        glViewport(0, 0, wd, hd);
+        glClear(GL_COLOR_BUFFER_BIT);
+        glRenderImage();
+    }
+    pfbo->release();
+    m_TileCache.insert(key, pfbo);
 }
 
 
@@ -116,7 +447,7 @@ void gl2dView::onTranslationIncrement()
     }
 
     m_ptOffset += m_TransIncrement;
-    update();
+    onProgressiveUpdate();
     m_iTimerInc++;
 }
 
@@ -140,7 +471,7 @@ void gl2dView::onResetIncrement()
 
     m_fScale += m_glScaleIncrement;
     m_ptOffset += m_TransIncrement;
-    update();
+    onProgressiveUpdate();
     m_iTimerInc++;
 }
 
@@ -178,7 +509,7 @@ void gl2dView::onDynamicIncrement()
 
     setAutoUnits();
 
-    update();
+    onProgressiveUpdate();
 }
 
 
@@ -204,6 +535,7 @@ void gl2dView::startResetTimer()
 void gl2dView::startDynamicTimer()
 {
     m_DynTimer.start(17);
+    m_Profiler.setTargetInterval(m_DynTimer.interval());
     setMouseTracking(false);
 }
 
@@ -244,7 +576,8 @@ void gl2dView::stopDynamicTimer()
 void gl2dView::keyPressEvent(QKeyEvent *pEvent)
 {
 //    bool bCtrl = (pEvent->modifiers() & Qt::ControlModifier);
-    bool bAlt  = (pEvent->modifiers() & Qt::AltModifier);
+    bool bAlt   = (pEvent->modifiers() & Qt::AltModifier);
+    bool bShift = (pEvent->modifiers() & Qt::ShiftModifier);
     switch (pEvent->key())
     {
         case Qt::Key_R:
@@ -258,6 +591,17 @@ void gl2dView::keyPressEvent(QKeyEvent *pEvent)
                 onSaveImage();
             break;
         }
+        case Qt::Key_F9:
+        {
+            if(bShift) exportProfile();
+            else
+            {
+                FrameProfiler::setEnabled(!FrameProfiler::isEnabled());
+                m_Profiler.clear();
+            }
+            update();
+            break;
+        }
     }
 
     QOpenGLWidget::keyPressEvent(pEvent);
@@ -292,6 +636,8 @@ void gl2dView::leaveEvent(QEvent *pEvent)
 
 void gl2dView::paintGL()
 {
+    m_Profiler.beginFrame();
+
 //    glClearColor(float(DisplayOptions::backgroundColor().redF()), float(DisplayOptions::backgroundColor().greenF()), float(DisplayOptions::backgroundColor().blueF()), 1.0f);
     glClearColor(0.0f, 0.0f, 0.0f, 1.0f);
     glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
@@ -304,7 +650,9 @@ void gl2dView::paintGL()
 
     glEnable(GL_DEPTH_TEST);
 
+    m_Profiler.beginStage(FrameProfiler::MAKEOBJECTS);
     glMake2dObjects();
+    m_Profiler.endStage(FrameProfiler::MAKEOBJECTS);
 
     double w = m_rectView.width();
     QVector2D off(-m_ptOffset.x()/width()*w, m_ptOffset.y()/width()*w);
@@ -321,13 +669,63 @@ void gl2dView::paintGL()
     m_matView.scale(m_fScale, m_fScale, m_fScale);
     m_matView.translate(-off.x(), -off.y(), 0.0f);
 
-    glRenderView();
+    m_Profiler.beginStage(FrameProfiler::RENDER);
+    if(useTileCache())
+    {
+        paintTiles();
+        m_bImageFromTiles = true;
+        glRenderView();
+        m_bImageFromTiles = false;
+    }
+    else if(m_bProgressive)
+    {
+        if(m_iProgressiveLevel>=0) paintProgressive();
+        else
+        {
+            // the finished image is reused until the view or the image parameters change
+            if(!m_pfboFull || m_FullImageKey!=fullImageKey()) renderFullImage();
+            paintFullImage();
+        }
+    }
+    else glRenderView();
+    m_Profiler.endStage(FrameProfiler::RENDER);
 
     glDisable(GL_CULL_FACE);
     glDisable(GL_BLEND);
     glDisable(GL_DEPTH_TEST);
 
+    m_Profiler.beginStage(FrameProfiler::OVERLAY);
     paintOverlay();
+    m_Profiler.endStage(FrameProfiler::OVERLAY);
+
+    m_Profiler.endFrame();
+    paintProfiler();
+}
+
+
+/** Paints the frame statistics on top of the view if the profiler's overlay is enabled */
+void gl2dView::paintProfiler()
+{
+    if(!FrameProfiler::isEnabled() || !FrameProfiler::bOverlay()) return;
+    QOpenGLPaintDevice device(size() * devicePixelRatio());
+    QPainter painter(&device);
+    int margin = int(10*devicePixelRatio());
+    m_Profiler.paintOverlay(painter, margin, margin);
+}
+
+
+/** Writes the recorded frames in CSV and JSON format in the user's documents directory */
+void gl2dView::exportProfile()
+{
+    QStringList loc = QStandardPaths::standardLocations(QStandardPaths::DocumentsLocation);
+    QString path;
+    if(!loc.isEmpty()) path = loc.first() + QDir::separator();
+    path += QString(metaObject()->className()) + "_frames";
+
+    bool bCSV  = m_Profiler.exportCSV(path+".csv");
+    bool bJSON = m_Profiler.exportJSON(path+".json");
+    if(bCSV && bJSON) setOutputInfo("Frame profile written to "+path+".csv and .json");
+    else              setOutputInfo("Could not write the frame profile to "+path);
 }
 
 
@@ -384,7 +782,7 @@ void gl2dView::mouseMoveEvent(QMouseEvent *pEvent)
 
         m_LastPoint=point;
 
-        update();
+        onProgressiveUpdate();
         return;
     }
     else if(pEvent->modifiers().testFlag(Qt::AltModifier))
@@ -401,7 +799,7 @@ void gl2dView::mouseMoveEvent(QMouseEvent *pEvent)
         }
         m_fScale *= zoomFactor;
         m_LastPoint=point;
-        update();
+        onProgressiveUpdate();
         return;
     }
 
@@ -946,7 +1344,7 @@ void gl2dView::wheelEvent(QWheelEvent *pEvent)
         m_ptOffset.rx() = a + (m_ptOffset.x()-a);
         m_ptOffset.ry() = b + (m_ptOffset.y()-b);
         setAutoUnits();
-        update();
+        onProgressiveUpdate();
     }
 
     pEvent->accept();
@@ -955,34 +1353,13 @@ void gl2dView::wheelEvent(QWheelEvent *pEvent)
 
 void gl2dView::initializeGL()
 {
-    QString strange, vsrc, gsrc, fsrc;
+    connect(context(), SIGNAL(aboutToBeDestroyed()), SLOT(onCleanupGL()), Qt::UniqueConnection);
 
+    // the programs are only compiled and linked by the first view which is initialized
     //--------- setup the shader to paint stippled thick lines -----------
-    vsrc = ":/shaders/line/line_VS.glsl";
-    m_shadLine.addShaderFromSourceFile(QOpenGLShader::Vertex, vsrc);
-    if(m_shadLine.log().length())
-    {
-        strange = QString::asprintf("%s", QString("Line vertex shader log:"+m_shadLine.log()).toStdString().c_str());
-        trace(strange);
-    }
-
-    gsrc = ":/shaders/line/line_GS.glsl";
-    m_shadLine.addShaderFromSourceFile(QOpenGLShader::Geometry, gsrc);
-    if(m_shadLine.log().length())
-    {
-        strange = QString::asprintf("%s", QString("Line geometry shader log:"+m_shadLine.log()).toStdString().c_str());
-        trace(strange);
-    }
-
-    fsrc = ":/shaders/line/line_FS.glsl";
-    m_shadLine.addShaderFromSourceFile(QOpenGLShader::Fragment, fsrc);
-    if(m_shadLine.log().length())
-    {
-        strange = QString::asprintf("%s", QString("Stipple fragment shader log:"+m_shadLine.log()).toStdString().c_str());
-        trace(strange);
-    }
-
-    m_shadLine.link();
+    ShaderRegistry::build(m_shadLine, "Line", {{QOpenGLShader::Vertex,   ":/shaders/line/line_VS.glsl"},
+                                               {QOpenGLShader::Geometry, ":/shaders/line/line_GS.glsl"},
+                                               {QOpenGLShader::Fragment, ":/shaders/line/line_FS.glsl"}});
     m_shadLine.bind();
     {
         m_locLine.m_attrVertex    = m_shadLine.attributeLocation("vertexPosition_modelSpace");
@@ -1001,31 +1378,9 @@ void gl2dView::initializeGL()
     }
     m_shadLine.release();
 
-    vsrc = ":/shaders/point/point_VS.glsl";
-    m_shadPoint.addShaderFromSourceFile(QOpenGLShader::Vertex, vsrc);
-    if(m_shadPoint.log().length())
-    {
-        strange = QString::asprintf("%s", QString("Point vertex shader log:"+m_shadPoint.log()).toStdString().c_str());
-        trace(strange);
-    }
-
-    gsrc = ":/shaders/point/point_GS.glsl";
-    m_shadPoint.addShaderFromSourceFile(QOpenGLShader::Geometry, gsrc);
-    if(m_shadPoint.log().length())
-    {
-        strange = QString::asprintf("%s", QString("Point geometry shader log:"+m_shadPoint.log()).toStdString().c_str());
-        trace(strange);
-    }
-
-    fsrc = ":/shaders/point/point_FS.glsl";
-    m_shadPoint.addShaderFromSourceFile(QOpenGLShader::Fragment, fsrc);
-    if(m_shadPoint.log().length())
-    {
-        strange = QString::asprintf("%s", QString("Point fragment shader log:"+m_shadPoint.log()).toStdString().c_str());
-        trace(strange);
-    }
-
-    m_shadPoint.link();
+    ShaderRegistry::build(m_shadPoint, "Point", {{QOpenGLShader::Vertex,   ":/shaders/point/point_VS.glsl"},
+                                                 {QOpenGLShader::Geometry, ":/shaders/point/point_GS.glsl"},
+                                                 {QOpenGLShader::Fragment, ":/shaders/point/point_FS.glsl"}});
     m_shadPoint.bind();
     {
         m_locPoint.m_attrVertex = m_shadPoint.attributeLocation("vertexPosition_modelSpace");
@@ -1044,25 +1399,8 @@ void gl2dView::initializeGL()
 
 
     // setup the flat point shader
-    vsrc =  ":/shaders/point2/point2_VS.glsl";
-    fsrc =  ":/shaders/point2/point2_FS.glsl";
-
-    m_shadPoint2.addShaderFromSourceFile(QOpenGLShader::Vertex, vsrc);
-    if(m_shadPoint2.log().length())
-    {
-        strange = QString::asprintf("%s", QString("point2 vertex shader log:"+m_shadPoint2.log()).toStdString().c_str());
-        trace(strange);
-    }
-
-
-    m_shadPoint2.addShaderFromSourceFile(QOpenGLShader::Fragment, fsrc);
-    if(m_shadPoint2.log().length())
-    {
-        strange = QString::asprintf("%s", QString("point2 fragment shader log:"+m_shadPoint2.log()).toStdString().c_str());
-        trace(strange);
-    }
-
-    m_shadPoint2.link();
+    ShaderRegistry::build(m_shadPoint2, "point2", {{QOpenGLShader::Vertex,   ":/shaders/point2/point2_VS.glsl"},
+                                                   {QOpenGLShader::Fragment, ":/shaders/point2/point2_FS.glsl"}});
     m_shadPoint2.bind();
     {
         m_locPt2.m_attrVertex = m_shadPoint2.attributeLocation("vertexPosition_modelSpace");
@@ -1076,23 +1414,8 @@ void gl2dView::initializeGL()
 
 
     //setup the shader to paint coloured surfaces
-    vsrc = ":/shaders/surface/surface_VS.glsl";
-    fsrc = ":/shaders/surface/surface_FS.glsl";
-    m_shadSurf.addShaderFromSourceFile(QOpenGLShader::Vertex, vsrc);
-    if(m_shadSurf.log().length())
-    {
-        strange = QString::asprintf("%s", QString("Surface vertex shader log:"+m_shadSurf.log()).toStdString().c_str());
-        trace(strange);
-    }
-
-    m_shadSurf.addShaderFromSourceFile(QOpenGLShader::Fragment, fsrc);
-    if(m_shadSurf.log().length())
-    {
-        strange = QString::asprintf("%s", QString("Surface fragment shader log:"+m_shadSurf.log()).toStdString().c_str());
-        trace(strange);
-    }
-
-    m_shadSurf.link();
+    ShaderRegistry::build(m_shadSurf, "Surface", {{QOpenGLShader::Vertex,   ":/shaders/surface/surface_VS.glsl"},
+                                                  {QOpenGLShader::Fragment, ":/shaders/surface/surface_FS.glsl"}});
     m_shadSurf.bind();
     {
         m_locSurf.m_attrVertex = m_shadSurf.attributeLocation("vertexPosition_modelSpace");
@@ -1115,6 +1438,11 @@ void gl2dView::initializeGL()
 
         m_uHasShadow             = m_shadSurf.uniformLocation("HasShadow");
         m_uShadowLightViewMatrix = m_shadSurf.uniformLocation("LightViewMatrix");
+
+        // the program may have been left in any state by a 3d view
+        m_shadSurf.setUniformValue(m_locSurf.m_HasTexture,  0);
+        m_shadSurf.setUniformValue(m_locSurf.m_IsInstanced, 0);
+        m_shadSurf.setUniformValue(m_uHasShadow,            0);
     }
     m_shadSurf.release();
 
@@ -1123,7 +1451,8 @@ void gl2dView::initializeGL()
 }
 
 
-void gl2dView::saveImage(QString const &filename, QString const &description)
+/** Asks the user for the path of the png image to save; returns an empty string if cancelled */
+QString gl2dView::imageFileName(QString const &filename)
 {
     QString Filter;
     QStringList filters;
@@ -1139,8 +1468,17 @@ void gl2dView::saveImage(QString const &filename, QString const &description)
                                             FileName,
                                             filters.at(0),
                                             &Filter);
+    if(FileName.isEmpty()) return FileName;
 
     if(FileName.right(4)!=".png") FileName+= ".png";
+    return FileName;
+}
+
+
+void gl2dView::saveImage(QString const &filename, QString const &description)
+{
+    QString FileName = imageFileName(filename);
+    if(FileName.isEmpty()) return;
 
 
     QOpenGLFramebufferObjectFormat fboFormat;
@@ -19,11 +19,14 @@
 #include <QOpenGLWidget>
 #include <QOffscreenSurface>
 #include <QOpenGLFramebufferObject>
+#include <QOpenGLTextureBlitter>
 #include <QTimer>
 #include <QPushButton>
 
 #include <xflcore/linestyle.h>
+#include <xfl3d/views/frameprofiler.h>
 #include <xfl3d/views/shadloc.h>
+#include <xfl3d/views/tilecache.h>
 #include <xflgeom/geom2d/vector2d.h>
 #include <xflwidgets/view/grid.h>
 
@@ -64,6 +67,8 @@ class gl2dView : public QOpenGLWidget
 
         static void setImageSize(QSize sz) {s_ImageSize=sz;}
 
+        FrameProfiler const &profiler() const {return m_Profiler;}
+
     protected:
         virtual QSize sizeHint() const override {return QSize(1500, 1100);}
         void showEvent(QShowEvent *pEvent) override;
@@ -79,9 +84,21 @@ class gl2dView : public QOpenGLWidget
         void paintGL() override;
         virtual void glMake2dObjects() {}
         virtual void glRenderView() = 0;
+        virtual void glRenderImage() {}
+        virtual bool useTileCache() const {return m_bTileCache;}
+        virtual QByteArray tileParameters() const {return QByteArray();}
+        void paintProgressive();
+        QSize makeFullBuffer();
+        void renderFullImage();
+        void paintFullImage();
+        QByteArray fullImageKey() const;
+        void paintTiles();
+        void renderTile(TileCache::TileKey const &key);
         virtual QPointF defaultOffset() {return QPointF();}
 
         virtual void paintOverlay();
+        void paintProfiler();
+        void exportProfile();
 
         void startDynamicTimer();
         void stopDynamicTimer();
@@ -123,13 +140,20 @@ class gl2dView : public QOpenGLWidget
 
         virtual void resizeLabels();
 
+        void startProgressiveRender();
+        int progressiveLevel() const {return m_iProgressiveLevel;}
+
+        QString imageFileName(QString const &filename);
         void saveImage(QString const &filename, QString const &description);
 
     protected slots:
+        void onCleanupGL();
         void onDynamicIncrement();
         void onTranslationIncrement();
         void onResetIncrement();
         void on2dReset();
+        void onProgressiveUpdate();
+        void onRefineRender();
         virtual void onSaveImage() {}
 
     signals:
@@ -140,16 +164,17 @@ class gl2dView : public QOpenGLWidget
         QOpenGLBuffer m_vboQuad;
         QOpenGLBuffer m_vboDisk;
 
-        QOpenGLShaderProgram m_shadPoint;
+        // the programs are shared with the other views, cf. ShaderRegistry
+        QOpenGLShaderProgram &m_shadPoint;
         ShaderLocations m_locPoint;
 
-        QOpenGLShaderProgram m_shadPoint2;
+        QOpenGLShaderProgram &m_shadPoint2;
         ShaderLocations m_locPt2;
 
-        QOpenGLShaderProgram m_shadLine;
+        QOpenGLShaderProgram &m_shadLine;
         ShaderLocations m_locLine;
 
-        QOpenGLShaderProgram m_shadSurf;
+        QOpenGLShaderProgram &m_shadSurf;
         ShaderLocations m_locSurf;
 
         QMatrix4x4 m_matProj, m_matView, m_matModel;
@@ -175,6 +200,8 @@ class gl2dView : public QOpenGLWidget
         QElapsedTimer m_MoveTime;
         QTimer m_DynTimer;
 
+        FrameProfiler m_Profiler;
+
         QTimer m_TransitionTimer; // used when the user has double-clicked on a location or has pressed a view icon
         QPointF m_Trans;
         bool m_bDynTranslation;
@@ -207,10 +234,30 @@ class gl2dView : public QOpenGLWidget
         int ANIMATIONFRAMES;
         int m_iTimerInc;
 
+        // progressive rendering
+        bool m_bProgressive;          /**< if true, interactions are rendered at low resolution first, then refined when idle */
+        int m_iProgressiveLevel;      /**< the current refinement level: 1/2^level resolution if >0, full resolution bands if 0, idle if <0 */
+        int m_iProgressiveBand;       /**< the next full resolution band to render */
+        QTimer m_RefineTimer;
+        QOpenGLFramebufferObject *m_pfboCoarse;
+        QOpenGLFramebufferObject *m_pfboFull;
+        QByteArray m_FullImageKey;    /**< the key of the finished image held by m_pfboFull, or empty if the image is incomplete */
+        QOpenGLTextureBlitter m_TextureBlitter;
+
+        // tile cache
+        bool m_bTileCache;            /**< if true, the image is composited from the tiles of the cache, and only the missing tiles are rendered */
+        bool m_bImageFromTiles;       /**< true while glRenderView() is called on top of the tiles, i.e. when only the decorations need to be drawn */
+        bool m_bTilesPending;         /**< true if some tiles are still displayed at a lower zoom level */
+        TileCache m_TileCache;
+
 
 
         static QSize s_ImageSize;
 
+        static int s_CoarseLevel;     /**< the first progressive level, i.e. 1/2^level resolution */
+        static int s_nBands;          /**< the number of frames over which the full resolution image is rendered */
+        static int s_TilesPerFrame;   /**< the max. number of tiles rendered in one frame at the current zoom level */
+
     public:
         QVector<Vector2d> m_DebugPts;
         QVector<Vector2d> m_DebugVecs;
@@ -22,12 +22,14 @@
 #include <xfl3d/controls/w3dprefs.h>
 #include <xfl3d/globals/gl_globals.h>
 #include <xfl3d/views/gl3dview.h>
+#include <xfl3d/views/shaderregistry.h>
 #include <xflcore/displayoptions.h>
 #include <xflcore/saveoptions.h>
 #include <xflcore/trace.h>
 #include <xflcore/units.h>
 #include <xflcore/xflcore.h>
 #include <xflgeom/geom3d/node.h>
+#include <xflgeom/geom3d/pointkdtree.h>
 #include <xflgeom/geom3d/triangle3d.h>
 #include <xflgeom/geom_globals/geom_global.h>
 #include <xflmath/matrix.h>
@@ -47,7 +49,12 @@ double gl3dView::s_ZAnimAngle = 0.25;
 
 Light gl3dView::s_Light;
 
-gl3dView::gl3dView(QWidget *pParent) : QOpenGLWidget(pParent)
+gl3dView::gl3dView(QWidget *pParent) : QOpenGLWidget(pParent),
+    m_shadSurf(ShaderRegistry::program("surface")),
+    m_shadLine(ShaderRegistry::program("line")),
+    m_shadPoint(ShaderRegistry::program("point")),
+    m_shadPoint2(ShaderRegistry::program("point2")),
+    m_shadDepth(ShaderRegistry::program("depth"))
 {
     setCursor(Qt::CrossCursor);
     setFocusPolicy(Qt::WheelFocus);
@@ -57,6 +64,11 @@ gl3dView::gl3dView(QWidget *pParent) : QOpenGLWidget(pParent)
 
     setFormat(s_GlSurfaceFormat);
 
+    m_plabInfoOutput = new QLabel(this);
+    m_plabInfoOutput->setFont(DisplayOptions::tableFont());
+    m_plabInfoOutput->setTextFormat(Qt::PlainText);
+    m_plabInfoOutput->setAttribute(Qt::WA_NoSystemBackground);
+
     m_pglLightDlg = nullptr;
 
     m_bZAnimate = false;
@@ -131,6 +143,19 @@ gl3dView::~gl3dView()
         m_pglLightDlg->close();
         delete m_pglLightDlg;
     }
+
+    makeCurrent();
+    m_Profiler.cleanupGL();
+    doneCurrent();
+}
+
+
+/** Releases the profiler's queries before the context is destroyed, e.g. when the widget is reparented */
+void gl3dView::onCleanupGL()
+{
+    makeCurrent();
+    m_Profiler.cleanupGL();
+    doneCurrent();
 }
 
 
@@ -150,6 +175,8 @@ void gl3dView::restoreViewPoint(Quaternion const &qt)
 
 void gl3dView::initializeGL()
 {
+    connect(context(), SIGNAL(aboutToBeDestroyed()), SLOT(onCleanupGL()), Qt::UniqueConnection);
+
     QOpenGLFunctions::initializeOpenGLFunctions();
 
     QString strange;
@@ -195,37 +222,13 @@ void gl3dView::initializeGL()
         trace(log);
     }    
 
-    QString vsrc, gsrc, fsrc;
-
     makeStandardBuffers();
 
-
+    // the programs are only compiled and linked by the first view which is initialized
     //--------- setup the shader to paint stippled thick lines -----------
-    vsrc = ":/shaders/line/line_VS.glsl";
-    m_shadLine.addShaderFromSourceFile(QOpenGLShader::Vertex, vsrc);
-    if(m_shadLine.log().length())
-    {
-        strange = QString::asprintf("%s", QString("Line vertex shader log:"+m_shadLine.log()).toStdString().c_str());
-        trace(strange);
-    }
-
-    gsrc = ":/shaders/line/line_GS.glsl";
-    m_shadLine.addShaderFromSourceFile(QOpenGLShader::Geometry, gsrc);
-    if(m_shadLine.log().length())
-    {
-        strange = QString::asprintf("%s", QString("Line geometry shader log:"+m_shadLine.log()).toStdString().c_str());
-        trace(strange);
-    }
-
-    fsrc = ":/shaders/line/line_FS.glsl";
-    m_shadLine.addShaderFromSourceFile(QOpenGLShader::Fragment, fsrc);
-    if(m_shadLine.log().length())
-    {
-        strange = QString::asprintf("%s", QString("Line fragment shader log:"+m_shadLine.log()).toStdString().c_str());
-        trace(strange);
-    }
-
-    m_shadLine.link();
+    ShaderRegistry::build(m_shadLine, "Line", {{QOpenGLShader::Vertex,   ":/shaders/line/line_VS.glsl"},
+                                               {QOpenGLShader::Geometry, ":/shaders/line/line_GS.glsl"},
+                                               {QOpenGLShader::Fragment, ":/shaders/line/line_FS.glsl"}});
     m_shadLine.bind();
     {
         m_locLine.m_attrVertex   = m_shadLine.attributeLocation("vertexPosition_modelSpace");
@@ -245,23 +248,8 @@ void gl3dView::initializeGL()
     m_shadLine.release();
 
     //setup the shader to paint coloured surfaces
-    vsrc = ":/shaders/surface/surface_VS.glsl";
-    fsrc = ":/shaders/surface/surface_FS.glsl";
-    m_shadSurf.addShaderFromSourceFile(QOpenGLShader::Vertex, vsrc);
-    if(m_shadSurf.log().length())
-    {
-        strange = QString::asprintf("%s", QString("Surface vertex shader log:"+m_shadSurf.log()).toStdString().c_str());
-        trace(strange);
-    }
-
-    m_shadSurf.addShaderFromSourceFile(QOpenGLShader::Fragment, fsrc);
-    if(m_shadSurf.log().length())
-    {
-        strange = QString::asprintf("%s", QString("Surface fragment shader log:"+m_shadSurf.log()).toStdString().c_str());
-        trace(strange);
-    }
-
-    m_shadSurf.link();
+    ShaderRegistry::build(m_shadSurf, "Surface", {{QOpenGLShader::Vertex,   ":/shaders/surface/surface_VS.glsl"},
+                                                  {QOpenGLShader::Fragment, ":/shaders/surface/surface_FS.glsl"}});
     m_shadSurf.bind();
     {
         m_locSurf.m_attrVertex = m_shadSurf.attributeLocation("vertexPosition_modelSpace");
@@ -269,6 +257,9 @@ void gl3dView::initializeGL()
         m_locSurf.m_attrUV     = m_shadSurf.attributeLocation("vertexUV");
         m_locSurf.m_attrColor  = m_shadSurf.attributeLocation("vertexColor");
         m_locSurf.m_attrOffset = m_shadSurf.attributeLocation("vertexOffset");
+        m_locSurf.m_attrInstMatrix = m_shadSurf.attributeLocation("instanceMatrix");
+        m_locSurf.m_attrInstRadius = m_shadSurf.attributeLocation("instanceRadius");
+        m_locSurf.m_attrInstColor  = m_shadSurf.attributeLocation("instanceColor");
 
         m_locSurf.m_ClipPlane    = m_shadSurf.uniformLocation("clipPlane0");
         m_locSurf.m_pvmMatrix    = m_shadSurf.uniformLocation("pvmMatrix");
@@ -284,36 +275,18 @@ void gl3dView::initializeGL()
 
         m_uHasShadow             = m_shadSurf.uniformLocation("HasShadow");
         m_uShadowLightViewMatrix = m_shadSurf.uniformLocation("LightViewMatrix");
+
+        // the program may have been left in any state by another view
+        m_shadSurf.setUniformValue(m_locSurf.m_HasTexture,  0);
+        m_shadSurf.setUniformValue(m_locSurf.m_IsInstanced, 0);
+        m_shadSurf.setUniformValue(m_uHasShadow,            0);
     }
     m_shadSurf.release();
 
     //--------- setup the shader to paint stippled large points -----------
-
-    vsrc = ":/shaders/point/point_VS.glsl";
-    m_shadPoint.addShaderFromSourceFile(QOpenGLShader::Vertex, vsrc);
-    if(m_shadPoint.log().length())
-    {
-        strange = QString::asprintf("%s", QString("Point vertex shader log:"+m_shadPoint.log()).toStdString().c_str());
-        trace(strange);
-    }
-
-    gsrc = ":/shaders/point/point_GS.glsl";
-    m_shadPoint.addShaderFromSourceFile(QOpenGLShader::Geometry, gsrc);
-    if(m_shadPoint.log().length())
-    {
-        strange = QString::asprintf("%s", QString("Point geometry shader log:"+m_shadPoint.log()).toStdString().c_str());
-        trace(strange);
-    }
-
-    fsrc = ":/shaders/point/point_FS.glsl";
-    m_shadPoint.addShaderFromSourceFile(QOpenGLShader::Fragment, fsrc);
-    if(m_shadPoint.log().length())
-    {
-        strange = QString::asprintf("%s", QString("Point fragment shader log:"+m_shadPoint.log()).toStdString().c_str());
-        trace(strange);
-    }
-
-    m_shadPoint.link();
+    ShaderRegistry::build(m_shadPoint, "Point", {{QOpenGLShader::Vertex,   ":/shaders/point/point_VS.glsl"},
+                                                 {QOpenGLShader::Geometry, ":/shaders/point/point_GS.glsl"},
+                                                 {QOpenGLShader::Fragment, ":/shaders/point/point_FS.glsl"}});
     m_shadPoint.bind();
     {
         m_locPoint.m_attrVertex = m_shadPoint.attributeLocation("vertexPosition_modelSpace");
@@ -332,25 +305,8 @@ void gl3dView::initializeGL()
 
 
     // setup the flat point shader
-    vsrc = ":/shaders/point2/point2_VS.glsl";
-    fsrc = ":/shaders/point2/point2_FS.glsl";
-
-    m_shadPoint2.addShaderFromSourceFile(QOpenGLShader::Vertex, vsrc);
-    if(m_shadPoint2.log().length())
-    {
-        strange = QString::asprintf("%s", QString("point2 vertex shader log:"+m_shadPoint2.log()).toStdString().c_str());
-        trace(strange);
-    }
-
-
-    m_shadPoint2.addShaderFromSourceFile(QOpenGLShader::Fragment, fsrc);
-    if(m_shadPoint2.log().length())
-    {
-        strange = QString::asprintf("%s", QString("point2 fragment shader log:"+m_shadPoint2.log()).toStdString().c_str());
-        trace(strange);
-    }
-
-    m_shadPoint2.link();
+    ShaderRegistry::build(m_shadPoint2, "point2", {{QOpenGLShader::Vertex,   ":/shaders/point2/point2_VS.glsl"},
+                                                   {QOpenGLShader::Fragment, ":/shaders/point2/point2_FS.glsl"}});
     m_shadPoint2.bind();
     {
         m_locPt2.m_attrVertex  = m_shadPoint2.attributeLocation("vertexPosition_modelSpace");
@@ -365,23 +321,8 @@ void gl3dView::initializeGL()
     m_shadPoint2.release();
 
     //setup the depth shader
-    vsrc = ":/shaders/shadow/depth_VS.glsl";
-    fsrc = ":/shaders/shadow/depth_FS.glsl";
-    m_shadDepth.addShaderFromSourceFile(QOpenGLShader::Vertex, vsrc);
-    if(m_shadDepth.log().length())
-    {
-        QString strange = QString::asprintf("%s", QString("Depth vertex shader log:"+m_shadDepth.log()).toStdString().c_str());
-        trace(strange);
-    }
-
-    m_shadDepth.addShaderFromSourceFile(QOpenGLShader::Fragment, fsrc);
-    if(m_shadDepth.log().length())
-    {
-        QString strange = QString::asprintf("%s", QString("Depth fragment shader log:"+m_shadDepth.log()).toStdString().c_str());
-        trace(strange);
-    }
-
-    m_shadDepth.link();
+    ShaderRegistry::build(m_shadDepth, "Depth", {{QOpenGLShader::Vertex,   ":/shaders/shadow/depth_VS.glsl"},
+                                                 {QOpenGLShader::Fragment, ":/shaders/shadow/depth_FS.glsl"}});
     m_shadDepth.bind();
     {
         m_attrDepthPos = m_shadDepth.attributeLocation("vertexPosition_modelSpace");
@@ -435,18 +376,51 @@ void gl3dView::onOglLogMsg(QOpenGLDebugMessage const & logmsg)
 }
 
 
+/**
+ * Makes the buffers used by all the views. The arcball depends on the view and is made for each view;
+ * the other buffers have constant geometry and are only made by the first view which is initialized,
+ * then shared with the next ones through the ShaderRegistry.
+ */
 void gl3dView::makeStandardBuffers()
 {
-    glMakeAxes();
-    glMakeLightSource();
     glMakeArcBall(m_ArcBall);
     glMakeArcPoint(m_ArcBall);
     glMakeIcoSphere();
+
+    QVector<QPair<QString, QOpenGLBuffer*>> const shared = {
+        {"axes",              &m_vboAxes},
+        {"lightsource",       &m_vboLightSource},
+        {"icosahedron",       &m_vboIcosahedron},
+        {"icosahedron_edges", &m_vboIcosahedronEdges},
+        {"cylinder",          &m_vboCylinder},
+        {"cylinder_contour",  &m_vboCylinderContour},
+        {"cube",              &m_vboCube},
+        {"cube_edges",        &m_vboCubeEdges},
+        {"thinarrow",         &m_vboThinArrow},
+        {"cone",              &m_vboCone},
+        {"cone_contour",      &m_vboConeContour}};
+
+    bool bShared = true;
+    for(int i=0; i<shared.size(); i++) bShared = bShared && ShaderRegistry::hasBuffer(shared.at(i).first);
+
+    if(bShared)
+    {
+        for(int i=0; i<shared.size(); i++) *shared.at(i).second = ShaderRegistry::buffer(shared.at(i).first);
+        return;
+    }
+
+    // detach from the buffers shared by a previous initialization so that they are not destroyed
+    for(int i=0; i<shared.size(); i++) *shared.at(i).second = QOpenGLBuffer();
+
+    glMakeAxes();
+    glMakeLightSource();
     glMakeIcosahedron();
     glMakeCylinder(1.0f, 0.05f, 10, 57);
     gl::makeCube(Vector3d(), 1.0,1.0,1.0, m_vboCube, m_vboCubeEdges);
     glMakeUnitArrow();
     glMakeCone(1.0f, 1.0f,  1, 57);
+
+    for(int i=0; i<shared.size(); i++) ShaderRegistry::setBuffer(shared.at(i).first, *shared.at(i).second);
 }
 
 
@@ -1042,6 +1016,18 @@ void gl3dView::keyPressEvent(QKeyEvent *pEvent)
             pEvent->accept();
             return;
         }
+        case Qt::Key_F9:
+        {
+            if(bShift) exportProfile();
+            else
+            {
+                FrameProfiler::setEnabled(!FrameProfiler::isEnabled());
+                m_Profiler.clear();
+            }
+            update();
+            pEvent->accept();
+            return;
+        }
         default:
             break;
     }
@@ -1081,6 +1067,7 @@ void gl3dView::hideEvent(QHideEvent *pEvent)
 void gl3dView::resizeGL(int width, int height)
 {
     QOpenGLWidget::resizeGL(width, height);
+    resizeLabels();
 
     double w = double(width);
     double h = double(height);
@@ -1231,10 +1218,13 @@ void gl3dView::glSetupLight()
 
 void gl3dView::paintGL()
 {
-//    auto t0 = std::chrono::high_resolution_clock::now();
+    m_Profiler.beginFrame();
 
+    m_Profiler.beginStage(FrameProfiler::MAKEOBJECTS);
     glMake3dObjects();
+    m_Profiler.endStage(FrameProfiler::MAKEOBJECTS);
 
+    m_Profiler.beginStage(FrameProfiler::RENDER);
     if(m_bIsImageLoaded)
     {
         QOpenGLPaintDevice device(size() * devicePixelRatio());
@@ -1243,13 +1233,57 @@ void gl3dView::paintGL()
     }
 
     paintGl3();
+    m_Profiler.endStage(FrameProfiler::RENDER);
 
     glDisable(GL_CULL_FACE);
+    m_Profiler.beginStage(FrameProfiler::OVERLAY);
     paintOverlay();
+    m_Profiler.endStage(FrameProfiler::OVERLAY);
 
-/*    auto t1 = std::chrono::high_resolution_clock::now();
-    int duration = std::chrono::duration_cast<std::chrono::microseconds>(t1 - t0).count();
-    qDebug("gl3dView::paintGL: %7d µs", duration);*/
+    m_Profiler.endFrame();
+    paintProfiler();
+}
+
+
+/** Paints the frame statistics on top of the view if the profiler's overlay is enabled */
+void gl3dView::paintProfiler()
+{
+    if(!FrameProfiler::isEnabled() || !FrameProfiler::bOverlay()) return;
+    QOpenGLPaintDevice device(size() * devicePixelRatio());
+    QPainter painter(&device);
+    int margin = int(10*devicePixelRatio());
+    m_Profiler.paintOverlay(painter, margin, margin);
+}
+
+
+/** Writes the recorded frames in CSV and JSON format in the user's documents directory */
+void gl3dView::exportProfile()
+{
+    QStringList loc = QStandardPaths::standardLocations(QStandardPaths::DocumentsLocation);
+    QString path;
+    if(!loc.isEmpty()) path = loc.first() + QDir::separator();
+    path += QString(metaObject()->className()) + "_frames";
+
+    bool bCSV  = m_Profiler.exportCSV(path+".csv");
+    bool bJSON = m_Profiler.exportJSON(path+".json");
+    if(bCSV && bJSON) setOutputInfo("Frame profile written to "+path+".csv and .json");
+    else              setOutputInfo("Could not write the frame profile to "+path);
+}
+
+
+void gl3dView::setOutputInfo(QString const &info)
+{
+    m_plabInfoOutput->setText(info);
+    resizeLabels();
+}
+
+
+void gl3dView::resizeLabels()
+{
+    int w = rect().width();
+    m_plabInfoOutput->adjustSize();
+    QPoint pos1(w-m_plabInfoOutput->width()-5, 5);
+    m_plabInfoOutput->move(pos1);
 }
 
 
@@ -1747,6 +1781,7 @@ void gl3dView::onDynamicIncrement()
 void gl3dView::startDynamicTimer()
 {
     m_DynTimer.start(17);
+    m_Profiler.setTargetInterval(m_DynTimer.interval());
 }
 
 
@@ -2391,7 +2426,11 @@ void gl3dView::paintThinArrow(Vector3d const &origin, const Vector3d& arrow,
 }
 
 
-void gl3dView::paintTriangles3Vtx(QOpenGLBuffer &vbo, const QColor &backclr, bool bTwoSided, bool bLight)
+/**
+ * Paints the triangles of the vbo, or the indexed triangles of the vbo if an index buffer is provided.
+ * The vbo contains (3 position components+3 normal components) for each vertex.
+ */
+void gl3dView::paintTriangles3Vtx(QOpenGLBuffer &vbo, const QColor &backclr, bool bTwoSided, bool bLight, QOpenGLBuffer *pIbo)
 {
     QOpenGLVertexArrayObject::Binder vaoBinder(&m_vao);
 
@@ -2420,15 +2459,13 @@ void gl3dView::paintTriangles3Vtx(QOpenGLBuffer &vbo, const QColor &backclr, boo
 
         vbo.bind();
         {
-            int nTriangles = vbo.size()/3/stride/int(sizeof(float)); // three vertices and (3 position components+3 normal components)
-
             m_shadSurf.setAttributeBuffer(m_locSurf.m_attrVertex, GL_FLOAT, 0,                 3, stride*sizeof(GLfloat));
             m_shadSurf.setAttributeBuffer(m_locSurf.m_attrNormal, GL_FLOAT, 3*sizeof(GLfloat), 3, stride*sizeof(GLfloat));
             glEnable(GL_POLYGON_OFFSET_FILL);
             glPolygonMode(GL_FRONT_AND_BACK, GL_FILL);
             glPolygonOffset(DEPTHFACTOR, DEPTHUNITS);
 
-            glDrawArrays(GL_TRIANGLES, 0, nTriangles*3); // 4 vertices defined but only 3 are used
+            drawTriangles(vbo, stride, pIbo);
         }
         vbo.release();
         glDisable(GL_POLYGON_OFFSET_FILL);
@@ -2501,10 +2538,17 @@ void gl3dView::paintSphere(float xs, float ys, float zs, float radius, const QCo
 }
 
 
-void gl3dView::paintSphereInstances(QOpenGLBuffer &vboPosInstances, float radius, QColor const &clr, bool bTwoSided, bool bLight)
+/**
+ * Paints a sphere at each of the positions of the instance buffer in a single instanced draw call.
+ * @param pvboSphere the sphere's triangles, or the default icosphere if null
+ */
+void gl3dView::paintSphereInstances(QOpenGLBuffer &vboPosInstances, float radius, QColor const &clr, bool bTwoSided, bool bLight,
+                                    QOpenGLBuffer *pvboSphere)
 {
     QOpenGLVertexArrayObject::Binder vaoBinder(&m_vao);
 
+    QOpenGLBuffer &vboSphere = pvboSphere ? *pvboSphere : m_vboIcoSphere;
+
     int nTriangles(0);
     int nObjects(0);
 
@@ -2523,7 +2567,7 @@ void gl3dView::paintSphereInstances(QOpenGLBuffer &vboPosInstances, float radius
 
         glEnable(GL_CULL_FACE);
 
-        m_vboIcoSphere.bind();
+        vboSphere.bind();
         {
             m_shadSurf.enableAttributeArray(m_locSurf.m_attrVertex);
             m_shadSurf.enableAttributeArray(m_locSurf.m_attrNormal);
@@ -2531,10 +2575,10 @@ void gl3dView::paintSphereInstances(QOpenGLBuffer &vboPosInstances, float radius
             m_shadSurf.setAttributeBuffer(m_locSurf.m_attrVertex, GL_FLOAT, 0,                 3, 6*sizeof(GLfloat));
             m_shadSurf.setAttributeBuffer(m_locSurf.m_attrNormal, GL_FLOAT, 3*sizeof(GLfloat), 3, 6*sizeof(GLfloat));
 
-            nTriangles = m_vboIcoSphere.size()/3/6/int(sizeof(float));
+            nTriangles = vboSphere.size()/3/6/int(sizeof(float));
 //            glDrawArrays(GL_TRIANGLES, 0, nTriangles*3); // 4 vertices defined but only 3 are used
         }
-        m_vboIcoSphere.release();
+        vboSphere.release();
 
         vboPosInstances.bind();
         {
@@ -2559,6 +2603,126 @@ void gl3dView::paintSphereInstances(QOpenGLBuffer &vboPosInstances, float radius
 }
 
 
+/**
+ * Culls the culler's instances against the view frustum, then paints the visible instances
+ * with one instanced draw call for each level of detail. The level of detail of each instance is
+ * the subdivision level of the icosphere, chosen from the sphere's radius projected on the screen.
+ */
+void gl3dView::paintSphereInstances(InstanceCuller &culler, float radius, QColor const &clr, bool bTwoSided, bool bLight)
+{
+    culler.cull(m_matProj*m_matView*m_matModel, radius, height()*devicePixelRatio());
+
+    for(int l=0; l<InstanceCuller::NLOD; l++)
+    {
+        if(culler.lodCount(l)==0) continue;
+        if(!m_vboIcoSphereLod[l].isCreated())
+        {
+            QOpenGLBuffer vboEdges;
+            glMakeIcoSphere(l, m_vboIcoSphereLod[l], vboEdges);
+        }
+        paintSphereInstances(culler.lodBuffer(l), radius, clr, bTwoSided, bLight, &m_vboIcoSphereLod[l]);
+    }
+}
+
+
+/**
+ * Paints all the spheres in a single instanced draw call.
+ * @param vboMatrices the per-instance model matrices, 16 floats each in column-major order
+ * @param vboRadii the per-instance radii, 1 float each
+ * @param vboColors the per-instance colours, 4 floats each in the range [0,1]
+ */
+void gl3dView::paintSphereInstances(QOpenGLBuffer &vboMatrices, QOpenGLBuffer &vboRadii, QOpenGLBuffer &vboColors, bool bLight)
+{
+    QOpenGLVertexArrayObject::Binder vaoBinder(&m_vao);
+
+    int nObjects = vboRadii.size()/int(sizeof(float));
+    if(nObjects<=0) return;
+    int nTriangles = m_vboIcoSphere.size()/3/6/int(sizeof(float));
+
+    m_shadSurf.bind();
+    {
+        m_shadSurf.setUniformValue(m_locSurf.m_HasTexture,  0);
+        m_shadSurf.setUniformValue(m_locSurf.m_IsInstanced, 2);
+        m_shadSurf.setUniformValue(m_locSurf.m_TwoSided,    0);
+        if(bLight) m_shadSurf.setUniformValue(m_locSurf.m_Light, 1);
+        else       m_shadSurf.setUniformValue(m_locSurf.m_Light, 0);
+        m_shadSurf.setUniformValue(m_locSurf.m_HasUniColor, 0);
+
+        glEnable(GL_CULL_FACE);
+        glPolygonMode(GL_FRONT_AND_BACK, GL_FILL);
+
+        m_vboIcoSphere.bind();
+        {
+            m_shadSurf.enableAttributeArray(m_locSurf.m_attrVertex);
+            m_shadSurf.enableAttributeArray(m_locSurf.m_attrNormal);
+            m_shadSurf.setAttributeBuffer(m_locSurf.m_attrVertex, GL_FLOAT, 0,                 3, 6*sizeof(GLfloat));
+            m_shadSurf.setAttributeBuffer(m_locSurf.m_attrNormal, GL_FLOAT, 3*sizeof(GLfloat), 3, 6*sizeof(GLfloat));
+        }
+        m_vboIcoSphere.release();
+
+        // the matrix attribute uses 4 consecutive locations, one per column
+        if(m_locSurf.m_attrInstMatrix>=0)
+        {
+            vboMatrices.bind();
+            for(int k=0; k<4; k++)
+            {
+                int loc = m_locSurf.m_attrInstMatrix+k;
+                m_shadSurf.enableAttributeArray(loc);
+                m_shadSurf.setAttributeBuffer(loc, GL_FLOAT, k*4*sizeof(GLfloat), 4, 16*sizeof(GLfloat));
+                glVertexAttribDivisor(GLuint(loc), 1);
+            }
+            vboMatrices.release();
+        }
+        if(m_locSurf.m_attrInstRadius>=0)
+        {
+            vboRadii.bind();
+            m_shadSurf.enableAttributeArray(m_locSurf.m_attrInstRadius);
+            m_shadSurf.setAttributeBuffer(m_locSurf.m_attrInstRadius, GL_FLOAT, 0, 1, sizeof(GLfloat));
+            glVertexAttribDivisor(GLuint(m_locSurf.m_attrInstRadius), 1);
+            vboRadii.release();
+        }
+        if(m_locSurf.m_attrInstColor>=0)
+        {
+            vboColors.bind();
+            m_shadSurf.enableAttributeArray(m_locSurf.m_attrInstColor);
+            m_shadSurf.setAttributeBuffer(m_locSurf.m_attrInstColor, GL_FLOAT, 0, 4, 4*sizeof(GLfloat));
+            glVertexAttribDivisor(GLuint(m_locSurf.m_attrInstColor), 1);
+            vboColors.release();
+        }
+
+        glDrawArraysInstanced(GL_TRIANGLES, 0, nTriangles*3, nObjects);
+
+        // leave things as they were
+        if(m_locSurf.m_attrInstMatrix>=0)
+        {
+            for(int k=0; k<4; k++)
+            {
+                glVertexAttribDivisor(GLuint(m_locSurf.m_attrInstMatrix+k), 0);
+                m_shadSurf.disableAttributeArray(m_locSurf.m_attrInstMatrix+k);
+            }
+        }
+        if(m_locSurf.m_attrInstRadius>=0)
+        {
+            glVertexAttribDivisor(GLuint(m_locSurf.m_attrInstRadius), 0);
+            m_shadSurf.disableAttributeArray(m_locSurf.m_attrInstRadius);
+        }
+        if(m_locSurf.m_attrInstColor>=0)
+        {
+            glVertexAttribDivisor(GLuint(m_locSurf.m_attrInstColor), 0);
+            m_shadSurf.disableAttributeArray(m_locSurf.m_attrInstColor);
+        }
+
+        glDisable(GL_CULL_FACE);
+
+        m_shadSurf.disableAttributeArray(m_locSurf.m_attrVertex);
+        m_shadSurf.disableAttributeArray(m_locSurf.m_attrNormal);
+        m_shadSurf.setUniformValue(m_locSurf.m_IsInstanced, 0);
+        m_shadSurf.setUniformValue(m_locSurf.m_HasUniColor, 1);
+    }
+    m_shadSurf.release();
+}
+
+
 void gl3dView::onZAnimate(bool bZAnimate)
 {
     m_bZAnimate = bZAnimate;
@@ -3339,14 +3503,37 @@ void gl3dView::glMakeIcosahedron()
 }
 
 
+/** Makes the unit sphere or gets it from the registry if it has already been made with the same number of splits */
 void gl3dView::glMakeIcoSphere(int nSplits)
 {
+    glMakeIcoSphere(nSplits, m_vboIcoSphere, m_vboIcoSphereEdges);
+}
+
+
+/** Makes the unit icosphere with nSplits subdivisions in the buffers, or gets it from the registry if it has been made */
+void gl3dView::glMakeIcoSphere(int nSplits, QOpenGLBuffer &vbo, QOpenGLBuffer &vboEdges)
+{
+    QString key = QString::asprintf("icosphere_%d", nSplits);
+    if(ShaderRegistry::hasBuffer(key))
+    {
+        vbo      = ShaderRegistry::buffer(key);
+        vboEdges = ShaderRegistry::buffer(key+"_edges");
+        return;
+    }
+
+    // the current buffers may be shared, do not destroy them
+    vbo      = QOpenGLBuffer();
+    vboEdges = QOpenGLBuffer();
+
     double radius = 1.0;
     // make vertices
     QVector<Triangle3d> icotriangles;
     makeSphere(radius, nSplits, icotriangles);
-    gl::makeTriangles3Vtx(icotriangles, false, m_vboIcoSphere);
-    gl::makeTrianglesOutline(icotriangles, Vector3d(), m_vboIcoSphereEdges);
+    gl::makeTriangles3Vtx(icotriangles, false, vbo);
+    gl::makeTrianglesOutline(icotriangles, Vector3d(), vboEdges);
+
+    ShaderRegistry::setBuffer(key,          vbo);
+    ShaderRegistry::setBuffer(key+"_edges", vboEdges);
 }
 
 
@@ -3546,7 +3733,7 @@ void gl3dView::updateLightMatrix()
 }
 
 
-void gl3dView::paintTrianglesToDepthMap(QOpenGLBuffer &vbo, QMatrix4x4 const &ModelMat, int stride)
+void gl3dView::paintTrianglesToDepthMap(QOpenGLBuffer &vbo, QMatrix4x4 const &ModelMat, int stride, QOpenGLBuffer *pIbo)
 {
     QOpenGLVertexArrayObject::Binder vaoBinder(&m_vao);
 
@@ -3558,9 +3745,8 @@ void gl3dView::paintTrianglesToDepthMap(QOpenGLBuffer &vbo, QMatrix4x4 const &Mo
 
         vbo.bind();
         {
-            int nTriangles = vbo.size()/3/stride/int(sizeof(float)); // three vertices and (3 position components+3 normal components)
             m_shadDepth.setAttributeBuffer(m_attrDepthPos, GL_FLOAT, 0, 3, stride*sizeof(GLfloat));
-            glDrawArrays(GL_TRIANGLES, 0, nTriangles*3); // 4 vertices defined but only 3 are used
+            drawTriangles(vbo, stride, pIbo);
             m_shadDepth.disableAttributeArray(m_attrDepthPos);
         }
         vbo.release();
@@ -3602,7 +3788,7 @@ void gl3dView::paintPoints2(QOpenGLBuffer &vbo, float width, int stride)
 
 
 void gl3dView::paintTriangles3VtxShadow(QOpenGLBuffer &vbo, const QColor &backclr, bool bTwoSided, bool bLight,
-                                        QMatrix4x4 const &modelmat, int stride)
+                                        QMatrix4x4 const &modelmat, int stride, QOpenGLBuffer *pIbo)
 {
     QOpenGLVertexArrayObject::Binder vaoBinder(&m_vao);
 
@@ -3639,7 +3825,6 @@ void gl3dView::paintTriangles3VtxShadow(QOpenGLBuffer &vbo, const QColor &backcl
         m_shadSurf.enableAttributeArray(m_locSurf.m_attrNormal);
 
         vbo.bind();
-        int nTriangles = vbo.size()/3/stride/int(sizeof(float)); // three vertices and (3 position components+3 normal components)
 
         m_shadSurf.setAttributeBuffer(m_locSurf.m_attrVertex, GL_FLOAT, 0,                 3, stride*sizeof(GLfloat));
         m_shadSurf.setAttributeBuffer(m_locSurf.m_attrNormal, GL_FLOAT, 3*sizeof(GLfloat), 3, stride*sizeof(GLfloat));
@@ -3647,7 +3832,7 @@ void gl3dView::paintTriangles3VtxShadow(QOpenGLBuffer &vbo, const QColor &backcl
         glPolygonMode(GL_FRONT_AND_BACK, GL_FILL);
         glPolygonOffset(DEPTHFACTOR, DEPTHUNITS);
 
-        glDrawArrays(GL_TRIANGLES, 0, nTriangles*3);
+        drawTriangles(vbo, stride, pIbo);
 
         glDisable(GL_POLYGON_OFFSET_FILL);
 
@@ -3728,6 +3913,26 @@ void gl3dView::paintTriangles3VtxTexture(QOpenGLBuffer &vbo, QOpenGLTexture *pTe
 }
 
 
+/**
+ * Issues the draw call for the triangles of the bound vbo. If the index buffer is provided,
+ * the triangles are drawn with the GLuint indices of the index buffer, otherwise
+ * each group of three consecutive vertices of the vbo makes a triangle.
+ */
+void gl3dView::drawTriangles(QOpenGLBuffer &vbo, int stride, QOpenGLBuffer *pIbo)
+{
+    if(pIbo && pIbo->isCreated())
+    {
+        pIbo->bind();
+        glDrawElements(GL_TRIANGLES, pIbo->size()/int(sizeof(GLuint)), GL_UNSIGNED_INT, nullptr);
+        pIbo->release();
+    }
+    else
+    {
+        int nTriangles = vbo.size()/3/stride/int(sizeof(float)); // three vertices and stride components
+        glDrawArrays(GL_TRIANGLES, 0, nTriangles*3);
+    }
+}
+
 
 void gl3dView::paintTriangles3VtxOutline(QOpenGLBuffer &vbo, QColor clr, int thickness)
 {
@@ -3823,6 +4028,13 @@ QVector4D gl3dView::worldToViewport(Vector3d const&v) const
 }
 
 
+/** Returns the level of detail of the mesh to draw with the model matrix, from the mesh's error projected on the viewport */
+int gl3dView::meshLodLevel(MeshLod const &lod, QMatrix4x4 const &modelmat) const
+{
+    return lod.selectLevel(m_matProj*m_matView*m_matModel*modelmat, height()*devicePixelRatio());
+}
+
+
 QPoint gl3dView::worldToScreen(Vector3d const&v, QVector4D &vScreen) const
 {
     QVector4D v4(float(v.x), float(v.y), float(v.z), 1.0f);
@@ -3868,6 +4080,20 @@ void gl3dView::screenToWorld(QPoint const &screenpt, int z, Vector3d &modelpt) c
 }
 
 
+/**
+ * Returns the index of the point of the tree under the screen point, i.e. the point closest to the viewer
+ * among those at a distance less than the radius from the line of sight, or -1 if there is none.
+ * @param maxindex if positive, only the points with an index less than maxindex are considered.
+ */
+int gl3dView::pickPoint(PointKdTree const &tree, QPoint const &screenpt, double radius, int maxindex) const
+{
+    Vector3d AA, BB;
+    screenToWorld(screenpt, -1, AA);
+    screenToWorld(screenpt,  1, BB);
+    return tree.closestToRay(AA, BB, radius, maxindex);
+}
+
+
 void gl3dView::viewportToWorld(Vector3d vp, Vector3d &w) const
 {
     //un-translate
@@ -10,6 +10,7 @@
 #pragma once
 
 #include <QElapsedTimer>
+#include <QLabel>
 #include <QOpenGLBuffer>
 #include <QOpenGLDebugLogger>
 #include <QOpenGLFunctions>
@@ -23,6 +24,9 @@
 
 #include <xflgeom/geom2d/vector2d.h>
 #include <xfl3d/controls/arcball.h>
+#include <xfl3d/views/frameprofiler.h>
+#include <xfl3d/views/instanceculler.h>
+#include <xfl3d/views/meshlod.h>
 #include <xfl3d/views/shadloc.h>
 #include <xfl3d/views/light.h>
 #include <xflcore/linestyle.h>
@@ -40,6 +44,7 @@
 
 
 class GLLightDlg;
+class PointKdTree;
 
 class gl3dView : public QOpenGLWidget, protected QOpenGLExtraFunctions
 {
@@ -130,6 +135,11 @@ class gl3dView : public QOpenGLWidget, protected QOpenGLExtraFunctions
         static void saveSettings(QSettings &settings);
         static void loadSettings(QSettings &settings);
 
+        FrameProfiler const &profiler() const {return m_Profiler;}
+
+        void setOutputInfo(QString const &info);
+        void clearOutputInfo()  {m_plabInfoOutput->clear();}
+
     signals:
         void viewModified();
 
@@ -182,10 +192,14 @@ class gl3dView : public QOpenGLWidget, protected QOpenGLExtraFunctions
         void onOglLogMsg(QOpenGLDebugMessage const & logmsg);
 
         void onSaveImage();
+        void onCleanupGL();
 
     protected:
         virtual void glRenderView();
         virtual void paintOverlay();
+        void paintProfiler();
+        void exportProfile();
+        void resizeLabels();
 
         void glMakeArcPoint(const ArcBall &arcball);
         void glMakeArcBall(ArcBall &arcball);
@@ -194,6 +208,7 @@ class gl3dView : public QOpenGLWidget, protected QOpenGLExtraFunctions
         void glMakeCylinder(float h, float r, int nz, int nh);
         void glMakeIcosahedron();
         void glMakeIcoSphere(int nSplits=2);
+        void glMakeIcoSphere(int nSplits, QOpenGLBuffer &vbo, QOpenGLBuffer &vboEdges);
         void glMakeUnitArrow();
         void glMakeCone(float h, float r, int nz, int nh);
 
@@ -218,7 +233,9 @@ class gl3dView : public QOpenGLWidget, protected QOpenGLExtraFunctions
         void paintBox(double x, double y, double z, double dx, double dy, double dz, QColor const &clr, bool bLight);
         void paintSphere(float xs, float ys, float zs, float radius, const QColor &color, bool bLight=true);
         void paintSphere(const Vector3d &place, float radius, const QColor &sphereColor, bool bLight=true);
-        void paintSphereInstances(QOpenGLBuffer &vboPosInstances, float radius, QColor const &clr, bool bTwoSided, bool bLight);
+        void paintSphereInstances(QOpenGLBuffer &vboPosInstances, float radius, QColor const &clr, bool bTwoSided, bool bLight, QOpenGLBuffer *pvboSphere=nullptr);
+        void paintSphereInstances(InstanceCuller &culler, float radius, QColor const &clr, bool bTwoSided, bool bLight);
+        void paintSphereInstances(QOpenGLBuffer &vboMatrices, QOpenGLBuffer &vboRadii, QOpenGLBuffer &vboColors, bool bLight);
 
         void paintIcosahedron(const Vector3d &place, float radius, const QColor &color, LineStyle const &ls, bool bOutline, bool bLight);
 
@@ -236,16 +253,18 @@ class gl3dView : public QOpenGLWidget, protected QOpenGLExtraFunctions
         void paintThinArrow(Vector3d const &origin, const Vector3d& arrow, LineStyle const &ls, QMatrix4x4 const ModelMatrix=QMatrix4x4());
         void paintThinArrow(Vector3d const &origin, const Vector3d& arrow, const QColor &clr, float w, Line::enumLineStipple stipple,
                             const QMatrix4x4 ModelMatrix=QMatrix4x4());
-        void paintTriangles3Vtx(QOpenGLBuffer &vbo, const QColor &backclr, bool bTwoSided, bool bLight);
+        void paintTriangles3Vtx(QOpenGLBuffer &vbo, const QColor &backclr, bool bTwoSided, bool bLight, QOpenGLBuffer *pIbo=nullptr);
 
         void paintTriangleFan(QOpenGLBuffer &vbo, const QColor &clr, bool bLight, bool bCullFaces);
 
         void updateLightMatrix();
-        void paintTrianglesToDepthMap(QOpenGLBuffer &vbo, const QMatrix4x4 &ModelMat, int stride);
-        void paintTriangles3VtxShadow(QOpenGLBuffer &vbo, const QColor &backclr, bool bTwoSided, bool bLight, const QMatrix4x4 &modelmat, int stride);
+        void paintTrianglesToDepthMap(QOpenGLBuffer &vbo, const QMatrix4x4 &ModelMat, int stride, QOpenGLBuffer *pIbo=nullptr);
+        void paintTriangles3VtxShadow(QOpenGLBuffer &vbo, const QColor &backclr, bool bTwoSided, bool bLight, const QMatrix4x4 &modelmat, int stride,
+                                      QOpenGLBuffer *pIbo=nullptr);
         void paintTriangles3VtxTexture(QOpenGLBuffer &vbo, QOpenGLTexture *pTexture, bool bTwoSided, bool bLight);
 
         void paintTriangles3VtxOutline(QOpenGLBuffer &vbo, QColor clr, int thickness);
+        void drawTriangles(QOpenGLBuffer &vbo, int stride, QOpenGLBuffer *pIbo);
 
         void paintColourMap(QOpenGLBuffer &vbo, const QMatrix4x4 &m_ModelMatrix = QMatrix4x4());
 
@@ -262,10 +281,12 @@ class gl3dView : public QOpenGLWidget, protected QOpenGLExtraFunctions
         void screenToViewport(QPoint const &point, int z, Vector3d &real) const;
         void screenToViewport(QPoint const &point, Vector3d &real) const;
         void screenToWorld(const QPoint &screenpt, int z, Vector3d &modelpt) const;
+        int pickPoint(PointKdTree const &tree, QPoint const &screenpt, double radius, int maxindex=-1) const;
         void viewportToScreen(Vector3d const &real, QPoint &point) const;
         void viewportToWorld(Vector3d vp, Vector3d &w) const;
 
         QVector4D worldToViewport(const Vector3d &v) const;
+        int meshLodLevel(MeshLod const &lod, QMatrix4x4 const &modelmat) const;
         QPoint worldToScreen(const Vector3d &v, QVector4D &vScreen) const;
         QPoint worldToScreen(QVector4D v4, QVector4D &vScreen) const;
 
@@ -280,10 +301,11 @@ class gl3dView : public QOpenGLWidget, protected QOpenGLExtraFunctions
         void initDepthMap();
 
     protected:
-        QOpenGLShaderProgram m_shadSurf;
-        QOpenGLShaderProgram m_shadLine;
-        QOpenGLShaderProgram m_shadPoint;
-        QOpenGLShaderProgram m_shadPoint2;
+        // the programs are shared by all the views, cf. ShaderRegistry
+        QOpenGLShaderProgram &m_shadSurf;
+        QOpenGLShaderProgram &m_shadLine;
+        QOpenGLShaderProgram &m_shadPoint;
+        QOpenGLShaderProgram &m_shadPoint2;
 
         ShaderLocations m_locSurf;
         ShaderLocations m_locLine;
@@ -291,7 +313,7 @@ class gl3dView : public QOpenGLWidget, protected QOpenGLExtraFunctions
         ShaderLocations m_locPt2;
 
         //shadow shader
-        QOpenGLShaderProgram m_shadDepth;   /** the shader used to build the depth map */
+        QOpenGLShaderProgram &m_shadDepth;   /** the shader used to build the depth map */
 
         // class shader locations
         ShaderLocations m_locShadow;
@@ -314,6 +336,7 @@ class gl3dView : public QOpenGLWidget, protected QOpenGLExtraFunctions
         QOpenGLBuffer m_vboCube, m_vboCubeEdges;
         QOpenGLBuffer m_vboIcosahedron, m_vboIcosahedronEdges;
         QOpenGLBuffer m_vboIcoSphere, m_vboIcoSphereEdges;
+        QOpenGLBuffer m_vboIcoSphereLod[InstanceCuller::NLOD];  /**< the icospheres with 0 to NLOD-1 subdivisions, made when first used */
         QOpenGLBuffer m_vboCone, m_vboConeContour;
         QOpenGLBuffer m_vboThinArrow;
         QOpenGLBuffer m_vboBackgroundQuad;
@@ -377,6 +400,10 @@ class gl3dView : public QOpenGLWidget, protected QOpenGLExtraFunctions
 
         QElapsedTimer m_MoveTime;
         QTimer m_DynTimer;
+
+        FrameProfiler m_Profiler;
+
+        QLabel *m_plabInfoOutput;
         Quaternion m_SpinInc;
         Vector3d m_Trans;
         bool m_bDynTranslation;
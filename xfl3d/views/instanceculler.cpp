@@ -0,0 +1,131 @@
+/****************************************************************************
+
+    Xfl3d application
+    Copyright (C) Andre Deperrois
+    License: GPL v3
+
+*****************************************************************************/
+
+#include <algorithm>
+#include <cmath>
+
+#include "instanceculler.h"
+#include <xfl3d/globals/vertexwriter.h>
+
+
+float InstanceCuller::s_LodPixels[NLOD-1] = {3.0f, 12.0f, 40.0f};
+
+
+InstanceCuller::InstanceCuller()
+{
+    for(int i=0; i<NLOD; i++) m_nLod[i] = 0;
+    m_Version = 0;
+    m_CulledVersion = -1;
+    m_CulledRadius = 0.0f;
+    m_CulledHeight = 0;
+}
+
+
+/** Sets the number of instances; the positions are then set with setPosition() */
+void InstanceCuller::setInstanceCount(int nInstances)
+{
+    int n = std::max(0, nInstances);
+    m_x.resize(n);
+    m_y.resize(n);
+    m_z.resize(n);
+    m_Pixels.resize(n);
+    m_Lod.resize(n);
+    m_Version++;
+}
+
+
+int InstanceCuller::visibleCount() const
+{
+    int n = 0;
+    for(int i=0; i<NLOD; i++) n += m_nLod[i];
+    return n;
+}
+
+
+/**
+ * Culls the instances against the frustum of the projection-view-model matrix and fills the buffers
+ * of each level of detail with the positions of the visible instances. Must be called with the context current.
+ * @param pvmMat the matrix which maps the instance positions to clip space
+ * @param radius the radius of the instances' bounding sphere
+ * @param viewportheight the height of the viewport in pixels
+ */
+void InstanceCuller::cull(QMatrix4x4 const &pvmMat, float radius, int viewportheight)
+{
+    if(m_CulledVersion==m_Version && m_CulledMat==pvmMat && m_CulledRadius==radius && m_CulledHeight==viewportheight)
+    {
+        // nothing has changed, unless the buffers have been destroyed with the context
+        bool bCreated = true;
+        for(int l=0; l<NLOD; l++) bCreated = bCreated && (m_nLod[l]==0 || m_vboLod[l].isCreated());
+        if(bCreated) return;
+    }
+    m_CulledVersion = m_Version;
+    m_CulledMat     = pvmMat;
+    m_CulledRadius  = radius;
+    m_CulledHeight  = viewportheight;
+
+    int n = m_x.size();
+
+    // the frustum planes a.x+b.y+c.z+d>=0, extracted from the rows of the matrix and normalized
+    QVector4D row[4] = {pvmMat.row(0), pvmMat.row(1), pvmMat.row(2), pvmMat.row(3)};
+    QVector4D plane[6] = {row[3]+row[0], row[3]-row[0], row[3]+row[1], row[3]-row[1], row[3]+row[2], row[3]-row[2]};
+    float pa[6], pb[6], pc[6], pd[6];
+    for(int ip=0; ip<6; ip++)
+    {
+        float norm = plane[ip].toVector3D().length();
+        if(norm<1.e-12f) norm = 1.0f;
+        pa[ip] = plane[ip].x()/norm;
+        pb[ip] = plane[ip].y()/norm;
+        pc[ip] = plane[ip].z()/norm;
+        pd[ip] = plane[ip].w()/norm + radius; // the sphere is visible if its centre is less than one radius outside
+    }
+
+    // the projected radius in pixels is radius * (vertical scale) / w * height/2
+    float scale = radius * row[1].toVector3D().length() * float(viewportheight) * 0.5f;
+    float wa = row[3].x(), wb = row[3].y(), wc = row[3].z(), wd = row[3].w();
+
+    float const *x = m_x.constData();
+    float const *y = m_y.constData();
+    float const *z = m_z.constData();
+    float *pixels = m_Pixels.data();
+
+    for(int i=0; i<n; i++)
+    {
+        float dmin = pa[0]*x[i] + pb[0]*y[i] + pc[0]*z[i] + pd[0];
+        for(int ip=1; ip<6; ip++)
+            dmin = std::min(dmin, pa[ip]*x[i] + pb[ip]*y[i] + pc[ip]*z[i] + pd[ip]);
+        float w = std::max(wa*x[i] + wb*y[i] + wc*z[i] + wd, 1.e-6f);
+        pixels[i] = dmin>=0.0f ? scale/w : -1.0f;
+    }
+
+    // count, then write the positions of each level of detail
+    signed char *lod = m_Lod.data();
+    for(int l=0; l<NLOD; l++) m_nLod[l] = 0;
+    for(int i=0; i<n; i++)
+    {
+        if(pixels[i]<0.0f)
+        {
+            lod[i] = -1;
+            continue;
+        }
+        int l = 0;
+        while(l<NLOD-1 && pixels[i]>=s_LodPixels[l]) l++;
+        lod[i] = static_cast<signed char>(l);
+        m_nLod[l]++;
+    }
+
+    for(int l=0; l<NLOD; l++)
+    {
+        VertexWriter positions(m_vboLod[l], m_nLod[l]*3);
+        for(int i=0; i<n; i++)
+        {
+            if(lod[i]==l) positions.put(x[i], y[i], z[i]);
+        }
+        positions.close();
+    }
+}
+
@@ -0,0 +1,65 @@
+/****************************************************************************
+
+    Xfl3d application
+    Copyright (C) Andre Deperrois
+    License: GPL v3
+
+*****************************************************************************/
+
+#pragma once
+
+#include <QMatrix4x4>
+#include <QOpenGLBuffer>
+#include <QVector>
+
+#include <xflgeom/geom3d/vector3d.h>
+
+
+/**
+ * @class InstanceCuller
+ * Selects the instances of a sphere which are visible in the view frustum, and sorts them by level of detail.
+ *
+ * The instance positions are stored as separate x, y and z arrays, so that the loops which test the bounding
+ * spheres against the six planes of the frustum and which project the radius to the screen have no branch
+ * and no dependency between iterations, and are vectorized by the compiler.
+ * The level of detail of each visible instance is the number of subdivisions of the icosphere, chosen from
+ * the radius of the sphere projected on the screen in pixels.
+ * The positions of the visible instances are written to one compacted buffer for each level of detail,
+ * so that each level is drawn with a single instanced draw call.
+ * The buffers are only rewritten if the matrix, the radius, the viewport or the instances have changed since the last cull.
+ */
+class InstanceCuller
+{
+    public:
+        static int const NLOD = 4;  /**< the number of levels of detail, i.e. icospheres with 0 to NLOD-1 subdivisions */
+
+    public:
+        InstanceCuller();
+
+        void setInstanceCount(int nInstances);
+        void setPosition(int i, Vector3d const &pos) {m_x[i]=pos.xf(); m_y[i]=pos.yf(); m_z[i]=pos.zf(); m_Version++;}
+
+        void cull(QMatrix4x4 const &pvmMat, float radius, int viewportheight);
+
+        int instanceCount() const {return m_x.size();}
+        int visibleCount() const;
+        int lodCount(int iLod) const {return m_nLod[iLod];}
+        QOpenGLBuffer &lodBuffer(int iLod) {return m_vboLod[iLod];}
+
+    private:
+        QVector<float> m_x, m_y, m_z;  /**< the instance positions */
+        QVector<float> m_Pixels;       /**< the projected radius of each instance in pixels, or -1 if the instance is culled */
+        QVector<signed char> m_Lod;    /**< the level of detail of each instance, or -1 if the instance is culled */
+
+        int m_Version;                 /**< incremented each time the instances are changed */
+        int m_CulledVersion;           /**< the version of the instances when the buffers were last written, or -1 */
+        QMatrix4x4 m_CulledMat;        /**< the matrix, radius and viewport height with which the buffers were last written */
+        float m_CulledRadius;
+        int m_CulledHeight;
+
+        int m_nLod[NLOD];
+        QOpenGLBuffer m_vboLod[NLOD];  /**< the compacted positions of the visible instances for each level of detail */
+
+        static float s_LodPixels[NLOD-1];  /**< the projected radii in pixels above which the next level of detail is used */
+};
+
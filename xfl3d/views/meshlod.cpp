@@ -0,0 +1,148 @@
+/****************************************************************************
+
+    Xfl3d application
+    Copyright (C) Andre Deperrois
+    License: GPL v3
+
+*****************************************************************************/
+
+#include <algorithm>
+#include <cmath>
+
+#include <QtConcurrent/QtConcurrent>
+
+#include "meshlod.h"
+#include <xfl3d/globals/gl_globals.h>
+#include <xflgeom/geom3d/meshdecimator.h>
+
+
+float MeshLod::s_MaxPixelError = 0.75f;
+
+
+MeshLod::MeshLod()
+{
+    m_Radius = 0.0;
+    m_bCancel = false;
+}
+
+
+MeshLod::~MeshLod()
+{
+    cancel();
+}
+
+
+/** Stops the background decimation, if any, and discards its levels */
+void MeshLod::cancel()
+{
+    m_bCancel = true;
+    m_Future.waitForFinished();
+    m_Future = QFuture<void>();
+    m_NewLevel.clear();
+    m_NewError.clear();
+    m_bCancel = false;
+}
+
+
+void MeshLod::clear()
+{
+    cancel();
+    m_Level.clear();
+    m_Error.clear();
+    m_vbo.clear();
+    m_ibo.clear();
+    m_vboOutline.clear();
+    m_Radius = 0.0;
+}
+
+
+/**
+ * Sets the full mesh as the only level, makes its bounding sphere, and starts making the decimated levels
+ * down to mintriangles in a background thread. The buffers are made afterwards with makeBuffers().
+ */
+void MeshLod::setMesh(TriMesh const &mesh, int mintriangles)
+{
+    clear();
+    m_Level.append(mesh);
+    m_Error.append(0.0);
+
+    m_Future = QtConcurrent::run([this, mesh, mintriangles]()
+    {
+        MeshDecimator::makeLodChain(mesh, mintriangles, m_NewLevel, m_NewError, &m_bCancel);
+    });
+
+    Vector3d lo, hi;
+    for(int iv=0; iv<mesh.vertexCount(); iv++)
+    {
+        Vector3d V = mesh.vertex(iv);
+        if(iv==0)
+        {
+            lo = hi = V;
+            continue;
+        }
+        lo.set(std::min(lo.x, V.x), std::min(lo.y, V.y), std::min(lo.z, V.z));
+        hi.set(std::max(hi.x, V.x), std::max(hi.y, V.y), std::max(hi.z, V.z));
+    }
+    m_Centre = (lo+hi)*0.5;
+    m_Radius = (hi-lo).norm()/2.0;
+}
+
+
+/**
+ * Replaces the levels with those made in the background once the decimation has finished.
+ * The buffers of the full mesh are kept.
+ * @return true if the levels have been replaced, in which case the buffers of the new levels must be made.
+ */
+bool MeshLod::updateLevels()
+{
+    if(!m_Future.isFinished() || m_NewLevel.size()<=1) return false;
+    m_Level = m_NewLevel;
+    m_Error = m_NewError;
+    m_NewLevel.clear();
+    m_NewError.clear();
+    return true;
+}
+
+
+/** Makes the surface and the outline buffers of the levels which do not have them yet. Must be called with the context current. */
+void MeshLod::makeBuffers(Vector3d const &pos, double creaseangle)
+{
+    int nLevels = m_Level.size();
+    int nBuilt = m_vbo.size();
+    m_vbo.resize(nLevels);
+    m_ibo.resize(nLevels);
+    m_vboOutline.resize(nLevels);
+    for(int l=nBuilt; l<nLevels; l++)
+    {
+        m_ibo[l] = QOpenGLBuffer(QOpenGLBuffer::IndexBuffer);
+        gl::makeTriMeshIndexed(m_Level.at(l), pos, creaseangle, m_vbo[l], m_ibo[l]);
+        gl::makeTriMeshOutline(m_Level.at(l), pos, m_vboOutline[l]);
+    }
+}
+
+
+/**
+ * Returns the coarsest level whose error projected on the screen is less than s_MaxPixelError pixels.
+ * @param pvmMat the matrix which maps the mesh's positions to clip space
+ * @param viewportheight the height of the viewport in pixels
+ */
+int MeshLod::selectLevel(QMatrix4x4 const &pvmMat, int viewportheight) const
+{
+    if(m_Level.size()<=1) return 0;
+
+    // the number of pixels per unit length is (vertical scale) / w * height/2, as in InstanceCuller,
+    // with w at the point of the bounding sphere closest to the viewer
+    QVector4D row1 = pvmMat.row(1);
+    QVector4D row3 = pvmMat.row(3);
+    float w = row3.x()*m_Centre.xf() + row3.y()*m_Centre.yf() + row3.z()*m_Centre.zf() + row3.w();
+    w -= float(m_Radius) * row3.toVector3D().length();
+    w = std::max(w, 1.e-6f);
+    float pixels = row1.toVector3D().length() * float(viewportheight) * 0.5f / w;
+
+    for(int l=m_Level.size()-1; l>0; l--)
+    {
+        if(float(m_Error.at(l))*pixels<s_MaxPixelError) return l;
+    }
+    return 0;
+}
+
@@ -0,0 +1,72 @@
+/****************************************************************************
+
+    Xfl3d application
+    Copyright (C) Andre Deperrois
+    License: GPL v3
+
+*****************************************************************************/
+
+#pragma once
+
+#include <atomic>
+
+#include <QFuture>
+#include <QMatrix4x4>
+#include <QOpenGLBuffer>
+#include <QVector>
+
+#include <xflgeom/geom3d/trimesh.h>
+#include <xflgeom/geom3d/vector3d.h>
+
+
+/**
+ * @class MeshLod
+ * Holds the levels of detail of a large mesh and their buffers, and selects the level to draw.
+ *
+ * The levels are made by quadric error decimation, each with about a quarter of the triangles of the previous one,
+ * and each records the largest distance by which it departs from the full mesh.
+ * The level drawn is the coarsest one whose error, projected on the screen at the point of the mesh's bounding sphere
+ * closest to the viewer, is less than s_MaxPixelError pixels; the full mesh is drawn when zoomed in.
+ * The decimation runs in a background thread; the full mesh is the only level until updateLevels() picks up the chain.
+ */
+class MeshLod
+{
+    public:
+        MeshLod();
+        ~MeshLod();
+
+        void setMesh(TriMesh const &mesh, int mintriangles);
+        bool updateLevels();
+        void makeBuffers(Vector3d const &pos, double creaseangle);
+        void clear();
+
+        int levelCount() const {return m_Level.size();}
+        int triangleCount(int iLevel) const {return m_Level.at(iLevel).triangleCount();}
+        double error(int iLevel) const {return m_Error.at(iLevel);}
+
+        int selectLevel(QMatrix4x4 const &pvmMat, int viewportheight) const;
+
+        QOpenGLBuffer &vbo(int iLevel)        {return m_vbo[iLevel];}
+        QOpenGLBuffer &ibo(int iLevel)        {return m_ibo[iLevel];}
+        QOpenGLBuffer &vboOutline(int iLevel) {return m_vboOutline[iLevel];}
+
+    private:
+        void cancel();
+
+    private:
+        QVector<TriMesh> m_Level;            /**< the full mesh, then the decimated levels */
+        QVector<double> m_Error;             /**< the largest distance error of each level */
+        Vector3d m_Centre;                   /**< the centre of the mesh's bounding sphere */
+        double m_Radius;                     /**< the radius of the mesh's bounding sphere */
+
+        QVector<QOpenGLBuffer> m_vbo, m_ibo;  /**< the indexed triangles of each level */
+        QVector<QOpenGLBuffer> m_vboOutline;  /**< the outline of each level */
+
+        QFuture<void> m_Future;              /**< the decimation running in the background */
+        QVector<TriMesh> m_NewLevel;         /**< the levels made in the background, until they are picked up */
+        QVector<double> m_NewError;
+        std::atomic<bool> m_bCancel;         /**< set to stop the background decimation */
+
+        static float s_MaxPixelError;        /**< the projected error in pixels below which a coarser level is used */
+};
+
@@ -0,0 +1,86 @@
+/****************************************************************************
+
+    Xfl3d application
+    Copyright (C) Andre Deperrois
+    License: GPL v3
+
+*****************************************************************************/
+
+
+#include "shaderregistry.h"
+#include <xflcore/trace.h>
+
+
+QMap<QString, QOpenGLShaderProgram*> ShaderRegistry::s_Programs;
+QMap<QString, QOpenGLBuffer*> ShaderRegistry::s_Buffers;
+QSet<QOpenGLShaderProgram const*> ShaderRegistry::s_Failed;
+
+
+/**
+ * Returns the program registered with this name, creating it if necessary.
+ * The program is not linked until build() is called for it.
+ */
+QOpenGLShaderProgram &ShaderRegistry::program(QString const &name)
+{
+    QOpenGLShaderProgram *pProgram = s_Programs.value(name, nullptr);
+    if(!pProgram)
+    {
+        pProgram = new QOpenGLShaderProgram;
+        s_Programs.insert(name, pProgram);
+    }
+    return *pProgram;
+}
+
+
+/**
+ * Links the program from the source files if it has not been linked yet, and returns true if the program is linked.
+ * The compilation is deferred to the link step, which loads the program binary from the disk cache if the same
+ * sources were compiled previously by the same driver. Must be called with a context current.
+ */
+bool ShaderRegistry::build(QOpenGLShaderProgram &shader, QString const &label, QVector<ShaderSource> const &sources)
+{
+    if(shader.isLinked()) return true;
+    if(s_Failed.contains(&shader)) return false; // don't add the same sources twice
+
+    for(int i=0; i<sources.size(); i++)
+    {
+        if(!shader.addCacheableShaderFromSourceFile(sources.at(i).first, sources.at(i).second))
+            trace(label + " shader: could not load the source file " + sources.at(i).second + "\n");
+    }
+
+    bool bLinked = shader.link();
+    if(shader.log().length())
+    {
+        QString strange = QString::asprintf("%s", QString(label+" shader log:"+shader.log()).toStdString().c_str());
+        trace(strange);
+    }
+    if(!bLinked)
+    {
+        trace(label + " shader is not linked\n");
+        s_Failed.insert(&shader);
+    }
+
+    return bLinked;
+}
+
+
+/** Returns a copy of the buffer registered with this key, which refers to the same OpenGL buffer object */
+QOpenGLBuffer ShaderRegistry::buffer(QString const &key)
+{
+    QOpenGLBuffer *pBuffer = s_Buffers.value(key, nullptr);
+    if(pBuffer) return *pBuffer;
+    return QOpenGLBuffer();
+}
+
+
+/**
+ * Registers a copy of the buffer. The buffer must not be destroyed or re-allocated afterwards
+ * since the copies held by the views refer to the same OpenGL buffer object.
+ */
+void ShaderRegistry::setBuffer(QString const &key, QOpenGLBuffer const &vbo)
+{
+    QOpenGLBuffer *pBuffer = s_Buffers.value(key, nullptr);
+    if(pBuffer) *pBuffer = vbo;
+    else        s_Buffers.insert(key, new QOpenGLBuffer(vbo));
+}
+
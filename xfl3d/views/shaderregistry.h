@@ -0,0 +1,58 @@
+/****************************************************************************
+
+    Xfl3d application
+    Copyright (C) Andre Deperrois
+    License: GPL v3
+
+*****************************************************************************/
+
+
+#pragma once
+
+#include <QMap>
+#include <QOpenGLBuffer>
+#include <QOpenGLShaderProgram>
+#include <QPair>
+#include <QSet>
+#include <QString>
+#include <QVector>
+
+
+/**
+ * @class ShaderRegistry
+ * Holds the shader programs and the constant vertex buffers which are used by all the views.
+ * All the QOpenGLWidget instances share their context with the application's global share context,
+ * since Qt::AA_ShareOpenGLContexts is set before the application is constructed, so that a program or
+ * a buffer created by one view can be used by all the others.
+ * The programs are compiled and linked by the first view which is initialized, and are then only bound
+ * by the next views. The shaders are loaded with QOpenGLShaderProgram::addCacheableShaderFromSourceFile,
+ * so that the linked binaries are stored in Qt's program binary disk cache, which is keyed by the
+ * driver's vendor, renderer and version and by the shader sources; the next runs of the application load
+ * the binaries instead of compiling the sources.
+ * The objects live as long as the application; they are intentionally never deleted, since the
+ * global share context may already be gone when the static objects are destroyed.
+ * Since the programs are shared, the uniforms which a view changes are seen by the other views;
+ * the views should not rely on uniform values set at initialization time except for constant values.
+ */
+class ShaderRegistry
+{
+    public:
+        typedef QPair<QOpenGLShader::ShaderType, QString> ShaderSource;
+
+    public:
+        static QOpenGLShaderProgram &program(QString const &name);
+        static bool build(QOpenGLShaderProgram &shader, QString const &label, QVector<ShaderSource> const &sources);
+
+        static bool hasBuffer(QString const &key) {return s_Buffers.contains(key);}
+        static QOpenGLBuffer buffer(QString const &key);
+        static void setBuffer(QString const &key, QOpenGLBuffer const &vbo);
+
+        static int programCount() {return s_Programs.size();}
+        static int bufferCount() {return s_Buffers.size();}
+
+    private:
+        static QMap<QString, QOpenGLShaderProgram*> s_Programs;
+        static QMap<QString, QOpenGLBuffer*> s_Buffers;
+        static QSet<QOpenGLShaderProgram const*> s_Failed;  /**< the programs which could not be linked */
+};
+
@@ -17,6 +17,7 @@ struct ShaderLocations
     int m_attrColor{-1};
     int m_attrUV{-1}; // vertex attribute array containing the texture's UV coordinates
     int m_attrOffset{-1};
+    int m_attrInstMatrix{-1}, m_attrInstRadius{-1}, m_attrInstColor{-1}; // per-instance model matrix, radius and colour
 
     // Uniforms
     int m_vmMatrix{-1}, m_pvmMatrix{-1};
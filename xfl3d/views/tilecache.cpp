@@ -0,0 +1,144 @@
+/****************************************************************************
+
+    Xfl3d application
+    Copyright (C) Andre Deperrois
+    License: GPL v3
+
+*****************************************************************************/
+
+#include <cmath>
+
+#include <QOpenGLFramebufferObject>
+
+#include "tilecache.h"
+
+
+int TileCache::s_TileSize(256);
+int TileCache::s_MaxMemory(128);
+int TileCache::s_MaxLevels(16);
+
+
+bool TileCache::TileKey::operator<(TileKey const &key) const
+{
+    if(Level!=key.Level) return Level<key.Level;
+    if(i!=key.i)         return i<key.i;
+    if(j!=key.j)         return j<key.j;
+    return Params<key.Params;
+}
+
+
+TileCache::TileCache()
+{
+    m_Frame = 0;
+}
+
+
+/** Returns the tile's frame buffer, or nullptr if the tile is not in the cache, and marks the tile as used in the current frame */
+QOpenGLFramebufferObject *TileCache::tile(TileKey const &key)
+{
+    QMap<TileKey, Tile>::iterator it = m_Tiles.find(key);
+    if(it==m_Tiles.end()) return nullptr;
+    it.value().m_LastUse = m_Frame;
+    return it.value().m_pfbo;
+}
+
+
+/** Takes ownership of the frame buffer */
+void TileCache::insert(TileKey const &key, QOpenGLFramebufferObject *pfbo)
+{
+    QMap<TileKey, Tile>::iterator it = m_Tiles.find(key);
+    if(it!=m_Tiles.end())
+    {
+        delete it.value().m_pfbo;
+        it.value().m_pfbo = pfbo;
+        it.value().m_LastUse = m_Frame;
+    }
+    else
+        m_Tiles.insert(key, {pfbo, m_Frame});
+}
+
+
+/**
+ * Returns the finest zoom level whose pixel size does not exceed the view's pixel size,
+ * so that the tiles are displayed at a resolution at least equal to the view's.
+ */
+int TileCache::level(double pixelsize)
+{
+    return int(std::floor(std::log2(pixelsize)));
+}
+
+
+double TileCache::pixelSize(int level)
+{
+    return std::ldexp(1.0, level);
+}
+
+
+/** Returns the key of the tile nlevels lower in zoom which covers the area of the tile */
+TileCache::TileKey TileCache::coarserKey(TileKey const &key, int nlevels)
+{
+    double f = std::ldexp(1.0, nlevels);
+    TileKey coarse;
+    coarse.Level  = key.Level + nlevels;
+    coarse.i      = int(std::floor(double(key.i)/f));
+    coarse.j      = int(std::floor(double(key.j)/f));
+    coarse.Params = key.Params;
+    return coarse;
+}
+
+
+/**
+ * Finds the tile rendered with the same parameters at a lower zoom level which covers the area
+ * of the requested tile, and which is the closest to the requested zoom level.
+ * @return true if such a tile exists.
+ */
+bool TileCache::coarserTile(TileKey const &key, TileKey &placeholder) const
+{
+    for(int d=1; d<=s_MaxLevels; d++)
+    {
+        TileKey coarse = coarserKey(key, d);
+        if(m_Tiles.contains(coarse))
+        {
+            placeholder = coarse;
+            return true;
+        }
+    }
+    return false;
+}
+
+
+/** Deletes the least recently used tiles until the cache fits in the maximum memory size; the tiles used in the current frame are kept */
+void TileCache::trim()
+{
+    qint64 tilememory = qint64(s_TileSize)*qint64(s_TileSize)*4;
+    qint64 maxtiles = qint64(s_MaxMemory)*1024*1024/tilememory;
+
+    while(m_Tiles.size()>maxtiles)
+    {
+        QMap<TileKey, Tile>::iterator oldest = m_Tiles.end();
+        for(QMap<TileKey, Tile>::iterator it=m_Tiles.begin(); it!=m_Tiles.end(); it++)
+        {
+            if(oldest==m_Tiles.end() || it.value().m_LastUse<oldest.value().m_LastUse)
+                oldest = it;
+        }
+        if(oldest==m_Tiles.end() || oldest.value().m_LastUse==m_Frame) break;
+
+        delete oldest.value().m_pfbo;
+        m_Tiles.erase(oldest);
+    }
+}
+
+
+void TileCache::clear()
+{
+    for(QMap<TileKey, Tile>::iterator it=m_Tiles.begin(); it!=m_Tiles.end(); it++)
+        delete it.value().m_pfbo;
+    m_Tiles.clear();
+}
+
+
+qint64 TileCache::memorySize() const
+{
+    return qint64(m_Tiles.size())*qint64(s_TileSize)*qint64(s_TileSize)*4;
+}
+
@@ -0,0 +1,84 @@
+/****************************************************************************
+
+    Xfl3d application
+    Copyright (C) Andre Deperrois
+    License: GPL v3
+
+*****************************************************************************/
+
+
+#pragma once
+
+#include <QByteArray>
+#include <QMap>
+#include <QVector>
+
+class QOpenGLFramebufferObject;
+
+
+/**
+ * @class TileCache
+ * A cache of the square image tiles rendered by a 2d view.
+ * The tiles are rendered at discrete zoom levels: the world size of a tile's pixel is 2^level,
+ * and the tiles of each level are aligned on a world-space grid anchored at the origin,
+ * so that a tile remains valid when the view is translated, and each tile is covered
+ * exactly by one tile of each lower zoom level.
+ * A tile is identified by its level, its index in the grid, and the parameters
+ * which were used to render it; the least recently used tiles are evicted when the
+ * memory used by the tiles exceeds the maximum size.
+ * The tiles are OpenGL frame buffers: the methods which create or delete tiles
+ * must be called with the view's context current.
+ */
+class TileCache
+{
+    public:
+        struct TileKey
+        {
+            int Level;        /**< the zoom level; the world size of the tile's pixels is 2^Level */
+            int i, j;         /**< the tile's index in the grid; the tile's bottom left corner is at (i,j)*tilesize*2^Level */
+            QByteArray Params;
+
+            bool operator<(TileKey const &key) const;
+            bool operator==(TileKey const &key) const {return Level==key.Level && i==key.i && j==key.j && Params==key.Params;}
+        };
+
+    private:
+        struct Tile
+        {
+            QOpenGLFramebufferObject *m_pfbo;
+            quint64 m_LastUse;
+        };
+
+    public:
+        TileCache();
+
+        void newFrame() {m_Frame++;}
+
+        QOpenGLFramebufferObject *tile(TileKey const &key);
+        void insert(TileKey const &key, QOpenGLFramebufferObject *pfbo);
+
+        bool coarserTile(TileKey const &key, TileKey &placeholder) const;
+        static TileKey coarserKey(TileKey const &key, int nlevels);
+
+        static int level(double pixelsize);
+        static double pixelSize(int level);
+
+        void trim();
+        void clear();
+
+        int tileCount() const {return m_Tiles.size();}
+        qint64 memorySize() const;
+
+        static int tileSize() {return s_TileSize;}
+        static void setMaxMemory(int MB) {s_MaxMemory=MB;}
+        static int maxMemory() {return s_MaxMemory;}
+
+    private:
+        QMap<TileKey, Tile> m_Tiles;
+        quint64 m_Frame;
+
+        static int s_TileSize;   /**< the size of the tiles, in pixels */
+        static int s_MaxLevels;  /**< the max. number of lower zoom levels searched for a placeholder */
+        static int s_MaxMemory;  /**< the maximum size of the cache, in MB */
+};
+
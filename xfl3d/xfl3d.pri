@@ -9,7 +9,10 @@ HEADERS += \
     xfl3d/controls/w3dprefs.h \
     xfl3d/globals/gl_globals.h \
     xfl3d/globals/opengldlg.h \
+    xfl3d/globals/quadcontourgrid.h \
+    xfl3d/globals/vertexwriter.h \
     xfl3d/testgl/gl2dcomplex.h \
+    xfl3d/testgl/fractalrenderer.h \
     xfl3d/testgl/gl2dfractal.h \
     xfl3d/testgl/gl2dnewton.h \
     xfl3d/testgl/gl2dquat.h \
@@ -28,11 +31,19 @@ HEADERS += \
     xfl3d/testgl/gl3dsurface.h \
     xfl3d/testgl/gl3dtestglview.h \
     xfl3d/testgl/gl3dtexture.h \
+    xfl3d/testgl/optim2dbench.h \
+    xfl3d/testgl/perturbationorbit.h \
+    xfl3d/testgl/quatraymarcher.h \
     xfl3d/testgl/spaceobject.h \
+    xfl3d/views/frameprofiler.h \
     xfl3d/views/gl2dview.h \
     xfl3d/views/gl3dview.h \
+    xfl3d/views/instanceculler.h \
     xfl3d/views/light.h \
+    xfl3d/views/meshlod.h \
+    xfl3d/views/shaderregistry.h \
     xfl3d/views/shadloc.h \
+    xfl3d/views/tilecache.h \
 
 
 SOURCES += \
@@ -46,7 +57,10 @@ SOURCES += \
     xfl3d/controls/w3dprefs.cpp \
     xfl3d/globals/gl_globals.cpp \
     xfl3d/globals/opengldlg.cpp \
+    xfl3d/globals/quadcontourgrid.cpp \
+    xfl3d/globals/vertexwriter.cpp \
     xfl3d/testgl/gl2dcomplex.cpp \
+    xfl3d/testgl/fractalrenderer.cpp \
     xfl3d/testgl/gl2dfractal.cpp \
     xfl3d/testgl/gl2dnewton.cpp \
     xfl3d/testgl/gl2dquat.cpp \
@@ -65,9 +79,17 @@ SOURCES += \
     xfl3d/testgl/gl3dsurface.cpp \
     xfl3d/testgl/gl3dtestglview.cpp \
     xfl3d/testgl/gl3dtexture.cpp \
+    xfl3d/testgl/optim2dbench.cpp \
+    xfl3d/testgl/perturbationorbit.cpp \
+    xfl3d/testgl/quatraymarcher.cpp \
     xfl3d/testgl/spaceobject.cpp \
+    xfl3d/views/frameprofiler.cpp \
     xfl3d/views/gl2dview.cpp \
     xfl3d/views/gl3dview.cpp \
+    xfl3d/views/instanceculler.cpp \
+    xfl3d/views/meshlod.cpp \
+    xfl3d/views/shaderregistry.cpp \
+    xfl3d/views/tilecache.cpp \
 
 
 RESOURCES += \
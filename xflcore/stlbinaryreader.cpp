@@ -0,0 +1,209 @@
+/****************************************************************************
+
+    Xfl3d application
+    Copyright (C) Andre Deperrois
+    License: GPL v3
+
+*****************************************************************************/
+
+
+#include <algorithm>
+#include <cfloat>
+#include <climits>
+#include <cstring>
+
+#include <QFile>
+#include <QFutureSynchronizer>
+#include <QThread>
+#include <QtConcurrent/QtConcurrent>
+#include <QtEndian>
+
+#include "stlbinaryreader.h"
+
+
+StlBinaryReader::StlBinaryReader()
+{
+    m_nFacets = 0;
+    for(int k=0; k<3; k++) m_Min[k] = m_Max[k] = 0.0f;
+    m_bCancelled = false;
+}
+
+
+/**
+ * Returns true if the size of the file matches the facet count of a binary STL header.
+ * This is more reliable than testing the keyword "solid", which some binary files use in their header.
+ */
+bool StlBinaryReader::isBinaryStlFile(QString const &filename)
+{
+    QFile file(filename);
+    if(!file.open(QIODevice::ReadOnly)) return false;
+    QByteArray header = file.read(s_HeaderSize);
+    if(header.size()<s_HeaderSize) return false;
+
+    quint32 n = 0;
+    memcpy(&n, header.constData()+80, sizeof(n));
+    n = qFromLittleEndian(n);
+    return file.size() == s_HeaderSize + qint64(n)*s_RecordSize;
+}
+
+
+bool StlBinaryReader::readFile(QString const &filename, double unitfactor)
+{
+    m_nFacets = 0;
+    m_Vertex.clear();
+    m_Normal.clear();
+    for(int k=0; k<3; k++) m_Min[k] = m_Max[k] = 0.0f;
+    m_Header.clear();
+    m_Error.clear();
+    m_bCancelled = false;
+
+    QFile stlfile(filename);
+    if (!stlfile.open(QIODevice::ReadOnly))
+    {
+        m_Error = "Unable to open the file: " + filename;
+        return false;
+    }
+
+    bool bSuccess = false;
+    qint64 size = stlfile.size();
+    uchar *pMap = size>0 ? stlfile.map(0, size) : nullptr;
+    if(pMap)
+    {
+        bSuccess = decode(pMap, size, unitfactor);
+        stlfile.unmap(pMap);
+    }
+    else
+    {
+        QByteArray data = stlfile.readAll();
+        bSuccess = decode(reinterpret_cast<uchar const*>(data.constData()), data.size(), unitfactor);
+    }
+    stlfile.close();
+    return bSuccess;
+}
+
+
+bool StlBinaryReader::decode(uchar const *pData, qint64 size, double unitfactor)
+{
+    if(size<s_HeaderSize)
+    {
+        m_Error = "The file is too short to be a binary STL file";
+        return false;
+    }
+
+    char const *pHeader = reinterpret_cast<char const*>(pData);
+    m_Header = QString::fromLatin1(pHeader, int(qstrnlen(pHeader, 80))).trimmed();
+
+    quint32 n = 0;
+    memcpy(&n, pData+80, sizeof(n));
+    n = qFromLittleEndian(n);
+    if(qint64(n)*9>INT_MAX)
+    {
+        m_Error = QString::asprintf("The facet count %u is too large", n);
+        return false;
+    }
+    if(size < s_HeaderSize + qint64(n)*s_RecordSize)
+    {
+        m_Error = QString::asprintf("The file is truncated: the header announces %u facets", n);
+        return false;
+    }
+
+    m_nFacets = int(n);
+    m_Vertex.resize(m_nFacets*9);
+    m_Normal.resize(m_nFacets*3);
+    if(m_nFacets==0) return true;
+
+    int nBlocks = (m_nFacets+s_BlockSize-1)/s_BlockSize;
+    int nThreads = std::max(1, QThread::idealThreadCount());
+    QVector<float> bbox(nBlocks*6);
+
+    uchar const *pRecords = pData + s_HeaderSize;
+    float *pVertex = m_Vertex.data();
+    float *pNormal = m_Normal.data();
+    float *pBBox = bbox.data();
+    float factor = float(unitfactor);
+
+    // decode the blocks by groups of one block per thread, and report the progress between the groups
+    for(int iGroup=0; iGroup<nBlocks; iGroup+=nThreads)
+    {
+        int lastblock = std::min(iGroup+nThreads, nBlocks);
+        QFutureSynchronizer<void> futureSync;
+        for(int iBlock=iGroup; iBlock<lastblock; iBlock++)
+        {
+            int first = iBlock*s_BlockSize;
+            int last  = std::min(first+s_BlockSize, m_nFacets);
+            float *pBlockBox = pBBox + iBlock*6;
+            futureSync.addFuture(QtConcurrent::run([=]() {decodeBlock(pRecords, first, last, factor, pVertex, pNormal, pBlockBox);}));
+        }
+        futureSync.waitForFinished();
+
+        if(m_Progress && !m_Progress(std::min(lastblock*s_BlockSize, m_nFacets), m_nFacets))
+        {
+            m_bCancelled = true;
+            m_Error = "Operation cancelled";
+            m_nFacets = 0;
+            m_Vertex.clear();
+            m_Normal.clear();
+            return false;
+        }
+    }
+
+    for(int k=0; k<3; k++)
+    {
+        m_Min[k] =  FLT_MAX;
+        m_Max[k] = -FLT_MAX;
+    }
+    for(int iBlock=0; iBlock<nBlocks; iBlock++)
+    {
+        for(int k=0; k<3; k++)
+        {
+            m_Min[k] = std::min(m_Min[k], bbox.at(iBlock*6+k));
+            m_Max[k] = std::max(m_Max[k], bbox.at(iBlock*6+3+k));
+        }
+    }
+    return true;
+}
+
+
+/**
+ * Decodes the facet records in the range [first, last[ and writes the min and max of their
+ * scaled vertex coordinates in the 6 floats of the bbox array.
+ */
+void StlBinaryReader::decodeBlock(uchar const *pRecords, int first, int last, float unitfactor,
+                                  float *pVertex, float *pNormal, float *bbox)
+{
+    for(int i=first; i<last; i++)
+    {
+        // the records are 50 bytes long, so the floats are not aligned and are copied out
+        quint32 raw[12];
+        memcpy(raw, pRecords + qint64(i)*s_RecordSize, sizeof(raw));
+        float f[12];
+        for(int k=0; k<12; k++)
+        {
+            quint32 u = qFromLittleEndian(raw[k]);
+            memcpy(f+k, &u, sizeof(float));
+        }
+
+        float *pN = pNormal + 3*qint64(i);
+        pN[0] = f[0];
+        pN[1] = f[1];
+        pN[2] = f[2];
+
+        float *pV = pVertex + 9*qint64(i);
+        for(int k=0; k<9; k++) pV[k] = f[3+k]*unitfactor;
+    }
+
+    // the bounding box is computed in a separate loop over the contiguous output, which the compiler vectorizes
+    float xmin = FLT_MAX, ymin = FLT_MAX, zmin = FLT_MAX;
+    float xmax =-FLT_MAX, ymax =-FLT_MAX, zmax =-FLT_MAX;
+    float const *pV = pVertex + 9*qint64(first);
+    int nVertices = (last-first)*3;
+    for(int j=0; j<nVertices; j++)
+    {
+        xmin = std::min(xmin, pV[3*j]);     xmax = std::max(xmax, pV[3*j]);
+        ymin = std::min(ymin, pV[3*j+1]);   ymax = std::max(ymax, pV[3*j+1]);
+        zmin = std::min(zmin, pV[3*j+2]);   zmax = std::max(zmax, pV[3*j+2]);
+    }
+    bbox[0] = xmin;    bbox[1] = ymin;    bbox[2] = zmin;
+    bbox[3] = xmax;    bbox[4] = ymax;    bbox[5] = zmax;
+}
+
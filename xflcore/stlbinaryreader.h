@@ -0,0 +1,74 @@
+/****************************************************************************
+
+    Xfl3d application
+    Copyright (C) Andre Deperrois
+    License: GPL v3
+
+*****************************************************************************/
+
+
+#pragma once
+
+#include <functional>
+
+#include <QString>
+#include <QVector>
+
+
+/**
+ * @class StlBinaryReader
+ * Reads the facets of a binary STL file into compact float arrays.
+ *
+ * The file is memory-mapped and the 50-byte facet records are decoded in place, without any intermediate
+ * stream or per-facet object. The records are split in blocks which are decoded concurrently; each block
+ * scales its vertices by the unit factor and computes its own bounding box, and the boxes are merged
+ * once all the blocks are done.
+ * Files which cannot be mapped, such as the files in the Qt resources, are read in memory in one go
+ * and decoded the same way.
+ */
+class StlBinaryReader
+{
+    public:
+        StlBinaryReader();
+
+        /** The callback is called between groups of blocks with the number of facets decoded
+         * and the total number of facets; it returns false to cancel the reading. */
+        void setProgressCallback(std::function<bool(int,int)> const &callback) {m_Progress = callback;}
+
+        bool readFile(QString const &filename, double unitfactor);
+
+        int facetCount() const {return m_nFacets;}
+        QVector<float> const &vertices() const {return m_Vertex;}
+        QVector<float> const &normals() const {return m_Normal;}
+
+        float bboxMin(int k) const {return m_Min[k];}
+        float bboxMax(int k) const {return m_Max[k];}
+
+        QString const &header() const {return m_Header;}
+        QString const &errorMessage() const {return m_Error;}
+        bool isCancelled() const {return m_bCancelled;}
+
+        static bool isBinaryStlFile(QString const &filename);
+
+    private:
+        bool decode(uchar const *pData, qint64 size, double unitfactor);
+        static void decodeBlock(uchar const *pRecords, int first, int last, float unitfactor,
+                                float *pVertex, float *pNormal, float *bbox);
+
+    private:
+        int m_nFacets;
+        QVector<float> m_Vertex;   /**< the 3 vertices of each facet, as 9 consecutive floats */
+        QVector<float> m_Normal;   /**< the normal of each facet, as 3 consecutive floats */
+        float m_Min[3], m_Max[3];
+
+        QString m_Header;
+        QString m_Error;
+        bool m_bCancelled;
+
+        std::function<bool(int,int)> m_Progress;
+
+        static int const s_HeaderSize = 84;   /**< the 80 bytes of the header and the 4 bytes of the facet count */
+        static int const s_RecordSize = 50;   /**< the normal and the 3 vertices as 12 floats, and the 2 bytes of the attribute */
+        static int const s_BlockSize = 65536; /**< the number of facets decoded by each task */
+};
+
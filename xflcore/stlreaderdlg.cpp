@@ -7,11 +7,17 @@
 *****************************************************************************/
 
 #include <QFileDialog>
+#include <QFutureSynchronizer>
 #include <QPushButton>
 #include <QLabel>
 #include <QHBoxLayout>
+#include <QThread>
+#include <QtConcurrent/QtConcurrent>
 
 #include "stlreaderdlg.h"
+#include <xflcore/stlbinaryreader.h>
+#include <xflcore/stltextreader.h>
+#include <xflcore/xflmeshfile.h>
 
 #include <xflcore/xflcore.h>
 #include <xflcore/saveoptions.h>
@@ -157,16 +163,113 @@ void StlReaderDlg::onImportFromStlFile()
 
 bool StlReaderDlg::importTrianglesFromStlFile(QString const &FileName, double unitfactor, QVector<Triangle3d> &trianglelist) const
 {
-    QFile stlfile(FileName);
-    if (!stlfile.open(QIODevice::ReadOnly))
+    QString solidname;
+    if(isStlTextFile(FileName))
+        return importStlTextFile(FileName, unitfactor, trianglelist, solidname);
+
+    m_pptoTextOutput->onAppendThisPlainText("Not recognized as a Text file... Switching to binary\n");
+    return importStlBinaryFile(FileName, unitfactor, trianglelist, solidname);
+}
+
+
+/**
+ * Imports the STL file into a compact mesh, without making the Triangle3d objects.
+ * The identical vertices are merged, and the vertices of the facets whose orientation
+ * is opposite to their normal are re-ordered; the face normals, connections and hierarchy are made.
+ * The mesh is read from the .xflmesh cache if the file has been imported before and has not changed since,
+ * and is otherwise written to the cache.
+ */
+bool StlReaderDlg::importMeshFromStlFile(QString const &FileName, double unitfactor, TriMesh &mesh) const
+{
+    QString cachefilename = XflMeshFile::cacheFileName(FileName);
+    XflMeshFile meshfile;
+    if(meshfile.load(cachefilename, FileName, unitfactor, mesh))
     {
-        m_pptoTextOutput->onAppendThisPlainText("Unable to open the file:" + FileName + "\n");
-        return false;
+        m_pptoTextOutput->onAppendThisPlainText(QString::asprintf("Loaded %d triangles and %d vertices from the mesh cache\n\n",
+                                                                  mesh.triangleCount(), mesh.vertexCount()));
+        return true;
     }
 
-    QString solidname;
+    QVector<float> vertices, normals;
+    if(isStlTextFile(FileName))
+    {
+        StlTextReader reader;
+        reader.setProgressCallback([this](qint64 nDone, qint64 size)
+        {
+            m_pptoTextOutput->onAppendThisPlainText(QString::asprintf("   parsed %lld/%lld bytes\n", nDone, size));
+            return !m_bCancel;
+        });
+        if(!reader.readFile(FileName, unitfactor))
+        {
+            if(!reader.isCancelled()) m_pptoTextOutput->onAppendThisPlainText(reader.errorMessage()+"\n");
+            return false;
+        }
+        vertices = reader.vertices();
+        normals  = reader.normals();
+    }
+    else
+    {
+        StlBinaryReader reader;
+        reader.setProgressCallback([this](int nDone, int nFacets)
+        {
+            m_pptoTextOutput->onAppendThisPlainText(QString::asprintf("   decoded %d/%d triangles\n", nDone, nFacets));
+            return !m_bCancel;
+        });
+        if(!reader.readFile(FileName, unitfactor))
+        {
+            if(!reader.isCancelled()) m_pptoTextOutput->onAppendThisPlainText(reader.errorMessage()+"\n");
+            return false;
+        }
+        vertices = reader.vertices();
+        normals  = reader.normals();
+    }
+
+    int nTriangles = normals.size()/3;
+    int nNegTriangles = 0;
+    float *pVertex = vertices.data();
+    for(int j=0; j<nTriangles; j++)
+    {
+        float *v = pVertex + 9*qint64(j);
+        float const *n = normals.constData() + 3*j;
+        float e1[3] = {v[3]-v[0], v[4]-v[1], v[5]-v[2]};
+        float e2[3] = {v[6]-v[0], v[7]-v[1], v[8]-v[2]};
+        float dot = (e1[1]*e2[2]-e1[2]*e2[1])*n[0] + (e1[2]*e2[0]-e1[0]*e2[2])*n[1] + (e1[0]*e2[1]-e1[1]*e2[0])*n[2];
+        if(dot<0.0f)
+        {
+            // re-order vertices to have a positive oriented triangle
+            for(int k=0; k<3; k++) std::swap(v[3+k], v[6+k]);
+            nNegTriangles++;
+        }
+    }
+
+    mesh.setTriangleSoup(vertices.constData(), nTriangles);
+    mesh.makeFaceNormals();
+    mesh.makeConnections();
+    mesh.makeBvh();
+
+    QString log;
+    log  = QString::asprintf("Read %d STL triangles, merged into %d vertices\n", nTriangles, mesh.vertexCount());
+    log += QString::asprintf("Reordered vertices of %d inverted triangles\n", nNegTriangles);
+    log += QString::asprintf("   Mesh memory = %.1f MB\n", double(mesh.memorySize())/1024.0/1024.0);
+    if(!meshfile.save(cachefilename, FileName, unitfactor, mesh))
+        log += "   The mesh could not be cached: " + meshfile.errorMessage() + "\n";
+    m_pptoTextOutput->onAppendThisPlainText(log+"\n");
+    return true;
+}
+
+
+/**
+ * Returns true if the file is recognized as a text STL file, i.e. if its first line holds the keyword 'solid'
+ * and its second line the keyword 'facet'. A file whose size matches the facet count of the binary header
+ * is binary, even if its header starts with 'solid'.
+ */
+bool StlReaderDlg::isStlTextFile(QString const &FileName)
+{
+    if(StlBinaryReader::isBinaryStlFile(FileName)) return false;
+
+    QFile stlfile(FileName);
+    if (!stlfile.open(QIODevice::ReadOnly)) return false;
 
-    //Try the text format first
     bool bText=true;
     QTextStream textstream(&stlfile);
     QString strong = textstream.readLine(80);
@@ -188,119 +291,36 @@ bool StlReaderDlg::importTrianglesFromStlFile(QString const &FileName, double un
         }
         else bText=false;
     }
-    textstream.seek(0);
-
-    bool bSuccess = false;
-    if(bText)
-    {
-        bSuccess = importStlTextFile(textstream, unitfactor, trianglelist, solidname);
-    }
-    else
-    {
-        m_pptoTextOutput->onAppendThisPlainText("Not recognized as a Text file... Switching to binary\n");
-        //Try the binary format
-        QDataStream inStream(&stlfile);
-        inStream.setByteOrder(QDataStream::LittleEndian);
-        //    uint u = inStream.byteOrder();
-
-        bSuccess = importStlBinaryFile(inStream, unitfactor, trianglelist, solidname);
-    }
-
     stlfile.close();
-
-    return bSuccess;
+    return bText;
 }
 
 
-bool StlReaderDlg::importStlBinaryFile(QDataStream &binstream, double unitfactor, QVector<Triangle3d> &trianglelist,
+bool StlReaderDlg::importStlBinaryFile(QString const &FileName, double unitfactor, QVector<Triangle3d> &trianglelist,
                                        QString &solidname) const
 {
     QString strong;
-    qint8  ch=0;
-    strong.clear();
     solidname = "STL_binary_solid";
-    //80 character header, avoid word "solid"
-    //                       0123456789 123456789 123456789 123456789 123456789 123456789 123456789 123456789
-    for(int j=0; j<80;j++)
-    {
-        strong += " ";
-        binstream >> ch;
-        strong[j] = char(ch);
-    }
-
-    int nTriangles=0;
-    binstream >> nTriangles;
-
-    trianglelist.reserve(nTriangles);
 
-    Vector3d N, v[3];
-    float xmin=1.e10, xmax=-1.0e10;
-    float ymin=1.e10, ymax=-1.0e10;
-    float zmin=1.e10, zmax=-1.0e10;
-    float x=0, y=0, z=0;
-    float nx=0, ny=0, nz=0;
-    char buffer[12];
-    int nNegTriangles=0;
-
-    for (int j=0; j<nTriangles; j++)
+    StlBinaryReader reader;
+    reader.setProgressCallback([this](int nDone, int nFacets)
     {
-        // the normal
-        xfl::readFloat(binstream, nx);
-        xfl::readFloat(binstream, ny);
-        xfl::readFloat(binstream, nz);
-        N.set(double(nx), double(ny), double(nz));
-
-        for(int iv=0; iv<3; iv++)
-        {
-            //vertex 0
-            xfl::readFloat(binstream, x);
-            xfl::readFloat(binstream, y);
-            xfl::readFloat(binstream, z);
-            x *= float(unitfactor);
-            y *= float(unitfactor);
-            z *= float(unitfactor);
-            xmin = std::min(x,xmin);   xmax = std::max(x,xmax);
-            ymin = std::min(y,ymin);   ymax = std::max(y,ymax);
-            zmin = std::min(z,zmin);   zmax = std::max(z,zmax);
-            v[iv].set(double(x), double(y), double(z));
-
-        }
-
-        trianglelist.push_back({v[0], v[1], v[2]});
-        Triangle3d &t3d = trianglelist.last();
-        if(t3d.normal().dot(N)<.0)
-        {
-            // re-order vertices to have a positive oriented triangle
-            Vector3d tmp = t3d.vertexAt(1);
-            t3d.setVertex(1, t3d.vertexAt(2));
-            t3d.setVertex(2, tmp);
-            t3d.setTriangle();
-
-            nNegTriangles++;
-        }
+        m_pptoTextOutput->onAppendThisPlainText(QString::asprintf("   decoded %d/%d triangles\n", nDone, nFacets));
+        return !m_bCancel;
+    });
 
-        t3d.setNormal(N);
+    if(!reader.readFile(FileName, unitfactor))
+    {
+        if(!reader.isCancelled()) m_pptoTextOutput->onAppendThisPlainText(reader.errorMessage()+"\n");
+        return false;
+    }
 
-        //add, then remove if nullptr; this avoids double construction
-/*        if(t3d.isNull())
-        {
-            trianglelist.pop_back();
-            nNullTriangles++;
-        }*/
+    int nTriangles = reader.facetCount();
+    int nNegTriangles = makeTriangles(reader.vertices().constData(), reader.normals().constData(), nTriangles, trianglelist);
 
-        //        trianglelist.last().displayNodes("BNodes==");
-        binstream.readRawData(buffer, 2);
-
-        if(j%1000==0)
-        {
-            QString strange;
-            strange = QString::asprintf("   imported %d triangles\n", int(trianglelist.size()-1));
-            m_pptoTextOutput->onAppendThisPlainText(strange);
-            
-            if(m_bCancel)
-                return false;
-        }
-    }
+    float xmin = reader.bboxMin(0), xmax = reader.bboxMax(0);
+    float ymin = reader.bboxMin(1), ymax = reader.bboxMax(1);
+    float zmin = reader.bboxMin(2), zmax = reader.bboxMax(2);
 
     QString logmsg;
     strong = QString::asprintf("Read %d STL triangles, made %d panels\n", nTriangles, int(trianglelist.size()));
@@ -334,152 +354,34 @@ bool StlReaderDlg::importStlBinaryFile(QDataStream &binstream, double unitfactor
 }
 
 
-bool StlReaderDlg::importStlTextFile(QTextStream &textstream, double unitfactor, QVector<Triangle3d> &trianglelist,
+bool StlReaderDlg::importStlTextFile(QString const &FileName, double unitfactor, QVector<Triangle3d> &trianglelist,
                                      QString &solidname) const
 {
-    QString strong;
-    int iLine=-1;
-    //header
-    do
+    StlTextReader reader;
+    reader.setDoublePrecision(true);
+    reader.setProgressCallback([this](qint64 nDone, qint64 size)
     {
-        strong = textstream.readLine();
-        m_pptoTextOutput->onAppendThisPlainText(strong+"\n");
-        iLine++;
-    }
-    while(!strong.length());
+        m_pptoTextOutput->onAppendThisPlainText(QString::asprintf("   parsed %lld/%lld bytes\n", nDone, size));
+        return !m_bCancel;
+    });
 
-    if(!strong.contains("solid", Qt::CaseInsensitive))
+    if(!reader.readFile(FileName, unitfactor))
     {
-        m_pptoTextOutput->onAppendThisPlainText("Error reading header: keyword \'solid\' not found");
+        if(!reader.isCancelled()) m_pptoTextOutput->onAppendThisPlainText(reader.errorMessage()+"\n");
         return false;
     }
-    
-    solidname = strong.replace("solid", "").trimmed();
-
-    double xmin=1.e100, xmax=-1.0e100;
-    double ymin=1.e100, ymax=-1.0e100;
-    double zmin=1.e100, zmax=-1.0e100;
-    Vector3d v[3], N;
-    double x=0,y=0,z=0;
-    double nx=0, ny=0, nz=0;
-    int nTriangles=0;
-    int nNegTriangles = 0;
+    solidname = reader.solidName();
+    m_pptoTextOutput->onAppendThisPlainText("solid "+solidname+"\n");
 
-    QString log;
-    while(!textstream.atEnd())
-    {
-        strong = textstream.readLine();
-        iLine++;
-        if(textstream.status() != QTextStream::Ok)
-        {
-            log = QString::asprintf("Unknown error reading line %d", iLine);
-            m_pptoTextOutput->onAppendThisPlainText(log);
-            return false;
-        }
+    int nTriangles = reader.facetCount();
+    int nNegTriangles = makeTriangles(reader.dVertices().constData(), reader.dNormals().constData(), nTriangles, trianglelist);
 
-        if(strong.contains("endsolid", Qt::CaseInsensitive)) break;
-
-        if(strong.contains("facet", Qt::CaseInsensitive) && strong.contains("normal", Qt::CaseInsensitive))
-        {
-            //read a triangle
-            strong.replace("facet","");
-            strong.replace("normal","");
-            strong.replace("FACET","");
-            strong.replace("NORMAL","");
-            strong = strong.trimmed();
-            if(xfl::readValues(strong,nx,ny,nz)==3)
-            {
-                strong = textstream.readLine();
-                iLine++;
-                if(strong.contains("outer", Qt::CaseInsensitive) && strong.contains("loop", Qt::CaseInsensitive))
-                {
-                    for(int iv=0; iv<3; iv++)
-                    {
-                        strong = textstream.readLine();
-                        iLine++;
-                        if(strong.contains("vertex", Qt::CaseInsensitive))
-                        {
-                            strong = strong.replace("vertex","").trimmed();
-                            if(xfl::readValues(strong,x,y,z)==3)
-                            {
-                                x*=unitfactor;
-                                y*=unitfactor;
-                                z*=unitfactor;
-                                xmin = std::min(x,xmin);   xmax = std::max(x,xmax);
-                                ymin = std::min(y,ymin);   ymax = std::max(y,ymax);
-                                zmin = std::min(z,zmin);   zmax = std::max(z,zmax);
-                                v[iv].set(x,y,z);
-                            }
-                            else
-                            {
-                                log = QString::asprintf("Error reading triangles: could not read 3 values on line %d", iLine);
-                                return false;
-                            }
-                        }
-                        else
-                        {
-                            log = QString::asprintf("Error reading triangles: keyword \'vertex\' not found on line %d", iLine);
-                            return false;
-                        }
-                    }
-                    strong = textstream.readLine();
-                    iLine++;
-                    if(!strong.contains("endloop", Qt::CaseInsensitive))
-                    {
-                        log = QString::asprintf("Error reading triangles: keyword \'endloop\' not found on line %d", iLine);
-                        return false;
-                    }
-                }
-                else
-                {
-                    log = QString::asprintf("Error reading triangles: keyword \'outer loop\' not found on line %d", iLine);
-                    return false;
-                }
-            }
-        }
-        else
-        {
-            log = QString::asprintf("Error reading triangles: keyword \'facet\' not found on line %d", iLine);
-            return false;
-        }
-        strong = textstream.readLine();
-        if(!strong.contains("endfacet", Qt::CaseInsensitive))
-        {
-            log = QString::asprintf("Error reading triangles: keyword \'endfacet\' not found on line %d", iLine);
-            return false;
-        }
-
-        trianglelist.push_back({v[0], v[1], v[2]});
-        Triangle3d &t3d = trianglelist.last();
-        N.set(nx,ny,nz);
-        if(t3d.normal().dot(N)<.0)
-        {
-            // re-order vertices to have a positive oriented triangle
-            Vector3d tmp = t3d.vertexAt(1);
-            t3d.setVertex(1, t3d.vertexAt(2));
-            t3d.setVertex(2, tmp);
-            t3d.setTriangle();
-
-            nNegTriangles++;
-        }
-        t3d.setNormal(N);
-        nTriangles++;
-/*        if(trianglelist.last().isNull())
-        {
-            nullsize++;
-            trianglelist.pop_back();
-        }*/
-        iLine++;
-        if(iLine%1000==0)
-        {
-            QString strange;
-            strange = QString::asprintf("   imported %d triangles\n", int(trianglelist.size())-1);
-            m_pptoTextOutput->onAppendThisPlainText(strange);
-            
-            if(m_bCancel) return false;
-        }
-    }
+    double xmin = reader.bboxMin(0), xmax = reader.bboxMax(0);
+    double ymin = reader.bboxMin(1), ymax = reader.bboxMax(1);
+    double zmin = reader.bboxMin(2), zmax = reader.bboxMax(2);
 
+    QString strong;
+    QString log;
     log = QString::asprintf("Read %d STL triangles successfully\n", nTriangles);
     strong = QString::asprintf("Reordered vertices of %d inverted triangles\n", nNegTriangles);
     log+=strong;
@@ -510,6 +412,66 @@ bool StlReaderDlg::importStlTextFile(QTextStream &textstream, double unitfactor,
 }
 
 
+/**
+ * Makes the triangles from the compact arrays of vertices and normals of the facets, by blocks in parallel
+ * since setting each triangle's properties is the main cost of the import.
+ * The vertices of the triangles whose orientation is opposite to the facet's normal are re-ordered.
+ * The text files are parsed in double precision, the binary files hold single precision values.
+ * @return the number of re-ordered triangles.
+ */
+template<typename T>
+static int makeStlTriangles(T const *pVertex, T const *pNormal, int nTriangles, QVector<Triangle3d> &trianglelist)
+{
+    trianglelist.resize(nTriangles);
+    Triangle3d *pTriangle = trianglelist.data();
+    int nBlocks = std::max(1, std::min(QThread::idealThreadCount(), nTriangles/1000));
+    QVector<int> negcount(nBlocks, 0);
+    int *pNegCount = negcount.data();
+    QFutureSynchronizer<void> futureSync;
+    for(int iBlock=0; iBlock<nBlocks; iBlock++)
+    {
+        futureSync.addFuture(QtConcurrent::run([=]()
+        {
+            int first = int(qint64(nTriangles)* iBlock   /nBlocks);
+            int last  = int(qint64(nTriangles)*(iBlock+1)/nBlocks);
+            for(int j=first; j<last; j++)
+            {
+                T const *v = pVertex+9*qint64(j);
+                Vector3d N(double(pNormal[3*j]), double(pNormal[3*j+1]), double(pNormal[3*j+2]));
+                Vector3d V0(double(v[0]), double(v[1]), double(v[2]));
+                Vector3d V1(double(v[3]), double(v[4]), double(v[5]));
+                Vector3d V2(double(v[6]), double(v[7]), double(v[8]));
+                if(((V1-V0)*(V2-V0)).dot(N)<0.0)
+                {
+                    // re-order vertices to have a positive oriented triangle
+                    std::swap(V1, V2);
+                    pNegCount[iBlock]++;
+                }
+                pTriangle[j].setTriangle(V0, V1, V2);
+                pTriangle[j].setNormal(N);
+            }
+        }));
+    }
+    futureSync.waitForFinished();
+
+    int nNegTriangles=0;
+    for(int iBlock=0; iBlock<nBlocks; iBlock++) nNegTriangles += negcount.at(iBlock);
+    return nNegTriangles;
+}
+
+
+int StlReaderDlg::makeTriangles(float const *pVertex, float const *pNormal, int nTriangles, QVector<Triangle3d> &trianglelist)
+{
+    return makeStlTriangles(pVertex, pNormal, nTriangles, trianglelist);
+}
+
+
+int StlReaderDlg::makeTriangles(double const *pVertex, double const *pNormal, int nTriangles, QVector<Triangle3d> &trianglelist)
+{
+    return makeStlTriangles(pVertex, pNormal, nTriangles, trianglelist);
+}
+
+
 void StlReaderDlg::loadSettings(QSettings &settings)
 {
     settings.beginGroup("StlReaderDlg");
@@ -17,6 +17,7 @@
 #include <QSettings>
 
 #include <xflgeom/geom3d/triangle3d.h>
+#include <xflgeom/geom3d/trimesh.h>
 #include <xflwidgets/customwts/plaintextoutput.h>
 
 class PlainTextOutput;
@@ -32,14 +33,19 @@ class StlReaderDlg : public QDialog
         QVector<Triangle3d> const & triangleList() const {return m_Triangle;}
 
         bool importTrianglesFromStlFile(const QString &FileName, double unitfactor, QVector<Triangle3d> &trianglelist) const;
-        bool importStlBinaryFile(QDataStream &binstream, double unitfactor, QVector<Triangle3d> &trianglelist, QString &solidname) const;
-        bool importStlTextFile(QTextStream &textstream, double unitfactor, QVector<Triangle3d> &trianglelist, QString &solidname) const;
+        bool importMeshFromStlFile(QString const &FileName, double unitfactor, TriMesh &mesh) const;
+        bool importStlBinaryFile(QString const &FileName, double unitfactor, QVector<Triangle3d> &trianglelist, QString &solidname) const;
+        bool importStlTextFile(QString const &FileName, double unitfactor, QVector<Triangle3d> &trianglelist, QString &solidname) const;
+
+        static bool isStlTextFile(QString const &FileName);
 
         static void loadSettings(QSettings &settings);
         static void saveSettings(QSettings &settings);
 
     private:
         void setupLayout();
+        static int makeTriangles(float const *pVertex, float const *pNormal, int nTriangles, QVector<Triangle3d> &trianglelist);
+        static int makeTriangles(double const *pVertex, double const *pNormal, int nTriangles, QVector<Triangle3d> &trianglelist);
 
         void showEvent(QShowEvent *pEvent) override;
         void hideEvent(QHideEvent *pEvent) override;
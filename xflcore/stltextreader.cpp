@@ -0,0 +1,345 @@
+/****************************************************************************
+
+    Xfl3d application
+    Copyright (C) Andre Deperrois
+    License: GPL v3
+
+*****************************************************************************/
+
+
+#include <algorithm>
+#include <cctype>
+#include <cfloat>
+#include <charconv>
+#include <cstring>
+
+#include <QFile>
+#include <QFutureSynchronizer>
+#include <QThread>
+#include <QtConcurrent/QtConcurrent>
+
+#include "stltextreader.h"
+
+
+static inline bool isBlank(char c)
+{
+    return c==' ' || c=='\t' || c=='\n' || c=='\r' || c=='\f' || c=='\v';
+}
+
+
+StlTextReader::StlTextReader()
+{
+    m_nFacets = 0;
+    for(int k=0; k<3; k++) m_Min[k] = m_Max[k] = 0.0;
+    m_bCancelled = false;
+    m_bDouble = false;
+}
+
+
+bool StlTextReader::readFile(QString const &filename, double unitfactor)
+{
+    m_nFacets = 0;
+    m_Vertex.clear();
+    m_Normal.clear();
+    m_dVertex.clear();
+    m_dNormal.clear();
+    for(int k=0; k<3; k++) m_Min[k] = m_Max[k] = 0.0;
+    m_SolidName.clear();
+    m_Error.clear();
+    m_bCancelled = false;
+
+    QFile stlfile(filename);
+    if (!stlfile.open(QIODevice::ReadOnly))
+    {
+        m_Error = "Unable to open the file: " + filename;
+        return false;
+    }
+
+    bool bSuccess = false;
+    qint64 size = stlfile.size();
+    uchar *pMap = size>0 ? stlfile.map(0, size) : nullptr;
+    if(pMap)
+    {
+        bSuccess = parse(reinterpret_cast<char const*>(pMap), size, unitfactor);
+        stlfile.unmap(pMap);
+    }
+    else
+    {
+        QByteArray data = stlfile.readAll();
+        bSuccess = parse(data.constData(), data.size(), unitfactor);
+    }
+    stlfile.close();
+    return bSuccess;
+}
+
+
+bool StlTextReader::parse(char const *pData, qint64 size, double unitfactor)
+{
+    // the solid's name is the rest of the first line
+    qint64 pos = 0;
+    char const *token = nullptr;
+    qint64 length = 0;
+    if(nextToken(pData, size, pos, token, length) && isKeyword(token, length, "solid"))
+    {
+        qint64 eol = pos;
+        while(eol<size && pData[eol]!='\n' && pData[eol]!='\r') eol++;
+        m_SolidName = QString::fromLatin1(pData+pos, int(eol-pos)).trimmed();
+    }
+
+    // split the file in chunks which start on a facet
+    int nChunks = int(size/s_ChunkSize)+1;
+    QVector<TextChunk> chunks(nChunks);
+    qint64 begin = 0;
+    for(int ic=0; ic<nChunks; ic++)
+    {
+        qint64 end = ic==nChunks-1 ? size : std::max(begin, nextFacet(pData, size, size*(ic+1)/nChunks));
+        chunks[ic].m_Begin = begin;
+        chunks[ic].m_End   = end;
+        begin = end;
+    }
+
+    int nThreads = std::max(1, QThread::idealThreadCount());
+    TextChunk *pChunk = chunks.data();
+    bool bDouble = m_bDouble;
+
+    for(int iGroup=0; iGroup<nChunks; iGroup+=nThreads)
+    {
+        int lastchunk = std::min(iGroup+nThreads, nChunks);
+        QFutureSynchronizer<void> futureSync;
+        for(int ic=iGroup; ic<lastchunk; ic++)
+        {
+            futureSync.addFuture(QtConcurrent::run([=]() {parseChunk(pData, unitfactor, bDouble, pChunk[ic]);}));
+        }
+        futureSync.waitForFinished();
+
+        for(int ic=iGroup; ic<lastchunk; ic++)
+        {
+            if(chunks.at(ic).m_Error.length())
+            {
+                // the line number is only counted when there is an error to report
+                qint64 errorpos = chunks.at(ic).m_ErrorPos;
+                int iLine = 1 + int(std::count(pData, pData+errorpos, '\n'));
+                m_Error = QString::asprintf("Error reading triangles on line %d: ", iLine) + chunks.at(ic).m_Error;
+                return false;
+            }
+        }
+
+        if(m_Progress && !m_Progress(chunks.at(lastchunk-1).m_End, size))
+        {
+            m_bCancelled = true;
+            m_Error = "Operation cancelled";
+            return false;
+        }
+    }
+
+    // stitch the facets of the chunks in the order of the file
+    int nFacets = 0;
+    for(int ic=0; ic<nChunks; ic++) nFacets += (m_bDouble ? chunks.at(ic).m_dNormal.size() : chunks.at(ic).m_Normal.size())/3;
+    if(m_bDouble)
+    {
+        m_dVertex.resize(nFacets*9);
+        m_dNormal.resize(nFacets*3);
+    }
+    else
+    {
+        m_Vertex.resize(nFacets*9);
+        m_Normal.resize(nFacets*3);
+    }
+
+    int iFacet = 0;
+    for(int k=0; k<3; k++)
+    {
+        m_Min[k] =  DBL_MAX;
+        m_Max[k] = -DBL_MAX;
+    }
+    for(int ic=0; ic<nChunks; ic++)
+    {
+        TextChunk const &chunk = chunks.at(ic);
+        int n = (m_bDouble ? chunk.m_dNormal.size() : chunk.m_Normal.size())/3;
+        if(n==0) continue;
+        if(m_bDouble)
+        {
+            std::copy(chunk.m_dVertex.constBegin(), chunk.m_dVertex.constEnd(), m_dVertex.begin()+iFacet*9);
+            std::copy(chunk.m_dNormal.constBegin(), chunk.m_dNormal.constEnd(), m_dNormal.begin()+iFacet*3);
+        }
+        else
+        {
+            std::copy(chunk.m_Vertex.constBegin(), chunk.m_Vertex.constEnd(), m_Vertex.begin()+iFacet*9);
+            std::copy(chunk.m_Normal.constBegin(), chunk.m_Normal.constEnd(), m_Normal.begin()+iFacet*3);
+        }
+        iFacet += n;
+        for(int k=0; k<3; k++)
+        {
+            m_Min[k] = std::min(m_Min[k], chunk.m_BBox[k]);
+            m_Max[k] = std::max(m_Max[k], chunk.m_BBox[3+k]);
+        }
+    }
+    m_nFacets = nFacets;
+    if(m_nFacets==0)
+    {
+        for(int k=0; k<3; k++) m_Min[k] = m_Max[k] = 0.0;
+    }
+    return true;
+}
+
+
+/**
+ * Parses the facets of the chunk; the chunk's range starts on a facet keyword, or at the beginning of the file.
+ * The facets are stored in the chunk's double arrays if bDouble is true, and in its float arrays otherwise.
+ */
+void StlTextReader::parseChunk(char const *pData, double unitfactor, bool bDouble, TextChunk &chunk)
+{
+    qint64 pos = chunk.m_Begin;
+    qint64 end = chunk.m_End;
+    char const *token = nullptr;
+    qint64 length = 0;
+
+    double bbox[6] = {DBL_MAX, DBL_MAX, DBL_MAX, -DBL_MAX, -DBL_MAX, -DBL_MAX};
+    double normal[3] = {0.0, 0.0, 0.0};
+    double vertex[9];
+    int nVertices = 0;
+    bool bFacet = false;
+
+    if(bDouble)
+    {
+        chunk.m_dVertex.reserve(int((end-chunk.m_Begin)/28));
+        chunk.m_dNormal.reserve(int((end-chunk.m_Begin)/84));
+    }
+    else
+    {
+        chunk.m_Vertex.reserve(int((end-chunk.m_Begin)/28));
+        chunk.m_Normal.reserve(int((end-chunk.m_Begin)/84));
+    }
+
+    while(nextToken(pData, end, pos, token, length))
+    {
+        if(isKeyword(token, length, "facet"))
+        {
+            if(bFacet)
+            {
+                chunk.m_Error = "keyword 'endfacet' not found";
+                break;
+            }
+            if(!nextToken(pData, end, pos, token, length) || !isKeyword(token, length, "normal") ||
+               !readNumbers(pData, end, pos, normal, 3))
+            {
+                chunk.m_Error = "could not read the facet's normal";
+                break;
+            }
+            bFacet = true;
+            nVertices = 0;
+        }
+        else if(isKeyword(token, length, "vertex"))
+        {
+            if(!bFacet || nVertices>=3)
+            {
+                chunk.m_Error = "unexpected keyword 'vertex'";
+                break;
+            }
+            if(!readNumbers(pData, end, pos, vertex+3*nVertices, 3))
+            {
+                chunk.m_Error = "could not read 3 values";
+                break;
+            }
+            nVertices++;
+        }
+        else if(isKeyword(token, length, "endfacet"))
+        {
+            if(!bFacet || nVertices!=3)
+            {
+                chunk.m_Error = "the facet does not have 3 vertices";
+                break;
+            }
+            for(int k=0; k<3; k++)
+            {
+                if(bDouble) chunk.m_dNormal.append(normal[k]);
+                else        chunk.m_Normal.append(float(normal[k]));
+            }
+            for(int k=0; k<9; k++)
+            {
+                double x = vertex[k]*unitfactor;
+                if(bDouble) chunk.m_dVertex.append(x);
+                else        chunk.m_Vertex.append(float(x));
+                bbox[k%3]   = std::min(bbox[k%3],   x);
+                bbox[3+k%3] = std::max(bbox[3+k%3], x);
+            }
+            bFacet = false;
+        }
+        // the keywords "outer loop", "endloop", "solid", "endsolid" and the solid's name are skipped
+    }
+
+    if(chunk.m_Error.isEmpty() && bFacet) chunk.m_Error = "keyword 'endfacet' not found";
+    if(chunk.m_Error.length()) chunk.m_ErrorPos = token ? qint64(token-pData) : chunk.m_Begin;
+
+    for(int k=0; k<6; k++) chunk.m_BBox[k] = bbox[k];
+}
+
+
+/** Returns the position of the first "facet" keyword at or after pos, or the size of the data if none */
+qint64 StlTextReader::nextFacet(char const *pData, qint64 size, qint64 pos)
+{
+    while(pos<size)
+    {
+        while(pos<size && isBlank(pData[pos])) pos++;
+        qint64 start = pos;
+        while(pos<size && !isBlank(pData[pos])) pos++;
+        // a token which does not follow a blank is the end of a token cut by pos, e.g. the end of "endfacet"
+        if(pos>start && (start==0 || isBlank(pData[start-1])) && isKeyword(pData+start, pos-start, "facet"))
+            return start;
+    }
+    return size;
+}
+
+
+/** Reads the next token before the end position, and moves pos after it; returns false if there is none */
+bool StlTextReader::nextToken(char const *pData, qint64 end, qint64 &pos, char const *&token, qint64 &length)
+{
+    while(pos<end && isBlank(pData[pos])) pos++;
+    if(pos>=end) return false;
+    qint64 start = pos;
+    while(pos<end && !isBlank(pData[pos])) pos++;
+    token = pData+start;
+    length = pos-start;
+    return true;
+}
+
+
+/** Reads the n next tokens as double precision numbers; the conversion does not depend on the locale */
+bool StlTextReader::readNumbers(char const *pData, qint64 end, qint64 &pos, double *values, int n)
+{
+    char const *token = nullptr;
+    qint64 length = 0;
+    for(int i=0; i<n; i++)
+    {
+        if(!nextToken(pData, end, pos, token, length)) return false;
+        if(*token=='+')
+        {
+            token++;
+            length--;
+        }
+#if defined(__cpp_lib_to_chars)
+        std::from_chars_result res = std::from_chars(token, token+length, values[i]);
+        if(res.ec!=std::errc() || res.ptr!=token+length) return false;
+#else
+        // the standard library does not convert floating point numbers yet; QByteArray's conversion uses the C locale
+        bool bOk = false;
+        values[i] = QByteArray::fromRawData(token, int(length)).toDouble(&bOk);
+        if(!bOk) return false;
+#endif
+    }
+    return true;
+}
+
+
+/** Returns true if the token is the lower case keyword, regardless of the token's case */
+bool StlTextReader::isKeyword(char const *token, qint64 length, char const *keyword)
+{
+    qint64 n = qint64(strlen(keyword));
+    if(length!=n) return false;
+    for(qint64 i=0; i<n; i++)
+    {
+        if(char(tolower(uchar(token[i])))!=keyword[i]) return false;
+    }
+    return true;
+}
+
@@ -0,0 +1,91 @@
+/****************************************************************************
+
+    Xfl3d application
+    Copyright (C) Andre Deperrois
+    License: GPL v3
+
+*****************************************************************************/
+
+
+#pragma once
+
+#include <functional>
+
+#include <QString>
+#include <QVector>
+
+
+/**
+ * @class StlTextReader
+ * Reads the facets of an ASCII STL file into compact arrays.
+ * The numbers are parsed in double precision; they are stored as floats, or as doubles if the
+ * double precision has been requested, e.g. to make Triangle3d objects without loss of accuracy.
+ *
+ * The file is memory-mapped and split in chunks which start on a "facet" keyword, so that each chunk
+ * holds complete facets and can be parsed independently of the others. The chunks are parsed concurrently
+ * with a tokenizer which works on the raw bytes, and the numbers are converted with a locale-independent parser.
+ * The facets of the chunks are then concatenated in the order of the file.
+ * Files which cannot be mapped, such as the files in the Qt resources, are read in memory in one go
+ * and parsed the same way.
+ */
+class StlTextReader
+{
+    public:
+        StlTextReader();
+
+        /** The callback is called between groups of chunks with the number of bytes parsed
+         * and the size of the file; it returns false to cancel the reading. */
+        void setProgressCallback(std::function<bool(qint64,qint64)> const &callback) {m_Progress = callback;}
+        void setDoublePrecision(bool bDouble) {m_bDouble = bDouble;}
+
+        bool readFile(QString const &filename, double unitfactor);
+
+        int facetCount() const {return m_nFacets;}
+        QVector<float> const &vertices() const {return m_Vertex;}
+        QVector<float> const &normals() const {return m_Normal;}
+        QVector<double> const &dVertices() const {return m_dVertex;}
+        QVector<double> const &dNormals() const {return m_dNormal;}
+
+        double bboxMin(int k) const {return m_Min[k];}
+        double bboxMax(int k) const {return m_Max[k];}
+
+        QString const &solidName() const {return m_SolidName;}
+        QString const &errorMessage() const {return m_Error;}
+        bool isCancelled() const {return m_bCancelled;}
+
+    private:
+        struct TextChunk
+        {
+            qint64 m_Begin, m_End;     /**< the byte range of the chunk in the file */
+            QVector<float> m_Vertex, m_Normal;
+            QVector<double> m_dVertex, m_dNormal;
+            double m_BBox[6];
+            QString m_Error;
+            qint64 m_ErrorPos;         /**< the byte position of the error in the file */
+        };
+
+        bool parse(char const *pData, qint64 size, double unitfactor);
+        static void parseChunk(char const *pData, double unitfactor, bool bDouble, TextChunk &chunk);
+        static qint64 nextFacet(char const *pData, qint64 size, qint64 pos);
+        static bool nextToken(char const *pData, qint64 end, qint64 &pos, char const *&token, qint64 &length);
+        static bool readNumbers(char const *pData, qint64 end, qint64 &pos, double *values, int n);
+        static bool isKeyword(char const *token, qint64 length, char const *keyword);
+
+    private:
+        int m_nFacets;
+        QVector<float> m_Vertex;   /**< the 3 vertices of each facet, as 9 consecutive floats */
+        QVector<float> m_Normal;   /**< the normal of each facet, as 3 consecutive floats */
+        QVector<double> m_dVertex; /**< the vertices in double precision, if requested */
+        QVector<double> m_dNormal; /**< the normals in double precision, if requested */
+        double m_Min[3], m_Max[3];
+        bool m_bDouble;            /**< if true, the facets are stored in double precision instead of single precision */
+
+        QString m_SolidName;
+        QString m_Error;
+        bool m_bCancelled;
+
+        std::function<bool(qint64,qint64)> m_Progress;
+
+        static qint64 const s_ChunkSize = 4*1024*1024; /**< the approximate number of bytes parsed by each task */
+};
+
@@ -10,7 +10,10 @@
 
 
 HEADERS += \
+    $$PWD/stlbinaryreader.h \
     $$PWD/stlreaderdlg.h \
+    $$PWD/stltextreader.h \
+    $$PWD/xflmeshfile.h \
     $$PWD/xflobject.h \
     xflcore/displayoptions.h \
     xflcore/enums_core.h \
@@ -26,7 +29,10 @@ HEADERS += \
 
 
 SOURCES += \
+    $$PWD/stlbinaryreader.cpp \
     $$PWD/stlreaderdlg.cpp \
+    $$PWD/stltextreader.cpp \
+    $$PWD/xflmeshfile.cpp \
     xflcore/displayoptions.cpp \
     xflcore/saveoptions.cpp \
     xflcore/trace.cpp \
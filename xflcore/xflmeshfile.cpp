@@ -0,0 +1,367 @@
+/****************************************************************************
+
+    Xfl3d application
+    Copyright (C) Andre Deperrois
+    License: GPL v3
+
+*****************************************************************************/
+
+
+#include <climits>
+#include <cstring>
+
+#include <QCryptographicHash>
+#include <QDateTime>
+#include <QDir>
+#include <QFile>
+#include <QFileInfo>
+#include <QSaveFile>
+#include <QStandardPaths>
+
+#include "xflmeshfile.h"
+#include <xflgeom/geom3d/trimesh.h>
+
+
+enum enumMeshSection {MESHPOSITIONS=1, MESHINDEXES, MESHFACENORMALS, MESHNEIGHBOURS, MESHBVHNODES, MESHBVHINDEXES, MESHBVHVERTICES};
+
+
+struct MeshFileHeader
+{
+    char    m_Magic[8];       /**< "XFLMESH" */
+    quint32 m_Version;
+    quint32 m_ByteOrder;
+    qint64  m_SourceSize;
+    qint64  m_SourceTime;     /**< the modification time of the source file in ms since the epoch, or 0 if unknown */
+    double  m_UnitFactor;     /**< the length unit factor with which the source file was read */
+    char    m_SourceHash[20]; /**< the SHA-1 hash of the source file */
+    qint32  m_nVertices;
+    qint32  m_nTriangles;
+    qint32  m_nSections;
+    char    m_Reserved[56];
+};
+
+
+/** The entry of a section in the table which follows the header */
+struct MeshFileSection
+{
+    quint32 m_Type;
+    quint32 m_ElementSize;
+    qint64  m_Offset;         /**< the position of the section from the start of the file */
+    qint64  m_Count;          /**< the number of elements */
+};
+
+static_assert(sizeof(MeshFileHeader)==128,  "the layout of the mesh file header depends on the compiler");
+static_assert(sizeof(MeshFileSection)==24,  "the layout of the mesh file sections depends on the compiler");
+
+static char const s_MeshMagic[8] = {'X','F','L','M','E','S','H','\0'};
+
+
+static inline qint64 alignedOffset(qint64 offset, int alignment)
+{
+    return (offset+alignment-1)/alignment*alignment;
+}
+
+
+static qint64 sourceTime(QFileInfo const &sourceinfo)
+{
+    QDateTime time = sourceinfo.lastModified();
+    return time.isValid() ? time.toMSecsSinceEpoch() : 0;
+}
+
+
+template <class T>
+static void copySection(uchar const *pData, MeshFileSection const &section, QVector<T> &array)
+{
+    array.resize(int(section.m_Count));
+    if(section.m_Count>0) memcpy(array.data(), pData+section.m_Offset, size_t(section.m_Count)*sizeof(T));
+}
+
+
+/** Returns true if all the indexes are in the range [min, max[ */
+static bool isInRange(QVector<int> const &index, int min, int max)
+{
+    for(int i=0; i<index.size(); i++)
+    {
+        if(index.at(i)<min || index.at(i)>=max) return false;
+    }
+    return true;
+}
+
+
+XflMeshFile::XflMeshFile()
+{
+}
+
+
+/** Returns the name of the cache file of the source file, in the application's cache directory */
+QString XflMeshFile::cacheFileName(QString const &sourcefile)
+{
+    QFileInfo sourceinfo(sourcefile);
+    QByteArray key = QCryptographicHash::hash(sourceinfo.absoluteFilePath().toUtf8(), QCryptographicHash::Sha1).toHex().left(16);
+    QString dirname = QStandardPaths::writableLocation(QStandardPaths::CacheLocation) + "/meshes";
+    return dirname + "/" + sourceinfo.completeBaseName() + "_" + QString::fromLatin1(key) + ".xflmesh";
+}
+
+
+QByteArray XflMeshFile::sourceHash(QString const &sourcefile)
+{
+    QFile file(sourcefile);
+    if(!file.open(QIODevice::ReadOnly)) return QByteArray();
+    QCryptographicHash hash(QCryptographicHash::Sha1);
+    if(!hash.addData(&file)) return QByteArray();
+    return hash.result();
+}
+
+
+/**
+ * Writes the mesh and the signature of its source file.
+ * The file is written to a temporary file which replaces the former one only once complete.
+ */
+bool XflMeshFile::save(QString const &filename, QString const &sourcefile, double unitfactor, TriMesh const &mesh)
+{
+    m_Error.clear();
+
+    QFileInfo sourceinfo(sourcefile);
+    QByteArray hash = sourceHash(sourcefile);
+    if(hash.size()!=20)
+    {
+        m_Error = "Unable to read the source file: " + sourcefile;
+        return false;
+    }
+
+    struct SectionData
+    {
+        MeshFileSection m_Entry;
+        void const *m_pData;
+    };
+
+    QVector<SectionData> sections;
+    sections.append({{MESHPOSITIONS,   sizeof(float), 0, mesh.m_Position.size()}, mesh.m_Position.constData()});
+    sections.append({{MESHINDEXES,     sizeof(int),   0, mesh.m_Index.size()},    mesh.m_Index.constData()});
+    if(mesh.hasFaceNormals())
+        sections.append({{MESHFACENORMALS, sizeof(float), 0, mesh.m_FaceNormal.size()}, mesh.m_FaceNormal.constData()});
+    if(mesh.hasConnections())
+        sections.append({{MESHNEIGHBOURS,  sizeof(int),   0, mesh.m_Neighbour.size()},  mesh.m_Neighbour.constData()});
+    if(mesh.hasBvh())
+    {
+        TriangleBvh const &bvh = mesh.m_Bvh;
+        sections.append({{MESHBVHNODES,    sizeof(TriangleBvh::BvhNode), 0, bvh.m_Node.size()},   bvh.m_Node.constData()});
+        sections.append({{MESHBVHINDEXES,  sizeof(int),                  0, bvh.m_Index.size()},  bvh.m_Index.constData()});
+        sections.append({{MESHBVHVERTICES, sizeof(double),               0, bvh.m_Vertex.size()}, bvh.m_Vertex.constData()});
+    }
+
+    MeshFileHeader header;
+    memset(&header, 0, sizeof(header));
+    memcpy(header.m_Magic, s_MeshMagic, sizeof(header.m_Magic));
+    header.m_Version    = s_Version;
+    header.m_ByteOrder  = s_ByteOrder;
+    header.m_SourceSize = sourceinfo.size();
+    header.m_SourceTime = sourceTime(sourceinfo);
+    header.m_UnitFactor = unitfactor;
+    memcpy(header.m_SourceHash, hash.constData(), sizeof(header.m_SourceHash));
+    header.m_nVertices  = mesh.vertexCount();
+    header.m_nTriangles = mesh.triangleCount();
+    header.m_nSections  = sections.size();
+
+    qint64 offset = alignedOffset(qint64(sizeof(MeshFileHeader)) + sections.size()*qint64(sizeof(MeshFileSection)), s_Alignment);
+    for(int is=0; is<sections.size(); is++)
+    {
+        MeshFileSection &entry = sections[is].m_Entry;
+        entry.m_Offset = offset;
+        offset = alignedOffset(offset + entry.m_Count*entry.m_ElementSize, s_Alignment);
+    }
+
+    QDir().mkpath(QFileInfo(filename).absolutePath());
+    QSaveFile file(filename);
+    if(!file.open(QIODevice::WriteOnly))
+    {
+        m_Error = "Unable to write the file: " + filename;
+        return false;
+    }
+
+    file.write(reinterpret_cast<char const*>(&header), sizeof(header));
+    for(int is=0; is<sections.size(); is++)
+        file.write(reinterpret_cast<char const*>(&sections.at(is).m_Entry), sizeof(MeshFileSection));
+
+    qint64 pos = qint64(sizeof(MeshFileHeader)) + sections.size()*qint64(sizeof(MeshFileSection));
+    for(int is=0; is<sections.size(); is++)
+    {
+        MeshFileSection const &entry = sections.at(is).m_Entry;
+        if(entry.m_Offset>pos) file.write(QByteArray(int(entry.m_Offset-pos), '\0'));
+        qint64 length = entry.m_Count*entry.m_ElementSize;
+        file.write(reinterpret_cast<char const*>(sections.at(is).m_pData), length);
+        pos = entry.m_Offset + length;
+    }
+
+    if(!file.commit())
+    {
+        m_Error = "Error writing the file: " + filename;
+        return false;
+    }
+    return true;
+}
+
+
+/**
+ * Reads the mesh if the file is the cache of the source file in its present state, read with the same unit factor.
+ * Returns false if the file is missing, invalid or out of date.
+ */
+bool XflMeshFile::load(QString const &filename, QString const &sourcefile, double unitfactor, TriMesh &mesh)
+{
+    m_Error.clear();
+
+    QFile file(filename);
+    if (!file.open(QIODevice::ReadOnly))
+    {
+        m_Error = "Unable to open the file: " + filename;
+        return false;
+    }
+
+    bool bSuccess = false;
+    qint64 size = file.size();
+    uchar *pMap = size>0 ? file.map(0, size) : nullptr;
+    if(pMap)
+    {
+        bSuccess = readSections(pMap, size, sourcefile, unitfactor, mesh);
+        file.unmap(pMap);
+    }
+    else
+    {
+        QByteArray data = file.readAll();
+        bSuccess = readSections(reinterpret_cast<uchar const*>(data.constData()), data.size(), sourcefile, unitfactor, mesh);
+    }
+    file.close();
+    return bSuccess;
+}
+
+
+bool XflMeshFile::readSections(uchar const *pData, qint64 size, QString const &sourcefile, double unitfactor, TriMesh &mesh)
+{
+    MeshFileHeader header;
+    if(size<qint64(sizeof(header)))
+    {
+        m_Error = "The mesh file is truncated";
+        return false;
+    }
+    memcpy(&header, pData, sizeof(header));
+
+    if(memcmp(header.m_Magic, s_MeshMagic, sizeof(header.m_Magic))!=0)
+    {
+        m_Error = "Not a mesh file";
+        return false;
+    }
+    if(header.m_Version!=s_Version || header.m_ByteOrder!=s_ByteOrder)
+    {
+        m_Error = "The mesh file was written by another version or on another platform";
+        return false;
+    }
+    if(header.m_UnitFactor!=unitfactor)
+    {
+        m_Error = "The mesh was read with another length unit";
+        return false;
+    }
+
+    QFileInfo sourceinfo(sourcefile);
+    qint64 time = sourceTime(sourceinfo);
+    if(header.m_SourceSize!=sourceinfo.size())
+    {
+        m_Error = "The source file has changed";
+        return false;
+    }
+    if(time==0 || header.m_SourceTime!=time)
+    {
+        // the file may have been copied or touched; its contents decide
+        QByteArray hash = sourceHash(sourcefile);
+        if(hash.size()!=20 || memcmp(hash.constData(), header.m_SourceHash, sizeof(header.m_SourceHash))!=0)
+        {
+            m_Error = "The source file has changed";
+            return false;
+        }
+    }
+
+    if(header.m_nSections<0 || header.m_nVertices<0 || header.m_nTriangles<0 ||
+       qint64(sizeof(header)) + header.m_nSections*qint64(sizeof(MeshFileSection))>size)
+    {
+        m_Error = "The mesh file is corrupted";
+        return false;
+    }
+
+    // the sections, indexed by their type
+    MeshFileSection section[MESHBVHVERTICES+1];
+    memset(section, 0, sizeof(section));
+    for(int is=0; is<header.m_nSections; is++)
+    {
+        MeshFileSection entry;
+        memcpy(&entry, pData + sizeof(header) + is*sizeof(MeshFileSection), sizeof(entry));
+        if(entry.m_Type<MESHPOSITIONS || entry.m_Type>MESHBVHVERTICES) continue; // written by a later version
+        if(entry.m_Offset<0 || entry.m_Count<0 || entry.m_Count>INT_MAX ||
+           entry.m_Offset + entry.m_Count*entry.m_ElementSize>size)
+        {
+            m_Error = "The mesh file is corrupted";
+            return false;
+        }
+        section[entry.m_Type] = entry;
+    }
+
+    qint64 nt = header.m_nTriangles;
+    bool bValid = section[MESHPOSITIONS].m_ElementSize==sizeof(float) && section[MESHPOSITIONS].m_Count==3*qint64(header.m_nVertices) &&
+                  section[MESHINDEXES].m_ElementSize==sizeof(int)     && section[MESHINDEXES].m_Count==3*nt;
+    bool bNormals = section[MESHFACENORMALS].m_ElementSize==sizeof(float) && section[MESHFACENORMALS].m_Count==3*nt;
+    bool bConnections = section[MESHNEIGHBOURS].m_ElementSize==sizeof(int) && section[MESHNEIGHBOURS].m_Count==3*nt;
+    bool bBvh = section[MESHBVHNODES].m_ElementSize==sizeof(TriangleBvh::BvhNode) && section[MESHBVHNODES].m_Count>0 &&
+                section[MESHBVHINDEXES].m_ElementSize==sizeof(int)     && section[MESHBVHINDEXES].m_Count==nt &&
+                section[MESHBVHVERTICES].m_ElementSize==sizeof(double) && section[MESHBVHVERTICES].m_Count==9*nt;
+    if(!bValid)
+    {
+        m_Error = "The mesh file is corrupted";
+        return false;
+    }
+
+    mesh.clear();
+    copySection(pData, section[MESHPOSITIONS], mesh.m_Position);
+    copySection(pData, section[MESHINDEXES],   mesh.m_Index);
+    if(bNormals)     copySection(pData, section[MESHFACENORMALS], mesh.m_FaceNormal);
+    if(bConnections) copySection(pData, section[MESHNEIGHBOURS],  mesh.m_Neighbour);
+    if(bBvh)
+    {
+        copySection(pData, section[MESHBVHNODES],    mesh.m_Bvh.m_Node);
+        copySection(pData, section[MESHBVHINDEXES],  mesh.m_Bvh.m_Index);
+        copySection(pData, section[MESHBVHVERTICES], mesh.m_Bvh.m_Vertex);
+    }
+
+    // the indexes are used without bound checks by the mesh and the hierarchy
+    bValid = isInRange(mesh.m_Index, 0, header.m_nVertices) && isInRange(mesh.m_Neighbour, -1, header.m_nTriangles) &&
+             isInRange(mesh.m_Bvh.m_Index, 0, header.m_nTriangles) && isValidBvh(mesh.m_Bvh, nt);
+    if(!bValid)
+    {
+        mesh.clear();
+        m_Error = "The mesh file is corrupted";
+        return false;
+    }
+    return true;
+}
+
+
+/**
+ * Returns true if the leaves of the hierarchy reference ranges of its triangles, and the children of each
+ * interior node follow their parent, so that the traversal stays in the arrays and terminates.
+ */
+bool XflMeshFile::isValidBvh(TriangleBvh const &bvh, qint64 nTriangles)
+{
+    int nNodes = bvh.m_Node.size();
+    for(int in=0; in<nNodes; in++)
+    {
+        TriangleBvh::BvhNode const &node = bvh.m_Node.at(in);
+        if(node.m_Count>0)
+        {
+            if(node.m_Offset<0 || qint64(node.m_Offset)+node.m_Count>nTriangles) return false;
+        }
+        else
+        {
+            // the left child is the next node, and the right child comes after it
+            if(node.m_Count<0 || in+1>=nNodes || node.m_Offset<=in+1 || node.m_Offset>=nNodes) return false;
+        }
+    }
+    return true;
+}
+
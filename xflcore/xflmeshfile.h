@@ -0,0 +1,57 @@
+/****************************************************************************
+
+    Xfl3d application
+    Copyright (C) Andre Deperrois
+    License: GPL v3
+
+*****************************************************************************/
+
+
+#pragma once
+
+#include <QByteArray>
+#include <QString>
+
+class TriangleBvh;
+class TriMesh;
+
+
+/**
+ * @class XflMeshFile
+ * Reads and writes the .xflmesh cache of a mesh imported from an STL file.
+ *
+ * The file holds the welded vertices, the vertex indexes of the triangles, and the face normals, connections
+ * and bounding volume hierarchy of the TriMesh if it has them. Each array is stored as one section aligned
+ * on 64 bytes, in the host's byte order, so that reading the file is a memory map and one copy per section,
+ * with no per-element parsing.
+ * The header identifies the source file by its size, its modification time and its SHA-1 hash, and the cache
+ * is ignored once the source has changed. The hash is only computed if the modification time differs,
+ * e.g. after the source file has been copied.
+ * Since the file is a cache, a file written by another version or on a host with another byte order is
+ * out of date rather than converted.
+ */
+class XflMeshFile
+{
+    public:
+        XflMeshFile();
+
+        bool save(QString const &filename, QString const &sourcefile, double unitfactor, TriMesh const &mesh);
+        bool load(QString const &filename, QString const &sourcefile, double unitfactor, TriMesh &mesh);
+
+        QString const &errorMessage() const {return m_Error;}
+
+        static QString cacheFileName(QString const &sourcefile);
+
+    private:
+        bool readSections(uchar const *pData, qint64 size, QString const &sourcefile, double unitfactor, TriMesh &mesh);
+        static bool isValidBvh(TriangleBvh const &bvh, qint64 nTriangles);
+        static QByteArray sourceHash(QString const &sourcefile);
+
+    private:
+        QString m_Error;
+
+        static quint32 const s_Version = 1;
+        static quint32 const s_ByteOrder = 0x01020304;  /**< reads differently on a host with another byte order */
+        static int const s_Alignment = 64;              /**< the alignment of the sections in the file */
+};
+
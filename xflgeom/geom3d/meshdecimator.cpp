@@ -0,0 +1,566 @@
+/****************************************************************************
+
+    Xfl3d application
+    Copyright (C) Andre Deperrois
+    License: GPL v3
+
+*****************************************************************************/
+
+
+#include <algorithm>
+#include <cmath>
+
+#include "meshdecimator.h"
+#include <xflgeom/geom3d/triangulation.h>
+#include <xflgeom/geom3d/trimesh.h>
+
+
+double MeshDecimator::s_BoundaryWeight = 1000.0;
+double MeshDecimator::s_MinNormalDot = 0.5;
+
+
+MeshDecimator::MeshDecimator()
+{
+    m_Stamp = 0;
+    m_Offset[0] = m_Offset[1] = m_Offset[2] = 0.0;
+    m_nTriangles = 0;
+    m_Error = 0.0;
+    m_pbCancel = nullptr;
+}
+
+
+/** Adds to the quadric Q the weighted quadric of the plane a.x+b.y+c.z+d=0 */
+static void addPlaneQuadric(double *Q, double a, double b, double c, double d, double weight)
+{
+    Q[0] += weight*a*a;    Q[1] += weight*a*b;    Q[2] += weight*a*c;    Q[3] += weight*a*d;
+    Q[4] += weight*b*b;    Q[5] += weight*b*c;    Q[6] += weight*b*d;
+    Q[7] += weight*c*c;    Q[8] += weight*c*d;
+    Q[9] += weight*d*d;
+}
+
+
+/**
+ * Initializes the decimation of the mesh: makes the vertex quadrics, finds the free and the non-manifold edges,
+ * and queues the collapse of each edge. The triangles with two identical vertices are discarded.
+ */
+void MeshDecimator::setMesh(TriMesh const &mesh)
+{
+    int nv = mesh.vertexCount();
+    int nt = mesh.triangleCount();
+
+    m_Queue = std::priority_queue<Collapse, std::vector<Collapse>, std::greater<Collapse>>();
+    m_Error = 0.0;
+    m_Stamp = 0;
+
+    // centre the positions on the mesh's box
+    float const *pos = mesh.positions().constData();
+    for(int k=0; k<3; k++)
+    {
+        double lo = 0.0, hi = 0.0;
+        for(int iv=0; iv<nv; iv++)
+        {
+            double x = double(pos[3*iv+k]);
+            if(iv==0 || x<lo) lo = x;
+            if(iv==0 || x>hi) hi = x;
+        }
+        m_Offset[k] = (lo+hi)/2.0;
+    }
+    m_Position.resize(3*nv);
+    for(int iv=0; iv<nv; iv++)
+    {
+        for(int k=0; k<3; k++) m_Position[3*iv+k] = double(pos[3*iv+k]) - m_Offset[k];
+    }
+
+    m_Index = mesh.indexes();
+    m_nTriangles = nt;
+    for(int it=0; it<nt; it++)
+    {
+        int *idx = m_Index.data()+3*it;
+        if(idx[0]==idx[1] || idx[1]==idx[2] || idx[2]==idx[0])
+        {
+            idx[0] = idx[1] = idx[2] = -1;
+            m_nTriangles--;
+        }
+    }
+
+    // the lists of corners of each vertex, in the order of the triangles
+    m_FirstCorner.fill(-1, nv);
+    m_NextCorner.fill(-1, 3*nt);
+    for(int ic=3*nt-1; ic>=0; ic--)
+    {
+        int iv = m_Index.at(ic);
+        if(iv<0) continue;
+        m_NextCorner[ic] = m_FirstCorner.at(iv);
+        m_FirstCorner[iv] = ic;
+    }
+
+    m_Version.fill(0, nv);
+    m_Mark.fill(0, nv);
+    m_Boundary.fill(-1, nv);
+    m_BQuadric.clear();
+    m_bLocked.fill(0, nv);
+
+    // the unweighted quadric of each triangle's plane, added to its three vertices
+    m_Quadric.fill(0.0, 10*nv);
+    for(int it=0; it<nt; it++)
+    {
+        int const *idx = m_Index.constData()+3*it;
+        if(idx[0]<0) continue;
+        Vector3d P0(m_Position.at(3*idx[0]), m_Position.at(3*idx[0]+1), m_Position.at(3*idx[0]+2));
+        Vector3d P1(m_Position.at(3*idx[1]), m_Position.at(3*idx[1]+1), m_Position.at(3*idx[1]+2));
+        Vector3d P2(m_Position.at(3*idx[2]), m_Position.at(3*idx[2]+1), m_Position.at(3*idx[2]+2));
+        Vector3d N = (P1-P0) * (P2-P0);
+        if(N.norm()<=0.0) continue;
+        N.normalize();
+        double d = -N.dot(P0);
+        for(int k=0; k<3; k++) addPlaneQuadric(m_Quadric.data()+10*idx[k], N.x, N.y, N.z, d, 1.0);
+    }
+
+    // sort the edges on their vertex pair to count the triangles which share each of them
+    std::vector<quint64> edge;
+    edge.reserve(size_t(3*m_nTriangles));
+    for(int it=0; it<nt; it++)
+    {
+        int const *idx = m_Index.constData()+3*it;
+        if(idx[0]<0) continue;
+        for(int iEdge=0; iEdge<3; iEdge++)
+        {
+            int n0 = idx[(iEdge+1)%3];
+            int n1 = idx[(iEdge+2)%3];
+            edge.push_back((quint64(std::min(n0, n1))<<32) | quint64(std::max(n0, n1)));
+        }
+    }
+    std::sort(edge.begin(), edge.end());
+
+    for(size_t i=0; i<edge.size();)
+    {
+        size_t j = i+1;
+        while(j<edge.size() && edge.at(j)==edge.at(i)) j++;
+        int n0 = int(edge.at(i)>>32);
+        int n1 = int(edge.at(i) & 0xffffffff);
+        if(j-i>2)
+        {
+            m_bLocked[n0] = m_bLocked[n1] = 1;
+        }
+        else if(j-i==1)
+        {
+            for(int iv : {n0, n1})
+            {
+                if(m_Boundary.at(iv)>=0) continue;
+                m_Boundary[iv] = m_BQuadric.size()/10;
+                m_BQuadric.append(QVector<double>(10, 0.0));
+            }
+
+            // the plane which contains the free edge and is perpendicular to its triangle
+            for(int ic=m_FirstCorner.at(n0); ic>=0; ic=m_NextCorner.at(ic))
+            {
+                int it = ic/3;
+                int const *idx = m_Index.constData()+3*it;
+                if(idx[0]!=n1 && idx[1]!=n1 && idx[2]!=n1) continue;
+                Vector3d P0(m_Position.at(3*idx[0]), m_Position.at(3*idx[0]+1), m_Position.at(3*idx[0]+2));
+                Vector3d P1(m_Position.at(3*idx[1]), m_Position.at(3*idx[1]+1), m_Position.at(3*idx[1]+2));
+                Vector3d P2(m_Position.at(3*idx[2]), m_Position.at(3*idx[2]+1), m_Position.at(3*idx[2]+2));
+                Vector3d A(m_Position.at(3*n0), m_Position.at(3*n0+1), m_Position.at(3*n0+2));
+                Vector3d B(m_Position.at(3*n1), m_Position.at(3*n1+1), m_Position.at(3*n1+2));
+                Vector3d M = (B-A) * ((P1-P0) * (P2-P0));
+                if(M.norm()>0.0)
+                {
+                    M.normalize();
+                    double d = -M.dot(A);
+                    addPlaneQuadric(m_BQuadric.data()+10*m_Boundary.at(n0), M.x, M.y, M.z, d, 1.0);
+                    addPlaneQuadric(m_BQuadric.data()+10*m_Boundary.at(n1), M.x, M.y, M.z, d, 1.0);
+                }
+                break;
+            }
+        }
+        i = j;
+    }
+
+    for(size_t i=0; i<edge.size(); i++)
+    {
+        if(i>0 && edge.at(i)==edge.at(i-1)) continue;
+        pushCollapse(int(edge.at(i)>>32), int(edge.at(i) & 0xffffffff));
+    }
+}
+
+
+/** Returns the value of the quadric at the position */
+double MeshDecimator::quadricError(double const *Q, double const *pos) const
+{
+    double x = pos[0], y = pos[1], z = pos[2];
+    return Q[0]*x*x + 2.0*Q[1]*x*y + 2.0*Q[2]*x*z + 2.0*Q[3]*x
+         + Q[4]*y*y + 2.0*Q[5]*y*z + 2.0*Q[6]*y
+         + Q[7]*z*z + 2.0*Q[8]*z
+         + Q[9];
+}
+
+
+/** Sets Q to the sum of the quadrics of the two vertices, with their boundary quadrics multiplied by the weight */
+void MeshDecimator::edgeQuadric(int v0, int v1, double boundaryweight, double *Q) const
+{
+    double const *Q0 = m_Quadric.constData()+10*v0;
+    double const *Q1 = m_Quadric.constData()+10*v1;
+    for(int i=0; i<10; i++) Q[i] = Q0[i]+Q1[i];
+
+    for(int iv : {v0, v1})
+    {
+        if(m_Boundary.at(iv)<0) continue;
+        double const *QB = m_BQuadric.constData()+10*m_Boundary.at(iv);
+        for(int i=0; i<10; i++) Q[i] += boundaryweight*QB[i];
+    }
+}
+
+
+/**
+ * Returns the distance error of the collapse of the edge v0-v1 into the position pos, i.e. the square root of the sum
+ * of the squared distances to the planes of the vertices' quadrics, with the boundary planes counted with a unit weight.
+ */
+double MeshDecimator::collapseError(int v0, int v1, double const *pos) const
+{
+    double Q[10];
+    edgeQuadric(v0, v1, 1.0, Q);
+    return sqrt(std::max(quadricError(Q, pos), 0.0));
+}
+
+
+/**
+ * Returns the cost of the collapse of the edge v0-v1, and the position of the merged vertex if pos is not null.
+ * The position minimizes the sum of the two quadrics; if the system is singular, or if its solution is farther
+ * than one edge length from the edge's middle, the best of the two vertices and the middle is used instead.
+ * A boundary vertex collapsed with an interior vertex keeps its position.
+ */
+double MeshDecimator::collapseCost(int v0, int v1, double *pos) const
+{
+    double Q[10];
+    edgeQuadric(v0, v1, s_BoundaryWeight, Q);
+
+    double const *P0 = m_Position.constData()+3*v0;
+    double const *P1 = m_Position.constData()+3*v1;
+    double best[3] = {P0[0], P0[1], P0[2]};
+    double cost = quadricError(Q, P0);
+
+    if(isBoundary(v0)!=isBoundary(v1))
+    {
+        if(isBoundary(v1))
+        {
+            best[0] = P1[0];  best[1] = P1[1];  best[2] = P1[2];
+            cost = quadricError(Q, P1);
+        }
+    }
+    else
+    {
+        double e1 = quadricError(Q, P1);
+        if(e1<cost)
+        {
+            best[0] = P1[0];  best[1] = P1[1];  best[2] = P1[2];
+            cost = e1;
+        }
+        double mid[3] = {(P0[0]+P1[0])/2.0, (P0[1]+P1[1])/2.0, (P0[2]+P1[2])/2.0};
+        double em = quadricError(Q, mid);
+        if(em<cost)
+        {
+            best[0] = mid[0];  best[1] = mid[1];  best[2] = mid[2];
+            cost = em;
+        }
+
+        // solve A.x = -b by Cramer's rule
+        double det = Q[0]*(Q[4]*Q[7]-Q[5]*Q[5]) - Q[1]*(Q[1]*Q[7]-Q[5]*Q[2]) + Q[2]*(Q[1]*Q[5]-Q[4]*Q[2]);
+        double tr = Q[0]+Q[4]+Q[7];
+        if(std::abs(det)>1.e-9*tr*tr*tr)
+        {
+            double b0 = -Q[3], b1 = -Q[6], b2 = -Q[8];
+            double opt[3];
+            opt[0] = (b0*(Q[4]*Q[7]-Q[5]*Q[5]) - Q[1]*(b1*Q[7]-Q[5]*b2) + Q[2]*(b1*Q[5]-Q[4]*b2)) / det;
+            opt[1] = (Q[0]*(b1*Q[7]-b2*Q[5]) - b0*(Q[1]*Q[7]-Q[5]*Q[2]) + Q[2]*(Q[1]*b2-b1*Q[2])) / det;
+            opt[2] = (Q[0]*(Q[4]*b2-Q[5]*b1) - Q[1]*(Q[1]*b2-b1*Q[2]) + b0*(Q[1]*Q[5]-Q[4]*Q[2])) / det;
+
+            double l2 = 0.0, d2 = 0.0;
+            for(int k=0; k<3; k++)
+            {
+                l2 += (P1[k]-P0[k])*(P1[k]-P0[k]);
+                d2 += (opt[k]-mid[k])*(opt[k]-mid[k]);
+            }
+            double eo = quadricError(Q, opt);
+            if(d2<=l2 && eo<cost)
+            {
+                best[0] = opt[0];  best[1] = opt[1];  best[2] = opt[2];
+                cost = eo;
+            }
+        }
+    }
+
+    if(pos)
+    {
+        pos[0] = best[0];  pos[1] = best[1];  pos[2] = best[2];
+    }
+    return std::max(cost, 0.0);
+}
+
+
+/** Queues the collapse of the edge v0-v1 with the current versions of its vertices */
+void MeshDecimator::pushCollapse(int v0, int v1)
+{
+    if(m_bLocked.at(v0) || m_bLocked.at(v1)) return;
+    Collapse c;
+    c.m_Cost = collapseCost(v0, v1, nullptr);
+    c.m_V[0] = v0;
+    c.m_V[1] = v1;
+    c.m_Version[0] = m_Version.at(v0);
+    c.m_Version[1] = m_Version.at(v1);
+    m_Queue.push(c);
+}
+
+
+/** Returns false if either vertex has been moved or collapsed since the collapse was queued */
+bool MeshDecimator::isValid(Collapse const &c) const
+{
+    return m_Version.at(c.m_V[0])>=0 && m_Version.at(c.m_V[0])==c.m_Version[0]
+        && m_Version.at(c.m_V[1])>=0 && m_Version.at(c.m_V[1])==c.m_Version[1];
+}
+
+
+/** Removes from the vertex's list the corners of the removed triangles and those which have been moved to another vertex */
+void MeshDecimator::compactCorners(int iv)
+{
+    int const *index = m_Index.constData();
+    int *next = m_NextCorner.data();
+    int *prev = m_FirstCorner.data()+iv;
+    while(*prev>=0)
+    {
+        int ic = *prev;
+        if(index[ic]!=iv) *prev = next[ic];
+        else              prev = next+ic;
+    }
+}
+
+
+/**
+ * Returns true if the edge v0-v1 can be collapsed into the position pos. The collapse must preserve the topology,
+ * i.e. the vertices common to the neighbourhoods of v0 and v1 must be exactly those of the triangles which share the edge,
+ * and must not flip or degenerate any of the remaining triangles. The corner lists must have been compacted.
+ */
+bool MeshDecimator::canCollapse(int v0, int v1, double const *pos)
+{
+    int const *index = m_Index.constData();
+
+    m_Stamp++;
+    for(int ic=m_FirstCorner.at(v0); ic>=0; ic=m_NextCorner.at(ic))
+    {
+        int const *idx = index+3*(ic/3);
+        for(int k=0; k<3; k++) if(idx[k]!=v0) m_Mark[idx[k]] = m_Stamp;
+    }
+
+    int nShared = 0, nCommon = 0;
+    for(int ic=m_FirstCorner.at(v1); ic>=0; ic=m_NextCorner.at(ic))
+    {
+        int const *idx = index+3*(ic/3);
+        if(idx[0]==v0 || idx[1]==v0 || idx[2]==v0) nShared++;
+        for(int k=0; k<3; k++)
+        {
+            int iv = idx[k];
+            if(iv!=v0 && iv!=v1 && m_Mark.at(iv)==m_Stamp)
+            {
+                nCommon++;
+                m_Mark[iv] = 0;
+            }
+        }
+    }
+    if(nShared==0 || nCommon!=nShared) return false;
+    if(isBoundary(v0) && isBoundary(v1) && nShared!=1) return false; // would pinch the surface
+
+    Vector3d P(pos[0], pos[1], pos[2]);
+    for(int iLoop=0; iLoop<2; iLoop++)
+    {
+        int iv = iLoop==0 ? v0 : v1;
+        for(int ic=m_FirstCorner.at(iv); ic>=0; ic=m_NextCorner.at(ic))
+        {
+            int const *idx = index+3*(ic/3);
+            if((idx[0]==v0 || idx[1]==v0 || idx[2]==v0) && (idx[0]==v1 || idx[1]==v1 || idx[2]==v1)) continue; // removed by the collapse
+
+            Vector3d V[3], W[3];
+            for(int k=0; k<3; k++)
+            {
+                V[k].set(m_Position.at(3*idx[k]), m_Position.at(3*idx[k]+1), m_Position.at(3*idx[k]+2));
+                W[k] = idx[k]==iv ? P : V[k];
+            }
+            Vector3d N0 = (V[1]-V[0]) * (V[2]-V[0]);
+            Vector3d N1 = (W[1]-W[0]) * (W[2]-W[0]);
+            double n0 = N0.norm(), n1 = N1.norm();
+            if(n1<=1.e-12*n0) return false;
+            if(N0.dot(N1)<s_MinNormalDot*n0*n1) return false;
+        }
+    }
+    return true;
+}
+
+
+/** Collapses the vertex v1 into the vertex v0 moved to the position pos, and queues the collapses of v0's new edges */
+void MeshDecimator::collapseEdge(int v0, int v1, double const *pos)
+{
+    int *index = m_Index.data();
+    int last = -1;
+    for(int ic=m_FirstCorner.at(v1); ic>=0; ic=m_NextCorner.at(ic))
+    {
+        int *idx = index+3*(ic/3);
+        if(idx[0]==v0 || idx[1]==v0 || idx[2]==v0)
+        {
+            idx[0] = idx[1] = idx[2] = -1;
+            m_nTriangles--;
+        }
+        else index[ic] = v0;
+        last = ic;
+    }
+
+    // move v1's corners to the head of v0's list
+    if(last>=0)
+    {
+        m_NextCorner[last] = m_FirstCorner.at(v0);
+        m_FirstCorner[v0] = m_FirstCorner.at(v1);
+    }
+    m_FirstCorner[v1] = -1;
+    compactCorners(v0);
+
+    for(int k=0; k<3; k++) m_Position[3*v0+k] = pos[k];
+    for(int i=0; i<10; i++) m_Quadric[10*v0+i] += m_Quadric.at(10*v1+i);
+    if(m_Boundary.at(v0)<0)
+        m_Boundary[v0] = m_Boundary.at(v1);
+    else if(m_Boundary.at(v1)>=0)
+    {
+        for(int i=0; i<10; i++) m_BQuadric[10*m_Boundary.at(v0)+i] += m_BQuadric.at(10*m_Boundary.at(v1)+i);
+    }
+    m_Version[v0]++;
+    m_Version[v1] = -1;
+
+    m_Stamp++;
+    m_Mark[v0] = m_Stamp;
+    for(int ic=m_FirstCorner.at(v0); ic>=0; ic=m_NextCorner.at(ic))
+    {
+        int const *idx = index+3*(ic/3);
+        for(int k=0; k<3; k++)
+        {
+            if(m_Mark.at(idx[k])==m_Stamp) continue;
+            m_Mark[idx[k]] = m_Stamp;
+            pushCollapse(v0, idx[k]);
+        }
+    }
+}
+
+
+/**
+ * Collapses the edges in the order of increasing cost until the number of triangles is at most targetcount,
+ * or until the next collapse would exceed the distance error maxerror if it is positive.
+ * The error is measured without the weight of the boundary planes, so that it is a distance to the original surface
+ * and its outline. May be called again with a lower target to continue the decimation.
+ * @return the number of triangles removed
+ */
+int MeshDecimator::collapse(int targetcount, double maxerror)
+{
+    int nStart = m_nTriangles;
+    double pos[3];
+
+    while(m_nTriangles>targetcount && !m_Queue.empty())
+    {
+        if(m_pbCancel && m_pbCancel->load()) break;
+
+        Collapse c = m_Queue.top();
+        if(!isValid(c))
+        {
+            m_Queue.pop();
+            continue;
+        }
+
+        int v0 = c.m_V[0];
+        int v1 = c.m_V[1];
+        if(isBoundary(v1) && !isBoundary(v0)) std::swap(v0, v1); // keep the boundary vertex
+
+        collapseCost(v0, v1, pos);
+        double error = collapseError(v0, v1, pos);
+        if(maxerror>0.0 && error>maxerror) break; // left in the queue, for a later call with a larger bound
+        m_Queue.pop();
+
+        compactCorners(v0);
+        compactCorners(v1);
+        if(!canCollapse(v0, v1, pos)) continue;
+
+        collapseEdge(v0, v1, pos);
+        m_Error = std::max(m_Error, error);
+    }
+    return nStart-m_nTriangles;
+}
+
+
+/** Makes the decimated mesh, with its vertices numbered in the order in which its triangles first use them */
+void MeshDecimator::makeMesh(TriMesh &mesh) const
+{
+    QVector<int> vertexid(m_FirstCorner.size(), -1);
+    QVector<float> positions;
+    QVector<int> indexes;
+    indexes.reserve(3*m_nTriangles);
+
+    for(int ic=0; ic<m_Index.size(); ic++)
+    {
+        int iv = m_Index.at(ic);
+        if(iv<0) continue;
+        if(vertexid.at(iv)<0)
+        {
+            vertexid[iv] = positions.size()/3;
+            for(int k=0; k<3; k++) positions.append(float(m_Position.at(3*iv+k) + m_Offset[k]));
+        }
+        indexes.append(vertexid.at(iv));
+    }
+    mesh.setMesh(positions, indexes);
+}
+
+
+/**
+ * Decimates the triangulation to targetcount triangles, or until the next collapse would exceed the distance error maxerror
+ * if it is positive. The nodes and the connections of the decimated triangulation are made.
+ */
+void MeshDecimator::decimate(Triangulation const &triangulation, int targetcount, double maxerror, Triangulation &decimated)
+{
+    TriMesh mesh;
+    mesh.fromTriangulation(triangulation);
+
+    MeshDecimator decimator;
+    decimator.setMesh(mesh);
+    decimator.collapse(targetcount, maxerror);
+    decimator.makeMesh(mesh);
+    mesh.makeConnections();
+    mesh.toTriangulation(decimated);
+}
+
+
+/**
+ * Makes the chain of levels of detail of the mesh. The first level is the mesh itself; each next level has about
+ * a quarter of the triangles of the previous one, down to mintriangles. The chain stops early if the decimation
+ * can no longer halve the number of triangles, e.g. because of the boundaries.
+ * @param errors the largest distance error of each level, i.e. 0 for the first level
+ * @param pbCancel if not null, the chain stops as soon as the flag is set, e.g. by another thread
+ */
+void MeshDecimator::makeLodChain(TriMesh const &mesh, int mintriangles, QVector<TriMesh> &levels, QVector<double> &errors,
+                                 std::atomic<bool> const *pbCancel)
+{
+    levels.clear();
+    errors.clear();
+    levels.append(mesh);
+    errors.append(0.0);
+
+    MeshDecimator decimator;
+    decimator.setCancelFlag(pbCancel);
+    decimator.setMesh(mesh);
+    int target = decimator.triangleCount()/4;
+    while(target>=mintriangles)
+    {
+        int nPrevious = decimator.triangleCount();
+        decimator.collapse(target);
+        if(pbCancel && pbCancel->load()) break;
+        if(decimator.triangleCount()>nPrevious/2) break;
+
+        TriMesh level;
+        decimator.makeMesh(level);
+        levels.append(level);
+        errors.append(decimator.error());
+        target = decimator.triangleCount()/4;
+    }
+}
+
@@ -0,0 +1,100 @@
+/****************************************************************************
+
+    Xfl3d application
+    Copyright (C) Andre Deperrois
+    License: GPL v3
+
+*****************************************************************************/
+
+
+#pragma once
+
+#include <atomic>
+#include <queue>
+#include <vector>
+
+#include <QVector>
+
+class Triangulation;
+class TriMesh;
+
+
+/**
+ * @class MeshDecimator
+ * Simplifies a triangle mesh by collapsing its edges in the order of their quadric error, after Garland and Heckbert.
+ *
+ * Each vertex holds the sum of the squared distance quadrics of the planes of its triangles. An edge is collapsed
+ * into the position which minimizes the sum of the quadrics of its two vertices, and the sum is the cost of the collapse.
+ * The edges are processed from a priority queue; the entries made stale by a collapse are recognized by the
+ * version stamps of their vertices and skipped when popped.
+ *
+ * The free edges are preserved by adding to their vertices the heavily weighted quadric of the plane which contains
+ * the edge and is perpendicular to its triangle, and a boundary vertex is only collapsed along a free edge.
+ * The boundary quadrics are kept apart, so that the distance error of a collapse is measured with a unit weight.
+ * The vertices of the non-manifold edges are not collapsed.
+ * A collapse is rejected if it would make the surface non-manifold, or flip or degenerate a triangle.
+ *
+ * The decimation can be resumed with a lower target, so that the successive levels of a LOD chain are each
+ * made from the previous one at no extra cost.
+ */
+class MeshDecimator
+{
+    public:
+        MeshDecimator();
+
+        void setMesh(TriMesh const &mesh);
+        void setCancelFlag(std::atomic<bool> const *pbCancel) {m_pbCancel=pbCancel;}
+        int collapse(int targetcount, double maxerror=0.0);
+        void makeMesh(TriMesh &mesh) const;
+
+        int triangleCount() const {return m_nTriangles;}
+        double error() const {return m_Error;}
+
+        static void decimate(Triangulation const &triangulation, int targetcount, double maxerror, Triangulation &decimated);
+        static void makeLodChain(TriMesh const &mesh, int mintriangles, QVector<TriMesh> &levels, QVector<double> &errors,
+                                 std::atomic<bool> const *pbCancel=nullptr);
+
+    private:
+        struct Collapse
+        {
+            double m_Cost;
+            int m_V[2];
+            int m_Version[2];
+            bool operator>(Collapse const &c) const {return m_Cost>c.m_Cost;}
+        };
+
+        bool isValid(Collapse const &c) const;
+        void pushCollapse(int v0, int v1);
+        bool isBoundary(int iv) const {return m_Boundary.at(iv)>=0;}
+        void edgeQuadric(int v0, int v1, double boundaryweight, double *Q) const;
+        double collapseCost(int v0, int v1, double *pos) const;
+        double collapseError(int v0, int v1, double const *pos) const;
+        double quadricError(double const *Q, double const *pos) const;
+        void compactCorners(int iv);
+        bool canCollapse(int v0, int v1, double const *pos);
+        void collapseEdge(int v0, int v1, double const *pos);
+
+    private:
+        QVector<double> m_Position;     /**< the vertex positions relative to m_Offset, as 3 consecutive doubles */
+        QVector<double> m_Quadric;      /**< the symmetric 4x4 quadric of the triangle planes of each vertex, as 10 consecutive doubles */
+        QVector<double> m_BQuadric;     /**< the unweighted quadric of the boundary planes of each vertex on a free edge */
+        QVector<int> m_Index;           /**< the vertex indexes of each triangle, or -1 if the triangle has been removed */
+        QVector<int> m_FirstCorner;     /**< the first corner of each vertex's list of corners, or -1 */
+        QVector<int> m_NextCorner;      /**< the next corner in the list of the corner's vertex, or -1 */
+        QVector<int> m_Version;         /**< incremented each time the vertex is moved, or -1 once it has been collapsed */
+        QVector<int> m_Boundary;        /**< the index of the vertex's boundary quadric, or -1 if the vertex is not on a free edge */
+        QVector<char> m_bLocked;        /**< true if the vertex is on a non-manifold edge */
+        QVector<int> m_Mark;            /**< the stamps used to mark the neighbour vertices in canCollapse() */
+        int m_Stamp;
+        double m_Offset[3];             /**< the centre of the mesh's box, subtracted from the positions to keep the quadrics accurate */
+
+        std::priority_queue<Collapse, std::vector<Collapse>, std::greater<Collapse>> m_Queue;
+
+        int m_nTriangles;
+        double m_Error;                 /**< the largest distance error of the collapses made so far */
+        std::atomic<bool> const *m_pbCancel;  /**< if not null, the decimation stops when the flag is set */
+
+        static double s_BoundaryWeight; /**< the weight of the boundary planes relative to the triangle planes */
+        static double s_MinNormalDot;   /**< the least cosine of the rotation of a triangle's normal by a collapse */
+};
+
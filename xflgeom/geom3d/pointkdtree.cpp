@@ -0,0 +1,173 @@
+/****************************************************************************
+
+    Xfl3d application
+    Copyright (C) Andre Deperrois
+    License: GPL v3
+
+*****************************************************************************/
+
+
+#include <algorithm>
+#include <cmath>
+
+#include "pointkdtree.h"
+
+
+PointKdTree::PointKdTree()
+{
+}
+
+
+void PointKdTree::clear()
+{
+    m_Point.clear();
+    m_Index.clear();
+    m_Node.clear();
+}
+
+
+/** Builds the tree from a copy of the points; the indexes returned by the queries are the indexes in this array */
+void PointKdTree::build(QVector<Vector3d> const &points)
+{
+    clear();
+    m_Point = points;
+    if(m_Point.isEmpty()) return;
+
+    m_Index.resize(m_Point.size());
+    for(int i=0; i<m_Index.size(); i++) m_Index[i] = i;
+
+    m_Node.reserve(2*m_Point.size()/s_LeafSize+1);
+    buildNode(0, m_Point.size());
+}
+
+
+/** Builds the node of the points in the index range [first, last[ and returns its index */
+int PointKdTree::buildNode(int first, int last)
+{
+    KdNode node;
+    for(int k=0; k<3; k++)
+    {
+        node.m_Min[k] =  1.e300;
+        node.m_Max[k] = -1.e300;
+    }
+    for(int i=first; i<last; i++)
+    {
+        Vector3d const &pt = m_Point.at(m_Index.at(i));
+        for(int k=0; k<3; k++)
+        {
+            node.m_Min[k] = std::min(node.m_Min[k], pt.dir(k));
+            node.m_Max[k] = std::max(node.m_Max[k], pt.dir(k));
+        }
+    }
+    node.m_First = first;
+    node.m_Last  = last;
+    node.m_Left = node.m_Right = -1;
+
+    int inode = m_Node.size();
+    m_Node.append(node);
+
+    if(last-first<=s_LeafSize) return inode;
+
+    // split at the median along the longest side of the box
+    int axis = 0;
+    for(int k=1; k<3; k++)
+    {
+        if(node.m_Max[k]-node.m_Min[k] > node.m_Max[axis]-node.m_Min[axis]) axis = k;
+    }
+    int mid = (first+last)/2;
+    std::nth_element(m_Index.begin()+first, m_Index.begin()+mid, m_Index.begin()+last,
+                     [this, axis](int i0, int i1) {return m_Point.at(i0).dir(axis) < m_Point.at(i1).dir(axis);});
+
+    int left  = buildNode(first, mid);
+    int right = buildNode(mid, last);
+    m_Node[inode].m_Left  = left;
+    m_Node[inode].m_Right = right;
+    return inode;
+}
+
+
+/**
+ * Returns true if the line A+t.U crosses the node's box enlarged by the radius,
+ * and the range [tmin, tmax] of the parameter t inside the box.
+ */
+bool PointKdTree::crossesBox(KdNode const &node, Vector3d const &A, Vector3d const &U, double radius, double &tmin, double &tmax) const
+{
+    tmin = -1.e300;
+    tmax =  1.e300;
+    for(int k=0; k<3; k++)
+    {
+        double lo = node.m_Min[k]-radius;
+        double hi = node.m_Max[k]+radius;
+        if(fabs(U.dir(k))<1.e-30)
+        {
+            if(A.dir(k)<lo || A.dir(k)>hi) return false;
+            continue;
+        }
+        double t0 = (lo-A.dir(k))/U.dir(k);
+        double t1 = (hi-A.dir(k))/U.dir(k);
+        if(t0>t1) std::swap(t0, t1);
+        tmin = std::max(tmin, t0);
+        tmax = std::min(tmax, t1);
+        if(tmin>tmax) return false;
+    }
+    return true;
+}
+
+
+/**
+ * Returns the index of the point closest to A along the line AB among the points which are
+ * at a distance less than the radius from the line, or -1 if there is none.
+ * @param maxindex if positive, only the points with an index less than maxindex are considered.
+ */
+int PointKdTree::closestToRay(Vector3d const &A, Vector3d const &B, double radius, int maxindex) const
+{
+    if(m_Node.isEmpty()) return -1;
+    Vector3d U = B-A;
+    if(U.norm()<1.e-30) return -1;
+    U.normalize();
+
+    int ibest = -1;
+    double tbest = 1.e300;
+    double r2 = radius*radius;
+    double tmin(0), tmax(0), tmin1(0), tmax1(0);
+
+    QVector<int> stack;
+    stack.reserve(64);
+    stack.push_back(0);
+    while(!stack.isEmpty())
+    {
+        KdNode const &node = m_Node.at(stack.takeLast());
+        if(!crossesBox(node, A, U, radius, tmin, tmax) || tmin>tbest) continue;
+
+        if(node.m_Left<0)
+        {
+            for(int i=node.m_First; i<node.m_Last; i++)
+            {
+                int ip = m_Index.at(i);
+                if(maxindex>=0 && ip>=maxindex) continue;
+                Vector3d AP = m_Point.at(ip)-A;
+                double t = AP.dot(U);
+                double d2 = AP.dot(AP) - t*t; // square of the distance to the line
+                if(d2<r2 && t<tbest)
+                {
+                    tbest = t;
+                    ibest = ip;
+                }
+            }
+            continue;
+        }
+
+        // visit the child nearest to A first, i.e. push it last
+        bool bLeft  = crossesBox(m_Node.at(node.m_Left),  A, U, radius, tmin,  tmax);
+        bool bRight = crossesBox(m_Node.at(node.m_Right), A, U, radius, tmin1, tmax1);
+        if(bLeft && bRight)
+        {
+            if(tmin<=tmin1) {stack.push_back(node.m_Right); stack.push_back(node.m_Left);}
+            else            {stack.push_back(node.m_Left);  stack.push_back(node.m_Right);}
+        }
+        else if(bLeft)  stack.push_back(node.m_Left);
+        else if(bRight) stack.push_back(node.m_Right);
+    }
+    return ibest;
+}
+
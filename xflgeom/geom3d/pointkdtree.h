@@ -0,0 +1,58 @@
+/****************************************************************************
+
+    Xfl3d application
+    Copyright (C) Andre Deperrois
+    License: GPL v3
+
+*****************************************************************************/
+
+
+#pragma once
+
+#include <QVector>
+
+#include <xflgeom/geom3d/vector3d.h>
+
+
+/**
+ * @class PointKdTree
+ * A static k-d tree of points, used to pick the point closest to a ray in a point cloud.
+ *
+ * The tree is built once by recursively splitting the points at the median along the longest axis
+ * of their bounding box. Each node holds the bounding box of its points, so that a query prunes the nodes
+ * whose box, enlarged by the pick radius, is not crossed by the ray, and the nodes which are farther
+ * along the ray than the best point found so far. The points of a leaf are tested directly.
+ * The cost of a pick is therefore in O(log N) for a narrow pick radius.
+ */
+class PointKdTree
+{
+    public:
+        PointKdTree();
+
+        void build(QVector<Vector3d> const &points);
+        void clear();
+
+        int pointCount() const {return m_Point.size();}
+        bool isEmpty() const {return m_Point.isEmpty();}
+
+        int closestToRay(Vector3d const &A, Vector3d const &B, double radius, int maxindex=-1) const;
+
+    private:
+        struct KdNode
+        {
+            double m_Min[3], m_Max[3];  /**< the bounding box of the node's points */
+            int m_First, m_Last;        /**< the range of the node's points in the index array */
+            int m_Left, m_Right;        /**< the child nodes, or -1 if the node is a leaf */
+        };
+
+        int buildNode(int first, int last);
+        bool crossesBox(KdNode const &node, Vector3d const &A, Vector3d const &U, double radius, double &tmin, double &tmax) const;
+
+    private:
+        QVector<Vector3d> m_Point;
+        QVector<int> m_Index;   /**< the point indexes, sorted so that the points of each node are contiguous */
+        QVector<KdNode> m_Node;
+
+        static int const s_LeafSize = 8;
+};
+
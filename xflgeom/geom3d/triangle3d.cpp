@@ -64,8 +64,15 @@ void Triangle3d::setTriangle(Node const& vtx0, Node const& vtx1, Node const& vtx
 }
 
 
+/**
+ * Makes the triangle's normal, CoG and area from its vertices, and tests if it is null.
+ * The other properties are made on first access, or by prepare(), since most bulk uses
+ * such as the import of STL files and rendering only need the vertices and the normal.
+ */
 void Triangle3d::setTriangle()
 {
+    m_bPrepared = false;
+
     S01.x = m_S[1].x-m_S[0].x;
     S01.y = m_S[1].y-m_S[0].y;
     S01.z = m_S[1].z-m_S[0].z;
@@ -76,24 +83,18 @@ void Triangle3d::setTriangle()
     S12.y = m_S[2].y-m_S[1].y;
     S12.z = m_S[2].z-m_S[1].z;
 
-    m_Edge[0].setNodes(m_S[1],m_S[2]);
-    m_Edge[1].setNodes(m_S[2],m_S[0]);
-    m_Edge[2].setNodes(m_S[0],m_S[1]);
-
-    m_Normal = m_Edge[1].segment() * m_Edge[2].segment();
+    m_Normal = S01 * S02;
+    double crossnorm = m_Normal.norm();
     m_Normal.normalize();
 
     m_CoG_g.x = (m_S[0].x+m_S[1].x+m_S[2].x)/3.0;
     m_CoG_g.y = (m_S[0].y+m_S[1].y+m_S[2].y)/3.0;
     m_CoG_g.z = (m_S[0].z+m_S[1].z+m_S[2].z)/3.0;
 
-    // set the origin at the CoG
-    // to compare integrals with MC's method, set the origin at vertex 0
-    O.x = m_CoG_g.x;
-    O.y = m_CoG_g.y;
-    O.z = m_CoG_g.z;
-
-    if(m_Edge[0].length()<LENGTHPRECISION || m_Edge[1].length()<LENGTHPRECISION || m_Edge[2].length()<LENGTHPRECISION)
+    double l01 = S01.norm();
+    double l02 = S02.norm();
+    double l12 = S12.norm();
+    if(l12<LENGTHPRECISION || l02<LENGTHPRECISION || l01<LENGTHPRECISION)
     {
         // one null side
         m_SignedArea = 0.0;
@@ -101,9 +102,10 @@ void Triangle3d::setTriangle()
         return;
     }
 
-    double sinthet0 = (S01*S02).norm() / S01.norm()/S02.norm();
-    double sinthet1 = (S12*S01).norm() / S12.norm()/S01.norm();
-    double sinthet2 = (S02*S12).norm() / S02.norm()/S12.norm();
+    // the three cross products of the sides have the same norm
+    double sinthet0 = crossnorm /l01/l02;
+    double sinthet1 = crossnorm /l12/l01;
+    double sinthet2 = crossnorm /l02/l12;
     double anglemin = 0.1/180*PI;
 
     if(sinthet0<anglemin || sinthet1<anglemin || sinthet2<anglemin)
@@ -116,20 +118,47 @@ void Triangle3d::setTriangle()
 
     m_bNullTriangle = false;
 
+    m_SignedArea = crossnorm/2.0;
+}
+
+
+/**
+ * Makes the edges, the local frame of reference, the projected 2d triangle and the matrix of barycentric coordinates.
+ * The properties are made lazily by the const accessors, which is not thread-safe: the triangles which are
+ * shared by concurrent tasks should be prepared beforehand, e.g. with Triangulation::prepareTriangles().
+ */
+void Triangle3d::makeLocalProperties() const
+{
+    m_Edge[0].setNodes(m_S[1],m_S[2]);
+    m_Edge[1].setNodes(m_S[2],m_S[0]);
+    m_Edge[2].setNodes(m_S[0],m_S[1]);
+
+    // set the origin at the CoG
+    // to compare integrals with MC's method, set the origin at vertex 0
+    O.x = m_CoG_g.x;
+    O.y = m_CoG_g.y;
+    O.z = m_CoG_g.z;
+
+    m_bPrepared = true;
+
+    if(m_bNullTriangle) return;
+
+    // the normal is made from the vertices, in case it has been set or flipped since setTriangle()
+    Vector3d N = (S01*S02).normalized();
 
     //define the local frame of reference
     // S01 defines the x-axis
     l = m_Edge[2].segment().normalized();
-    m = m_Normal*l;
+    m = N*l;
 
     m_CF.setOrigin(O);
-    m_CF.setIJK(l,m,m_Normal);
+    m_CF.setIJK(l,m,N);
 
     m_Sl[0] = m_CF.globalToLocal(m_S[0]-m_CoG_g);
     m_Sl[1] = m_CF.globalToLocal(m_S[1]-m_CoG_g);
     m_Sl[2] = m_CF.globalToLocal(m_S[2]-m_CoG_g);
 
-    m_CoG_l  = globalToLocal(m_CoG_g-m_CoG_g);
+    m_CoG_l  = m_CF.globalToLocal(m_CoG_g-m_CoG_g);
 
     m_triangle2d.setTriangle(Vector2d(m_Sl[0].x, m_Sl[0].y), Vector2d(m_Sl[1].x, m_Sl[1].y), Vector2d(m_Sl[2].x, m_Sl[2].y));
 
@@ -140,11 +169,9 @@ void Triangle3d::setTriangle()
     transpose33(gmat);
     invert33(gmat);
 
-    m_S01l = globalToLocal(m_Edge[2].segment());
-    m_S02l = globalToLocal(m_Edge[1].segment());
-    m_S12l = globalToLocal(m_Edge[0].segment());
-
-    m_SignedArea = (m_Edge[1].segment()*m_Edge[2].segment()).dot(m_Normal)/2.0;
+    m_S01l = m_CF.globalToLocal(m_Edge[2].segment());
+    m_S02l = m_CF.globalToLocal(m_Edge[1].segment());
+    m_S12l = m_CF.globalToLocal(m_Edge[0].segment());
 }
 
 
@@ -309,6 +336,7 @@ bool Triangle3d::intersectSegmentProjection(Segment3d const &seg) const
 {
     Vector3d A, B;
     Vector2d Al, Bl, I;
+    prepare();
     // convert everything to 2d - segments don't intersect in 3d
     normalProjection(seg.vertexAt(0), A);
     normalProjection(seg.vertexAt(1), B);
@@ -369,6 +397,7 @@ bool Triangle3d::intersectRayInside(Vector3d const &A, Vector3d const &U, Vector
 
 void Triangle3d::splitIn4Triangles(QVector<Triangle3d> &trianglelist) const
 {
+    prepare();
     trianglelist.resize(4);
     trianglelist[0].setTriangle(m_Edge[1].midPoint(), m_S[0], m_Edge[2].midPoint());
     trianglelist[1].setTriangle(m_Edge[2].midPoint(), m_S[1], m_Edge[0].midPoint());
@@ -410,6 +439,7 @@ double Triangle3d::maxEdgeLength() const
 
 double Triangle3d::qualityFactor(double &r, double &shortestEdge) const
 {
+    prepare();
     double a = m_Edge[0].length();
     double b = m_Edge[1].length();
     double c = m_Edge[2].length();
@@ -426,6 +456,7 @@ double Triangle3d::qualityFactor(double &r, double &shortestEdge) const
 
 int Triangle3d::edgeIndex(Segment3d const &seg, double precision) const
 {
+    prepare();
     for(int iEdge=0; iEdge<3; iEdge++)
     {
         if(m_Edge[iEdge].isSame(seg, precision)) return iEdge;
@@ -25,13 +25,15 @@ class Triangle3d
 
         void setTriangle();
         void setTriangle(Node const &vtx0, Node const &vtx1, Node const &vtx2);
+        void prepare() const {if(!m_bPrepared) makeLocalProperties();}
+        bool isPrepared() const {return m_bPrepared;}
         inline void setNormal(const Vector3d &N);
         inline void setNormal(double nx, double ny, double nz);
         void flipNormal() {m_Normal.reverse();}
 
         void reverseOrientation();
 
-        Segment3d const &edge(int iVtx) const {return m_Edge[iVtx%3];}
+        Segment3d const &edge(int iVtx) const {prepare(); return m_Edge[iVtx%3];}
         inline Segment3d const &edge(int iVtx0, int iVtx1) const;
 
         void clearConnections() {m_Neighbour[0] = m_Neighbour[1] = m_Neighbour[2] = -1;}
@@ -56,7 +58,7 @@ class Triangle3d
         }
         bool hasVertex(int nodeindex) const { return (nodeindex==m_S[0].index()) || (nodeindex==m_S[1].index()) || (nodeindex==m_S[2].index());}
 
-        CartesianFrame const & frame() const {return m_CF;}
+        CartesianFrame const & frame() const {prepare(); return m_CF;}
 
         void setVertex(int ivtx, Node const &V) {m_S[ivtx%3].x=V.x; m_S[ivtx%3].y=V.y; m_S[ivtx%3].z=V.z;}
         void setVertex(int ivtx, double x, double y, double z) {m_S[ivtx%3].x=x; m_S[ivtx%3].y=y; m_S[ivtx%3].z=z;}
@@ -86,17 +88,17 @@ class Triangle3d
 
         inline void normalProjection(Vector3d const &pt, Vector3d &projected) const;
 
-        void globalToLocal(Vector3d const &V, Vector3d &VLocal) const {m_CF.globalToLocal(V, VLocal);}
-        Vector3d globalToLocal(Vector3d const &V) const {return m_CF.globalToLocal(V);}
-        Vector3d globalToLocal(double const &Vx, double const &Vy, double const &Vz) const {return m_CF.globalToLocal(Vector3d(Vx,Vy, Vz));}
-        Vector3d localToGlobal(Vector3d const &V) const {return m_CF.localToGlobal(V);}
+        void globalToLocal(Vector3d const &V, Vector3d &VLocal) const {prepare(); m_CF.globalToLocal(V, VLocal);}
+        Vector3d globalToLocal(Vector3d const &V) const {prepare(); return m_CF.globalToLocal(V);}
+        Vector3d globalToLocal(double const &Vx, double const &Vy, double const &Vz) const {prepare(); return m_CF.globalToLocal(Vector3d(Vx,Vy, Vz));}
+        Vector3d localToGlobal(Vector3d const &V) const {prepare(); return m_CF.localToGlobal(V);}
 
-        void localToGlobalPosition(double const&xl, double const &yl, double const &zl, double &XG, double &YG, double &ZG) const {m_CF.localToGlobalPosition(xl, yl, zl, XG, YG, ZG);}
-        Vector3d localToGlobalPosition(Vector3d const &Pl) const {return m_CF.localToGlobalPosition(Pl);}
-        void globalToLocalPosition(double const&XG, double const&YG, double const&ZG, double &xl, double &yl, double &zl) const {m_CF.globalToLocalPosition(XG, YG, ZG, xl, yl, zl);}
-        Vector3d globalToLocalPosition(Vector3d const &P) const {return m_CF.globalToLocalPosition(P);}
+        void localToGlobalPosition(double const&xl, double const &yl, double const &zl, double &XG, double &YG, double &ZG) const {prepare(); m_CF.localToGlobalPosition(xl, yl, zl, XG, YG, ZG);}
+        Vector3d localToGlobalPosition(Vector3d const &Pl) const {prepare(); return m_CF.localToGlobalPosition(Pl);}
+        void globalToLocalPosition(double const&XG, double const&YG, double const&ZG, double &xl, double &yl, double &zl) const {prepare(); m_CF.globalToLocalPosition(XG, YG, ZG, xl, yl, zl);}
+        Vector3d globalToLocalPosition(Vector3d const &P) const {prepare(); return m_CF.globalToLocalPosition(P);}
 
-        Triangle2d const & triangle2d()  const {return m_triangle2d;}
+        Triangle2d const & triangle2d()  const {prepare(); return m_triangle2d;}
 
         Vector3d const & normal() const {return m_Normal;}
         Vector3d & normal() {return m_Normal;}
@@ -116,7 +118,7 @@ class Triangle3d
         double signedArea() const {return m_SignedArea;}
         double area() const {return fabs(m_SignedArea);}
         Vector3d const & CoG_g() const {return m_CoG_g;}
-        Vector3d const & CoG_l() const {return m_CoG_l;}
+        Vector3d const & CoG_l() const {prepare(); return m_CoG_l;}
 
         inline double angle(int iVtx) const;
 
@@ -171,6 +173,7 @@ class Triangle3d
         void barycentricCoords(Vector3d const &ptLocal, double *g) const  { barycentricCoords(ptLocal.x, ptLocal.y, g); }
         void barycentricCoords(double xl, double yl, double *g) const
         {
+            prepare();
             g[0] = gmat[0] + gmat[1]*xl+ gmat[2]*yl;
             g[1] = gmat[3] + gmat[4]*xl+ gmat[5]*yl;
             g[2] = gmat[6] + gmat[7]*xl+ gmat[8]*yl;
@@ -181,34 +184,39 @@ class Triangle3d
 
     protected:
         inline void initialize();
+        void makeLocalProperties() const;
 
 
     protected:
         Node m_S[3];                      /** the three triangle vertices, in global coordinates**/
 
-        Vector3d m_Sl[3];                 /**< The three triangle vertices, in local coordinates */
-
         int m_Neighbour[3];               /**< the indexes of the three neighbour triangle sharing one of the edge, or -1 if none */
         double m_SignedArea;              /**< The panel's signed area; */
         bool m_bNullTriangle;
                                           /** @todo remove & replace with m_S[].index() */
-        Vector3d O;                       /**< the origin of the local reference frame, in global coordinates */
-        Vector3d Ol;                      /**< the origin in local coordinates, i.e. (0,0,0) */
 
         Vector3d m_Normal;
-        Segment3d m_Edge[3];              /**< the three sides, in global coordinates */
-        Vector3d m_S01l, m_S02l, m_S12l;  /**< the three sides, in local coordinates */
-        Vector3d m, l;                    /**< the unit vectors which lie in the panel's plane. Cf. document NACA 4023 */
-
         Vector3d m_CoG_g;                 /**< the position of the center of gravity in global coordinates */
-        Vector3d m_CoG_l;                 /**< the position of the center of gravity in local coordinates */
         Vector3d S01, S02, S12;           /**< the three sides, in global coordinates */
 
-        Triangle2d m_triangle2d;
+        // the local properties, made on first access or by prepare(), since most bulk uses only need the vertices and the normal
+        mutable bool m_bPrepared;         /**< true if the local properties are up to date with the vertices */
+
+        mutable Vector3d m_Sl[3];                 /**< The three triangle vertices, in local coordinates */
+        mutable Vector3d O;                       /**< the origin of the local reference frame, in global coordinates */
+        mutable Vector3d Ol;                      /**< the origin in local coordinates, i.e. (0,0,0) */
+
+        mutable Segment3d m_Edge[3];              /**< the three sides, in global coordinates */
+        mutable Vector3d m_S01l, m_S02l, m_S12l;  /**< the three sides, in local coordinates */
+        mutable Vector3d m, l;                    /**< the unit vectors which lie in the panel's plane. Cf. document NACA 4023 */
+
+        mutable Vector3d m_CoG_l;                 /**< the position of the center of gravity in local coordinates */
+
+        mutable Triangle2d m_triangle2d;
 
-        CartesianFrame m_CF;
+        mutable CartesianFrame m_CF;
 
-        double gmat[9];             /**< the transformation matrix from local coordinates to barycentric coordinates;*/
+        mutable double gmat[9];             /**< the transformation matrix from local coordinates to barycentric coordinates;*/
 };
 
 
@@ -288,6 +296,7 @@ inline void Triangle3d::initialize()
     m_Neighbour[0] = m_Neighbour[1] = m_Neighbour[2] = -1;
 
     m_bNullTriangle = true;
+    m_bPrepared = false;
     m_SignedArea  = 0.0;
     m_S[0].setIndex(-1);
     m_S[1].setIndex(-1);
@@ -298,6 +307,7 @@ inline void Triangle3d::initialize()
 /** returns the edge between vertices i0 and i1 */
 inline Segment3d const &Triangle3d::edge(int i0, int i1) const
 {
+    prepare();
     if(i0==0)
     {
         if     (i1==1) return m_Edge[2];
@@ -466,7 +476,7 @@ inline bool Triangle3d::containsPointProjection(Vector3d const &pt, Vector3d &pr
     Vector3d proj_l;
 
     normalProjection(pt, proj);
-    m_CF.globalToLocalPosition(proj, proj_l);
+    proj_l = globalToLocalPosition(proj);
 
     double g[] = {0,0,0};
     barycentricCoords(proj_l, g);
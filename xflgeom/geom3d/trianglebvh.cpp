@@ -0,0 +1,615 @@
+/****************************************************************************
+
+    Xfl3d application
+    Copyright (C) Andre Deperrois
+    License: GPL v3
+
+*****************************************************************************/
+
+
+#include <algorithm>
+#include <cfloat>
+#include <cmath>
+
+#include "trianglebvh.h"
+#include <xflgeom/geom3d/trimesh.h>
+
+
+/** The largest float which is less than or equal to x */
+static inline float floatBelow(double x)
+{
+    float f = float(x);
+    if(double(f)>x) f = std::nextafter(f, -FLT_MAX);
+    return f;
+}
+
+
+/** The smallest float which is greater than or equal to x */
+static inline float floatAbove(double x)
+{
+    float f = float(x);
+    if(double(f)<x) f = std::nextafter(f, FLT_MAX);
+    return f;
+}
+
+
+static inline double boxArea(double const *bmin, double const *bmax)
+{
+    double dx = bmax[0]-bmin[0];
+    double dy = bmax[1]-bmin[1];
+    double dz = bmax[2]-bmin[2];
+    return 2.0*(dx*dy + dy*dz + dz*dx);
+}
+
+
+static inline float nodeArea(float const *bmin, float const *bmax)
+{
+    float dx = bmax[0]-bmin[0];
+    float dy = bmax[1]-bmin[1];
+    float dz = bmax[2]-bmin[2];
+    return 2.0f*(dx*dy + dy*dz + dz*dx);
+}
+
+
+TriangleBvh::TriangleBvh()
+{
+}
+
+
+void TriangleBvh::clear()
+{
+    m_Node.clear();
+    m_Index.clear();
+    m_Vertex.clear();
+}
+
+
+/** Builds the hierarchy; the queries return the indexes of the triangles in this list */
+void TriangleBvh::build(QVector<Triangle3d> const &triangles)
+{
+    clear();
+    m_Vertex.resize(triangles.size()*9);
+    double *pVertex = m_Vertex.data();
+    for(int i=0; i<triangles.size(); i++)
+    {
+        Triangle3d const &t3 = triangles.at(i);
+        for(int iv=0; iv<3; iv++)
+        {
+            Node const &vtx = t3.vertexAt(iv);
+            pVertex[9*i+3*iv+0] = vtx.x;
+            pVertex[9*i+3*iv+1] = vtx.y;
+            pVertex[9*i+3*iv+2] = vtx.z;
+        }
+    }
+    buildHierarchy();
+}
+
+
+/** Builds the hierarchy of the mesh's triangles; the queries return the indexes of the triangles in the mesh */
+void TriangleBvh::build(TriMesh const &mesh)
+{
+    clear();
+    m_Vertex.resize(mesh.triangleCount()*9);
+    double *pVertex = m_Vertex.data();
+    for(int i=0; i<mesh.triangleCount(); i++)
+    {
+        for(int iv=0; iv<3; iv++)
+        {
+            Vector3d vtx = mesh.vertex(mesh.vertexIndex(i, iv));
+            pVertex[9*i+3*iv+0] = vtx.x;
+            pVertex[9*i+3*iv+1] = vtx.y;
+            pVertex[9*i+3*iv+2] = vtx.z;
+        }
+    }
+    buildHierarchy();
+}
+
+
+/**
+ * Builds the nodes of the triangles whose vertices have been copied in their original order,
+ * then reorders the vertices in the order of the leaves.
+ */
+void TriangleBvh::buildHierarchy()
+{
+    int n = m_Vertex.size()/9;
+    if(n==0)
+    {
+        clear();
+        return;
+    }
+
+    // the boxes and centroids of the triangles
+    QVector<double> tribox(n*6), centroid(n*3);
+    for(int i=0; i<n; i++)
+    {
+        double const *pVertex = m_Vertex.constData() + 9*i;
+        for(int k=0; k<3; k++)
+        {
+            double v0 = pVertex[k];
+            double v1 = pVertex[3+k];
+            double v2 = pVertex[6+k];
+            tribox[6*i+k]   = std::min(v0, std::min(v1, v2));
+            tribox[6*i+3+k] = std::max(v0, std::max(v1, v2));
+            centroid[3*i+k] = (v0+v1+v2)/3.0;
+        }
+    }
+
+    m_Index.resize(n);
+    for(int i=0; i<n; i++) m_Index[i] = i;
+    m_Node.reserve(2*n/s_LeafSize+1);
+    buildNode(tribox, centroid, 0, n, 0);
+
+    QVector<double> leafvertex(n*9);
+    for(int i=0; i<n; i++)
+    {
+        double const *pVertex = m_Vertex.constData() + 9*m_Index.at(i);
+        std::copy(pVertex, pVertex+9, leafvertex.begin()+9*i);
+    }
+    m_Vertex.swap(leafvertex);
+
+    setBoxes();
+    m_Node.squeeze();
+}
+
+
+/** Returns the approximate memory used by the hierarchy, in bytes */
+qint64 TriangleBvh::memorySize() const
+{
+    return qint64(m_Node.size())   * qint64(sizeof(BvhNode))
+         + qint64(m_Index.size())  * qint64(sizeof(int))
+         + qint64(m_Vertex.size()) * qint64(sizeof(double));
+}
+
+
+/**
+ * Updates the vertices and the boxes after the triangles have been moved, keeping the hierarchy's topology.
+ * The list must be the one used to build the hierarchy, with the same number of triangles in the same order.
+ */
+void TriangleBvh::refit(QVector<Triangle3d> const &triangles)
+{
+    if(triangles.size()!=m_Index.size())
+    {
+        build(triangles);
+        return;
+    }
+    setLeafVertices(triangles);
+    setBoxes();
+}
+
+
+/** Builds the node of the triangles in the index range [first, last[ and returns its index */
+int TriangleBvh::buildNode(QVector<double> const &tribox, QVector<double> const &centroid, int first, int last, int depth)
+{
+    int inode = m_Node.size();
+    m_Node.append(BvhNode());
+    int count = last-first;
+
+    double nmin[3] = { DBL_MAX,  DBL_MAX,  DBL_MAX};
+    double nmax[3] = {-DBL_MAX, -DBL_MAX, -DBL_MAX};
+    double cmin[3] = { DBL_MAX,  DBL_MAX,  DBL_MAX};
+    double cmax[3] = {-DBL_MAX, -DBL_MAX, -DBL_MAX};
+    for(int i=first; i<last; i++)
+    {
+        int it = m_Index.at(i);
+        for(int k=0; k<3; k++)
+        {
+            nmin[k] = std::min(nmin[k], tribox.at(6*it+k));
+            nmax[k] = std::max(nmax[k], tribox.at(6*it+3+k));
+            cmin[k] = std::min(cmin[k], centroid.at(3*it+k));
+            cmax[k] = std::max(cmax[k], centroid.at(3*it+k));
+        }
+    }
+
+    if(count<=s_LeafSize)
+    {
+        m_Node[inode].m_Offset = first;
+        m_Node[inode].m_Count  = count;
+        return inode;
+    }
+
+    // find the split of the binned centroids which minimizes the surface area heuristic
+    int bestaxis = -1;
+    int bestbin = -1;
+    double bestcost = DBL_MAX;
+    for(int axis=0; axis<3; axis++)
+    {
+        double extent = cmax[axis]-cmin[axis];
+        if(extent<=0.0) continue;
+        double scale = double(s_nBins)/extent;
+
+        int bincount[s_nBins];
+        double bmin[s_nBins][3], bmax[s_nBins][3];
+        for(int b=0; b<s_nBins; b++)
+        {
+            bincount[b] = 0;
+            for(int k=0; k<3; k++)
+            {
+                bmin[b][k] =  DBL_MAX;
+                bmax[b][k] = -DBL_MAX;
+            }
+        }
+        for(int i=first; i<last; i++)
+        {
+            int it = m_Index.at(i);
+            int b = std::min(s_nBins-1, int((centroid.at(3*it+axis)-cmin[axis])*scale));
+            bincount[b]++;
+            for(int k=0; k<3; k++)
+            {
+                bmin[b][k] = std::min(bmin[b][k], tribox.at(6*it+k));
+                bmax[b][k] = std::max(bmax[b][k], tribox.at(6*it+3+k));
+            }
+        }
+
+        // the area and count on the right side of each split plane, swept from the right
+        double rightarea[s_nBins];
+        int rightcount[s_nBins];
+        double smin[3] = { DBL_MAX,  DBL_MAX,  DBL_MAX};
+        double smax[3] = {-DBL_MAX, -DBL_MAX, -DBL_MAX};
+        int n = 0;
+        for(int b=s_nBins-1; b>0; b--)
+        {
+            n += bincount[b];
+            for(int k=0; k<3; k++)
+            {
+                smin[k] = std::min(smin[k], bmin[b][k]);
+                smax[k] = std::max(smax[k], bmax[b][k]);
+            }
+            rightcount[b] = n;
+            rightarea[b] = n>0 ? boxArea(smin, smax) : 0.0;
+        }
+
+        // the split after bin b separates the bins [0, b] and [b+1, s_nBins[
+        for(int k=0; k<3; k++)
+        {
+            smin[k] =  DBL_MAX;
+            smax[k] = -DBL_MAX;
+        }
+        n = 0;
+        for(int b=0; b<s_nBins-1; b++)
+        {
+            n += bincount[b];
+            for(int k=0; k<3; k++)
+            {
+                smin[k] = std::min(smin[k], bmin[b][k]);
+                smax[k] = std::max(smax[k], bmax[b][k]);
+            }
+            if(n==0 || rightcount[b+1]==0) continue;
+            double cost = double(n)*boxArea(smin, smax) + double(rightcount[b+1])*rightarea[b+1];
+            if(cost<bestcost)
+            {
+                bestcost = cost;
+                bestaxis = axis;
+                bestbin = b;
+            }
+        }
+    }
+
+    if(bestaxis<0)
+    {
+        // all the centroids are at the same position
+        m_Node[inode].m_Offset = first;
+        m_Node[inode].m_Count  = count;
+        return inode;
+    }
+
+    // stop splitting if intersecting all the triangles is cheaper than traversing the two children
+    double nodearea = boxArea(nmin, nmax);
+    if(count<=4*s_LeafSize && nodearea>0.0 && 1.0+bestcost/nodearea >= double(count))
+    {
+        m_Node[inode].m_Offset = first;
+        m_Node[inode].m_Count  = count;
+        return inode;
+    }
+
+    int mid = first;
+    if(depth<s_MaxDepth)
+    {
+        double cmin0 = cmin[bestaxis];
+        double scale = double(s_nBins)/(cmax[bestaxis]-cmin[bestaxis]);
+        auto split = std::partition(m_Index.begin()+first, m_Index.begin()+last,
+                                    [&centroid, bestaxis, bestbin, cmin0, scale](int it)
+                                    {return std::min(s_nBins-1, int((centroid.at(3*it+bestaxis)-cmin0)*scale))<=bestbin;});
+        mid = int(split - m_Index.begin());
+    }
+    if(mid<=first || mid>=last)
+    {
+        // the hierarchy is too deep, or the split is degenerate: split at the median instead
+        mid = (first+last)/2;
+        std::nth_element(m_Index.begin()+first, m_Index.begin()+mid, m_Index.begin()+last,
+                         [&centroid, bestaxis](int i0, int i1) {return centroid.at(3*i0+bestaxis) < centroid.at(3*i1+bestaxis);});
+    }
+
+    buildNode(tribox, centroid, first, mid, depth+1);
+    int right = buildNode(tribox, centroid, mid, last, depth+1);
+    m_Node[inode].m_Offset = right;
+    m_Node[inode].m_Count  = 0;
+    return inode;
+}
+
+
+/** Copies the vertices of the triangles in the order of the leaves */
+void TriangleBvh::setLeafVertices(QVector<Triangle3d> const &triangles)
+{
+    m_Vertex.resize(m_Index.size()*9);
+    double *pVertex = m_Vertex.data();
+    for(int i=0; i<m_Index.size(); i++)
+    {
+        Triangle3d const &t3 = triangles.at(m_Index.at(i));
+        for(int iv=0; iv<3; iv++)
+        {
+            Node const &vtx = t3.vertexAt(iv);
+            pVertex[9*i+3*iv+0] = vtx.x;
+            pVertex[9*i+3*iv+1] = vtx.y;
+            pVertex[9*i+3*iv+2] = vtx.z;
+        }
+    }
+}
+
+
+/**
+ * Sets the boxes of the nodes bottom-up; since the nodes are stored depth-first, the children of a node
+ * have greater indexes than the node and the boxes are set in one reverse pass.
+ * The boxes are rounded outwards to single precision.
+ */
+void TriangleBvh::setBoxes()
+{
+    for(int in=m_Node.size()-1; in>=0; in--)
+    {
+        BvhNode &node = m_Node[in];
+        if(node.m_Count>0)
+        {
+            double bmin[3] = { DBL_MAX,  DBL_MAX,  DBL_MAX};
+            double bmax[3] = {-DBL_MAX, -DBL_MAX, -DBL_MAX};
+            double const *pVertex = m_Vertex.constData() + 9*node.m_Offset;
+            for(int j=0; j<node.m_Count*3; j++)
+            {
+                for(int k=0; k<3; k++)
+                {
+                    bmin[k] = std::min(bmin[k], pVertex[3*j+k]);
+                    bmax[k] = std::max(bmax[k], pVertex[3*j+k]);
+                }
+            }
+            for(int k=0; k<3; k++)
+            {
+                node.m_Min[k] = floatBelow(bmin[k]);
+                node.m_Max[k] = floatAbove(bmax[k]);
+            }
+        }
+        else
+        {
+            BvhNode const &left  = m_Node.at(in+1);
+            BvhNode const &right = m_Node.at(node.m_Offset);
+            for(int k=0; k<3; k++)
+            {
+                node.m_Min[k] = std::min(left.m_Min[k], right.m_Min[k]);
+                node.m_Max[k] = std::max(left.m_Max[k], right.m_Max[k]);
+            }
+        }
+    }
+}
+
+
+TriangleBvh::BvhRay TriangleBvh::makeRay(Vector3d const &A, Vector3d const &U)
+{
+    BvhRay ray;
+    for(int k=0; k<3; k++)
+    {
+        ray.m_A[k] = A.dir(k);
+        ray.m_U[k] = U.dir(k);
+        ray.m_Orig[k] = float(A.dir(k));
+        // avoid the infinite inverse of a null component, which would make NaNs in the slab test
+        double u = fabs(U.dir(k))<1.e-30 ? (U.dir(k)<0.0 ? -1.e-30 : 1.e-30) : U.dir(k);
+        ray.m_InvDir[k] = float(1.0/u);
+    }
+    return ray;
+}
+
+
+/**
+ * Returns true if the ray crosses the node's box in the range [0, tmax] of its parameter,
+ * and the parameter at which the ray enters the box.
+ */
+bool TriangleBvh::hitsBox(BvhNode const &node, BvhRay const &ray, double tmax, float &tentry) const
+{
+    float t0[3], t1[3];
+    for(int k=0; k<3; k++)
+    {
+        float ta = (node.m_Min[k]-ray.m_Orig[k])*ray.m_InvDir[k];
+        float tb = (node.m_Max[k]-ray.m_Orig[k])*ray.m_InvDir[k];
+        t0[k] = std::min(ta, tb);
+        t1[k] = std::max(ta, tb);
+    }
+    tentry = std::max(std::max(t0[0], t0[1]), std::max(t0[2], 0.0f));
+    float texit = std::min(std::min(t1[0], t1[1]), std::min(t1[2], float(std::min(tmax, double(FLT_MAX)))));
+    // allow for the rounding of the single precision test
+    return tentry <= texit + 1.e-5f*std::fabs(texit);
+}
+
+
+/**
+ * Returns true if the ray crosses the leaf triangle i in the range [0, tmax] of its parameter,
+ * and the parameter t of the intersection. The test is two-sided, and includes the edges.
+ */
+bool TriangleBvh::hitsTriangle(int i, BvhRay const &ray, double tmax, double &t) const
+{
+    double const *v = m_Vertex.constData() + 9*i;
+    double e1[3] = {v[3]-v[0], v[4]-v[1], v[5]-v[2]};
+    double e2[3] = {v[6]-v[0], v[7]-v[1], v[8]-v[2]};
+    double const *U = ray.m_U;
+    double p[3] = {U[1]*e2[2]-U[2]*e2[1], U[2]*e2[0]-U[0]*e2[2], U[0]*e2[1]-U[1]*e2[0]};
+    double det = e1[0]*p[0] + e1[1]*p[1] + e1[2]*p[2];
+    if(fabs(det)<1.e-30) return false;
+    double invdet = 1.0/det;
+
+    double s[3] = {ray.m_A[0]-v[0], ray.m_A[1]-v[1], ray.m_A[2]-v[2]};
+    double b1 = (s[0]*p[0] + s[1]*p[1] + s[2]*p[2])*invdet;
+    if(b1<0.0 || b1>1.0) return false;
+
+    double q[3] = {s[1]*e1[2]-s[2]*e1[1], s[2]*e1[0]-s[0]*e1[2], s[0]*e1[1]-s[1]*e1[0]};
+    double b2 = (U[0]*q[0] + U[1]*q[1] + U[2]*q[2])*invdet;
+    if(b2<0.0 || b1+b2>1.0) return false;
+
+    t = (e2[0]*q[0] + e2[1]*q[1] + e2[2]*q[2])*invdet;
+    return t>=0.0 && t<=tmax;
+}
+
+
+/**
+ * Returns the index of the first triangle crossed by the ray A+t.U with t in [0, tmax], or -1 if there is none,
+ * and the parameter t of the intersection. U does not need to be normalized.
+ */
+int TriangleBvh::closestHit(Vector3d const &A, Vector3d const &U, double tmax, double &t) const
+{
+    if(m_Node.isEmpty()) return -1;
+    BvhRay ray = makeRay(A, U);
+
+    int ibest = -1;
+    double tbest = tmax;
+    double ti = 0.0;
+    float tentry = 0.0f, tleft = 0.0f, tright = 0.0f;
+
+    QVector<int> stack;
+    stack.reserve(64);
+    stack.push_back(0);
+    while(!stack.isEmpty())
+    {
+        int inode = stack.takeLast();
+        BvhNode const &node = m_Node.at(inode);
+        if(!hitsBox(node, ray, tbest, tentry)) continue;
+
+        if(node.m_Count>0)
+        {
+            for(int i=node.m_Offset; i<node.m_Offset+node.m_Count; i++)
+            {
+                if(hitsTriangle(i, ray, tbest, ti))
+                {
+                    tbest = ti;
+                    ibest = i;
+                }
+            }
+            continue;
+        }
+
+        // visit the nearest child first, i.e. push it last
+        bool bLeft  = hitsBox(m_Node.at(inode+1),       ray, tbest, tleft);
+        bool bRight = hitsBox(m_Node.at(node.m_Offset), ray, tbest, tright);
+        if(bLeft && bRight)
+        {
+            if(tleft<=tright) {stack.push_back(node.m_Offset); stack.push_back(inode+1);}
+            else              {stack.push_back(inode+1);       stack.push_back(node.m_Offset);}
+        }
+        else if(bLeft)  stack.push_back(inode+1);
+        else if(bRight) stack.push_back(node.m_Offset);
+    }
+
+    if(ibest<0) return -1;
+    t = tbest;
+    return m_Index.at(ibest);
+}
+
+
+/** Returns true if the ray A+t.U crosses any triangle with t in [0, tmax]; stops at the first intersection found */
+bool TriangleBvh::anyHit(Vector3d const &A, Vector3d const &U, double tmax) const
+{
+    if(m_Node.isEmpty()) return false;
+    BvhRay ray = makeRay(A, U);
+
+    double ti = 0.0;
+    float tentry = 0.0f;
+
+    QVector<int> stack;
+    stack.reserve(64);
+    stack.push_back(0);
+    while(!stack.isEmpty())
+    {
+        int inode = stack.takeLast();
+        BvhNode const &node = m_Node.at(inode);
+        if(!hitsBox(node, ray, tmax, tentry)) continue;
+
+        if(node.m_Count>0)
+        {
+            for(int i=node.m_Offset; i<node.m_Offset+node.m_Count; i++)
+            {
+                if(hitsTriangle(i, ray, tmax, ti)) return true;
+            }
+            continue;
+        }
+        stack.push_back(node.m_Offset);
+        stack.push_back(inode+1);
+    }
+    return false;
+}
+
+
+/** Returns the box of the triangle i, in the order of the leaves */
+void TriangleBvh::triangleBox(int i, double *bmin, double *bmax) const
+{
+    double const *pVertex = m_Vertex.constData() + 9*i;
+    for(int k=0; k<3; k++)
+    {
+        bmin[k] = std::min(pVertex[k], std::min(pVertex[3+k], pVertex[6+k]));
+        bmax[k] = std::max(pVertex[k], std::max(pVertex[3+k], pVertex[6+k]));
+    }
+}
+
+
+/**
+ * Appends to the array the pairs of triangles of this hierarchy and of the other one whose boxes overlap
+ * once enlarged by the margin, as the indexes of the two triangles in their original lists.
+ * The two hierarchies are descended together; the larger node of each overlapping pair is split,
+ * so that only the pairs of nodes which overlap are visited.
+ */
+void TriangleBvh::overlappingPairs(TriangleBvh const &other, double margin, QVector<int> &pairs) const
+{
+    if(m_Node.isEmpty() || other.m_Node.isEmpty()) return;
+    float fmargin = floatAbove(margin);
+
+    QVector<int> stack;  // pairs of node indexes
+    stack.reserve(128);
+    stack.push_back(0);
+    stack.push_back(0);
+    while(!stack.isEmpty())
+    {
+        int jnode = stack.takeLast();
+        int inode = stack.takeLast();
+        BvhNode const &ni = m_Node.at(inode);
+        BvhNode const &nj = other.m_Node.at(jnode);
+
+        bool bOverlap = true;
+        for(int k=0; k<3 && bOverlap; k++)
+            bOverlap = ni.m_Min[k]<=nj.m_Max[k]+fmargin && nj.m_Min[k]<=ni.m_Max[k]+fmargin;
+        if(!bOverlap) continue;
+
+        if(ni.m_Count>0 && nj.m_Count>0)
+        {
+            double imin[3], imax[3], jmin[3], jmax[3];
+            for(int i=ni.m_Offset; i<ni.m_Offset+ni.m_Count; i++)
+            {
+                triangleBox(i, imin, imax);
+                for(int j=nj.m_Offset; j<nj.m_Offset+nj.m_Count; j++)
+                {
+                    other.triangleBox(j, jmin, jmax);
+                    bool bTriOverlap = true;
+                    for(int k=0; k<3 && bTriOverlap; k++)
+                        bTriOverlap = imin[k]<=jmax[k]+margin && jmin[k]<=imax[k]+margin;
+                    if(!bTriOverlap) continue;
+                    pairs.append(m_Index.at(i));
+                    pairs.append(other.m_Index.at(j));
+                }
+            }
+            continue;
+        }
+
+        if(nj.m_Count>0 || (ni.m_Count==0 && nodeArea(ni.m_Min, ni.m_Max)>=nodeArea(nj.m_Min, nj.m_Max)))
+        {
+            stack.push_back(inode+1);       stack.push_back(jnode);
+            stack.push_back(ni.m_Offset);   stack.push_back(jnode);
+        }
+        else
+        {
+            stack.push_back(inode);   stack.push_back(jnode+1);
+            stack.push_back(inode);   stack.push_back(nj.m_Offset);
+        }
+    }
+}
+
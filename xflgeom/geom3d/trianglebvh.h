@@ -0,0 +1,88 @@
+/****************************************************************************
+
+    Xfl3d application
+    Copyright (C) Andre Deperrois
+    License: GPL v3
+
+*****************************************************************************/
+
+
+#pragma once
+
+#include <QVector>
+
+#include <xflgeom/geom3d/triangle3d.h>
+#include <xflgeom/geom3d/vector3d.h>
+
+class TriMesh;
+
+
+/**
+ * @class TriangleBvh
+ * A bounding volume hierarchy over a list of triangles, used to intersect rays with large meshes.
+ *
+ * The hierarchy is built top-down; each node is split along the axis and at the position which minimize
+ * the surface area heuristic, evaluated on a fixed number of bins of the triangles' centroids.
+ * The nodes are stored depth-first in a flat array of 32-byte nodes with single precision boxes, so that
+ * the left child of an interior node is the next node and only the index of the right child is stored.
+ * The vertices of the triangles are copied in the order of the leaves, so that a leaf's triangles are contiguous in memory.
+ *
+ * The hierarchy can be refitted after the triangles have been moved or deformed, which keeps its topology
+ * and updates the boxes bottom-up in linear time; its quality degrades if the triangles move much relative to each other,
+ * in which case it should be rebuilt.
+ */
+class TriangleBvh
+{
+    friend class XflMeshFile;
+
+    public:
+        TriangleBvh();
+
+        void build(QVector<Triangle3d> const &triangles);
+        void build(TriMesh const &mesh);
+        void refit(QVector<Triangle3d> const &triangles);
+        void clear();
+
+        bool isEmpty() const {return m_Node.isEmpty();}
+        int triangleCount() const {return m_Index.size();}
+        int nodeCount() const {return m_Node.size();}
+        qint64 memorySize() const;
+
+        int closestHit(Vector3d const &A, Vector3d const &U, double tmax, double &t) const;
+        bool anyHit(Vector3d const &A, Vector3d const &U, double tmax) const;
+        void overlappingPairs(TriangleBvh const &other, double margin, QVector<int> &pairs) const;
+
+    private:
+        struct BvhNode
+        {
+            float m_Min[3];
+            int m_Offset;       /**< the index of the first triangle if the node is a leaf, or the index of the right child */
+            float m_Max[3];
+            int m_Count;        /**< the number of triangles if the node is a leaf, or 0 */
+        };
+
+        struct BvhRay
+        {
+            double m_A[3], m_U[3];
+            float m_Orig[3], m_InvDir[3];
+        };
+
+        void buildHierarchy();
+        int buildNode(QVector<double> const &tribox, QVector<double> const &centroid, int first, int last, int depth);
+        void setLeafVertices(QVector<Triangle3d> const &triangles);
+        void setBoxes();
+        bool hitsBox(BvhNode const &node, BvhRay const &ray, double tmax, float &tentry) const;
+        bool hitsTriangle(int i, BvhRay const &ray, double tmax, double &t) const;
+        void triangleBox(int i, double *bmin, double *bmax) const;
+        static BvhRay makeRay(Vector3d const &A, Vector3d const &U);
+
+    private:
+        QVector<BvhNode> m_Node;
+        QVector<int> m_Index;       /**< the index in the original list of each triangle, in the order of the leaves */
+        QVector<double> m_Vertex;   /**< the 3 vertices of each triangle, in the order of the leaves, as 9 consecutive doubles */
+
+        static int const s_nBins = 12;
+        static int const s_LeafSize = 4;
+        static int const s_MaxDepth = 48;   /**< the depth beyond which the nodes are split at the median, to bound the depth of degenerate hierarchies */
+};
+
@@ -7,9 +7,17 @@
 *****************************************************************************/
 
 
+#include <algorithm>
+#include <cmath>
+
 #include <QDataStream>
+#include <QFutureSynchronizer>
+#include <QHash>
+#include <QThread>
+#include <QtConcurrent/QtConcurrent>
 
 #include "triangulation.h"
+#include <xflgeom/geom_globals/geom_global.h>
 #include <xflmath/constants.h>
 
 
@@ -21,24 +29,103 @@ Triangulation::Triangulation()
 #define MERGELENGTH 0.0001
 
 
+/** The key of the cell (ix, iy, iz) of the welding grid; cells which share a key only cost extra distance tests */
+static inline quint64 weldCellKey(qint64 ix, qint64 iy, qint64 iz)
+{
+    return (quint64(ix)*73856093ULL) ^ (quint64(iy)*19349663ULL) ^ (quint64(iz)*83492791ULL);
+}
+
+
 /**
- * Make the array of unique Node objects from the list of triangles
+ * Make the array of unique Node objects from the list of triangles.
+ *
+ * The vertices are welded with a hash grid of cell size MERGELENGTH: a vertex is merged with a node
+ * which is closer than MERGELENGTH in each direction, so that this node is in the vertex's cell
+ * or in one of the 26 neighbour cells. Each cell holds the list of its nodes, most recent first,
+ * and the vertex is merged with the most recent matching node, as in isTriangleNode().
+ * The cost is linear in the number of vertices.
  */
 int Triangulation::makeNodes()
 {
-    //make the array of nodes and set the vertex indices
+    int nVertices = m_Triangle.size()*3;
     m_Node.clear();
-    m_Node.reserve(m_Triangle.size()*3);
+    m_Node.reserve(nVertices);
+
+    // the grid cells of the vertices, computed in parallel for large meshes
+    QVector<qint64> cell(nVertices*3);
+    qint64 *pCell = cell.data();
+    Triangle3d const *pTriangle = m_Triangle.constData();
+    auto makeCells = [pCell, pTriangle](int first, int last)
+    {
+        for(int it=first; it<last; it++)
+        {
+            for(int iv=0; iv<3; iv++)
+            {
+                Node const &vtx = pTriangle[it].vertexAt(iv);
+                qint64 *c = pCell + 9*it+3*iv;
+                c[0] = qint64(std::floor(vtx.x/MERGELENGTH));
+                c[1] = qint64(std::floor(vtx.y/MERGELENGTH));
+                c[2] = qint64(std::floor(vtx.z/MERGELENGTH));
+            }
+        }
+    };
+
+    int nThreads = m_Triangle.size()>20000 ? std::max(1, QThread::idealThreadCount()) : 1;
+    if(nThreads>1)
+    {
+        QFutureSynchronizer<void> futureSync;
+        for(int iBlock=0; iBlock<nThreads; iBlock++)
+        {
+            int first = int(qint64(m_Triangle.size())* iBlock   /nThreads);
+            int last  = int(qint64(m_Triangle.size())*(iBlock+1)/nThreads);
+            futureSync.addFuture(QtConcurrent::run([=]() {makeCells(first, last);}));
+        }
+        futureSync.waitForFinished();
+    }
+    else makeCells(0, m_Triangle.size());
+
+    // weld the vertices in order, so that the nodes are numbered as they are met
+    QHash<quint64, int> cellnode;  // the most recent node of each cell
+    QVector<int> nextnode;         // the previous node in the same cell, or -1
+    cellnode.reserve(nVertices/2);
+    nextnode.reserve(nVertices);
     for(int it=0; it<m_Triangle.size(); it++)
     {
         Triangle3d &t3 = m_Triangle[it];
         for(int iv=0; iv<3; iv++)
         {
-            int iNode = isTriangleNode(t3.vertex(iv));
+            Node const &vtx = t3.vertexAt(iv);
+            qint64 const *c = cell.constData() + 9*it+3*iv;
+            int iNode = -1;
+            for(int dx=-1; dx<=1; dx++)
+            {
+                for(int dy=-1; dy<=1; dy++)
+                {
+                    for(int dz=-1; dz<=1; dz++)
+                    {
+                        QHash<quint64, int>::const_iterator itc = cellnode.constFind(weldCellKey(c[0]+dx, c[1]+dy, c[2]+dz));
+                        if(itc==cellnode.constEnd()) continue;
+                        // the lists are in decreasing order, so only the nodes more recent than the current match are tested
+                        for(int in=itc.value(); in>iNode; in=nextnode.at(in))
+                        {
+                            Node const &nd = m_Node.at(in);
+                            if(fabs(nd.x-vtx.x)<MERGELENGTH && fabs(nd.y-vtx.y)<MERGELENGTH && fabs(nd.z-vtx.z)<MERGELENGTH)
+                            {
+                                iNode = in;
+                                break;
+                            }
+                        }
+                    }
+                }
+            }
+
             if(iNode<0)
             {
                 iNode = m_Node.size();
-                m_Node.push_back(t3.vertex(iv));
+                m_Node.push_back(vtx);
+                quint64 key = weldCellKey(c[0], c[1], c[2]);
+                nextnode.push_back(cellnode.value(key, -1));
+                cellnode.insert(key, iNode);
             }
             m_Node[iNode].addTriangleIndex(it);
             t3.setVertexIndex(iv, iNode);
@@ -121,6 +208,35 @@ int Triangulation::isTriangleNode(const Node &nd) const
 }
 
 
+/**
+ * Makes the local properties of all the triangles, in parallel for large meshes.
+ * Needs to be called before the triangles' frames, edges or barycentric coordinates are used by concurrent tasks,
+ * since the triangles otherwise make them on first access.
+ */
+void Triangulation::prepareTriangles()
+{
+    Triangle3d const *pTriangle = m_Triangle.constData();
+    auto prepareBlock = [pTriangle](int first, int last)
+    {
+        for(int it=first; it<last; it++) pTriangle[it].prepare();
+    };
+
+    int nThreads = m_Triangle.size()>20000 ? std::max(1, QThread::idealThreadCount()) : 1;
+    if(nThreads>1)
+    {
+        QFutureSynchronizer<void> futureSync;
+        for(int iBlock=0; iBlock<nThreads; iBlock++)
+        {
+            int first = int(qint64(m_Triangle.size())* iBlock   /nThreads);
+            int last  = int(qint64(m_Triangle.size())*(iBlock+1)/nThreads);
+            futureSync.addFuture(QtConcurrent::run([=]() {prepareBlock(first, last);}));
+        }
+        futureSync.waitForFinished();
+    }
+    else prepareBlock(0, m_Triangle.size());
+}
+
+
 void Triangulation::flipXZ()
 {
     for(int it=0; it<m_Triangle.size(); it++)
@@ -132,6 +248,8 @@ void Triangulation::flipXZ()
     {
         m_Node[in].y = m_Node[in].y;
     }
+
+    if(hasBvh()) m_Bvh.refit(m_Triangle);
 }
 
 
@@ -148,6 +266,8 @@ void Triangulation::scale(double XFactor, double YFactor, double ZFactor)
         m_Node[in].y *= YFactor;
         m_Node[in].z *= ZFactor;
     }
+
+    if(hasBvh()) m_Bvh.refit(m_Triangle);
 }
 
 
@@ -162,6 +282,8 @@ void Triangulation::translate(const Vector3d &T)
     {
         m_Node[in].translate(T);
     }
+
+    if(hasBvh()) m_Bvh.refit(m_Triangle);
 }
 
 
@@ -176,11 +298,38 @@ void Triangulation::rotate(Vector3d const &Origin, Vector3d const&axis, double t
     {
         m_Node[in].rotate(Origin, axis, theta);
     }
+
+    if(hasBvh()) m_Bvh.refit(m_Triangle);
 }
 
 
+/**
+ * Returns the intersection of the line AB which is closest to A, and the normal of the intersected triangle.
+ * Uses the bounding volume hierarchy if it has been made, and tests all the triangles otherwise.
+ */
 bool Triangulation::intersect(Vector3d const &A, Vector3d const &B, Vector3d &Inear, Vector3d &N) const
 {
+    if(hasBvh())
+    {
+        // the line is searched in both directions from A
+        Vector3d U = B-A;
+        double tfwd=0, tbwd=0;
+        int ifwd = m_Bvh.closestHit(A,  U, 1.e300, tfwd);
+        int ibwd = m_Bvh.closestHit(A, U*(-1.0), 1.e300, tbwd);
+        if(ifwd<0 && ibwd<0) return false;
+        if(ibwd<0 || (ifwd>=0 && tfwd<=tbwd))
+        {
+            Inear = A + U*tfwd;
+            N = m_Triangle.at(ifwd).normal();
+        }
+        else
+        {
+            Inear = A - U*tbwd;
+            N = m_Triangle.at(ibwd).normal();
+        }
+        return true;
+    }
+
     double dmax = +1.e10;
     bool bIntersect = false;
     Vector3d I;
@@ -205,6 +354,76 @@ bool Triangulation::intersect(Vector3d const &A, Vector3d const &B, Vector3d &In
 }
 
 
+/**
+ * Intersects the triangles of this triangulation with those of the other one, and returns the intersection
+ * as chains of segments made by makeSegmentChains().
+ * The candidate pairs of triangles are those whose boxes overlap, found by descending the two bounding volume
+ * hierarchies together; the hierarchies are made here if they have not been. The pairs are then tested
+ * with intersectTriangles3d, in parallel for large numbers of pairs, so that the cost depends on the
+ * size of the intersection rather than on the product of the numbers of triangles.
+ * @return true if the triangulations intersect
+ */
+bool Triangulation::intersect(Triangulation const &other, QVector<QVector<Segment3d>> &chains, double precision) const
+{
+    chains.clear();
+
+    TriangleBvh bvh, otherbvh;
+    if(hasBvh()) bvh = m_Bvh;
+    else         bvh.build(m_Triangle);
+    if(other.hasBvh()) otherbvh = other.m_Bvh;
+    else               otherbvh.build(other.m_Triangle);
+
+    QVector<int> pairs;
+    bvh.overlappingPairs(otherbvh, precision, pairs);
+    int nPairs = pairs.size()/2;
+    if(nPairs==0) return false;
+
+    Triangle3d const *pTriangle = m_Triangle.constData();
+    Triangle3d const *pOther = other.m_Triangle.constData();
+    int const *pPair = pairs.constData();
+
+    // the triangles make their frames and edges on first access, which must not happen concurrently;
+    // only the candidates are prepared, since they are usually few
+    for(int ip=0; ip<nPairs; ip++)
+    {
+        pTriangle[pPair[2*ip]].prepare();
+        pOther[pPair[2*ip+1]].prepare();
+    }
+
+    int nThreads = nPairs>20000 ? std::max(1, QThread::idealThreadCount()) : 1;
+    QVector<QVector<Segment3d>> blocksegments(nThreads);
+    QVector<Segment3d> *pSegments = blocksegments.data();
+    auto intersectBlock = [pSegments, pTriangle, pOther, pPair, precision](int iBlock, int first, int last)
+    {
+        Segment3d seg;
+        for(int ip=first; ip<last; ip++)
+        {
+            if(intersectTriangles3d(pTriangle[pPair[2*ip]], pOther[pPair[2*ip+1]], seg, precision))
+                pSegments[iBlock].append(seg);
+        }
+    };
+
+    if(nThreads>1)
+    {
+        QFutureSynchronizer<void> futureSync;
+        for(int iBlock=0; iBlock<nThreads; iBlock++)
+        {
+            int first = int(qint64(nPairs)* iBlock   /nThreads);
+            int last  = int(qint64(nPairs)*(iBlock+1)/nThreads);
+            futureSync.addFuture(QtConcurrent::run([=]() {intersectBlock(iBlock, first, last);}));
+        }
+        futureSync.waitForFinished();
+    }
+    else intersectBlock(0, 0, nPairs);
+
+    QVector<Segment3d> segments;
+    for(int iBlock=0; iBlock<nThreads; iBlock++) segments.append(blocksegments.at(iBlock));
+
+    makeSegmentChains(segments, precision, chains);
+    return !chains.isEmpty();
+}
+
+
 void Triangulation::makeXZsymmetric()
 {
     int nt = nTriangles();
@@ -228,6 +447,8 @@ void Triangulation::flipNormals()
 
     for(int it=0; it<m_Node.size(); it++)
         m_Node[it].normal().reverse();
+
+    if(hasBvh()) m_Bvh.refit(m_Triangle);
 }
 
 
@@ -307,6 +528,8 @@ bool Triangulation::serializeFl5(QDataStream &ar, bool bIsStoring)
         if(ArchiveFormat<500001 || ArchiveFormat>500010) return false;
 
         m_Triangle.clear();
+        m_NonManifoldEdge.clear();
+        m_Bvh.clear();
         m_Node.clear();
 
         ar >> n;
@@ -329,7 +552,10 @@ bool Triangulation::serializeFl5(QDataStream &ar, bool bIsStoring)
 }
 
 
-/** Assumes that the connections have been made */
+/**
+ * Assumes that the connections have been made.
+ * The free edges are the edges with no neighbour triangle, excluding the non-manifold edges.
+ */
 void Triangulation::getFreeEdges(QVector<Segment3d> &freeedges) const
 {
     freeedges.clear();
@@ -338,8 +564,7 @@ void Triangulation::getFreeEdges(QVector<Segment3d> &freeedges) const
         Triangle3d const &p3 = m_Triangle.at(i3);
         for(int i=0; i<3; i++)
         {
-//            if(p3.neighbourEdgeIndex(0)!=i && p3.neighbourEdgeIndex(1)!=i && p3.neighbourEdgeIndex(2)!=i)
-            if(p3.neighbour(i)<0)
+            if(p3.neighbour(i)<0 && !std::binary_search(m_NonManifoldEdge.constBegin(), m_NonManifoldEdge.constEnd(), 3*i3+i))
             {
                 // this edge is a free edge
                 Segment3d const &seg = p3.edge(i);
@@ -350,6 +575,21 @@ void Triangulation::getFreeEdges(QVector<Segment3d> &freeedges) const
 }
 
 
+/**
+ * Assumes that the connections have been made.
+ * Returns one segment for each triangle sharing a non-manifold edge.
+ */
+void Triangulation::getNonManifoldEdges(QVector<Segment3d> &edges) const
+{
+    edges.clear();
+    for(int i=0; i<m_NonManifoldEdge.size(); i++)
+    {
+        int halfedge = m_NonManifoldEdge.at(i);
+        edges.push_back(m_Triangle.at(halfedge/3).edge(halfedge%3));
+    }
+}
+
+
 bool Triangulation::areNeighbours(Triangle3d const &t1, Triangle3d const &t2) const
 {
     int nsharednodes=0;
@@ -360,67 +600,92 @@ bool Triangulation::areNeighbours(Triangle3d const &t1, Triangle3d const &t2) co
     return(nsharednodes>1);
 }
 
+
+/** Assumes that the connections have been made */
+bool Triangulation::areNeighbours(int it1, int it2) const
+{
+    if(it1<0 || it1>=m_Triangle.size()) return false;
+    Triangle3d const &t1 = m_Triangle.at(it1);
+    return t1.neighbour(0)==it2 || t1.neighbour(1)==it2 || t1.neighbour(2)==it2;
+}
+
+
 void Triangulation::clearConnections()
 {
     for(int it0=0; it0<m_Triangle.size(); it0++)
     {
         m_Triangle[it0].clearConnections();
     }
+    m_NonManifoldEdge.clear();
 }
 
 /**
- * Typically used to connect the triangles i.e. define the neighbours of a triangulation.
- * Time expensive, so should be done only when needed.
- * Sets the neighbours
- * Sets the indexes of the vertices
- * Makes the nodes
+ * Connects the triangles i.e. defines the neighbours of a triangulation.
+ * Makes the nodes first if the vertex indexes of the triangles are not set.
+ * The edges are matched on the pair of node indexes of their vertices, using a hash map,
+ * so that the cost is linear in the number of triangles.
+ * An edge shared by exactly two triangles connects them. An edge shared by more than two triangles
+ * is non-manifold: it connects none of them and is recorded in the list of non-manifold edges.
  */
 void Triangulation::makeTriangleConnections()
 {
-    double const MAXDISTANCE = 1.e-4;
-
     clearConnections();
 
-    for(int it0=0; it0<m_Triangle.size(); it0++)
+    bool bNodes = !m_Node.isEmpty();
+    for(int it=0; it<m_Triangle.size() && bNodes; it++)
     {
-        Triangle3d &t30 = m_Triangle[it0];
-        // seek neighbours around the triangle's index first moving upwards and downwards
-        for(int it1=it0-1; it1>=0; it1--)
+        for(int iv=0; iv<3; iv++)
         {
-            Triangle3d &t31 = m_Triangle[it1];
-            if(t30.neighbourCount()>=3) break; // a triangle has no more than 3 neighbours
-            for(int iEdge=0; iEdge<3; iEdge++)
-            {
-                int nEdge = t30.edgeIndex(t31.edge(iEdge), MAXDISTANCE);
-                if(nEdge>=0)
-                {
-                    t30.setNeighbour(it0, nEdge);
-                    // take this opportunity to connect the other triangle too
-                    nEdge = t31.edgeIndex(t30.edge(nEdge), MAXDISTANCE);
-                    t31.setNeighbour(it0, nEdge);
-                    break;
-                }
-            }
+            int iNode = m_Triangle.at(it).nodeIndex(iv);
+            if(iNode<0 || iNode>=m_Node.size()) bNodes = false;
         }
-        for(int it1=it0+1; it1<m_Triangle.size(); it1++)
+    }
+    if(!bNodes) makeNodes();
+
+    // the first two half-edges met on each edge, and the number of triangles sharing the edge
+    struct EdgeUse
+    {
+        EdgeUse() : m_Count(0) {m_HalfEdge[0] = m_HalfEdge[1] = -1;}
+        int m_HalfEdge[2];
+        int m_Count;
+    };
+
+    QHash<quint64, EdgeUse> edgemap;
+    edgemap.reserve(m_Triangle.size()*3/2+1);
+    for(int it=0; it<m_Triangle.size(); it++)
+    {
+        Triangle3d const &t3 = m_Triangle.at(it);
+        for(int iEdge=0; iEdge<3; iEdge++)
         {
-            Triangle3d &t31 = m_Triangle[it1];
-            if(t30.neighbourCount()>=3) break; // a triangle has no more than 3 neighbours
-            for(int iEdge=0; iEdge<3; iEdge++)
-            {
-                int nEdge = t30.edgeIndex(t31.edge(iEdge), MAXDISTANCE);
-                if(nEdge>=0)
-                {
-                    t30.setNeighbour(it0, nEdge);
+            // the edge iEdge is opposite to the vertex iEdge
+            int n0 = t3.nodeIndex((iEdge+1)%3);
+            int n1 = t3.nodeIndex((iEdge+2)%3);
+            if(n0==n1) continue; // collapsed edge
+            quint64 key = (quint64(std::min(n0, n1))<<32) | quint64(std::max(n0, n1));
+            EdgeUse &use = edgemap[key];
+            if(use.m_Count<2) use.m_HalfEdge[use.m_Count] = 3*it+iEdge;
+            else              m_NonManifoldEdge.append(3*it+iEdge);
+            use.m_Count++;
+        }
+    }
 
-                    // take this opportunity to connect the other triangle too
-                    nEdge = t31.edgeIndex(t30.edge(nEdge), MAXDISTANCE);
-                    t31.setNeighbour(it0, nEdge);
-                    break;
-                 }
-            }
+    for(QHash<quint64, EdgeUse>::const_iterator ite=edgemap.constBegin(); ite!=edgemap.constEnd(); ++ite)
+    {
+        EdgeUse const &use = ite.value();
+        if(use.m_Count==2)
+        {
+            int h0 = use.m_HalfEdge[0];
+            int h1 = use.m_HalfEdge[1];
+            m_Triangle[h0/3].setNeighbour(h1/3, h0%3);
+            m_Triangle[h1/3].setNeighbour(h0/3, h1%3);
+        }
+        else if(use.m_Count>2)
+        {
+            m_NonManifoldEdge.append(use.m_HalfEdge[0]);
+            m_NonManifoldEdge.append(use.m_HalfEdge[1]);
         }
     }
+    std::sort(m_NonManifoldEdge.begin(), m_NonManifoldEdge.end());
 }
 
 
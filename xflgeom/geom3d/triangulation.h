@@ -11,6 +11,7 @@
 #include <QVector>
 #include <xflgeom/geom3d/triangle3d.h>
 #include <xflgeom/geom3d/node.h>
+#include <xflgeom/geom3d/trianglebvh.h>
 
 
 
@@ -22,16 +23,17 @@ class Triangulation
         Triangle3d const & triangleAt(int idx) const {return m_Triangle.at(idx);}
         Triangle3d &triangle(int idx) {return m_Triangle[idx];}
 
-        void setTriangles(QVector<Triangle3d> const& trianglelist) {m_Triangle=trianglelist;}
-        void setTriangle(int it, Triangle3d const &t3d) {if(it<0 || it>=m_Triangle.size()) return; else m_Triangle[it]=t3d;}
-        void appendTriangle(Triangle3d const& triangle) {m_Triangle.append(triangle);}
-        void appendTriangles(QVector<Triangle3d> const& trianglelist) {m_Triangle.append(trianglelist);}
+        void setTriangles(QVector<Triangle3d> const& trianglelist) {m_Triangle=trianglelist;  m_NonManifoldEdge.clear();  m_Bvh.clear();}
+        void setTriangle(int it, Triangle3d const &t3d) {if(it<0 || it>=m_Triangle.size()) return; else m_Triangle[it]=t3d;  m_NonManifoldEdge.clear();  m_Bvh.clear();}
+        void appendTriangle(Triangle3d const& triangle) {m_Triangle.append(triangle);  m_NonManifoldEdge.clear();  m_Bvh.clear();}
+        void appendTriangles(QVector<Triangle3d> const& trianglelist) {m_Triangle.append(trianglelist);  m_NonManifoldEdge.clear();  m_Bvh.clear();}
 
         void makeXZsymmetric();
         void clearConnections();
         void makeTriangleConnections();
         int makeNodes();
         void makeNodeNormals(bool bReversed=false);
+        void prepareTriangles();
 
         int isTriangleNode(const Node &nd) const;
 
@@ -41,12 +43,18 @@ class Triangulation
         void flipXZ();
 
         bool areNeighbours(Triangle3d const &t1, Triangle3d const &t2) const;
+        bool areNeighbours(int it1, int it2) const;
 
-        void clear() {m_Triangle.clear();  m_Node.clear();}
+        void clear() {m_Triangle.clear();  m_Node.clear();  m_NonManifoldEdge.clear();  m_Bvh.clear();}
         int nTriangles() const {return m_Triangle.size();}
-        void setTriangleCount(int ntriangles) {m_Triangle.resize(ntriangles);}
+        void setTriangleCount(int ntriangles) {m_Triangle.resize(ntriangles);  m_NonManifoldEdge.clear();  m_Bvh.clear();}
 
         bool intersect(const Vector3d &A, const Vector3d &B, Vector3d &Inear, Vector3d &N) const;
+        bool intersect(Triangulation const &other, QVector<QVector<Segment3d>> &chains, double precision) const;
+
+        void makeBvh() {m_Bvh.build(m_Triangle);}
+        void clearBvh() {m_Bvh.clear();}
+        bool hasBvh() const {return !m_Bvh.isEmpty() && m_Bvh.triangleCount()==m_Triangle.size();}
 
         QVector<Triangle3d> &triangles() {return m_Triangle;}
         QVector<Triangle3d> const &triangles() const {return m_Triangle;}
@@ -69,6 +77,9 @@ class Triangulation
         void computeSurfaceProperties(double &lx, double &ly, double &lz, double &wettedarea);
 
         void getFreeEdges(QVector<Segment3d> &freeedges) const;
+        void getNonManifoldEdges(QVector<Segment3d> &edges) const;
+        bool isManifold() const {return m_NonManifoldEdge.isEmpty();}
+        void setNonManifoldEdges(QVector<int> const &halfedges) {m_NonManifoldEdge=halfedges;}
 
         void flipNormals();
 
@@ -77,6 +88,8 @@ class Triangulation
     private:
         QVector<Triangle3d> m_Triangle;
         QVector<Node> m_Node;
+        QVector<int> m_NonManifoldEdge;  /**< the half-edges 3*iTriangle+iEdge which share an edge with two or more other triangles, sorted; cleared with the connections */
+        TriangleBvh m_Bvh;               /**< the hierarchy used by intersect(); cleared when triangles are added or replaced, refitted by the transformations */
 };
 
 
@@ -0,0 +1,311 @@
+/****************************************************************************
+
+    Xfl3d application
+    Copyright (C) Andre Deperrois
+    License: GPL v3
+
+*****************************************************************************/
+
+
+#include <algorithm>
+
+#include <QHash>
+
+#include "trimesh.h"
+#include <xflgeom/geom3d/triangulation.h>
+
+
+TriMesh::TriMesh()
+{
+}
+
+
+void TriMesh::clear()
+{
+    m_Position.clear();
+    m_Index.clear();
+    m_FaceNormal.clear();
+    m_Neighbour.clear();
+    m_Bvh.clear();
+}
+
+
+void TriMesh::setMesh(QVector<float> const &positions, QVector<int> const &indexes)
+{
+    clear();
+    m_Position = positions;
+    m_Index = indexes;
+}
+
+
+/**
+ * Makes the mesh from a list of triangles given as 9 consecutive floats each, such as the facets of an STL file.
+ * The corners at identical positions are merged into one vertex; the vertices are numbered
+ * in the order in which they are first met.
+ */
+void TriMesh::setTriangleSoup(float const *pVertex, int nTriangles)
+{
+    clear();
+    int nCorners = nTriangles*3;
+    if(nCorners<=0) return;
+
+    // sort the corners by position to group the identical ones
+    QVector<int> corner(nCorners);
+    for(int ic=0; ic<nCorners; ic++) corner[ic] = ic;
+    auto less = [pVertex](int ic0, int ic1)
+    {
+        float const *V0 = pVertex + 3*qint64(ic0);
+        float const *V1 = pVertex + 3*qint64(ic1);
+        if(V0[0]!=V1[0]) return V0[0]<V1[0];
+        if(V0[1]!=V1[1]) return V0[1]<V1[1];
+        return V0[2]<V1[2];
+    };
+    std::sort(corner.begin(), corner.end(), less);
+
+    QVector<int> group(nCorners);
+    int nGroups = 0;
+    for(int i=0; i<nCorners; i++)
+    {
+        if(i>0 && less(corner.at(i-1), corner.at(i))) nGroups++;
+        group[corner.at(i)] = nGroups;
+    }
+    nGroups++;
+
+    // number the vertices in the order of the corners
+    QVector<int> vertexid(nGroups, -1);
+    m_Position.reserve(nGroups*3);
+    m_Index.resize(nCorners);
+    for(int ic=0; ic<nCorners; ic++)
+    {
+        int &iv = vertexid[group.at(ic)];
+        if(iv<0)
+        {
+            iv = m_Position.size()/3;
+            m_Position.append(pVertex[3*qint64(ic)]);
+            m_Position.append(pVertex[3*qint64(ic)+1]);
+            m_Position.append(pVertex[3*qint64(ic)+2]);
+        }
+        m_Index[ic] = iv;
+    }
+}
+
+
+Vector3d TriMesh::faceNormal(int it) const
+{
+    Vector3d V0 = vertex(m_Index.at(3*it));
+    Vector3d V1 = vertex(m_Index.at(3*it+1));
+    Vector3d V2 = vertex(m_Index.at(3*it+2));
+    Vector3d N = (V1-V0) * (V2-V0);
+    if(N.norm()>0.0) N.normalize();
+    return N;
+}
+
+
+void TriMesh::makeFaceNormals()
+{
+    m_FaceNormal.resize(m_Index.size());
+    for(int it=0; it<triangleCount(); it++)
+    {
+        Vector3d N = faceNormal(it);
+        m_FaceNormal[3*it]   = N.xf();
+        m_FaceNormal[3*it+1] = N.yf();
+        m_FaceNormal[3*it+2] = N.zf();
+    }
+}
+
+
+/**
+ * Connects the triangles which share an edge, matching the edges on their pair of vertex indexes with a hash map.
+ * The edges shared by more than two triangles are non-manifold and connect none of them.
+ */
+void TriMesh::makeConnections()
+{
+    m_Neighbour.fill(-1, m_Index.size());
+
+    struct EdgeUse
+    {
+        EdgeUse() : m_Count(0) {m_HalfEdge[0] = m_HalfEdge[1] = -1;}
+        int m_HalfEdge[2];
+        int m_Count;
+    };
+
+    QHash<quint64, EdgeUse> edgemap;
+    edgemap.reserve(m_Index.size()/2+1);
+    for(int it=0; it<triangleCount(); it++)
+    {
+        for(int iEdge=0; iEdge<3; iEdge++)
+        {
+            int n0 = m_Index.at(3*it+(iEdge+1)%3);
+            int n1 = m_Index.at(3*it+(iEdge+2)%3);
+            if(n0==n1) continue;
+            quint64 key = (quint64(std::min(n0, n1))<<32) | quint64(std::max(n0, n1));
+            EdgeUse &use = edgemap[key];
+            if(use.m_Count<2) use.m_HalfEdge[use.m_Count] = 3*it+iEdge;
+            use.m_Count++;
+        }
+    }
+
+    for(QHash<quint64, EdgeUse>::const_iterator ite=edgemap.constBegin(); ite!=edgemap.constEnd(); ++ite)
+    {
+        EdgeUse const &use = ite.value();
+        if(use.m_Count!=2) continue;
+        m_Neighbour[use.m_HalfEdge[0]] = use.m_HalfEdge[1]/3;
+        m_Neighbour[use.m_HalfEdge[1]] = use.m_HalfEdge[0]/3;
+    }
+}
+
+
+/**
+ * Intersects the line AB with the mesh, searching in both directions from A, and returns the intersection
+ * nearest to A and the normal of its triangle. Requires the hierarchy; returns false if it has not been made.
+ */
+bool TriMesh::intersect(Vector3d const &A, Vector3d const &B, Vector3d &Inear, Vector3d &N) const
+{
+    if(!hasBvh()) return false;
+
+    Vector3d U = B-A;
+    double tfwd=0, tbwd=0;
+    int ifwd = m_Bvh.closestHit(A,  U, 1.e300, tfwd);
+    int ibwd = m_Bvh.closestHit(A, U*(-1.0), 1.e300, tbwd);
+    if(ifwd<0 && ibwd<0) return false;
+    if(ibwd<0 || (ifwd>=0 && tfwd<=tbwd))
+    {
+        Inear = A + U*tfwd;
+        N = faceNormal(ifwd);
+    }
+    else
+    {
+        Inear = A - U*tbwd;
+        N = faceNormal(ibwd);
+    }
+    return true;
+}
+
+
+/**
+ * Makes the mesh from the nodes of the triangulation if they have been made,
+ * and otherwise by merging the identical vertices of its triangles.
+ */
+void TriMesh::fromTriangulation(Triangulation const &triangulation)
+{
+    clear();
+    int nt = triangulation.nTriangles();
+
+    bool bNodes = triangulation.nNodes()>0;
+    for(int it=0; it<nt && bNodes; it++)
+    {
+        for(int iv=0; iv<3; iv++)
+        {
+            int iNode = triangulation.triangleAt(it).nodeIndex(iv);
+            if(iNode<0 || iNode>=triangulation.nNodes()) bNodes = false;
+        }
+    }
+
+    if(bNodes)
+    {
+        m_Position.resize(triangulation.nNodes()*3);
+        for(int in=0; in<triangulation.nNodes(); in++)
+        {
+            Node const &nd = triangulation.nodeAt(in);
+            m_Position[3*in]   = nd.xf();
+            m_Position[3*in+1] = nd.yf();
+            m_Position[3*in+2] = nd.zf();
+        }
+        m_Index.resize(nt*3);
+        for(int it=0; it<nt; it++)
+        {
+            for(int iv=0; iv<3; iv++) m_Index[3*it+iv] = triangulation.triangleAt(it).nodeIndex(iv);
+        }
+    }
+    else
+    {
+        QVector<float> soup(nt*9);
+        for(int it=0; it<nt; it++)
+        {
+            for(int iv=0; iv<3; iv++)
+            {
+                Node const &vtx = triangulation.triangleAt(it).vertexAt(iv);
+                soup[9*it+3*iv]   = vtx.xf();
+                soup[9*it+3*iv+1] = vtx.yf();
+                soup[9*it+3*iv+2] = vtx.zf();
+            }
+        }
+        setTriangleSoup(soup.constData(), nt);
+    }
+}
+
+
+/** Makes the triangles and the nodes of the triangulation, and the connections if the mesh has them */
+void TriMesh::toTriangulation(Triangulation &triangulation) const
+{
+    int nv = vertexCount();
+    int nt = triangleCount();
+
+    QVector<Node> nodes(nv);
+    for(int iv=0; iv<nv; iv++) nodes[iv].setPosition(vertex(iv));
+
+    QVector<Triangle3d> triangles(nt);
+    for(int it=0; it<nt; it++)
+    {
+        int n0 = m_Index.at(3*it);
+        int n1 = m_Index.at(3*it+1);
+        int n2 = m_Index.at(3*it+2);
+        triangles[it].setTriangle(nodes.at(n0), nodes.at(n1), nodes.at(n2));
+        triangles[it].setVertexIndexes(n0, n1, n2);
+        if(hasConnections()) triangles[it].setNeighbours(m_Neighbour.constData()+3*it);
+    }
+
+    for(int it=0; it<nt; it++)
+    {
+        for(int iv=0; iv<3; iv++) nodes[m_Index.at(3*it+iv)].addTriangleIndex(it);
+    }
+
+    triangulation.clear();
+    triangulation.setTriangles(triangles);
+    triangulation.setNodes(nodes);
+    if(hasConnections())
+    {
+        QVector<int> halfedges;
+        getNonManifoldEdges(halfedges);
+        triangulation.setNonManifoldEdges(halfedges);
+    }
+}
+
+
+/**
+ * Assumes that the connections have been made.
+ * Returns the sorted half-edges 3*iTriangle+iEdge of the edges shared by more than two triangles.
+ * These edges connect none of their triangles, so that only the half-edges without a neighbour are examined.
+ */
+void TriMesh::getNonManifoldEdges(QVector<int> &halfedges) const
+{
+    halfedges.clear();
+    QHash<quint64, QVector<int>> edgemap;
+    for(int ih=0; ih<m_Neighbour.size(); ih++)
+    {
+        if(m_Neighbour.at(ih)>=0) continue;
+        int it = ih/3;
+        int n0 = m_Index.at(3*it+(ih%3+1)%3);
+        int n1 = m_Index.at(3*it+(ih%3+2)%3);
+        if(n0==n1) continue;
+        edgemap[(quint64(std::min(n0, n1))<<32) | quint64(std::max(n0, n1))].append(ih);
+    }
+
+    for(QHash<quint64, QVector<int>>::const_iterator ite=edgemap.constBegin(); ite!=edgemap.constEnd(); ++ite)
+    {
+        if(ite.value().size()>2) halfedges.append(ite.value());
+    }
+    std::sort(halfedges.begin(), halfedges.end());
+}
+
+
+/** Returns the approximate memory used by the mesh's arrays, in bytes */
+qint64 TriMesh::memorySize() const
+{
+    return qint64(m_Position.size())   * qint64(sizeof(float))
+         + qint64(m_Index.size())      * qint64(sizeof(int))
+         + qint64(m_FaceNormal.size()) * qint64(sizeof(float))
+         + qint64(m_Neighbour.size())  * qint64(sizeof(int))
+         + m_Bvh.memorySize();
+}
+
@@ -0,0 +1,78 @@
+/****************************************************************************
+
+    Xfl3d application
+    Copyright (C) Andre Deperrois
+    License: GPL v3
+
+*****************************************************************************/
+
+
+#pragma once
+
+#include <QVector>
+
+#include <xflgeom/geom3d/trianglebvh.h>
+#include <xflgeom/geom3d/vector3d.h>
+
+class Triangulation;
+
+
+/**
+ * @class TriMesh
+ * A compact indexed triangle mesh, for the large triangle sets imported from STL files.
+ *
+ * The mesh holds only the vertex positions as 3 consecutive floats and the triangles as triples of vertex indexes.
+ * The face normals, the connections of the triangles and the bounding volume hierarchy are optional
+ * and are made on demand.
+ * This costs a few tens of bytes per triangle, much less than a Triangulation, whose Triangle3d objects
+ * each hold their nodes, edges, frame and projected triangle.
+ * The edge iEdge of a triangle is opposite to its vertex iEdge, as in Triangle3d.
+ */
+class TriMesh
+{
+    friend class XflMeshFile;
+
+    public:
+        TriMesh();
+
+        void clear();
+        void setMesh(QVector<float> const &positions, QVector<int> const &indexes);
+        void setTriangleSoup(float const *pVertex, int nTriangles);
+
+        int vertexCount() const {return m_Position.size()/3;}
+        int triangleCount() const {return m_Index.size()/3;}
+        bool isEmpty() const {return m_Index.isEmpty();}
+
+        QVector<float> const &positions() const {return m_Position;}
+        QVector<int> const &indexes() const {return m_Index;}
+        Vector3d vertex(int iv) const {return Vector3d(double(m_Position.at(3*iv)), double(m_Position.at(3*iv+1)), double(m_Position.at(3*iv+2)));}
+        int vertexIndex(int it, int ic) const {return m_Index.at(3*it+ic);}
+        Vector3d faceNormal(int it) const;
+
+        void makeFaceNormals();
+        bool hasFaceNormals() const {return !m_Index.isEmpty() && m_FaceNormal.size()==m_Index.size();}
+        QVector<float> const &faceNormals() const {return m_FaceNormal;}
+
+        void makeConnections();
+        void getNonManifoldEdges(QVector<int> &halfedges) const;
+        bool hasConnections() const {return !m_Index.isEmpty() && m_Neighbour.size()==m_Index.size();}
+        int neighbour(int it, int iEdge) const {return m_Neighbour.at(3*it+iEdge);}
+
+        void makeBvh() {m_Bvh.build(*this);}
+        bool hasBvh() const {return !m_Bvh.isEmpty() && m_Bvh.triangleCount()==triangleCount();}
+        TriangleBvh const &bvh() const {return m_Bvh;}
+        bool intersect(Vector3d const &A, Vector3d const &B, Vector3d &Inear, Vector3d &N) const;
+
+        void fromTriangulation(Triangulation const &triangulation);
+        void toTriangulation(Triangulation &triangulation) const;
+
+        qint64 memorySize() const;
+
+    private:
+        QVector<float> m_Position;     /**< the vertex positions, as 3 consecutive floats */
+        QVector<int> m_Index;          /**< the vertex indexes of each triangle, as 3 consecutive ints */
+        QVector<float> m_FaceNormal;   /**< optional, the unit normal of each triangle, as 3 consecutive floats */
+        QVector<int> m_Neighbour;      /**< optional, the neighbour triangle across each edge, or -1 */
+        TriangleBvh m_Bvh;             /**< optional, the hierarchy used to intersect rays with the mesh */
+};
+
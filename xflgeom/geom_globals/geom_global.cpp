@@ -7,8 +7,11 @@
 *****************************************************************************/
 
 
+#include <cmath>
+
 #include <QDataStream>
 #include <QFileInfo>
+#include <QHash>
 
 
 #include "geom_global.h"
@@ -532,7 +535,7 @@ bool overlapSegments3d(Segment3d const &s0, Segment3d const &s1, Segment3d &seg,
     if(bCheckColinearity)
     {
         if(fabs((s0.unitDir() * s1p.unitDir()).norm())>1.e-6) return false; // the two segments are not parallel
-        if(fabs((s0.unitDir() * V00).norm()/V00.norm())>1.e-6) return false; // one point of s1 does not lie on the line of s0
+        if(V00.norm()>LENGTHPRECISION && fabs((s0.unitDir() * V00).norm()/V00.norm())>1.e-6) return false; // one point of s1 does not lie on the line of s0
     }
 
     double dot00 = V00.dot(s0.unitDir());
@@ -566,6 +569,12 @@ bool overlapSegments3d(Segment3d const &s0, Segment3d const &s1, Segment3d &seg,
     {
         //  10_____00
         if(dot01<0) return false; //  10_____11____00_____01
+        else if(dot11>0)
+        {
+            //  10____00_____01_____11
+            seg = s0; // s0 is included in s1
+            return true;
+        }
         else
         {
             //  10____00_____11_____01
@@ -576,6 +585,168 @@ bool overlapSegments3d(Segment3d const &s0, Segment3d const &s1, Segment3d &seg,
 }
 
 
+/** The key of the cell (ix, iy, iz) of the grid used to merge the end points of the segments */
+static inline quint64 chainCellKey(qint64 ix, qint64 iy, qint64 iz)
+{
+    return (quint64(ix)*73856093ULL) ^ (quint64(iy)*19349663ULL) ^ (quint64(iz)*83492791ULL);
+}
+
+
+/**
+ * Connects the segments which share an end point into chains, e.g. to make the polylines
+ * of the intersection of two triangulations.
+ * The end points closer than precision in each direction are merged with a hash grid. The duplicated segments are dropped,
+ * and two segments which overlap from a common end point, as tested by overlapSegments3d, are merged by
+ * shortening the longer one to start at the far end of the shorter one. The null segments are ignored.
+ * Each chain is a list of segments joined head to tail; the open chains run between the points which
+ * do not join exactly two segments, and the remaining segments make closed chains.
+*/
+void makeSegmentChains(QVector<Segment3d> const &segments, double precision, QVector<QVector<Segment3d>> &chains)
+{
+    chains.clear();
+    if(precision<=0.0) precision = LENGTHPRECISION;
+
+    // merge the end points
+    QVector<Vector3d> point;
+    QHash<quint64, int> cellpoint;  // the most recent point of each cell
+    QVector<int> nextpoint;         // the previous point in the same cell, or -1
+    auto pointIndex = [&point, &cellpoint, &nextpoint, precision](Vector3d const &P)
+    {
+        qint64 cx = qint64(std::floor(P.x/precision));
+        qint64 cy = qint64(std::floor(P.y/precision));
+        qint64 cz = qint64(std::floor(P.z/precision));
+        for(int dx=-1; dx<=1; dx++)
+        {
+            for(int dy=-1; dy<=1; dy++)
+            {
+                for(int dz=-1; dz<=1; dz++)
+                {
+                    for(int ip=cellpoint.value(chainCellKey(cx+dx, cy+dy, cz+dz), -1); ip>=0; ip=nextpoint.at(ip))
+                    {
+                        Vector3d const &Q = point.at(ip);
+                        if(fabs(Q.x-P.x)<precision && fabs(Q.y-P.y)<precision && fabs(Q.z-P.z)<precision) return ip;
+                    }
+                }
+            }
+        }
+        int ip = point.size();
+        quint64 key = chainCellKey(cx, cy, cz);
+        point.append(P);
+        nextpoint.append(cellpoint.value(key, -1));
+        cellpoint[key] = ip;
+        return ip;
+    };
+
+    // the segments as pairs of point indexes, without the duplicates
+    QVector<int> edge;
+    QHash<quint64, int> edgemap;
+    for(int is=0; is<segments.size(); is++)
+    {
+        Segment3d const &seg = segments.at(is);
+        if(seg.length()<precision) continue;
+        int p0 = pointIndex(seg.vertexAt(0));
+        int p1 = pointIndex(seg.vertexAt(1));
+        if(p0==p1) continue;
+        quint64 key = (quint64(std::min(p0, p1))<<32) | quint64(std::max(p0, p1));
+        if(edgemap.contains(key)) continue;
+        edgemap.insert(key, edge.size()/2);
+        edge.append(p0);
+        edge.append(p1);
+    }
+
+    int nEdges = edge.size()/2;
+    QVector<QVector<int>> incident(point.size());
+    for(int ie=0; ie<nEdges; ie++)
+    {
+        incident[edge.at(2*ie)].append(ie);
+        incident[edge.at(2*ie+1)].append(ie);
+    }
+
+    // merge the segments which overlap from a common end point
+    QVector<int> work(point.size());
+    for(int ip=0; ip<point.size(); ip++) work[ip] = ip;
+    while(!work.isEmpty())
+    {
+        int ip = work.takeLast();
+        bool bMerged = true;
+        while(bMerged)
+        {
+            bMerged = false;
+            QVector<int> const &inc = incident.at(ip);
+            for(int a=0; a<inc.size() && !bMerged; a++)
+            {
+                for(int b=a+1; b<inc.size() && !bMerged; b++)
+                {
+                    int ea = inc.at(a), eb = inc.at(b);
+                    int qa = edge.at(2*ea)==ip ? edge.at(2*ea+1) : edge.at(2*ea);
+                    int qb = edge.at(2*eb)==ip ? edge.at(2*eb+1) : edge.at(2*eb);
+                    Segment3d sa(point.at(ip), point.at(qa));
+                    Segment3d sb(point.at(ip), point.at(qb));
+                    Segment3d overlap;
+                    if(!overlapSegments3d(sa, sb, overlap, precision, true) || overlap.length()<precision) continue;
+
+                    // the longer segment now starts at the far end of the shorter one
+                    int elong = sa.length()>=sb.length() ? ea : eb;
+                    int q     = sa.length()>=sb.length() ? qb : qa;
+                    int r     = sa.length()>=sb.length() ? qa : qb;
+                    incident[ip].removeOne(elong);
+                    // the segment no longer joins ip and r, so the key of (ip, r) is free for a later segment
+                    edgemap.remove((quint64(std::min(ip, r))<<32) | quint64(std::max(ip, r)));
+                    quint64 key = (quint64(std::min(q, r))<<32) | quint64(std::max(q, r));
+                    if(edgemap.contains(key))
+                    {
+                        incident[r].removeOne(elong);
+                        edge[2*elong] = edge[2*elong+1] = -1;
+                    }
+                    else
+                    {
+                        edgemap.insert(key, elong);
+                        edge[2*elong]   = q;
+                        edge[2*elong+1] = r;
+                        incident[q].append(elong);
+                        work.append(q);
+                    }
+                    bMerged = true;
+                }
+            }
+        }
+    }
+
+    // walk the chains from the points which do not join two segments, then the closed chains
+    QVector<bool> bUsed(nEdges, false);
+    for(int ie=0; ie<nEdges; ie++) bUsed[ie] = edge.at(2*ie)<0;
+    auto walk = [&](int ip, int ie)
+    {
+        QVector<Segment3d> chain;
+        while(ie>=0)
+        {
+            bUsed[ie] = true;
+            int iq = edge.at(2*ie)==ip ? edge.at(2*ie+1) : edge.at(2*ie);
+            chain.append(Segment3d(point.at(ip), point.at(iq)));
+            ip = iq;
+            ie = -1;
+            if(incident.at(ip).size()==2)
+            {
+                for(int je : incident.at(ip))
+                    if(!bUsed.at(je)) ie = je;
+            }
+        }
+        chains.append(chain);
+    };
+
+    for(int ip=0; ip<point.size(); ip++)
+    {
+        if(incident.at(ip).size()==2) continue;
+        for(int ie : incident.at(ip))
+            if(!bUsed.at(ie)) walk(ip, ie);
+    }
+    for(int ie=0; ie<nEdges; ie++)
+    {
+        if(!bUsed.at(ie)) walk(edge.at(2*ie), ie);
+    }
+}
+
+
 void makeSphere(double radius, int nSplit, QVector<Triangle3d> &triangles)
 {
     // make vertices
@@ -643,9 +814,13 @@ void makeSphere(double radius, int nSplit, QVector<Triangle3d> &triangles)
         {
             Triangle3d const& t3d = triangles.at(it);
 
-            M0.set(t3d.edge(0).midPoint());
-            M1.set(t3d.edge(1).midPoint());
-            M2.set(t3d.edge(2).midPoint());
+            // the mid points of the edges opposite to vertices 0, 1 and 2; made from the vertices to leave the triangle unprepared
+            Node const &S0 = t3d.vertexAt(0);
+            Node const &S1 = t3d.vertexAt(1);
+            Node const &S2 = t3d.vertexAt(2);
+            M0.set((S1.x+S2.x)/2.0, (S1.y+S2.y)/2.0, (S1.z+S2.z)/2.0);
+            M1.set((S2.x+S0.x)/2.0, (S2.y+S0.y)/2.0, (S2.z+S0.z)/2.0);
+            M2.set((S0.x+S1.x)/2.0, (S0.y+S1.y)/2.0, (S0.z+S1.z)/2.0);
 
             // project radially the mid points onto the unit sphere
             M0.normalize();
@@ -37,6 +37,7 @@ bool intersectRay(Vector2d const &A0, Vector2d const &A1, Vector2d const &O, Vec
 
 bool intersectTriangles3d(Triangle3d const &t0, Triangle3d const &t1, Segment3d &seg, double precision);
 bool overlapSegments3d(Segment3d const &s0, Segment3d const &s1, Segment3d &seg, double precision, bool bCheckColinearity=false);
+void makeSegmentChains(QVector<Segment3d> const &segments, double precision, QVector<QVector<Segment3d>> &chains);
 
 double distanceToLine2d(const Vector2d &A, const Vector2d &B, const Vector2d &P);
 
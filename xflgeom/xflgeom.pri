@@ -10,13 +10,17 @@ HEADERS += \
     xflgeom/geom2d/vector2d.h \
     xflgeom/geom3d/cartesianframe.h \
     xflgeom/geom3d/frame.h \
+    xflgeom/geom3d/meshdecimator.h \
     xflgeom/geom3d/node.h \
+    xflgeom/geom3d/pointkdtree.h \
     xflgeom/geom3d/quad3d.h \
     xflgeom/geom3d/quaternion.h \
     xflgeom/geom3d/segment3d.h \
     xflgeom/geom3d/slg3d.h \
     xflgeom/geom3d/triangle3d.h \
+    xflgeom/geom3d/trianglebvh.h \
     xflgeom/geom3d/triangulation.h \
+    xflgeom/geom3d/trimesh.h \
     xflgeom/geom3d/vector3d.h \
     xflgeom/geom_globals/geom_global.h \
     xflgeom/geom_globals/geom_params.h \
@@ -32,12 +36,16 @@ SOURCES += \
     xflgeom/geom2d/triangle2d.cpp \
     xflgeom/geom2d/vector2d.cpp \
     xflgeom/geom3d/frame.cpp \
+    xflgeom/geom3d/meshdecimator.cpp \
     xflgeom/geom3d/node.cpp \
+    xflgeom/geom3d/pointkdtree.cpp \
     xflgeom/geom3d/quad3d.cpp \
     xflgeom/geom3d/quaternion.cpp \
     xflgeom/geom3d/segment3d.cpp \
     xflgeom/geom3d/slg3d.cpp \
     xflgeom/geom3d/triangle3d.cpp \
+    xflgeom/geom3d/trianglebvh.cpp \
     xflgeom/geom3d/triangulation.cpp \
+    xflgeom/geom3d/trimesh.cpp \
     xflgeom/geom3d/vector3d.cpp \
     xflgeom/geom_globals/geom_global.cpp \
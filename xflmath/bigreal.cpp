@@ -0,0 +1,241 @@
+/****************************************************************************
+
+    Xfl3d application
+    Copyright (C) Andre Deperrois
+    License: GPL v3
+
+*****************************************************************************/
+
+#include <algorithm>
+#include <cmath>
+
+#include "bigreal.h"
+
+
+BigReal::BigReal()
+{
+    m_bNeg = false;
+    for(int i=0; i<NLIMBS; i++) m_Limb[i] = 0;
+}
+
+
+BigReal::BigReal(double d)
+{
+    setDouble(d);
+}
+
+
+/** The conversion is exact, since the double's 53 bit mantissa fits in the first limbs */
+void BigReal::setDouble(double d)
+{
+    for(int i=0; i<NLIMBS; i++) m_Limb[i] = 0;
+    m_bNeg = d<0.0;
+    d = fabs(d);
+
+    double intpart = floor(d);
+    m_Limb[0] = quint32(intpart);
+    d -= intpart;
+    for(int i=1; i<NLIMBS && d>0.0; i++)
+    {
+        d *= 4294967296.0;
+        double limb = floor(d);
+        m_Limb[i] = quint32(limb);
+        d -= limb;
+    }
+    if(isZero()) m_bNeg = false;
+}
+
+
+/**
+ * Sums the first nonzero limb and the two next ones, i.e. at least 65 significant bits,
+ * so that the result is rounded to double precision whatever the magnitude of the value.
+ */
+double BigReal::toDouble() const
+{
+    int first = 0;
+    while(first<NLIMBS && m_Limb[first]==0) first++;
+
+    double d = 0.0;
+    for(int i=std::min(first+2, NLIMBS-1); i>=first; i--)
+        d += ldexp(double(m_Limb[i]), -32*i);
+    return m_bNeg ? -d : d;
+}
+
+
+bool BigReal::isZero() const
+{
+    for(int i=0; i<NLIMBS; i++)
+        if(m_Limb[i]!=0) return false;
+    return true;
+}
+
+
+int BigReal::compareMagnitude(BigReal const &a, BigReal const &b)
+{
+    for(int i=0; i<NLIMBS; i++)
+    {
+        if(a.m_Limb[i]>b.m_Limb[i]) return  1;
+        if(a.m_Limb[i]<b.m_Limb[i]) return -1;
+    }
+    return 0;
+}
+
+
+void BigReal::addMagnitude(BigReal const &a, BigReal const &b, BigReal &r)
+{
+    quint64 carry = 0;
+    for(int i=NLIMBS-1; i>=0; i--)
+    {
+        quint64 sum = quint64(a.m_Limb[i]) + quint64(b.m_Limb[i]) + carry;
+        r.m_Limb[i] = quint32(sum);
+        carry = sum>>32;
+    }
+}
+
+
+/** r = a-b, assuming |a|>=|b| */
+void BigReal::subMagnitude(BigReal const &a, BigReal const &b, BigReal &r)
+{
+    qint64 borrow = 0;
+    for(int i=NLIMBS-1; i>=0; i--)
+    {
+        qint64 diff = qint64(a.m_Limb[i]) - qint64(b.m_Limb[i]) - borrow;
+        borrow = diff<0 ? 1 : 0;
+        if(diff<0) diff += qint64(4294967296LL);
+        r.m_Limb[i] = quint32(diff);
+    }
+}
+
+
+BigReal BigReal::operator+(BigReal const &b) const
+{
+    BigReal r;
+    if(m_bNeg==b.m_bNeg)
+    {
+        addMagnitude(*this, b, r);
+        r.m_bNeg = m_bNeg;
+    }
+    else if(compareMagnitude(*this, b)>=0)
+    {
+        subMagnitude(*this, b, r);
+        r.m_bNeg = m_bNeg;
+    }
+    else
+    {
+        subMagnitude(b, *this, r);
+        r.m_bNeg = b.m_bNeg;
+    }
+    if(r.isZero()) r.m_bNeg = false;
+    return r;
+}
+
+
+/** Schoolbook multiplication, truncated to the resolution of the fixed-point representation */
+BigReal BigReal::operator*(BigReal const &b) const
+{
+    // the product of limbs i and j has weight 2^(-32(i+j));
+    // keep one extra limb to propagate the carries into the last limb
+    quint64 acc[NLIMBS+1];
+    for(int k=0; k<=NLIMBS; k++) acc[k] = 0;
+
+    for(int i=0; i<NLIMBS; i++)
+    {
+        if(m_Limb[i]==0) continue;
+        for(int j=0; i+j<=NLIMBS && j<NLIMBS; j++)
+        {
+            quint64 p = quint64(m_Limb[i]) * quint64(b.m_Limb[j]);
+            int k = i+j;
+            if(k<=NLIMBS) acc[k]   += p & 0xffffffffULL;
+            if(k>0)       acc[k-1] += p>>32;
+        }
+    }
+
+    BigReal r;
+    quint64 carry = 0;
+    for(int k=NLIMBS; k>=0; k--)
+    {
+        quint64 sum = acc[k] + carry;
+        if(k<NLIMBS) r.m_Limb[k] = quint32(sum);
+        carry = sum>>32;
+    }
+    r.m_bNeg = (m_bNeg!=b.m_bNeg);
+    if(r.isZero()) r.m_bNeg = false;
+    return r;
+}
+
+
+/** Divides the magnitude in place by a small integer */
+void BigReal::divideBy(quint32 d)
+{
+    quint64 rem = 0;
+    for(int i=0; i<NLIMBS; i++)
+    {
+        quint64 cur = (rem<<32) | quint64(m_Limb[i]);
+        m_Limb[i] = quint32(cur/d);
+        rem = cur%d;
+    }
+}
+
+
+/** Returns the decimal representation; ndecimals<0 prints all the significant decimals */
+QString BigReal::toString(int ndecimals) const
+{
+    if(ndecimals<0) ndecimals = int((NLIMBS-1)*32*0.30103);
+
+    QString str = m_bNeg ? "-" : "";
+    str += QString::number(m_Limb[0]);
+    str += ".";
+
+    BigReal frac(*this);
+    frac.m_Limb[0] = 0;
+    for(int id=0; id<ndecimals; id++)
+    {
+        // multiply the fractional part by 10 and extract the integer digit
+        quint64 carry = 0;
+        for(int i=NLIMBS-1; i>=1; i--)
+        {
+            quint64 prod = quint64(frac.m_Limb[i])*10ULL + carry;
+            frac.m_Limb[i] = quint32(prod);
+            carry = prod>>32;
+        }
+        str += QChar('0'+int(carry));
+    }
+    return str;
+}
+
+
+bool BigReal::fromString(QString const &str)
+{
+    QString s = str.trimmed();
+    bool bNeg = false;
+    if(s.startsWith('-'))
+    {
+        bNeg = true;
+        s = s.mid(1);
+    }
+    else if(s.startsWith('+')) s = s.mid(1);
+
+    int idot = s.indexOf('.');
+    QString intpart  = idot>=0 ? s.left(idot) : s;
+    QString fracpart = idot>=0 ? s.mid(idot+1) : QString();
+
+    bool bOk = true;
+    quint32 intvalue = intpart.isEmpty() ? 0 : intpart.toUInt(&bOk);
+    if(!bOk) return false;
+
+    BigReal r;
+    // Horner's scheme from the last decimal: frac = (digit + frac)/10
+    for(int id=fracpart.length()-1; id>=0; id--)
+    {
+        QChar c = fracpart.at(id);
+        if(!c.isDigit()) return false;
+        r.m_Limb[0] += quint32(c.digitValue());
+        r.divideBy(10);
+    }
+    r.m_Limb[0] = intvalue;
+    r.m_bNeg = bNeg && !r.isZero();
+
+    *this = r;
+    return true;
+}
+
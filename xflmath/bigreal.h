@@ -0,0 +1,56 @@
+/****************************************************************************
+
+    Xfl3d application
+    Copyright (C) Andre Deperrois
+    License: GPL v3
+
+*****************************************************************************/
+
+#pragma once
+
+#include <QString>
+
+
+/**
+ * @class BigReal
+ * A signed fixed-point real number with a 32 bit integer part and NLIMBS-1 32 bit fractional limbs,
+ * i.e. a resolution of about 1e-144.
+ * Only the operations required to compute high precision reference orbits are implemented.
+ * The integer part is not checked for overflow.
+ */
+class BigReal
+{
+    public:
+        static int const NLIMBS = 16;
+
+    public:
+        BigReal();
+        BigReal(double d);
+
+        void setDouble(double d);
+        double toDouble() const;
+
+        bool isNegative() const {return m_bNeg;}
+        bool isZero() const;
+
+        BigReal operator-() const {BigReal r(*this); if(!r.isZero()) r.m_bNeg = !r.m_bNeg; return r;}
+        BigReal operator+(BigReal const &b) const;
+        BigReal operator-(BigReal const &b) const {return *this + (-b);}
+        BigReal operator*(BigReal const &b) const;
+        void operator+=(BigReal const &b) {*this = *this + b;}
+        void operator-=(BigReal const &b) {*this = *this - b;}
+
+        QString toString(int ndecimals=-1) const;
+        bool fromString(QString const &str);
+
+    private:
+        static int compareMagnitude(BigReal const &a, BigReal const &b);
+        static void addMagnitude(BigReal const &a, BigReal const &b, BigReal &r);
+        static void subMagnitude(BigReal const &a, BigReal const &b, BigReal &r);
+        void divideBy(quint32 d);
+
+    private:
+        bool m_bNeg;
+        quint32 m_Limb[NLIMBS]; /**< m_Limb[0] is the integer part; limb i has weight 2^(-32i) */
+};
+
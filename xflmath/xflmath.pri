@@ -2,9 +2,11 @@
 
 HEADERS += \
     $$PWD/matrix.h \
+    xflmath/bigreal.h \
     xflmath/constants.h \
     xflmath/mathelem.h \
 
 SOURCES += \
     $$PWD/matrix.cpp \
+    xflmath/bigreal.cpp \
     xflmath/mathelem.cpp \